@@ -0,0 +1,37 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+// CRC-16/IBM (полином 0xA001 отражённый, init 0xFFFF) — общий для ПК и прошивок.
+//
+// Варианты:
+//  - crc16_ibm_bitwise — эталонный побитовый расчёт;
+//  - crc16_ibm_table   — табличный, 1 байт за шаг (таблица 512 байт во flash);
+//  - crc16_ibm_slice8  — slice-by-8, 8 байт за шаг (таблицы 4 КБ в ОЗУ,
+//    строятся в crc16_init());
+//  - crc16_ibm_hw      — аппаратный блок CRC STM32 с программируемым
+//    полиномом (F0/F3/F7/G0/G4/L4/H7), только при -DCRC16_USE_STM32_HW.
+// crc16_ibm()/crc16_ibm_update() выбирают самый быстрый доступный путь.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC16_INIT 0xFFFF
+
+void crc16_init(void);
+
+uint16_t crc16_ibm_bitwise(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t crc16_ibm_table(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t crc16_ibm_slice8(uint16_t crc, const uint8_t *data, size_t len);
+#ifdef CRC16_USE_STM32_HW
+uint16_t crc16_ibm_hw(uint16_t crc, const uint8_t *data, size_t len);
+#endif
+
+// Продолжить расчёт с состояния crc (для кадров, собираемых по частям)
+uint16_t crc16_ibm_update(uint16_t crc, const uint8_t *data, size_t len);
+
+static inline uint16_t crc16_ibm(const uint8_t *data, size_t len)
+{
+    return crc16_ibm_update(CRC16_INIT, data, len);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include "osc_codec.h"
+
+size_t osc_pack12_encode(const uint16_t *src, size_t n, uint8_t *dst)
+{
+    uint8_t *out = dst;
+    size_t i = 0;
+    // Пара читается целиком до записи — поэтому годится и dst == src
+    for (; i + 2 <= n; i += 2) {
+        uint32_t a = src[i] & 0x0FFF, b = src[i + 1] & 0x0FFF;
+        out[0] = (uint8_t)a;
+        out[1] = (uint8_t)((a >> 8) | (b << 4));
+        out[2] = (uint8_t)(b >> 4);
+        out += 3;
+    }
+    if (i < n) {
+        uint32_t a = src[i] & 0x0FFF;
+        out[0] = (uint8_t)a;
+        out[1] = (uint8_t)(a >> 8);
+        out += 2;
+    }
+    return (size_t)(out - dst);
+}
+
+size_t osc_delta_size(const uint16_t *src, size_t n, size_t *wide)
+{
+    size_t bytes = 0, w = 0;
+    uint16_t prev = 0;
+    uint32_t run = 0;
+    for (size_t i = 0; i < n; i++) {
+        int32_t d = (int32_t)src[i] - prev;
+        prev = src[i];
+        if (d == 0) {
+            if (run++ == 0) bytes++;
+            if (run == 64) run = 0;
+            continue;
+        }
+        run = 0;
+        if (d >= -64 && d <= 63) bytes += 1;
+        else if (d >= -4096 && d <= 4095) bytes += 2;
+        else {
+            bytes += 3;
+            w++;
+        }
+    }
+    if (wide) *wide = w;
+    return bytes;
+}
+
+size_t osc_delta_encode(const uint16_t *src, size_t n, uint8_t *dst)
+{
+    uint8_t *out = dst;
+    uint16_t prev = 0;
+    uint32_t run = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint16_t x = src[i];
+        int32_t d = (int32_t)x - prev;
+        prev = x;
+        if (d == 0) {
+            // Счётчик серии пишем сразу и дописываем на месте: так запись
+            // никогда не обгоняет чтение
+            if (run == 0) *out++ = 0x80;
+            else out[-1] = (uint8_t)(0x80 | run);
+            if (++run == 64) run = 0;
+            continue;
+        }
+        run = 0;
+        if (d >= -64 && d <= 63) {
+            *out++ = (uint8_t)(d & 0x7F);
+        } else if (d >= -4096 && d <= 4095) {
+            *out++ = (uint8_t)(0xC0 | ((d >> 8) & 0x1F));
+            *out++ = (uint8_t)d;
+        } else {
+            *out++ = 0xE0;
+            *out++ = (uint8_t)x;
+            *out++ = (uint8_t)(x >> 8);
+        }
+    }
+    return (size_t)(out - dst);
+}
+
+bool osc_pack12_decode_ref(const uint8_t *src, size_t len, uint16_t *dst, size_t n)
+{
+    if (len != OSC_PACK12_BYTES(n)) return false;
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2, src += 3) {
+        dst[i] = src[0] | ((src[1] & 0x0F) << 8);
+        dst[i + 1] = (src[1] >> 4) | (src[2] << 4);
+    }
+    if (i < n) dst[i] = src[0] | ((src[1] & 0x0F) << 8);
+    return true;
+}
+
+bool osc_delta_decode_ref(const uint8_t *src, size_t len, uint16_t *dst, size_t n)
+{
+    const uint8_t *end = src + len;
+    uint16_t x = 0;
+    size_t i = 0;
+    while (src < end && i < n) {
+        uint8_t t = *src++;
+        if (t < 0x80) {
+            x += (int8_t)(t << 1) >> 1;
+            dst[i++] = x;
+        } else if (t < 0xC0) {
+            size_t run = (t & 0x3F) + 1u;
+            if (run > n - i) return false;
+            while (run--) dst[i++] = x;
+        } else if (t < 0xE0) {
+            if (src == end) return false;
+            int32_t d = ((t & 0x1F) << 8) | *src++;
+            x += (int16_t)(d << 3) >> 3;
+            dst[i++] = x;
+        } else if (t == 0xE0) {
+            if (end - src < 2) return false;
+            x = src[0] | (src[1] << 8);
+            src += 2;
+            dst[i++] = x;
+        } else {
+            return false;
+        }
+    }
+    return i == n && src == end;
+}
@@ -0,0 +1,37 @@
+#ifndef OSC_CODEC_H
+#define OSC_CODEC_H
+
+// Кодирование отсчётов в OSC_DATA_EXT (см. docs/protocol.md) — общее для
+// прошивки (кодер) и ПК (эталонный декодер; быстрые — pc-app/unpack.c).
+//
+// OSC_ENC_RAW16  — u16 little-endian, как в OSC_DATA.
+// OSC_ENC_PACK12 — 2 отсчёта в 3 байтах: b0 = a[7:0], b1 = a[11:8] | b[3:0] << 4,
+//                  b2 = b[11:4]; при нечётном n последний отсчёт — 2 байта (b0, b1).
+// OSC_ENC_DELTA  — разности соседних отсчётов (первый — от 0), токены:
+//   0ddddddd           разность -64..63
+//   10rrrrrr           r + 1 нулевых разностей (1..64)
+//   110ddddd dddddddd  разность -4096..4095 (старшие биты в первом байте)
+//   11100000 lo hi     сам отсчёт, 16 бит
+//
+// Кодеры работают и на месте (dst == src): выход не обгоняет чтение. Для
+// DELTA это верно, пока нет 3-байтовых токенов (osc_delta_size считает их).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum { OSC_ENC_RAW16 = 0, OSC_ENC_PACK12 = 1, OSC_ENC_DELTA = 2, OSC_ENC_COUNT };
+#define OSC_ENC_BIT(e)      (1u << (e))
+#define OSC_PACK12_BYTES(n) (((size_t)(n) * 3 + 1) / 2)
+
+size_t osc_pack12_encode(const uint16_t *src, size_t n, uint8_t *dst);
+
+// Размер потока DELTA; *wide — сколько 3-байтовых токенов (можно NULL)
+size_t osc_delta_size(const uint16_t *src, size_t n, size_t *wide);
+size_t osc_delta_encode(const uint16_t *src, size_t n, uint8_t *dst);
+
+// Эталонные декодеры: true, если вход дал ровно n отсчётов без остатка
+bool osc_pack12_decode_ref(const uint8_t *src, size_t len, uint16_t *dst, size_t n);
+bool osc_delta_decode_ref(const uint8_t *src, size_t len, uint16_t *dst, size_t n);
+
+#endif
@@ -0,0 +1,155 @@
+#include "dds.h"
+
+#include <math.h>
+
+uint32_t dds_step(uint32_t freq_mHz)
+{
+    const uint64_t fs_mHz = (uint64_t)DDS_RATE_HZ * 1000;
+    if (freq_mHz > DDS_MAX_mHz) freq_mHz = DDS_MAX_mHz;
+    return (uint32_t)((((uint64_t)freq_mHz << 32) + fs_mHz / 2) / fs_mHz);
+}
+
+void dds_init(dds_t *d, const uint16_t *table, uint32_t len, uint32_t freq_mHz)
+{
+    d->phase = 0;
+    d->step = dds_step(freq_mHz);
+    d->table = table;
+    d->len = len;
+    d->sweeping = false;
+    d->step_pending = d->table_pending = d->sweep_pending = false;
+}
+
+void dds_set_freq(dds_t *d, uint32_t freq_mHz)
+{
+    d->sweep_pending = false;
+    d->step_pending = false;
+    d->next_step = dds_step(freq_mHz);
+    d->step_pending = true;
+}
+
+void dds_set_table(dds_t *d, const uint16_t *table, uint32_t len)
+{
+    d->table_pending = false;
+    d->next_table = table;
+    d->next_len = len;
+    d->table_pending = true;
+}
+
+bool dds_table_busy(const dds_t *d)
+{
+    return d->table_pending;
+}
+
+// Свип: шаг 32.32 раз в блок (половину буфера) — прибавкой или умножением
+// на постоянный множитель; в конце — точно f1 (или снова f0)
+bool dds_sweep(dds_t *d, uint32_t f0_mHz, uint32_t f1_mHz, uint32_t time_ms, uint8_t flags)
+{
+    const uint64_t fs_mHz = (uint64_t)DDS_RATE_HZ * 1000;
+    if (!time_ms || f0_mHz > DDS_MAX_mHz || f1_mHz > DDS_MAX_mHz) return false;
+    uint32_t blocks = (uint32_t)((uint64_t)time_ms * DDS_RATE_HZ / 1000 / DDS_HALF);
+    if (!blocks) blocks = 1;
+    uint64_t from = ((uint64_t)f0_mHz << 32) / fs_mHz << 32;
+    uint64_t to = ((uint64_t)f1_mHz << 32) / fs_mHz << 32;
+    // Дробная часть шага: остаток деления, ещё 32 бита
+    from |= (((uint64_t)f0_mHz << 32) % fs_mHz << 32) / fs_mHz;
+    to |= (((uint64_t)f1_mHz << 32) % fs_mHz << 32) / fs_mHz;
+    int64_t inc = 0, mul = 0;
+    if (flags & DDS_SWEEP_LOG) {
+        if (!f0_mHz || !f1_mHz) return false;
+        float x = expm1f(logf((float)f1_mHz / f0_mHz) / blocks);
+        if (x <= -0.5f || x >= 0.5f) return false;  // быстрее чем вдвое за блок
+        mul = (int64_t)(x * 4294967296.0f);
+    } else {
+        inc = (int64_t)(to - from) / (int64_t)blocks;
+    }
+
+    d->step_pending = false;
+    d->sweep_pending = false;
+    d->next_from = from;
+    d->next_to = to;
+    d->next_inc = inc;
+    d->next_mul = mul;
+    d->next_blocks = blocks;
+    d->next_flags = flags;
+    d->sweep_pending = true;
+    return true;
+}
+
+static void sweep_advance(dds_t *d)
+{
+    if (--d->sweep_left == 0) {
+        if (d->sweep_flags & DDS_SWEEP_REPEAT) {
+            d->sweep_step = d->sweep_from;
+            d->sweep_left = d->sweep_blocks;
+        } else {
+            d->sweep_step = d->sweep_to;
+            d->sweeping = false;
+        }
+    } else if (d->sweep_flags & DDS_SWEEP_LOG) {
+        // step * (1 + mul / 2^32) без переполнения: step < 2^63, |mul| < 2^31
+        uint64_t hi = d->sweep_step >> 32, lo = d->sweep_step & 0xFFFFFFFFu;
+        d->sweep_step += (uint64_t)((int64_t)hi * d->sweep_mul + (((int64_t)lo * d->sweep_mul) >> 32));
+    } else {
+        d->sweep_step += (uint64_t)d->sweep_inc;
+    }
+    d->step = (uint32_t)((d->sweep_step + 0x80000000u) >> 32);
+}
+
+// Запросы основного цикла — с начала блока: фаза не сбрасывается, меняются
+// только шаг и таблица
+static void take_pending(dds_t *d)
+{
+    if (d->table_pending) {
+        d->table = d->next_table;
+        d->len = d->next_len;
+        d->table_pending = false;
+    }
+    if (d->sweep_pending) {
+        d->sweep_from = d->sweep_step = d->next_from;
+        d->sweep_to = d->next_to;
+        d->sweep_inc = d->next_inc;
+        d->sweep_mul = d->next_mul;
+        d->sweep_blocks = d->sweep_left = d->next_blocks;
+        d->sweep_flags = d->next_flags;
+        d->sweeping = true;
+        d->step = (uint32_t)((d->sweep_step + 0x80000000u) >> 32);
+        d->sweep_pending = false;
+    }
+    if (d->step_pending) {
+        d->step = d->next_step;
+        d->sweeping = false;
+        d->step_pending = false;
+    }
+}
+
+// Отсчёт — линейная интерполяция между соседними точками таблицы по
+// старшим битам фазы: у 256 точек без неё паразитные составляющие около
+// -48 дБ, с ней их не видно за шумом квантования 12 бит. 256 точек —
+// индекс и доля прямо из фазы; другая длина (user) — умножение 32x32.
+void dds_fill(dds_t *d, uint16_t *out, uint16_t n)
+{
+    take_pending(d);
+    uint32_t ph = d->phase, step = d->step;
+    const uint16_t *t = d->table;
+    if (d->len == 256) {
+        for (uint16_t i = 0; i < n; i++) {
+            uint32_t k = ph >> 24;
+            int32_t fr = (ph >> 8) & 0xFFFF;
+            int32_t a = t[k], b = t[k + 1];
+            out[i] = (uint16_t)(a + (((b - a) * fr) >> 16));
+            ph += step;
+        }
+    } else {
+        uint32_t len = d->len;
+        for (uint16_t i = 0; i < n; i++) {
+            uint64_t pos = (uint64_t)ph * len;
+            uint32_t k = (uint32_t)(pos >> 32);
+            int32_t fr = (int32_t)((uint32_t)pos >> 16);
+            int32_t a = t[k], b = t[k + 1];
+            out[i] = (uint16_t)(a + (((b - a) * fr) >> 16));
+            ph += step;
+        }
+    }
+    d->phase = ph;
+    if (d->sweeping) sweep_advance(d);
+}
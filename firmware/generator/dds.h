@@ -0,0 +1,67 @@
+#ifndef DDS_H
+#define DDS_H
+
+// Режим DDS генератора: ЦАП на постоянной частоте DDS_RATE_HZ, отсчёты
+// считает 32-битный аккумулятор фазы по таблице формы. Частота — только
+// приращение фазы: шаг DDS_RATE_HZ / 2^32 (0,23 мГц), смена частоты без
+// перенастройки таймера и без скачка фазы. Не зависит от HAL — собирается
+// и на ПК (firmware/host/check_dds).
+//
+// DMA circular читает буфер из двух половин по DDS_HALF отсчётов; по
+// прерыванию половины передачи dds_fill пишет первую половину, по концу —
+// вторую. Новые частота, таблица, свип из основного цикла применяются с
+// начала следующей половины.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DDS_RATE_HZ  1000000u   // отсчётов ЦАП в секунду
+#define DDS_HALF     256        // отсчётов в половине буфера DMA (256 мкс)
+#define DDS_BUF_LEN  (2 * DDS_HALF)
+#define DDS_MAX_mHz  (DDS_RATE_HZ / 2 * 1000u)
+
+enum { DDS_SWEEP_LOG = 1, DDS_SWEEP_REPEAT = 2 };
+
+typedef struct {
+    uint32_t phase;             // 2^32 — период
+    uint32_t step;              // приращение фазы за отсчёт
+    const uint16_t *table;      // len + 1 точек, последняя равна первой
+    uint32_t len;
+    // Свип: шаг в 32.32, меняется раз в половину буфера
+    bool sweeping;
+    uint8_t sweep_flags;        // DDS_SWEEP_*
+    uint64_t sweep_step;
+    uint64_t sweep_from;
+    uint64_t sweep_to;
+    int64_t sweep_inc;          // линейный: прибавка за блок
+    int64_t sweep_mul;          // логарифмический: (множитель - 1) * 2^32
+    uint32_t sweep_blocks, sweep_left;
+    // Из основного цикла: поля next_* пишутся при сброшенном флаге,
+    // прерывание забирает их, когда флаг поднят
+    volatile bool step_pending, table_pending, sweep_pending;
+    uint32_t next_step;
+    const uint16_t *next_table;
+    uint32_t next_len;
+    uint64_t next_from, next_to;
+    int64_t next_inc, next_mul;
+    uint32_t next_blocks;
+    uint8_t next_flags;
+} dds_t;
+
+// table — len + 1 точек (table[len] = table[0]); фаза с нуля
+void dds_init(dds_t *d, const uint16_t *table, uint32_t len, uint32_t freq_mHz);
+// Приращение фазы для частоты (до DDS_MAX_mHz)
+uint32_t dds_step(uint32_t freq_mHz);
+// Из основного цикла. Частота — фаза продолжается, свип прекращается
+void dds_set_freq(dds_t *d, uint32_t freq_mHz);
+// Новая таблица с начала следующей половины; прежнюю не трогать, пока
+// dds_table_busy
+void dds_set_table(dds_t *d, const uint16_t *table, uint32_t len);
+bool dds_table_busy(const dds_t *d);
+// Свип от f0 до f1 за time_ms (линейный или логарифмический, по кругу или
+// до f1 и стоп); false — недопустимые параметры
+bool dds_sweep(dds_t *d, uint32_t f0_mHz, uint32_t f1_mHz, uint32_t time_ms, uint8_t flags);
+// Прерывание DMA: n отсчётов в out
+void dds_fill(dds_t *d, uint16_t *out, uint16_t n);
+
+#endif
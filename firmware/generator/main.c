@@ -8,39 +8,103 @@
 #include <stdint.h>
 #include <math.h>
 
-// Настройки таблиц
-#define WAVE_TABLE_POINTS 256
-#define MAX_USER_POINTS   1024
-
-// Типы форм
-enum {
-    WAVE_SINE = 0,
-    WAVE_RECT_FULL,
-    WAVE_RECT_HALF,
-    WAVE_SAW,
-    WAVE_TRI,
-    WAVE_SQUARE,
-    WAVE_USER
-};
-
-// Текущие параметры
-static uint8_t wave_type = WAVE_SINE;
-static uint32_t freq_mHz = 1000000;  // 1 кГц по умолчанию
-static uint16_t ampl_mVpp = 1000;    // 1 В пик-пик
-static int16_t offset_mV = 0;
-static uint16_t duty_permille = 500;
-
-static uint16_t wave_table[MAX_USER_POINTS];
+#include "crc16.h"          // common/crc16.c
+#include "wave.h"           // таблицы форм и замена без разрыва
+#include "dds.h"            // режим DDS: постоянная частота ЦАП, аккумулятор фазы
+
+// Приём команд: кадры протокола (docs/protocol.md), payload до upload_wave
+// в 1024 точки; таблицы длиннее — только кусками
+#define CMD_MAX_PAYLOAD   (2 + 1024 * 2)
+#define CMD_RESP          0x80   // ответ: cmd | 0x80
+#define REPLY_MAX_PAYLOAD 16
+
+// Коды ошибок в первом байте ответа
+enum { ERR_OK = 0, ERR_PARAM = 1, ERR_UNKNOWN = 2 };
+
+#define CMD_SET_ALL       0x16   // {u8 wave; u32 freq_mHz; u16 ampl_mVpp; i16 offset_mV; u16 duty_permille}
+#define CMD_SET_MODE      0x17   // {u8 mode}
+#define CMD_SWEEP         0x18   // {u32 f0_mHz; u32 f1_mHz; u32 time_ms; u8 flags}
+#define CMD_UPLOAD_BEGIN  0x19   // {u32 n; u16 chunk_points; u16 crc}
+#define CMD_UPLOAD_CHUNK  0x1A   // {u32 offset; u16 n; u16 crc; n×u16}
+#define CMD_UPLOAD_COMMIT 0x1B   // -> {u8 err; u16 missing}
+#define UPLOAD_CHUNK_MAX  512    // точек в куске
+
+// Режимы: таблица на частоте ЦАП под частоту сигнала или DDS
+enum { GEN_MODE_TABLE = 0, GEN_MODE_DDS = 1 };
+
+// Текущие параметры: 1 кГц, 1 В пик-пик
+static wave_params_t gen = {WAVE_SINE, 1000000, 1000, 0, 500};
+
+// Табличный режим и DDS не работают одновременно, их таблицы делят одну
+// память; смена режима — только при остановленном DMA (apply_pending,
+// start_dds). Вместе с user_table и upload_buf — четыре таблицы по
+// MAX_USER_POINTS (wave.h), а не шесть.
+static union {
+    struct {
+        uint16_t dac[MAX_USER_POINTS];
+        uint16_t wave[MAX_USER_POINTS + 1];
+    } tab;
+    uint16_t dds[2][MAX_USER_POINTS + 1];
+} gen_mem;
+
+// dac_buf читает DMA по кругу; wave_table — теневая таблица, из неё
+// wave_swap переносит новую форму в dac_buf на границах DMA. Таблицы на
+// точку длиннее: в DDS за последней точкой повтор первой.
+static uint16_t *const dac_buf = gen_mem.tab.dac;
+static uint16_t *const wave_table = gen_mem.tab.wave;
 static uint16_t table_len = WAVE_TABLE_POINTS;
+static wave_swap_t swap;
+static uint16_t user_table[MAX_USER_POINTS];    // upload_wave
+static uint16_t user_len = 0;
+
+// Загрузка кусками: куски ложатся в upload_buf по смещениям в любом
+// порядке (повтор того же куска безвреден), got — принятые куски; commit
+// при всех кусках и верном CRC целого переносит таблицу в user_table.
+// До commit генератор играет прежнюю форму.
+static uint16_t upload_buf[MAX_USER_POINTS];
+static struct {
+    bool active;
+    uint16_t n, chunk;
+    uint16_t crc;               // crc16_ibm байтов всей таблицы
+    uint8_t got[(MAX_USER_POINTS + 7) / 8];
+} upload;
+
+// DDS: DMA по кругу читает dds_buf, половины пишет dds_fill в прерываниях;
+// таблиц формы две (в gen_mem) — новая считается в той, что не читается
+static uint8_t gen_mode = GEN_MODE_TABLE;
+static volatile bool dds_on;
+static dds_t dds;
+static uint16_t dds_buf[DDS_BUF_LEN];
+static uint16_t (*const dds_tab)[MAX_USER_POINTS + 1] = gen_mem.dds;
+static struct {
+    uint32_t f0_mHz, f1_mHz, time_ms;
+    uint8_t flags;
+} sweep;
+
+// Команды только отмечают, что поменялось; пересчёт — один раз за проход
+// основного цикла (apply_pending), сколько бы команд ни пришло
+static bool table_dirty, rate_dirty, mode_dirty, sweep_dirty;
+static volatile bool rate_on_swap;  // частота — вместе с заменой таблицы
+
+static uint8_t cmd_buf[8 + CMD_MAX_PAYLOAD + 2];
+static uint16_t cmd_fill = 0;
+static uint32_t rx_crc_errors;
 
 static void SystemClock_Config(void);
 static void MX_DAC_PWM_Init(void);
 static void MX_USB_UART_Init(void);
 static void MX_TIM_Wave_Init(uint32_t freq_mHz, uint16_t points);
+static void tim_set_rate(uint32_t freq_mHz, uint16_t points);
+static void start_dac_dma(uint16_t *buf, uint16_t points);
+static void stop_dac_dma(void);
 static void apply_waveform(void);
-static void fill_wave_table(uint8_t type);
-static void handle_command(uint8_t *pkt, uint16_t len);
-static uint16_t crc16_ibm(const uint8_t *data, uint16_t len);
+static uint16_t fill_table(uint16_t *t);
+static void start_dds(void);
+static void apply_pending(void);
+static void poll_commands(void);
+static void handle_command(uint16_t seq, uint8_t cmd, const uint8_t *p, uint16_t len);
+static void link_write(const uint8_t *data, uint16_t len);
+static uint16_t link_read(uint8_t *data, uint16_t max);
 
 // Можно улучшить: добавить калибровку амплитуды с учётом опорного напряжения.
 
@@ -48,176 +112,370 @@ int main(void)
 {
     HAL_Init();
     SystemClock_Config();
+    crc16_init();
     MX_DAC_PWM_Init();
     MX_USB_UART_Init();
 
-    fill_wave_table(wave_type);
-    MX_TIM_Wave_Init(freq_mHz, table_len);
+    wave_init();
+    table_len = fill_table(wave_table);
     apply_waveform();
 
     while (1) {
-        // TODO: читать входящие кадры по USB CDC/UART и вызывать handle_command()
+        poll_commands();
+        apply_pending();
         // Можно добавить светодиод статуса.
     }
 }
 
-// Обработка команд
-static void handle_command(uint8_t *pkt, uint16_t len)
+// Прерывания DMA ЦАП (у PWM — XferHalfCpltCallback / XferCpltCallback
+// DMA таймера): замена таблицы по половинам; частота — с той же границы,
+// что и новая таблица. В DDS — отсчёты освободившейся половины.
+void HAL_DAC_ConvHalfCpltCallbackCh1(DAC_HandleTypeDef *hdac)
 {
-    if (len < 6) return;
-    uint8_t cmd = pkt[5];
+    (void)hdac;
+    if (dds_on) {
+        dds_fill(&dds, dds_buf, DDS_HALF);
+        return;
+    }
+    wave_swap_half(&swap);
+}
+
+void HAL_DAC_ConvCpltCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+    (void)hdac;
+    if (dds_on) {
+        dds_fill(&dds, dds_buf + DDS_HALF, DDS_HALF);
+        return;
+    }
+    if (wave_swap_full(&swap) && rate_on_swap) {
+        rate_on_swap = false;
+        tim_set_rate(gen.freq_mHz, table_len);
+    }
+}
+
+// Приём команд: копим байты линии, ищем sync, проверяем длину и CRC.
+// Битый кадр сдвигает поиск на байт (как у осциллографа).
+static void poll_commands(void)
+{
+    cmd_fill += link_read(cmd_buf + cmd_fill, sizeof(cmd_buf) - cmd_fill);
+    while (cmd_fill >= 8) {
+        uint16_t skip = 1;
+        if (cmd_buf[0] == 0x55 && cmd_buf[1] == 0xAA) {
+            uint16_t len = cmd_buf[6] | (cmd_buf[7] << 8);
+            if (cmd_buf[2] == 0x01 && len <= CMD_MAX_PAYLOAD) {
+                uint16_t total = 8 + len + 2;
+                if (cmd_fill < total) return;   // ждём остаток кадра
+                uint16_t crc = cmd_buf[8 + len] | (cmd_buf[9 + len] << 8);
+                if (crc16_ibm(&cmd_buf[2], 6 + len) == crc) {
+                    handle_command(cmd_buf[3] | (cmd_buf[4] << 8), cmd_buf[5], &cmd_buf[8], len);
+                    skip = total;
+                } else {
+                    rx_crc_errors++;
+                }
+            }
+        }
+        cmd_fill -= skip;
+        memmove(cmd_buf, cmd_buf + skip, cmd_fill);
+    }
+}
+
+// Ответ на команду: тот же seq, cmd | 0x80. Потока данных у генератора нет,
+// ответ уходит сразу, до следующей команды — ПК шлёт команды подряд, не
+// дожидаясь ответов, и сверяет их по seq.
+static void send_reply(uint16_t seq, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    uint8_t buf[8 + REPLY_MAX_PAYLOAD + 2];
+    uint16_t idx = 0;
+    if (len > REPLY_MAX_PAYLOAD) return;
+    buf[idx++] = 0x55;
+    buf[idx++] = 0xAA;
+    buf[idx++] = 0x01;
+    buf[idx++] = seq & 0xFF;
+    buf[idx++] = seq >> 8;
+    buf[idx++] = cmd | CMD_RESP;
+    buf[idx++] = len & 0xFF;
+    buf[idx++] = len >> 8;
+    memcpy(&buf[idx], payload, len);
+    idx += len;
+    uint16_t crc = crc16_ibm(&buf[2], idx - 2);
+    buf[idx++] = crc & 0xFF;
+    buf[idx++] = crc >> 8;
+    link_write(buf, idx);
+}
+
+static void reply_err(uint16_t seq, uint8_t cmd, uint8_t err)
+{
+    send_reply(seq, cmd, &err, 1);
+}
+
+// Обработка команды; p — payload длиной len. Ответ — на каждую: {u8 err}
+// (get_gen_status — err и параметры)
+static void handle_command(uint16_t seq, uint8_t cmd, const uint8_t *p, uint16_t len)
+{
+    uint8_t err = ERR_PARAM;
 
     switch (cmd) {
     case 0x10: // set_wave
-        if (len >= 7) {
-            wave_type = pkt[6];
-            if (wave_type != WAVE_USER) {
-                fill_wave_table(wave_type);
-            }
-            apply_waveform();
+        if (len >= 1 && p[0] <= WAVE_USER && (p[0] != WAVE_USER || user_len)) {
+            gen.type = p[0];
+            table_dirty = true;
+            err = ERR_OK;
         }
         break;
     case 0x11: // set_freq
-        if (len >= 10) {
-            memcpy(&freq_mHz, &pkt[6], 4);
-            MX_TIM_Wave_Init(freq_mHz, table_len);
-            apply_waveform();
+        if (len >= 4) {
+            memcpy(&gen.freq_mHz, &p[0], 4);
+            rate_dirty = true;
+            err = ERR_OK;
         }
         break;
     case 0x12: // set_ampl
-        if (len >= 8) {
-            memcpy(&ampl_mVpp, &pkt[6], 2);
-            fill_wave_table(wave_type);
-            apply_waveform();
+        if (len >= 2) {
+            memcpy(&gen.ampl_mVpp, &p[0], 2);
+            table_dirty |= gen.type != WAVE_USER;
+            err = ERR_OK;
         }
         break;
     case 0x13: // set_offset
-        if (len >= 8) {
-            memcpy(&offset_mV, &pkt[6], 2);
-            fill_wave_table(wave_type);
-            apply_waveform();
+        if (len >= 2) {
+            memcpy(&gen.offset_mV, &p[0], 2);
+            table_dirty |= gen.type != WAVE_USER;
+            err = ERR_OK;
         }
         break;
     case 0x14: // set_duty (для меандра)
-        if (len >= 8) {
-            memcpy(&duty_permille, &pkt[6], 2);
-            if (wave_type == WAVE_SQUARE) {
-                fill_wave_table(wave_type);
-                apply_waveform();
-            }
+        if (len >= 2) {
+            memcpy(&gen.duty_permille, &p[0], 2);
+            table_dirty |= gen.type == WAVE_SQUARE;
+            err = ERR_OK;
         }
         break;
     case 0x15: // upload_wave
-        if (len >= 8) {
+        if (len >= 2) {
             uint16_t n = 0;
-            memcpy(&n, &pkt[6], 2);
-            if (n > 0 && n <= MAX_USER_POINTS && len >= 8 + n * 2) {
-                memcpy(wave_table, &pkt[8], n * 2);
-                table_len = n;
-                wave_type = WAVE_USER;
-                MX_TIM_Wave_Init(freq_mHz, table_len);
-                apply_waveform();
+            memcpy(&n, &p[0], 2);
+            if (n > 0 && n <= MAX_USER_POINTS && len >= 2 + n * 2) {
+                memcpy(user_table, &p[2], n * 2);
+                user_len = n;
+                gen.type = WAVE_USER;
+                table_dirty = true;
+                err = ERR_OK;
             }
         }
         break;
-    case 0x1F: // get_gen_status
-        // TODO: отправить ответ с текущими параметрами
-        break;
-    default:
-        // Можно улучшить: вернуть ошибку "неизвестная команда"
-        break;
-    }
-}
-
-// Заполнение таблиц форм
-static void fill_wave_table(uint8_t type)
-{
-    table_len = WAVE_TABLE_POINTS;
-    float ampl = ampl_mVpp / 2.0f;
-    float offset = offset_mV;
-
-    switch (type) {
-    case WAVE_SINE:
-        for (uint16_t i = 0; i < table_len; i++) {
-            float x = (2.0f * 3.1415926f * i) / table_len;
-            float v = offset + ampl * sinf(x);
-            if (v < 0) v = 0; // простая защита
-            if (v > 3300) v = 3300;
-            wave_table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+    case CMD_SET_ALL: // все параметры сразу: таблица и частота — один раз
+        if (len >= 11 && p[0] <= WAVE_USER && (p[0] != WAVE_USER || user_len)) {
+            gen.type = p[0];
+            memcpy(&gen.freq_mHz, &p[1], 4);
+            memcpy(&gen.ampl_mVpp, &p[5], 2);
+            memcpy(&gen.offset_mV, &p[7], 2);
+            memcpy(&gen.duty_permille, &p[9], 2);
+            table_dirty = rate_dirty = true;
+            err = ERR_OK;
         }
         break;
-    case WAVE_RECT_FULL:
-        for (uint16_t i = 0; i < table_len; i++) {
-            float v = offset + ampl * fabsf(sinf((2.0f * 3.1415926f * i) / table_len));
-            if (v > 3300) v = 3300;
-            wave_table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+    case CMD_SET_MODE: // таблица / DDS
+        if (len >= 1 && p[0] <= GEN_MODE_DDS) {
+            mode_dirty |= p[0] != gen_mode;
+            gen_mode = p[0];
+            err = ERR_OK;
         }
         break;
-    case WAVE_RECT_HALF:
-        for (uint16_t i = 0; i < table_len; i++) {
-            float s = sinf((2.0f * 3.1415926f * i) / table_len);
-            float v = offset + (s > 0 ? ampl * s : 0);
-            if (v < 0) v = 0;
-            if (v > 3300) v = 3300;
-            wave_table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+    case CMD_SWEEP: // свип частоты, только в DDS
+        if (len >= 13 && gen_mode == GEN_MODE_DDS) {
+            memcpy(&sweep.f0_mHz, &p[0], 4);
+            memcpy(&sweep.f1_mHz, &p[4], 4);
+            memcpy(&sweep.time_ms, &p[8], 4);
+            sweep.flags = p[12];
+            if (sweep.time_ms && sweep.f0_mHz <= DDS_MAX_mHz && sweep.f1_mHz <= DDS_MAX_mHz &&
+                (!(sweep.flags & DDS_SWEEP_LOG) || (sweep.f0_mHz && sweep.f1_mHz))) {
+                sweep_dirty = true;
+                err = ERR_OK;
+            }
         }
         break;
-    case WAVE_SAW:
-        for (uint16_t i = 0; i < table_len; i++) {
-            float v = offset + ampl * ((float)i / table_len * 2.0f - 1.0f);
-            if (v < 0) v = 0;
-            if (v > 3300) v = 3300;
-            wave_table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+    case CMD_UPLOAD_BEGIN:
+        if (len >= 8) {
+            uint32_t n;
+            uint16_t chunk;
+            memcpy(&n, &p[0], 4);
+            memcpy(&chunk, &p[4], 2);
+            if (n >= 1 && n <= MAX_USER_POINTS && chunk >= 1 && chunk <= UPLOAD_CHUNK_MAX) {
+                upload.n = (uint16_t)n;
+                upload.chunk = chunk;
+                memcpy(&upload.crc, &p[6], 2);
+                memset(upload.got, 0, sizeof(upload.got));
+                upload.active = true;
+                err = ERR_OK;
+            }
         }
         break;
-    case WAVE_TRI:
-        for (uint16_t i = 0; i < table_len; i++) {
-            float phase = (float)i / table_len;
-            float v = (phase < 0.5f) ? (phase * 2.0f) : (2.0f - phase * 2.0f);
-            v = offset + ampl * (v * 2.0f - 1.0f);
-            if (v < 0) v = 0;
-            if (v > 3300) v = 3300;
-            wave_table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+    case CMD_UPLOAD_CHUNK: // кусок по границе chunk, полный (кроме последнего), CRC данных
+        if (upload.active && len >= 8) {
+            uint32_t off;
+            uint16_t n, crc;
+            memcpy(&off, &p[0], 4);
+            memcpy(&n, &p[4], 2);
+            memcpy(&crc, &p[6], 2);
+            uint32_t k = off / upload.chunk;
+            if (off % upload.chunk == 0 && off < upload.n &&
+                n == (upload.n - off < upload.chunk ? upload.n - off : upload.chunk) && len >= 8 + n * 2 &&
+                crc16_ibm(&p[8], n * 2) == crc) {
+                memcpy(&upload_buf[off], &p[8], n * 2);
+                upload.got[k / 8] |= 1u << (k % 8);
+                err = ERR_OK;
+            }
         }
         break;
-    case WAVE_SQUARE:
-        for (uint16_t i = 0; i < table_len; i++) {
-            float duty = duty_permille / 1000.0f;
-            float v = ( (float)i / table_len < duty ) ? (offset + ampl) : (offset - ampl);
-            if (v < 0) v = 0;
-            if (v > 3300) v = 3300;
-            wave_table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+    case CMD_UPLOAD_COMMIT: { // {u8 err; u16 missing} — недостающих кусков
+        uint8_t r[3] = {ERR_PARAM, 0, 0};
+        uint16_t missing = 0;
+        if (upload.active) {
+            uint16_t chunks = (upload.n + upload.chunk - 1) / upload.chunk;
+            for (uint16_t k = 0; k < chunks; k++) {
+                if (!(upload.got[k / 8] & (1u << (k % 8)))) missing++;
+            }
+            if (!missing && crc16_ibm((const uint8_t *)upload_buf, upload.n * 2) == upload.crc) {
+                memcpy(user_table, upload_buf, upload.n * 2);
+                user_len = upload.n;
+                gen.type = WAVE_USER;
+                table_dirty = true;
+                r[0] = ERR_OK;  // загрузка остаётся: повтор commit (ответ потерян) — снова 0
+            }
         }
-        break;
-    case WAVE_USER:
-        // Пользовательская таблица уже загружена, просто не трогаем
-        break;
+        memcpy(&r[1], &missing, 2);
+        send_reply(seq, cmd, r, sizeof(r));
+        return;
+    }
+    case 0x1F: { // get_gen_status
+        // {u8 err; u8 wave; u32 freq_mHz; u16 ampl_mVpp; i16 offset_mV; u16 duty_permille; u8 mode}
+        uint8_t st[13];
+        st[0] = ERR_OK;
+        st[1] = gen.type;
+        memcpy(&st[2], &gen.freq_mHz, 4);
+        memcpy(&st[6], &gen.ampl_mVpp, 2);
+        memcpy(&st[8], &gen.offset_mV, 2);
+        memcpy(&st[10], &gen.duty_permille, 2);
+        st[12] = gen_mode;
+        send_reply(seq, cmd, st, sizeof(st));
+        return;
+    }
     default:
+        err = ERR_UNKNOWN;
         break;
     }
+    reply_err(seq, cmd, err);
 }
 
-// Применяем таблицу: останавливаем DMA, обновляем буфер, запускаем снова
+// Таблица в DMA целиком: останавливаем DMA, обновляем буфер, запускаем
+// снова. Только при старте и смене длины таблицы (upload_wave другой
+// длины, переход user <-> стандартные формы) — на выходе разрыв.
 static void apply_waveform(void)
 {
-    // TODO: остановить DMA, скопировать wave_table в буфер DAC/PWM, запустить DMA circular
+    dds_on = false;
+    stop_dac_dma();
+    memcpy(dac_buf, wave_table, table_len * sizeof(uint16_t));
+    wave_swap_init(&swap, dac_buf, table_len);
+    rate_on_swap = false;
+    MX_TIM_Wave_Init(gen.freq_mHz, table_len);
+    start_dac_dma(dac_buf, table_len);
 }
 
-// Настройки железа — заполните под конкретный МК
-static void SystemClock_Config(void) { /* TODO */ }
-static void MX_DAC_PWM_Init(void) { /* TODO */ }
-static void MX_USB_UART_Init(void) { /* TODO */ }
-static void MX_TIM_Wave_Init(uint32_t freq_mHz, uint16_t points) { /* TODO */ }
+// Таблица текущей формы в t (user — копия загруженной), за последней
+// точкой — повтор первой для DDS; возвращает длину
+static uint16_t fill_table(uint16_t *t)
+{
+    uint16_t n = gen.type == WAVE_USER ? user_len : WAVE_TABLE_POINTS;
+    if (gen.type == WAVE_USER) {
+        memcpy(t, user_table, n * sizeof(uint16_t));
+    } else {
+        wave_fill(t, n, &gen);
+    }
+    t[n] = t[0];
+    return n;
+}
+
+// Переход в DDS: обе половины буфера заранее, таймер на постоянную
+// DDS_RATE_HZ — один разрыв; дальше частота и форма меняются без него
+static void start_dds(void)
+{
+    dds_on = false;
+    stop_dac_dma();
+    dds_init(&dds, dds_tab[0], fill_table(dds_tab[0]), gen.freq_mHz);
+    dds_fill(&dds, dds_buf, DDS_BUF_LEN);
+    MX_TIM_Wave_Init(DDS_RATE_HZ * 1000u / DDS_BUF_LEN, DDS_BUF_LEN);
+    dds_on = true;
+    start_dac_dma(dds_buf, DDS_BUF_LEN);
+}
 
-static uint16_t crc16_ibm(const uint8_t *data, uint16_t len)
+// DDS: таблица — в свободную из двух, частота и свип — в dds_t; всё с
+// начала следующей половины буфера, фаза продолжается
+static void apply_pending_dds(void)
 {
-    uint16_t crc = 0xFFFF;
-    for (uint16_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (uint8_t b = 0; b < 8; b++) {
-            if (crc & 1) crc = (crc >> 1) ^ 0xA001;
-            else crc >>= 1;
+    if (table_dirty) {
+        if (dds_table_busy(&dds)) return;
+        uint16_t *t = dds.table == dds_tab[0] ? dds_tab[1] : dds_tab[0];
+        dds_set_table(&dds, t, fill_table(t));
+    }
+    if (rate_dirty) dds_set_freq(&dds, gen.freq_mHz);
+    if (sweep_dirty && !dds_sweep(&dds, sweep.f0_mHz, sweep.f1_mHz, sweep.time_ms, sweep.flags)) {
+        dds_set_freq(&dds, gen.freq_mHz);   // свип быстрее вдвое за блок
+    }
+    table_dirty = rate_dirty = sweep_dirty = false;
+}
+
+// Накопленные изменения: новая таблица в теневом буфере и замена на
+// границах DMA, без остановки; частота — вместе с ней или сразу (ARR с
+// предзагрузкой меняется на событии обновления, фаза не рвётся). Пока идёт
+// прежняя замена, изменения ждут — последние параметры применятся целиком.
+static void apply_pending(void)
+{
+    if (mode_dirty) {
+        // Смена режима — с перезапуском DMA, таблица и частота — уже новые
+        mode_dirty = table_dirty = rate_dirty = false;
+        if (gen_mode == GEN_MODE_DDS) {
+            start_dds();
+        } else {
+            sweep_dirty = false;
+            // wave_table — на месте таблиц DDS: сначала остановить DMA
+            dds_on = false;
+            stop_dac_dma();
+            table_len = fill_table(wave_table);
+            apply_waveform();
         }
     }
-    return crc;
+    if (gen_mode == GEN_MODE_DDS) {
+        apply_pending_dds();
+        return;
+    }
+    if (!table_dirty && !rate_dirty) return;
+    if (wave_swap_busy(&swap)) return;
+    if (table_dirty) {
+        uint16_t n = fill_table(wave_table);
+        if (n != table_len) {
+            table_len = n;
+            apply_waveform();
+        } else {
+            rate_on_swap = rate_dirty;
+            wave_swap_request(&swap, wave_table);
+        }
+    } else {
+        tim_set_rate(gen.freq_mHz, table_len);
+    }
+    table_dirty = rate_dirty = false;
 }
+
+// Настройки железа — заполните под конкретный МК
+static void SystemClock_Config(void) { /* TODO */ }
+static void MX_DAC_PWM_Init(void) { /* TODO */ }
+static void MX_USB_UART_Init(void) { /* TODO */ }
+static void MX_TIM_Wave_Init(uint32_t freq_mHz, uint16_t points) { /* TODO */ }
+// Только ARR (ARPE = 1): отсчётов в секунду freq_mHz * points / 1000, новое
+// значение — с ближайшего события обновления таймера
+static void tim_set_rate(uint32_t freq_mHz, uint16_t points) { /* TODO */ }
+// HAL_DAC_Start_DMA(&hdac, DAC_CHANNEL_1, buf, points, DAC_ALIGN_12B_R), DMA circular,
+// прерывания половины и конца передачи -> HAL_DAC_Conv*CpltCallbackCh1
+static void start_dac_dma(uint16_t *buf, uint16_t points) { /* TODO */ }
+static void stop_dac_dma(void) { /* TODO: HAL_DAC_Stop_DMA */ }
+static void link_write(const uint8_t *data, uint16_t len) { /* TODO: CDC_Transmit_FS / HAL_UART_Transmit */ }
+static uint16_t link_read(uint8_t *data, uint16_t max) { /* TODO: из кольца CDC_Receive_FS / UART RX DMA */ return 0; }
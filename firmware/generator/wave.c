@@ -0,0 +1,234 @@
+#include "wave.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#endif
+
+// Синтез таблиц в целых. Форма s(i) для 256 точек — q15 (s * 32767),
+// отсчёт в 2^-17 кода ЦАП: v = O + (A * s) >> 16, где O — смещение, A —
+// половина размаха (оба уже в кодах ЦАП, 4095/3300 на мВ). На Cortex-M4/M7
+// это SMLAWB/SMLAWT по паре отсчётов из одного слова и USAT вместо
+// ограничения 0..4095.
+//
+// Результат обязан совпадать с прежним float-расчётом кода в код. Ошибка
+// целого v относительно точного значения — полшага q15 формы (A / 2^17) и
+// пара единиц на округлениях O, A и сдвига, ошибка float
+// (сумма, *4095, /3300 — по 2^-24 от 3300..4095) — меньше 0,002 кода, с
+// запасом 2^-7. Если v - E и v + E дают один код — он и есть; иначе
+// (несколько процентов отсчётов, у самой границы) отсчёт считается в float.
+// Половина размаха больше WAVE_Q_MAX_CODE кодов, смещение больше двух (выход
+// всё равно упирается в 0 или 3300 мВ) и длины кроме 256 — целиком float.
+
+#define WAVE_Q_SHIFT    17
+#define WAVE_Q_MARGIN   (1 << (WAVE_Q_SHIFT - 7))
+#define WAVE_Q_MAX_CODE 4095
+
+// q15 выровнены на слово: на DSP читаются парами
+static float sin_f[WAVE_TABLE_POINTS];                  // sinf тех же аргументов, что прежде
+static _Alignas(4) int16_t sin_q[WAVE_TABLE_POINTS];    // то же в q15
+static _Alignas(4) int16_t saw_q[WAVE_TABLE_POINTS];
+static _Alignas(4) int16_t tri_q[WAVE_TABLE_POINTS];
+static _Alignas(4) int16_t shape_q[WAVE_TABLE_POINTS];  // форма текущего вызова
+static uint16_t code_hi[WAVE_TABLE_POINTS];             // код по v + E
+static uint16_t redo[WAVE_TABLE_POINTS];                // отсчёты у границы кода
+
+void wave_init(void)
+{
+    for (uint16_t i = 0; i < WAVE_TABLE_POINTS; i++) {
+        sin_f[i] = sinf((2.0f * 3.1415926f * i) / WAVE_TABLE_POINTS);
+        sin_q[i] = (int16_t)lrintf(sin_f[i] * 32767.0f);
+        // i / 128 - 1 и треугольник со ступенью 1/64 — в шкале 32767
+        int32_t saw = i * 256 - 32768;
+        int32_t tri = i < WAVE_TABLE_POINTS / 2 ? i * 512 - 32768 : 3 * 32768 - i * 512;
+        saw_q[i] = (int16_t)((saw * 32767 + (saw < 0 ? -16384 : 16384)) / 32768);
+        tri_q[i] = (int16_t)((tri * 32767 + (tri < 0 ? -16384 : 16384)) / 32768);
+    }
+}
+
+// Отсчёт в коде ЦАП так, как считался прежде (float). В прежнем
+// WAVE_RECT_FULL не было нижнего ограничения: при отрицательном смещении
+// (uint16_t) от отрицательного float — неопределённое поведение; теперь 0.
+static uint16_t code_float(float offset, float ampl, float shape)
+{
+    float v = offset + ampl * shape;
+    if (v < 0) v = 0; // простая защита
+    if (v > 3300) v = 3300;
+    return (uint16_t)(v * 4095.0f / 3300.0f);
+}
+
+// Форма в точке i: ровно те же выражения float, что в прежних циклах
+static float shape_float(const wave_params_t *p, uint16_t i, uint16_t len)
+{
+    float s, phase;
+    switch (p->type) {
+    case WAVE_SINE:
+    case WAVE_RECT_FULL:
+    case WAVE_RECT_HALF:
+        s = len == WAVE_TABLE_POINTS ? sin_f[i] : sinf((2.0f * 3.1415926f * i) / len);
+        if (p->type == WAVE_RECT_FULL) return fabsf(s);
+        if (p->type == WAVE_RECT_HALF) return s > 0 ? s : 0;
+        return s;
+    case WAVE_SAW:
+        return (float)i / len * 2.0f - 1.0f;
+    case WAVE_TRI:
+        phase = (float)i / len;
+        s = (phase < 0.5f) ? (phase * 2.0f) : (2.0f - phase * 2.0f);
+        return s * 2.0f - 1.0f;
+    default:
+        return ((float)i / len < p->duty_permille / 1000.0f) ? 1.0f : -1.0f;
+    }
+}
+
+// Форма в q15 для 256 точек; порог меандра i/256 < duty/1000 в float совпадает с целым:
+// ближе 1/256000 они не бывают, а равны только на кратных 1/8, где
+// float(duty/1000) точен.
+static const int16_t *shape_q15(const wave_params_t *p)
+{
+    switch (p->type) {
+    case WAVE_SINE:
+        return sin_q;
+    case WAVE_RECT_FULL:
+        for (uint16_t i = 0; i < WAVE_TABLE_POINTS; i++) shape_q[i] = sin_q[i] < 0 ? -sin_q[i] : sin_q[i];
+        break;
+    case WAVE_RECT_HALF:
+        for (uint16_t i = 0; i < WAVE_TABLE_POINTS; i++) shape_q[i] = sin_q[i] > 0 ? sin_q[i] : 0;
+        break;
+    case WAVE_SAW:
+        return saw_q;
+    case WAVE_TRI:
+        return tri_q;
+    default:
+        for (uint16_t i = 0; i < WAVE_TABLE_POINTS; i++) {
+            shape_q[i] = (uint32_t)i * 1000 < (uint32_t)p->duty_permille * WAVE_TABLE_POINTS ? 32767 : -32767;
+        }
+        break;
+    }
+    return shape_q;
+}
+
+static inline uint16_t sat12(int32_t x)
+{
+#if defined(__ARM_FEATURE_DSP)
+    return (uint16_t)__usat(x, 12);
+#else
+    return (uint16_t)(x < 0 ? 0 : x > 4095 ? 4095 : x);
+#endif
+}
+
+// o + (a * s) >> 16 без 64-битного умножения (у Cortex-M0 его нет):
+// a = ah * 2^16 + al, младшая часть al * s помещается в 32 бита
+static inline int32_t mla_q15(int32_t o, int32_t ah, int32_t al, int16_t s)
+{
+    return o + ah * s + ((al * s) >> 16);
+}
+
+// Ядро: n отсчётов формы s в коды ЦАП; номера отсчётов у границы — в redo
+static uint16_t fill_q15(uint16_t *restrict table, const int16_t *restrict s, uint16_t n, int32_t a, int32_t o, int32_t e)
+{
+    uint16_t nredo = 0;
+    uint16_t i = 0;
+#if defined(__ARM_FEATURE_DSP)
+    // Два отсчёта формы одним словом: нижний — SMLAWB, верхний — SMLAWT
+    const int32_t *s2 = (const int32_t *)s;
+    for (; i + 1 < n; i += 2) {
+        int32_t w = s2[i / 2];
+        int32_t v0 = __smlawb(a, w, o), v1 = __smlawt(a, w, o);
+        uint16_t c0 = sat12((v0 - e) >> WAVE_Q_SHIFT), c1 = sat12((v1 - e) >> WAVE_Q_SHIFT);
+        table[i] = c0;
+        table[i + 1] = c1;
+        if (c0 != sat12((v0 + e) >> WAVE_Q_SHIFT)) redo[nredo++] = i;
+        if (c1 != sat12((v1 + e) >> WAVE_Q_SHIFT)) redo[nredo++] = i + 1;
+    }
+#endif
+    // Без ветвлений (векторизуется): нижняя граница — в таблицу, верхняя —
+    // рядом; расхождения собираются вторым проходом по 8 отсчётов
+    uint16_t i0 = i;
+    int32_t ah = a >> 16, al = a & 0xFFFF;
+    for (; i < n; i++) {
+        int32_t v = mla_q15(o, ah, al, s[i]);
+        table[i] = sat12((v - e) >> WAVE_Q_SHIFT);
+        code_hi[i] = sat12((v + e) >> WAVE_Q_SHIFT);
+    }
+    for (i = i0; i < n; i += 8) {
+        uint16_t m = n - i < 8 ? n - i : 8;
+        if (!memcmp(table + i, code_hi + i, m * sizeof(uint16_t))) continue;
+        for (uint16_t j = i; j < i + m; j++) {
+            if (table[j] != code_hi[j]) redo[nredo++] = j;
+        }
+    }
+    return nredo;
+}
+
+// Заполнение таблиц форм
+uint16_t wave_fill(uint16_t *table, uint16_t len, const wave_params_t *p)
+{
+    float ampl = p->ampl_mVpp / 2.0f;
+    float offset = p->offset_mV;
+
+    if (p->type >= WAVE_USER) return 0;     // WAVE_USER: таблицу загружает upload_wave
+
+    // Коды: a_code = ampl_mVpp/2 * 4095/3300, o_code = offset * 4095/3300
+    int32_t a_num = (int32_t)p->ampl_mVpp * 4095;   // 2 * 3300 * a_code
+    int32_t o_num = (int32_t)p->offset_mV * 4095;   // 3300 * o_code
+    if (len != WAVE_TABLE_POINTS || a_num > WAVE_Q_MAX_CODE * 6600 || o_num > 2 * WAVE_Q_MAX_CODE * 3300 ||
+        o_num < -2 * WAVE_Q_MAX_CODE * 3300) {
+        for (uint16_t i = 0; i < len; i++) table[i] = code_float(offset, ampl, shape_float(p, i, len));
+        return len;
+    }
+
+    // A = a_code * 2^33 / 32767 (s в q15 со шкалой 32767, сдвиг 16),
+    // O = o_code * 2^17; оба с округлением
+    int64_t den = (int64_t)6600 * 32767;
+    int32_t a = (int32_t)((((int64_t)a_num << 33) + den / 2) / den);
+    int64_t o64 = (int64_t)o_num << WAVE_Q_SHIFT;
+    int32_t o = (int32_t)((o64 >= 0 ? o64 + 1650 : o64 - 1650) / 3300);
+    // Ошибка: форма — a_code * 2^17 / 65534 = a / 2^17 (+1), прочее — 4
+    int32_t e = (a >> WAVE_Q_SHIFT) + 1 + 4 + WAVE_Q_MARGIN;
+
+    uint16_t nredo = fill_q15(table, shape_q15(p), WAVE_TABLE_POINTS, a, o, e);
+    for (uint16_t k = 0; k < nredo; k++) table[redo[k]] = code_float(offset, ampl, shape_float(p, redo[k], len));
+    return nredo;
+}
+
+void wave_swap_init(wave_swap_t *w, uint16_t *out, uint16_t len)
+{
+    w->out = out;
+    w->len = len;
+    w->src = 0;
+    w->state = WAVE_SWAP_IDLE;
+    w->swaps = 0;
+}
+
+void wave_swap_request(wave_swap_t *w, const uint16_t *src)
+{
+    w->src = src;
+    w->state = WAVE_SWAP_ARMED;
+}
+
+bool wave_swap_busy(const wave_swap_t *w)
+{
+    return w->state != WAVE_SWAP_IDLE;
+}
+
+// DMA перешёл во вторую половину: первая свободна до конца передачи
+void wave_swap_half(wave_swap_t *w)
+{
+    if (w->state != WAVE_SWAP_ARMED) return;
+    memcpy(w->out, w->src, (w->len / 2) * sizeof(uint16_t));
+    w->state = WAVE_SWAP_COPYING;
+}
+
+// DMA снова с начала, первая половина уже новая: вторая свободна до
+// половины. Запрос, пришедший после половины (ARMED), ждёт следующей.
+bool wave_swap_full(wave_swap_t *w)
+{
+    if (w->state != WAVE_SWAP_COPYING) return false;
+    uint16_t h = w->len / 2;
+    memcpy(w->out + h, w->src + h, (w->len - h) * sizeof(uint16_t));
+    w->swaps++;
+    w->state = WAVE_SWAP_IDLE;
+    return true;
+}
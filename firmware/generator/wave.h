@@ -0,0 +1,76 @@
+#ifndef WAVE_H
+#define WAVE_H
+
+// Таблицы форм генератора и их замена без разрыва. Не зависит от HAL —
+// собирается и на ПК (firmware/host/check_wave, check_synth).
+//
+// DAC читает буфер out по кругу (DMA circular). Новая таблица считается в
+// теневом буфере и переносится в out по половинам: по прерыванию половины
+// передачи (DMA уже читает вторую половину) — первая, по концу передачи
+// (DMA снова в первой) — вторая. Каждый период на выходе целиком старый или
+// целиком новый; от запроса до конца замены — не больше двух периодов.
+// Копия половины в прерывании должна успеть за половину периода.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WAVE_TABLE_POINTS 256
+
+// Длина формы user (upload_wave, загрузка кусками). Таблицы генератора
+// (main.c) занимают около 8 · MAX_USER_POINTS байт ОЗУ: 4096 — ~33 КБ
+// (F4/F7/H7/G4), на малых МК (F0/F1/G0/L0) соберите с -DMAX_USER_POINTS=1024
+// (~8 КБ) или 256 (~2 КБ, как стандартные формы)
+#ifndef MAX_USER_POINTS
+#define MAX_USER_POINTS   4096
+#endif
+#if MAX_USER_POINTS < WAVE_TABLE_POINTS || MAX_USER_POINTS > 32768
+#error "MAX_USER_POINTS: от WAVE_TABLE_POINTS до 32768"
+#endif
+
+// Типы форм
+enum {
+    WAVE_SINE = 0,
+    WAVE_RECT_FULL,
+    WAVE_RECT_HALF,
+    WAVE_SAW,
+    WAVE_TRI,
+    WAVE_SQUARE,
+    WAVE_USER
+};
+
+typedef struct {
+    uint8_t type;
+    uint32_t freq_mHz;
+    uint16_t ampl_mVpp;
+    int16_t offset_mV;
+    uint16_t duty_permille;     // для меандра
+} wave_params_t;
+
+// Базовые таблицы форм (q15), один раз до первого wave_fill
+void wave_init(void);
+// Таблица формы p->type (кроме WAVE_USER) в коды ЦАП, len точек. Целыми
+// по базовым таблицам, код в код как прежний расчёт во float; возвращает,
+// сколько отсчётов всё же посчитано во float (у границы кода).
+uint16_t wave_fill(uint16_t *table, uint16_t len, const wave_params_t *p);
+
+enum { WAVE_SWAP_IDLE = 0, WAVE_SWAP_ARMED, WAVE_SWAP_COPYING };
+
+typedef struct {
+    uint16_t *out;              // буфер DMA
+    uint16_t len;
+    const uint16_t *src;        // новая таблица (len точек)
+    volatile uint8_t state;     // WAVE_SWAP_*
+    volatile uint32_t swaps;    // завершённых замен
+} wave_swap_t;
+
+void wave_swap_init(wave_swap_t *w, uint16_t *out, uint16_t len);
+// Из основного цикла, только при !wave_swap_busy; src не трогать, пока
+// замена не завершится
+void wave_swap_request(wave_swap_t *w, const uint16_t *src);
+bool wave_swap_busy(const wave_swap_t *w);
+// Прерывания DMA: половина передачи / конец передачи. wave_swap_full —
+// true, если на этой границе замена завершилась (с неё же — новая частота).
+void wave_swap_half(wave_swap_t *w);
+bool wave_swap_full(wave_swap_t *w);
+
+#endif
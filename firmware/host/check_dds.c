@@ -0,0 +1,291 @@
+// Режим DDS генератора (generator/dds.c): отсчёты — как их писали бы
+// прерывания DMA, по DDS_HALF за раз.
+//
+// Проверяется: точность частоты (шаг 0,23 мГц — ошибка меньше 1 мГц во
+// всём диапазоне); чистота спектра синуса — SFDR по БПФ с окном
+// Блэкмана — Харриса (с интерполяцией — не хуже 70 дБ, для сравнения — без
+// неё и идеальный синус в 12 битах); смена частоты без скачка фазы
+// (соседние отсчёты на стыке отличаются не больше, чем внутри периода);
+// свипы — линейный и логарифмический попадают в середине и в конце,
+// по кругу — снова с начала. Плюс время на отсчёт и шаг частоты табличного
+// режима для сравнения.
+
+#include "dds.h"
+#include "wave.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define FFT_N 65536
+
+static uint16_t tab[MAX_USER_POINTS + 1];
+static uint16_t out[FFT_N];
+static double complex fft_buf[FFT_N];
+static dds_t dds;
+volatile uint16_t sink;
+
+static int fail(const char *what)
+{
+    fprintf(stderr, "check_dds: %s\n", what);
+    return 1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t make_table(uint8_t type, uint16_t len)
+{
+    wave_params_t p = {type, 1000000, 3000, 1650, 500};
+    wave_fill(tab, len, &p);
+    tab[len] = tab[0];
+    return len;
+}
+
+static void run(uint16_t *dst, unsigned n)
+{
+    for (unsigned i = 0; i < n; i += DDS_HALF) dds_fill(&dds, dst + i, DDS_HALF);
+}
+
+static void fft(double complex *x, unsigned n)
+{
+    for (unsigned i = 1, j = 0; i < n; i++) {
+        unsigned bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            double complex t = x[i];
+            x[i] = x[j];
+            x[j] = t;
+        }
+    }
+    for (unsigned len = 2; len <= n; len <<= 1) {
+        double complex w = cexp(-2 * M_PI * I / len);
+        for (unsigned i = 0; i < n; i += len) {
+            double complex wk = 1;
+            for (unsigned k = 0; k < len / 2; k++) {
+                double complex u = x[i + k], v = x[i + k + len / 2] * wk;
+                x[i + k] = u + v;
+                x[i + k + len / 2] = u - v;
+                wk *= w;
+            }
+        }
+    }
+}
+
+// SFDR, дБ: основная составляющая против наибольшей прочей (без
+// постоянной и ±8 бинов вокруг основной — ширина окна)
+static double sfdr(const double *x)
+{
+    static double mag[FFT_N / 2];
+    double mean = 0;
+    for (unsigned i = 0; i < FFT_N; i++) mean += x[i] / FFT_N;
+    for (unsigned i = 0; i < FFT_N; i++) {
+        double a = 2 * M_PI * i / (FFT_N - 1);
+        double w = 0.35875 - 0.48829 * cos(a) + 0.14128 * cos(2 * a) - 0.01168 * cos(3 * a);
+        fft_buf[i] = (x[i] - mean) * w;
+    }
+    fft(fft_buf, FFT_N);
+    unsigned peak = 0;
+    for (unsigned i = 0; i < FFT_N / 2; i++) {
+        mag[i] = cabs(fft_buf[i]);
+        if (i > 8 && mag[i] > mag[peak]) peak = i;
+    }
+    double spur = 0;
+    for (unsigned i = 9; i < FFT_N / 2; i++) {
+        if (i + 8 >= peak && i <= peak + 8) continue;
+        if (mag[i] > spur) spur = mag[i];
+    }
+    return 20 * log10(mag[peak] / spur);
+}
+
+static double sfdr_dds(uint32_t len, uint32_t freq_mHz)
+{
+    static double x[FFT_N];
+    dds_init(&dds, tab, len, freq_mHz);
+    run(out, FFT_N);
+    for (unsigned i = 0; i < FFT_N; i++) x[i] = out[i];
+    return sfdr(x);
+}
+
+// Без интерполяции (точка таблицы по старшим битам фазы) и идеальный синус,
+// округлённый до 12 бит, — для сравнения
+static double sfdr_ref(uint32_t freq_mHz, bool ideal)
+{
+    static double x[FFT_N];
+    uint32_t ph = 0, step = dds_step(freq_mHz);
+    for (unsigned i = 0; i < FFT_N; i++, ph += step) {
+        double s = sin(2 * M_PI * ph / 4294967296.0);
+        x[i] = ideal ? floor((1650 + 1500 * s) * 4095 / 3300) : tab[ph >> 24];
+    }
+    return sfdr(x);
+}
+
+static int check_freq(void)
+{
+    double worst = 0;
+    srand(19);
+    for (unsigned n = 0; n < 1000000; n++) {
+        uint32_t f = n < 1000 ? n : (uint32_t)(((uint64_t)rand() << 16 ^ rand()) % (DDS_MAX_mHz + 1));
+        double got = dds_step(f) * (DDS_RATE_HZ * 1000.0) / 4294967296.0;
+        if (fabs(got - f) > worst) worst = fabs(got - f);
+    }
+    printf("frequency: step %.3f mHz, worst error %.3f mHz over 1M frequencies up to %u Hz\n",
+           DDS_RATE_HZ * 1000.0 / 4294967296.0, worst, DDS_MAX_mHz / 1000);
+    return worst < 1.0 ? 0 : fail("frequency error of 1 mHz or more");
+}
+
+static int check_purity(void)
+{
+    make_table(WAVE_SINE, WAVE_TABLE_POINTS);
+    static const uint32_t freqs[] = {1000000, 12345678, 99999999, 123456789};
+    for (unsigned k = 0; k < sizeof(freqs) / sizeof(freqs[0]); k++) {
+        double d = sfdr_dds(WAVE_TABLE_POINTS, freqs[k]);
+        printf("sine %10.3f Hz: SFDR %.1f dB interpolated, %.1f dB table lookup, %.1f dB ideal 12-bit\n",
+               freqs[k] / 1000.0, d, sfdr_ref(freqs[k], false), sfdr_ref(freqs[k], true));
+        if (d < 70) return fail("SFDR below 70 dB");
+    }
+    // Таблица не из 256 точек (user): индекс умножением
+    make_table(WAVE_SINE, 1000);
+    double d = sfdr_dds(1000, 12345678);
+    printf("sine 1000-point table, 12345.678 Hz: SFDR %.1f dB\n", d);
+    return d < 70 ? fail("SFDR below 70 dB (1000-point table)") : 0;
+}
+
+// Наибольшая разность соседних отсчётов
+static int max_delta(const uint16_t *x, unsigned from, unsigned to)
+{
+    int m = 0;
+    for (unsigned i = from + 1; i < to; i++) {
+        int d = abs((int)x[i] - (int)x[i - 1]);
+        if (d > m) m = d;
+    }
+    return m;
+}
+
+static int check_continuity(void)
+{
+    const unsigned blocks = 64, n = blocks * DDS_HALF;
+    make_table(WAVE_SINE, WAVE_TABLE_POINTS);
+    int worst = 0, slope = 0, restart = 0;
+    srand(190);
+    for (unsigned r = 0; r < 200; r++) {
+        uint32_t f1 = 1000 + rand() % 20000000, f2 = 1000 + rand() % 20000000;
+        uint32_t phase_before;
+        dds_init(&dds, tab, WAVE_TABLE_POINTS, f1);
+        run(out, n / 2);
+        phase_before = dds.phase;
+        dds_set_freq(&dds, f2);
+        run(out + n / 2, n / 2);
+        // Фаза на стыке продолжается: шаг f1 до, шаг f2 после
+        if (dds.phase != phase_before + (n / 2) * dds_step(f2)) return fail("phase jumped on frequency change");
+        int m = max_delta(out, n / 2 - 1, n / 2 + 1);
+        int s = max_delta(out, 0, n);
+        int inside = f1 > f2 ? max_delta(out, 0, n / 2) : max_delta(out, n / 2, n);
+        if (m > inside + 1) return fail("step at frequency change larger than within a period");
+        if (m > worst) worst = m;
+        if (s > slope) slope = s;
+        // Для сравнения: перезапуск с нулевой фазы (как новая таблица с начала)
+        int last = out[n / 2 - 1];
+        dds_init(&dds, tab, WAVE_TABLE_POINTS, f2);
+        run(out, DDS_HALF);
+        if (abs(out[0] - last) > restart) restart = abs(out[0] - last);
+    }
+    printf("frequency change: worst step at the joint %d codes (max within signal %d), with phase restart %d\n",
+           worst, slope, restart);
+    return 0;
+}
+
+// Свип: шаг раз в блок; частота блока — по текущему шагу
+static double block_freq(void)
+{
+    return dds.step * (DDS_RATE_HZ * 1000.0) / 4294967296.0;
+}
+
+static int check_sweep(void)
+{
+    static uint16_t blk[DDS_HALF];
+    make_table(WAVE_SINE, WAVE_TABLE_POINTS);
+    dds_init(&dds, tab, WAVE_TABLE_POINTS, 1000000);
+    // Линейный 1 -> 10 кГц за 100 мс
+    if (!dds_sweep(&dds, 1000000, 10000000, 100, 0)) return fail("linear sweep rejected");
+    unsigned blocks = 100 * DDS_RATE_HZ / 1000 / DDS_HALF;
+    double prev = 0, mid = 0;
+    for (unsigned b = 0; b < blocks + 4; b++) {
+        dds_fill(&dds, blk, DDS_HALF);
+        double f = block_freq();
+        if (f + 1 < prev) return fail("linear sweep not monotonic");
+        if (b == blocks / 2 - 1) mid = f;
+        prev = f;
+    }
+    if (dds.step != dds_step(10000000) || dds.sweeping) return fail("linear sweep did not stop at f1");
+    if (fabs(mid - 5500000) > 30000) return fail("linear sweep off in the middle");
+    printf("linear sweep 1..10 kHz / 100 ms: %u blocks, middle %.1f Hz, end %.3f Hz\n", blocks, mid / 1000,
+           block_freq() / 1000);
+
+    // Логарифмический 10 Гц -> 100 кГц за 1 с: в середине 1 кГц
+    if (!dds_sweep(&dds, 10000, 100000000, 1000, DDS_SWEEP_LOG)) return fail("log sweep rejected");
+    blocks = 1000 * DDS_RATE_HZ / 1000 / DDS_HALF;
+    for (unsigned b = 0; b < blocks + 4; b++) {
+        dds_fill(&dds, blk, DDS_HALF);
+        if (b == blocks / 2 - 1) mid = block_freq();
+    }
+    if (dds.step != dds_step(100000000)) return fail("log sweep did not stop at f1");
+    if (fabs(mid / 1000000 - 1) > 0.01) return fail("log sweep off in the middle");
+    printf("log sweep 10 Hz..100 kHz / 1 s: middle %.2f Hz, end %.3f Hz\n", mid / 1000, block_freq() / 1000);
+
+    // По кругу: после конца — снова f0
+    if (!dds_sweep(&dds, 2000000, 3000000, 10, DDS_SWEEP_REPEAT)) return fail("repeat sweep rejected");
+    blocks = 10 * DDS_RATE_HZ / 1000 / DDS_HALF;
+    for (unsigned b = 0; b < blocks; b++) dds_fill(&dds, blk, DDS_HALF);
+    if (!dds.sweeping || dds.step != dds_step(2000000)) return fail("repeat sweep did not restart");
+    // set_freq прекращает свип
+    dds_set_freq(&dds, 5000000);
+    dds_fill(&dds, blk, DDS_HALF);
+    if (dds.sweeping || dds.step != dds_step(5000000)) return fail("set_freq did not stop the sweep");
+    if (dds_sweep(&dds, 10, 500000000, 1, DDS_SWEEP_LOG)) return fail("too fast log sweep accepted");
+    return 0;
+}
+
+static double ns_per_sample(uint32_t len)
+{
+    static uint16_t half[DDS_HALF];
+    const unsigned reps = 200000;
+    dds_init(&dds, tab, len, 12345678);
+    double t0 = now_s();
+    for (unsigned r = 0; r < reps; r++) {
+        dds_fill(&dds, half, DDS_HALF);
+        sink = half[r % DDS_HALF];
+    }
+    return (now_s() - t0) / reps / DDS_HALF * 1e9;
+}
+
+int main(void)
+{
+    wave_init();
+    if (check_freq() || check_purity() || check_continuity() || check_sweep()) return 1;
+
+    make_table(WAVE_SINE, WAVE_TABLE_POINTS);
+    double ns = ns_per_sample(WAVE_TABLE_POINTS);
+    printf("dds_fill 256-point table: %.2f ns/sample on host, %.1f%% of a core at %u samples/s\n", ns,
+           ns * DDS_RATE_HZ / 1e7, DDS_RATE_HZ);
+    make_table(WAVE_SINE, 1000);
+    ns = ns_per_sample(1000);
+    printf("dds_fill 1000-point table: %.2f ns/sample on host\n", ns);
+
+    // Табличный режим: частота ЦАП = TIM 84 МГц / ARR, 256 точек на период —
+    // соседние ARR дают соседние частоты
+    static const double fr[] = {1000, 10000, 100000};
+    for (unsigned k = 0; k < 3; k++) {
+        double arr = floor(84e6 / (256 * fr[k]));
+        printf("table mode at %6.0f Hz: nearest %.3f / %.3f Hz; DDS step %.3f mHz\n", fr[k],
+               84e6 / (256 * (arr + 1)), 84e6 / (256 * arr), DDS_RATE_HZ * 1000.0 / 4294967296.0);
+    }
+    return 0;
+}
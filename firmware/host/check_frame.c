@@ -0,0 +1,218 @@
+// Проверка раскладки слота кольца прошивки осциллографа: байты, которые
+// уходят по DMA прямо из слота, должны совпадать с кадром OSC_DATA из
+// docs/protocol.md, собранным независимо (proto_build из pc-app), и
+// разбираться приёмником ПК. Кадры OSC_DATA_EXT (PACK12, DELTA) проходят
+// через разбор и распаковку ПК (pc-app/unpack.c) обратно в исходные отсчёты.
+// Сегмент (segment.h) — OSC_DATA_EXT с seg, nseg и меткой t в расширении.
+// Передискретизация (oversample.h) — отсчёты до 16 бит: всегда u16, bits в
+// расширении, какую бы кодировку ни просили.
+
+#include "osc_frame.h"
+#include "proto.h"
+#include "unpack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int fail(const char *what)
+{
+    fprintf(stderr, "check_frame: %s\n", what);
+    return 1;
+}
+
+// Кадр по описанию протокола: meta {u32 fs_hz; u8 ch; u16 nsamples; u16 pretrig} + u16 LE
+static size_t reference(uint8_t *out, uint16_t seq, uint8_t ch, uint32_t fs, uint16_t pretrig,
+                        const uint16_t *samples, uint16_t n)
+{
+    static uint8_t payload[OSC_META_LEN + OSC_FRAME_POINTS * 2];
+    uint8_t *p = payload;
+    *p++ = fs & 0xFF;
+    *p++ = (fs >> 8) & 0xFF;
+    *p++ = (fs >> 16) & 0xFF;
+    *p++ = fs >> 24;
+    *p++ = ch;
+    *p++ = n & 0xFF;
+    *p++ = n >> 8;
+    *p++ = pretrig & 0xFF;
+    *p++ = pretrig >> 8;
+    for (uint16_t i = 0; i < n; i++) {
+        *p++ = samples[i] & 0xFF;
+        *p++ = samples[i] >> 8;
+    }
+    return proto_build(out, seq, PROTO_CMD_OSC_DATA, payload, (uint16_t)(p - payload));
+}
+
+int main(void)
+{
+    crc16_init();
+
+    static osc_slot_t slot;
+    static uint16_t linear[OSC_FRAME_POINTS];
+    static uint8_t ref[OSC_FRAME_BYTES(OSC_FRAME_POINTS)];
+
+    if ((uintptr_t)slot.data % 4) return fail("data not 4-aligned");
+
+    proto_rx_t rx;
+    if (!proto_rx_init(&rx, 1 << 16)) return fail("proto_rx_init");
+
+    // Линейный кадр и кадры, записанные по кругу с разным началом
+    static const uint16_t starts[] = {0, 1, OSC_DMA_POINTS, OSC_FRAME_POINTS / 2, OSC_FRAME_POINTS, OSC_SLOT_POINTS - 1};
+    uint32_t x = 7;
+    for (size_t k = 0; k < sizeof(starts) / sizeof(starts[0]); k++) {
+        uint16_t start = starts[k];
+        for (uint32_t i = 0; i < OSC_FRAME_POINTS; i++) {
+            x = x * 1103515245u + 12345u;
+            linear[i] = (uint16_t)((x >> 16) & 0x0FFF);
+            slot.data[(start + i) % OSC_SLOT_POINTS] = linear[i];
+        }
+        slot.fs_hz = 500000 + (uint32_t)k;
+        slot.nsamples = OSC_FRAME_POINTS;
+        slot.pretrig = (uint16_t)(1234 + k);
+        slot.start = start;
+
+        uint16_t seq = (uint16_t)(0xBEEF + k);
+        uint16_t n = osc_slot_finalize(&slot, seq, 0, OSC_ENC_RAW16);
+        if (osc_slot_wire(&slot) + OSC_HDR_LEN + OSC_META_LEN != (const uint8_t *)slot.data) {
+            return fail("header+meta not adjacent to data");
+        }
+        size_t rn = reference(ref, seq, 0, slot.fs_hz, slot.pretrig, linear, OSC_FRAME_POINTS);
+        if (n != rn || n != OSC_FRAME_BYTES(OSC_FRAME_POINTS)) return fail("wire length");
+        if (memcmp(osc_slot_wire(&slot), ref, n) != 0) return fail("wire bytes differ from protocol.md frame");
+        if (slot.start != 0) return fail("slot not rotated");
+
+        // Приёмник ПК: кадр проходит проверку CRC и разбирается
+        proto_rx_feed(&rx, osc_slot_wire(&slot), n);
+        proto_frame_t f;
+        if (!proto_rx_next(&rx, &f)) return fail("pc parser rejected slot");
+        if (f.seq != seq || f.cmd != PROTO_CMD_OSC_DATA || f.len != n - PROTO_HDR_LEN - PROTO_CRC_LEN) {
+            return fail("pc parser header");
+        }
+    }
+    if (rx.crc_errors || rx.bad_headers || rx.skipped_bytes) return fail("pc parser counters");
+    printf("osc slot layout == OSC_DATA frame (%u points, %u bytes): ok\n",
+           OSC_FRAME_POINTS, (unsigned)OSC_FRAME_BYTES(OSC_FRAME_POINTS));
+
+    // OSC_DATA_EXT: шум (DELTA длиннее — прошивка должна уйти в PACK12) и
+    // плавный сигнал (DELTA), с разным началом записи и нечётной длиной
+    static uint16_t out[OSC_FRAME_POINTS];
+    static const struct { uint8_t want, smooth, got; uint16_t n; } cases[] = {
+        {OSC_ENC_PACK12, 0, OSC_ENC_PACK12, OSC_FRAME_POINTS},
+        {OSC_ENC_PACK12, 0, OSC_ENC_PACK12, OSC_FRAME_POINTS - 1},
+        {OSC_ENC_DELTA, 0, OSC_ENC_PACK12, OSC_FRAME_POINTS},
+        {OSC_ENC_DELTA, 1, OSC_ENC_DELTA, OSC_FRAME_POINTS},
+        {OSC_ENC_DELTA, 1, OSC_ENC_DELTA, OSC_FRAME_POINTS - 3},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (size_t k = 0; k < sizeof(starts) / sizeof(starts[0]); k++) {
+            uint16_t start = starts[k], ns = cases[c].n;
+            for (uint32_t i = 0; i < ns; i++) {
+                x = x * 1103515245u + 12345u;
+                linear[i] = cases[c].smooth ? (uint16_t)(2048 + (i % 400 < 200 ? i % 200 : 200 - i % 200) * 8 + (x >> 16) % 9)
+                                            : (uint16_t)((x >> 16) & 0x0FFF);
+                slot.data[(start + i) % OSC_SLOT_POINTS] = linear[i];
+            }
+            slot.nsamples = ns;
+            slot.pretrig = (uint16_t)k;
+            slot.start = start;
+            uint16_t seq = (uint16_t)(c * 16 + k);
+            uint16_t n = osc_slot_finalize(&slot, seq, 2, cases[c].want);
+            if (cases[c].got == OSC_ENC_PACK12 && n != PROTO_HDR_LEN + OSC_META_LEN + OSC_EXT_LEN + OSC_PACK12_BYTES(ns) + PROTO_CRC_LEN) {
+                return fail("pack12 wire length");
+            }
+
+            proto_rx_feed(&rx, osc_slot_wire(&slot), n);
+            proto_frame_t f;
+            osc_meta_t m;
+            if (!proto_rx_next(&rx, &f)) return fail("pc parser rejected ext slot");
+            if (f.seq != seq || f.cmd != PROTO_CMD_OSC_DATA_EXT) return fail("ext header");
+            if (!osc_parse_data(f.cmd, f.payload, f.len, &m)) return fail("ext meta");
+            if (m.enc != cases[c].got || m.nsamples != ns || m.ch != 2 || m.pretrig != k) return fail("ext meta fields");
+            if (!osc_unpack(&m, out)) return fail("ext unpack");
+            if (memcmp(out, linear, ns * 2u) != 0) return fail("ext samples differ");
+        }
+        printf("OSC_DATA_EXT enc %u (asked %u, %u points): ok\n", cases[c].got, cases[c].want, cases[c].n);
+    }
+
+    // Несколько каналов: даже u16 уходит как OSC_DATA_EXT с nch и phase, а
+    // разбор ПК раскладывает отсчёты по каналам
+    for (uint8_t nch = 2; nch <= OSC_MAX_CH; nch++) {
+        uint8_t phase = nch - 1;
+        for (uint32_t i = 0; i < OSC_FRAME_POINTS; i++) {
+            // Старшая тетрада — канал отсчёта, младшие 12 бит — номер
+            linear[i] = (uint16_t)((((phase + i) % nch) << 12) | (i & 0x0FFF));
+            slot.data[i] = linear[i];
+        }
+        slot.nsamples = OSC_FRAME_POINTS;
+        slot.start = 0;
+        slot.nch = nch;
+        slot.phase = phase;
+        uint16_t n = osc_slot_finalize(&slot, nch, 0, OSC_ENC_RAW16);
+        proto_rx_feed(&rx, osc_slot_wire(&slot), n);
+        proto_frame_t f;
+        osc_meta_t m;
+        if (!proto_rx_next(&rx, &f) || f.cmd != PROTO_CMD_OSC_DATA_EXT) return fail("multi-channel frame");
+        if (!osc_parse_data(f.cmd, f.payload, f.len, &m) || m.nch != nch || m.phase != phase) {
+            return fail("multi-channel meta");
+        }
+        if (!osc_unpack(&m, out) || memcmp(out, linear, OSC_FRAME_POINTS * 2)) return fail("multi-channel samples");
+        printf("OSC_DATA_EXT %u channels, phase %u: ok\n", nch, phase);
+    }
+    slot.nch = 1;
+    slot.phase = 0;
+
+    // Сегмент короче кадра: u16 и PACK12, метка больше 32 бит
+    for (uint8_t enc = OSC_ENC_RAW16; enc <= OSC_ENC_PACK12; enc++) {
+        const uint16_t ns = 777;
+        for (uint32_t i = 0; i < ns; i++) slot.data[i] = linear[i] = (uint16_t)((i * 2654435761u) >> 20);
+        slot.nsamples = ns;
+        slot.pretrig = 100;
+        slot.start = 0;
+        slot.seg = 41;
+        slot.nseg = 42;
+        slot.t = 0x123456789ABull;
+        uint16_t n = osc_slot_finalize(&slot, 99, 0, enc);
+        proto_rx_feed(&rx, osc_slot_wire(&slot), n);
+        proto_frame_t f;
+        osc_meta_t m;
+        if (!proto_rx_next(&rx, &f) || f.cmd != PROTO_CMD_OSC_DATA_EXT) return fail("segment frame");
+        if (!osc_parse_data(f.cmd, f.payload, f.len, &m) || m.seg != 41 || m.nseg != 42 ||
+            m.seg_t != 0x123456789ABull || m.enc != enc || m.nsamples != ns || m.pretrig != 100) {
+            return fail("segment meta");
+        }
+        if (!osc_unpack(&m, out) || memcmp(out, linear, ns * 2u)) return fail("segment samples");
+        printf("OSC_DATA_EXT segment %u/%u, enc %u: ok\n", m.seg, m.nseg, enc);
+    }
+    slot.nseg = 0;
+
+    // 16 бит: PACK12 просили, но уходит u16; разрядность — после полей сегмента
+    for (uint8_t nch = 1; nch <= 2; nch++) {
+        for (uint32_t i = 0; i < OSC_FRAME_POINTS; i++) slot.data[i] = linear[i] = (uint16_t)(i * 40503u);
+        slot.nsamples = OSC_FRAME_POINTS;
+        slot.pretrig = 10;
+        slot.start = 0;
+        slot.nch = nch;
+        slot.bits = 16;
+        uint16_t n = osc_slot_finalize(&slot, 7, 0, OSC_ENC_PACK12);
+        if (n != PROTO_HDR_LEN + OSC_META_LEN + OSC_EXT_LEN + OSC_SEG_EXT_LEN + OSC_BITS_EXT_LEN +
+                     OSC_FRAME_POINTS * 2 + PROTO_CRC_LEN) {
+            return fail("16-bit wire length");
+        }
+        proto_rx_feed(&rx, osc_slot_wire(&slot), n);
+        proto_frame_t f;
+        osc_meta_t m;
+        if (!proto_rx_next(&rx, &f) || f.cmd != PROTO_CMD_OSC_DATA_EXT) return fail("16-bit frame");
+        if (!osc_parse_data(f.cmd, f.payload, f.len, &m) || m.bits != 16 || m.enc != OSC_ENC_RAW16 ||
+            m.nseg != 0 || m.nch != nch) {
+            return fail("16-bit meta");
+        }
+        if (!osc_unpack(&m, out) || memcmp(out, linear, OSC_FRAME_POINTS * 2)) return fail("16-bit samples");
+        printf("OSC_DATA_EXT 16 bits, %u channel(s): ok\n", nch);
+    }
+    slot.bits = 12;
+    slot.nch = 1;
+    if (rx.crc_errors || rx.bad_headers || rx.skipped_bytes) return fail("pc parser counters (ext)");
+
+    proto_rx_free(&rx);
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Передискретизация осциллографа (oscilloscope/oversample.c): сырые отсчёты
+// приходят кусками случайной длины (как половины буфера DMA), выход — в
+// блоки случайного размера (как блоки кадра).
+//
+// Проверяется: совпадение с прямым счётом (сумма 4^k отсчётов канала, сдвиг
+// на k с округлением) для 1..4 каналов и k = 0..4 при любых разбиениях;
+// рост разрядности — полная шкала 4095 даёт 4095·2^k, ноль — ноль; прибавка
+// разрядов на постоянном уровне с шумом около кода АЦП (ожидается около k
+// бит); время на сырой отсчёт и доля ядра на предельной частоте АЦП.
+
+#include "oversample.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RAW_N   (1u << 20)
+#define ADC_MAX_HZ 2000000u     // как OSC_ADC_MAX_HZ в main.c
+
+static uint16_t raw[RAW_N];
+static uint16_t got[RAW_N];
+static uint16_t want[RAW_N];
+static ovs_t ovs;
+static uint32_t rnd_x = 12345;
+
+static int fail(const char *what)
+{
+    fprintf(stderr, "check_oversample: %s\n", what);
+    return 1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t rnd(void)
+{
+    rnd_x = rnd_x * 1103515245u + 12345u;
+    return rnd_x >> 8;
+}
+
+// Нормальный шум (Бокс — Мюллер)
+static double gauss(void)
+{
+    double u = (rnd() + 1.0) / 16777217.0, v = rnd() / 16777216.0;
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// Прямой счёт: группа — nch·4^k сырых подряд, выход по каналам; k = 0 —
+// отсчёты как есть, все до последнего
+static uint32_t reference(const uint16_t *src, uint32_t n, uint8_t nch, uint8_t k, uint16_t *dst)
+{
+    if (k == 0) {
+        memcpy(dst, src, n * sizeof(uint16_t));
+        return n;
+    }
+    uint32_t r = 1u << 2 * k, out = 0;
+    for (uint32_t g = 0; (g + 1) * r * nch <= n; g++) {
+        for (uint8_t c = 0; c < nch; c++) {
+            uint32_t sum = 0;
+            for (uint32_t j = 0; j < r; j++) sum += src[(g * r + j) * nch + c];
+            dst[out++] = (uint16_t)((sum + (1u << (k - 1))) >> k);
+        }
+    }
+    return out;
+}
+
+// Весь поток через ovs_run кусками до max_chunk, выход — блоками до max_room
+static uint32_t run_split(const uint16_t *src, uint32_t n, uint16_t *dst, uint32_t max_chunk, uint32_t max_room)
+{
+    uint32_t i = 0, out = 0, room = 0;
+    while (i < n) {
+        if (room == 0) room = 1 + rnd() % max_room;
+        uint32_t len = 1 + rnd() % max_chunk;
+        if (len > n - i) len = n - i;
+        while (len) {
+            uint32_t used = len;
+            uint32_t w = ovs_run(&ovs, src + i, &used, dst + out, room);
+            out += w;
+            room -= w;
+            i += used;
+            len -= used;
+            if (room == 0) room = 1 + rnd() % max_room;
+        }
+    }
+    return out;
+}
+
+static int check_reference(void)
+{
+    for (uint32_t i = 0; i < RAW_N; i++) raw[i] = (uint16_t)(rnd() & 0x0FFF);
+    static const uint32_t splits[][2] = {{1, 1}, {7, 3}, {1024, 1024}, {3000, 17}, {65536, 8192}};
+    for (uint8_t nch = 1; nch <= OSC_MAX_CH; nch++) {
+        for (uint8_t k = 0; k <= OVS_MAX_SHIFT; k++) {
+            uint32_t n = RAW_N / 16;    // хвост без целой группы — в сумме, на выход не попадает
+            uint32_t m = reference(raw, n, nch, k, want);
+            for (size_t s = 0; s < sizeof(splits) / sizeof(splits[0]); s++) {
+                ovs_config(&ovs, k, nch);
+                uint32_t w = run_split(raw, n, got, splits[s][0], splits[s][1]);
+                if (w != m || memcmp(got, want, m * sizeof(uint16_t))) {
+                    fprintf(stderr, "nch %u, k %u, chunks %u, blocks %u: %u of %u\n", nch, k, splits[s][0],
+                            splits[s][1], w, m);
+                    return fail("differs from reference");
+                }
+            }
+        }
+        printf("%u channel(s), k 0..%u, 5 chunk/block splits: ok\n", nch, OVS_MAX_SHIFT);
+    }
+    return 0;
+}
+
+static int check_range(void)
+{
+    for (uint8_t k = 0; k <= OVS_MAX_SHIFT; k++) {
+        uint32_t r = 1u << 2 * k;
+        for (uint32_t i = 0; i < 4 * r; i++) raw[i] = 4095;
+        for (uint32_t i = 4 * r; i < 8 * r; i++) raw[i] = 0;
+        uint32_t n = 8 * r;
+        ovs_config(&ovs, k, 1);
+        if (ovs_run(&ovs, raw, &n, got, 8) != 8) return fail("range: output count");
+        for (int j = 0; j < 4; j++) {
+            if (got[j] != 4095u << k || got[4 + j] != 0) return fail("range: full scale / zero");
+        }
+    }
+    printf("full scale: 4095 -> %u at k = %u: ok\n", 4095u << OVS_MAX_SHIFT, OVS_MAX_SHIFT);
+    return 0;
+}
+
+// Постоянный уровень между кодами и шум 0,7 кода: СКО ошибки выхода в
+// единицах входа падает в 2^k раз — столько бит и прибавляется
+static int check_enob(void)
+{
+    const double level = 1234.37, sigma = 0.7;
+    for (uint32_t i = 0; i < RAW_N; i++) {
+        long v = lround(level + sigma * gauss());
+        raw[i] = (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v);
+    }
+    double e0 = 0;
+    for (uint32_t i = 0; i < RAW_N; i++) e0 += (raw[i] - level) * (raw[i] - level);
+    e0 = sqrt(e0 / RAW_N);
+    for (uint8_t k = 1; k <= OVS_MAX_SHIFT; k++) {
+        uint32_t n = RAW_N;
+        ovs_config(&ovs, k, 1);
+        uint32_t m = ovs_run(&ovs, raw, &n, got, RAW_N);
+        double e = 0, scale = 1 << k;
+        for (uint32_t i = 0; i < m; i++) e += (got[i] / scale - level) * (got[i] / scale - level);
+        e = sqrt(e / m);
+        double gain = log2(e0 / e);
+        printf("k = %u (%u bits): noise %.3f -> %.4f codes of 12 bits, +%.2f bits\n", k, 12 + k, e0, e, gain);
+        if (gain < k - 0.3) return fail("effective bits gain below k");
+    }
+    return 0;
+}
+
+static void bench(uint8_t nch, uint8_t k)
+{
+    for (uint32_t i = 0; i < RAW_N; i++) raw[i] = (uint16_t)(rnd() & 0x0FFF);
+    ovs_config(&ovs, k, nch);
+    const unsigned reps = 50;
+    double t0 = now_s();
+    for (unsigned r = 0; r < reps; r++) {
+        // Куски по полбуфера DMA, как в прерываниях
+        for (uint32_t i = 0; i < RAW_N; i += OSC_DMA_POINTS) {
+            uint32_t n = OSC_DMA_POINTS;
+            ovs_run(&ovs, raw + i, &n, got, OSC_DMA_POINTS);
+        }
+    }
+    double ns = (now_s() - t0) * 1e9 / ((double)RAW_N * reps);
+    printf("ovs_run %u channel(s), k = %u: %.3f ns/raw sample on host, %.2f%% of a core at %u samples/s\n", nch, k,
+           ns, ns * ADC_MAX_HZ * 1e-7, ADC_MAX_HZ);
+}
+
+int main(void)
+{
+    if (check_reference() || check_range() || check_enob()) return 1;
+    bench(1, 1);
+    bench(1, OVS_MAX_SHIFT);
+    bench(4, 2);
+    return 0;
+}
@@ -0,0 +1,172 @@
+// Синтез таблиц генератора в целых (generator/wave.c) против прежнего
+// расчёта во float: legacy_fill — прежний fill_wave_table дословно, с одной
+// правкой — нижнее ограничение в WAVE_RECT_FULL (без него отрицательный
+// float приводился к uint16_t, неопределённое поведение).
+//
+// Проверяется код в код: все формы на сетке размахов, смещений и
+// скважностей (с краями: 0, за 3300 мВ, за пределы целого пути), плюс
+// случайные параметры. Печатается доля отсчётов, посчитанных во float (у
+// границы кода), и время пересчёта таблицы: float против целых.
+
+#include "wave.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static uint16_t ref[WAVE_TABLE_POINTS];
+static uint16_t got[WAVE_TABLE_POINTS];
+volatile uint16_t sink;
+
+static void legacy_fill(uint16_t *table, uint16_t len, const wave_params_t *p)
+{
+    float ampl = p->ampl_mVpp / 2.0f;
+    float offset = p->offset_mV;
+
+    switch (p->type) {
+    case WAVE_SINE:
+        for (uint16_t i = 0; i < len; i++) {
+            float x = (2.0f * 3.1415926f * i) / len;
+            float v = offset + ampl * sinf(x);
+            if (v < 0) v = 0; // простая защита
+            if (v > 3300) v = 3300;
+            table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+        }
+        break;
+    case WAVE_RECT_FULL:
+        for (uint16_t i = 0; i < len; i++) {
+            float v = offset + ampl * fabsf(sinf((2.0f * 3.1415926f * i) / len));
+            if (v < 0) v = 0;
+            if (v > 3300) v = 3300;
+            table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+        }
+        break;
+    case WAVE_RECT_HALF:
+        for (uint16_t i = 0; i < len; i++) {
+            float s = sinf((2.0f * 3.1415926f * i) / len);
+            float v = offset + (s > 0 ? ampl * s : 0);
+            if (v < 0) v = 0;
+            if (v > 3300) v = 3300;
+            table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+        }
+        break;
+    case WAVE_SAW:
+        for (uint16_t i = 0; i < len; i++) {
+            float v = offset + ampl * ((float)i / len * 2.0f - 1.0f);
+            if (v < 0) v = 0;
+            if (v > 3300) v = 3300;
+            table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+        }
+        break;
+    case WAVE_TRI:
+        for (uint16_t i = 0; i < len; i++) {
+            float phase = (float)i / len;
+            float v = (phase < 0.5f) ? (phase * 2.0f) : (2.0f - phase * 2.0f);
+            v = offset + ampl * (v * 2.0f - 1.0f);
+            if (v < 0) v = 0;
+            if (v > 3300) v = 3300;
+            table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+        }
+        break;
+    case WAVE_SQUARE:
+        for (uint16_t i = 0; i < len; i++) {
+            float duty = p->duty_permille / 1000.0f;
+            float v = ( (float)i / len < duty ) ? (offset + ampl) : (offset - ampl);
+            if (v < 0) v = 0;
+            if (v > 3300) v = 3300;
+            table[i] = (uint16_t)(v * 4095.0f / 3300.0f);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static unsigned long long tables, points, redone;
+
+static int check(const wave_params_t *p)
+{
+    legacy_fill(ref, WAVE_TABLE_POINTS, p);
+    redone += wave_fill(got, WAVE_TABLE_POINTS, p);
+    tables++;
+    points += WAVE_TABLE_POINTS;
+    for (unsigned i = 0; i < WAVE_TABLE_POINTS; i++) {
+        if (got[i] != ref[i]) {
+            fprintf(stderr, "check_synth: type %u ampl %u mVpp offset %d mV duty %u: point %u is %u, float %u\n",
+                    p->type, p->ampl_mVpp, p->offset_mV, p->duty_permille, i, got[i], ref[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double bench(uint8_t type, bool fixed)
+{
+    wave_params_t p = {type, 1000000, 1000, 1650, 500};
+    const int reps = 20000;
+    double t0 = now_s();
+    for (int r = 0; r < reps; r++) {
+        p.ampl_mVpp = (uint16_t)(1000 + r % 7);
+        if (fixed) {
+            wave_fill(got, WAVE_TABLE_POINTS, &p);
+        } else {
+            legacy_fill(got, WAVE_TABLE_POINTS, &p);
+        }
+        sink = got[r % WAVE_TABLE_POINTS];
+    }
+    return (now_s() - t0) / reps * 1e6;
+}
+
+int main(void)
+{
+    static const uint16_t ampls[] = {0, 1, 2, 3, 7, 10, 99, 100, 333, 999, 1000, 1001, 1650, 2000, 3299, 3300,
+                                     3301, 4000, 6599, 6600, 6601, 6602, 10000, 65535};
+    static const int16_t offs[] = {-32768, -6601, -6600, -5000, -1650, -1, 0, 1, 100, 825, 1000, 1649, 1650,
+                                   1651, 3299, 3300, 3301, 5000, 6600, 6601, 32767};
+    static const uint16_t duties[] = {0, 1, 125, 250, 333, 499, 500, 501, 875, 999, 1000, 1001, 65535};
+    static const char *names[] = {"sine", "rect_full", "rect_half", "saw", "tri", "square"};
+    wave_init();
+
+    for (uint8_t t = WAVE_SINE; t <= WAVE_SQUARE; t++) {
+        for (unsigned a = 0; a < sizeof(ampls) / sizeof(ampls[0]); a++) {
+            for (unsigned o = 0; o < sizeof(offs) / sizeof(offs[0]); o++) {
+                for (unsigned d = 0; d < sizeof(duties) / sizeof(duties[0]); d++) {
+                    wave_params_t p = {t, 1000000, ampls[a], offs[o], duties[d]};
+                    if (check(&p)) return 1;
+                    if (t != WAVE_SQUARE) break;
+                }
+            }
+        }
+    }
+    // Рабочая область: размах до 6,6 В, смещение −3,3..6,6 В, все скважности
+    srand(18);
+    for (unsigned n = 0; n < 300000; n++) {
+        wave_params_t p = {(uint8_t)(rand() % 6), 1000000, (uint16_t)(rand() % 6601),
+                           (int16_t)(rand() % 9901 - 3300), (uint16_t)(rand() % 1001)};
+        if (check(&p)) return 1;
+    }
+    // Все размахы при середине шкалы
+    for (unsigned a = 0; a <= 6600; a++) {
+        wave_params_t p = {WAVE_SINE, 1000000, (uint16_t)a, 1650, 500};
+        if (check(&p)) return 1;
+    }
+    printf("%llu tables, %llu points: all equal to float; %.2f%% of points redone in float near a code edge\n",
+           tables, points, 100.0 * redone / points);
+    // Без FPU цена таблицы — в основном отсчёты во float (программные)
+    printf("float points per table: %u before, %.1f now\n", WAVE_TABLE_POINTS, (double)redone / tables);
+
+    for (uint8_t t = WAVE_SINE; t <= WAVE_SQUARE; t++) {
+        double f = bench(t, false), q = bench(t, true);
+        printf("%-9s %u points: float %6.2f us, q15 %5.2f us (x%.1f) on host\n", names[t], WAVE_TABLE_POINTS, f, q,
+               f / q);
+    }
+    return 0;
+}
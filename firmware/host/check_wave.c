@@ -0,0 +1,135 @@
+// Замена таблицы генератора на границах DMA (generator/wave.c): DMA
+// circular читает буфер по отсчёту, в середине и в конце — прерывания
+// половины и конца передачи; основной цикл в случайные моменты ставит
+// новую таблицу (только когда прежняя замена завершилась, как
+// apply_pending). Таблица k: отсчёт i — k * len + i, по значению видно,
+// из какой таблицы и какого места отсчёт.
+//
+// Проверяется: каждый период на выходе — одна таблица целиком, по порядку,
+// без пропусков; от запроса до нового периода — не больше двух периодов.
+// Для сравнения — прежний путь: таблица переписывается на месте в
+// случайный момент (период из двух таблиц). Плюс время wave_fill: сколько
+// стоил пересчёт на каждую из команд «Применить» против одного set_all.
+
+#include "wave.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint16_t out[MAX_USER_POINTS];
+static uint16_t shadow[MAX_USER_POINTS];
+static wave_swap_t swap;
+static unsigned long long req_n[0x10000];   // период запроса таблицы k
+volatile uint16_t sink;                     // чтобы wave_fill не выбросил оптимизатор
+
+static int fail(const char *what, unsigned len, unsigned long long period)
+{
+    fprintf(stderr, "check_wave: %s (len %u, period %llu)\n", what, len, period);
+    return 1;
+}
+
+static void fill_id(uint16_t *t, unsigned len, unsigned k)
+{
+    for (unsigned i = 0; i < len; i++) t[i] = (uint16_t)(k * len + i);
+}
+
+// Период: все отсчёты одной таблицы и на своих местах; номер таблицы или -1
+static int period_table(const uint16_t *p, unsigned len)
+{
+    unsigned k = p[0] / len;
+    for (unsigned i = 0; i < len; i++) {
+        if (p[i] != k * len + i) return -1;
+    }
+    return (int)k;
+}
+
+// naive — таблица пишется прямо в out, как прежний apply_waveform без
+// остановки DMA
+static int run(unsigned len, unsigned periods, bool naive, unsigned *mixed)
+{
+    uint16_t *got = malloc(len * sizeof(uint16_t));
+    unsigned next_k = 1, shown = 0, pos = 0;
+    unsigned worst = 0;
+    int prev = 0;
+    *mixed = 0;
+    fill_id(out, len, 0);
+    wave_swap_init(&swap, out, len);
+    srand(len);
+    for (unsigned long long n = 0; n < periods; n++) {
+        for (pos = 0; pos < len; pos++) {
+            // Основной цикл между отсчётами: изредка — новая таблица
+            if (next_k * len + len <= 0x10000 && rand() % (len / 2 + 1) == 0) {
+                if (naive) {
+                    fill_id(out, len, next_k++);
+                } else if (!wave_swap_busy(&swap)) {
+                    fill_id(shadow, len, next_k++);
+                    wave_swap_request(&swap, shadow);
+                    req_n[next_k - 1] = n;
+                }
+            }
+            got[pos] = out[pos];
+            if (pos + 1 == len / 2) wave_swap_half(&swap);
+        }
+        wave_swap_full(&swap);
+
+        int k = period_table(got, len);
+        if (k < 0) {
+            (*mixed)++;
+            if (!naive) return fail("period from two tables", len, n);
+            continue;
+        }
+        if (naive) continue;
+        if (k < prev || (k != prev && k != prev + 1)) return fail("tables out of order", len, n);
+        if (k != prev) {
+            shown++;
+            unsigned d = (unsigned)(n - req_n[k]);
+            if (d > worst) worst = d;
+        }
+        prev = k;
+    }
+    free(got);
+    if (naive) return 0;
+    if (shown + 1 != next_k && !(shown + 2 == next_k && wave_swap_busy(&swap))) {
+        return fail("requested table never shown", len, periods);
+    }
+    if (worst > 2) return fail("swap took more than two periods", len, periods);
+    printf("len %4u: %5u tables swapped, 0 mixed periods, worst %u periods to take effect\n", len, shown, worst);
+    return 0;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    static const unsigned lens[] = {WAVE_TABLE_POINTS, 255, 17, MAX_USER_POINTS};
+    wave_init();
+    for (unsigned i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        unsigned mixed;
+        if (run(lens[i], 20000, false, &mixed)) return 1;
+        if (run(lens[i], 20000, true, &mixed)) return 1;
+        printf("          in-place rewrite: %u mixed periods\n", mixed);
+        if (!mixed) return fail("in-place rewrite never mixed periods (test too weak)", lens[i], 0);
+    }
+
+    // «Применить»: прежде set_wave/set_ampl/set_offset/set_duty пересчитывали
+    // таблицу (до 4 раз) и перезапускали DMA (5 раз), set_all — один пересчёт
+    wave_params_t p = {WAVE_SINE, 1000000, 1000, 1650, 500};
+    const int reps = 20000;
+    double t0 = now_s();
+    for (int r = 0; r < reps; r++) {
+        p.ampl_mVpp = (uint16_t)(1000 + r % 7);
+        wave_fill(shadow, WAVE_TABLE_POINTS, &p);
+        sink = shadow[r % WAVE_TABLE_POINTS];
+    }
+    double us = (now_s() - t0) / reps * 1e6;
+    printf("wave_fill sine %u points: %.2f us on host; apply: 4 fills + 5 DMA restarts -> 1 fill, 0 restarts\n",
+           WAVE_TABLE_POINTS, us);
+    return 0;
+}
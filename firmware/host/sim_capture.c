@@ -0,0 +1,219 @@
+// Имитация DMA АЦП в двухбуферном режиме поверх capture.c: блоки потока
+// пишутся по адресам, которые вернул capture_block, на блок вперёд (как
+// железо пишет в другой буфер, пока идёт прерывание); «передача» держит
+// слот rd заданное число блоков и проверяет кадр в момент освобождения.
+//
+// Проверяется: без триггера кадры идут встык, без пропусков и повторов
+// (при полном кольце теряются только целые кадры и это видно в dropped);
+// с триггером каждый кадр — непрерывный кусок потока, точка триггера на
+// месте pretrig (ровно pre), ни одно срабатывание не пропущено при быстрой передаче.
+// То же для потока из 2..4 чередующихся каналов: phase кадра — канал его
+// первого отсчёта, триггер — только по каналу trig_ch, кадр с триггером
+// начинается с канала 0.
+
+#include "capture.h"
+#include "crc16.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NSLOTS 4
+
+static osc_slot_t ring[NSLOTS];
+static capture_t cap;
+static uint8_t sim_nch = 1, sim_trig_ch = 0;
+
+// Отсчёт потока — младшие 16 бит номера
+static inline uint16_t sample(uint64_t idx)
+{
+    return (uint16_t)idx;
+}
+
+typedef struct {
+    uint64_t frames;
+    uint64_t next_idx;      // номер отсчёта, с которого ждём следующий кадр
+    uint64_t gap;           // пропущено отсчётов между кадрами
+    uint64_t first_idx;
+    uint16_t pretrig_min, pretrig_max;
+} stats_t;
+
+static int fail(const char *what, uint64_t frame)
+{
+    fprintf(stderr, "sim_capture: %s (frame %llu)\n", what, (unsigned long long)frame);
+    return 1;
+}
+
+// Проверка кадра: непрерывность и восстановление номера первого отсчёта
+static int check_frame(const osc_slot_t *s, stats_t *st, int trig, uint16_t level)
+{
+    const uint16_t *d = s->data;
+    if (s->start != 0) return fail("slot not rotated", st->frames);
+    if (s->nsamples != OSC_FRAME_POINTS) return fail("nsamples", st->frames);
+    for (uint32_t i = 1; i < s->nsamples; i++) {
+        if ((uint16_t)(d[i - 1] + 1) != d[i]) return fail("samples not contiguous", st->frames);
+    }
+    // Первый номер >= next_idx с теми же младшими 16 битами
+    uint64_t idx = st->next_idx + (uint16_t)(d[0] - sample(st->next_idx));
+    if (st->frames == 0) st->first_idx = idx;
+    st->gap += idx - st->next_idx;
+    st->next_idx = idx + s->nsamples;
+    if (s->nch != sim_nch || s->phase != idx % sim_nch) return fail("nch/phase", st->frames);
+    if (trig && sim_nch > 1) {
+        // Срабатывание — первый отсчёт канала trig_ch не ниже level
+        if (s->phase != 0 || (idx + s->pretrig) % sim_nch != sim_trig_ch ||
+            (uint16_t)(d[s->pretrig] - level) >= sim_nch) {
+            fprintf(stderr, "pretrig %u: %u, level %u, phase %u\n", s->pretrig, d[s->pretrig], level, s->phase);
+            return fail("trigger point not on trig_ch", st->frames);
+        }
+    } else if (trig) {
+        if (d[s->pretrig] != level) {
+            fprintf(stderr, "pretrig %u: %u != %u\n", s->pretrig, d[s->pretrig], level);
+            return fail("trigger point not at pretrig", st->frames);
+        }
+    }
+    if (trig) {
+        if (s->pretrig < st->pretrig_min) st->pretrig_min = s->pretrig;
+        if (s->pretrig > st->pretrig_max) st->pretrig_max = s->pretrig;
+    }
+    st->frames++;
+    return 0;
+}
+
+// Прогон: nblocks блоков DMA; передача занимает tx_blocks блоков на кадр
+// (0 — кадр забирают сразу, rnd — случайно 0..tx_blocks)
+static int run(uint8_t mode, uint16_t level, uint8_t pre_pct, uint64_t nblocks, uint32_t tx_blocks, int rnd,
+               stats_t *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->pretrig_min = 0xFFFF;
+    capture_init(&cap, ring, NSLOTS);
+    trigger_config(&cap.trig, mode, TRIG_RISING, level, 16);
+    cap.pre_pct = pre_pct;
+    cap.nch = sim_nch;
+    cap.trig_ch = sim_trig_ch;
+    capture_restart(&cap);
+
+    uint32_t rng = 12345;
+    int tx_busy = 0;
+    uint32_t tx_left = 0;
+    uint64_t idx = 0;
+
+    // Блок 0 уже записан; в цикле DMA пишет блок k+1, пока обрабатывается k
+    for (uint32_t j = 0; j < OSC_DMA_POINTS; j++) capture_target(&cap, 0)[j] = sample(idx++);
+    for (uint64_t k = 0; k < nblocks; k++) {
+        uint16_t *dst = capture_target(&cap, (int)((k + 1) & 1));
+        for (uint32_t j = 0; j < OSC_DMA_POINTS; j++) dst[j] = sample(idx++);
+        capture_block(&cap, (int)(k & 1));
+
+        // Передача
+        if (tx_busy && tx_left-- == 0) {
+            if (check_frame(&ring[cap.rd], st, mode == TRIG_NORM, level)) return 1;
+            capture_release(&cap);
+            tx_busy = 0;
+        }
+        if (!tx_busy && cap.rd != cap.wr) {
+            osc_slot_finalize(&ring[cap.rd], 0, 0, OSC_ENC_RAW16);
+            if (rnd) {
+                rng = rng * 1103515245u + 12345u;
+                tx_left = (rng >> 16) % (tx_blocks + 1);
+            } else {
+                tx_left = tx_blocks;
+            }
+            tx_busy = 1;
+            if (tx_left == 0) {
+                if (check_frame(&ring[cap.rd], st, mode == TRIG_NORM, level)) return 1;
+                capture_release(&cap);
+                tx_busy = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+// pre так же, как в capture.c: при нескольких каналах pre ≡ trig_ch (mod nch)
+static uint32_t pre_points(uint8_t pct)
+{
+    uint32_t pre = OSC_FRAME_POINTS * pct / 100;
+    if (sim_nch > 1) {
+        pre = pre - pre % sim_nch + sim_trig_ch;
+        if (pre > OSC_FRAME_POINTS - 1) pre -= sim_nch;
+    }
+    if (pre > OSC_FRAME_POINTS - 1) pre = OSC_FRAME_POINTS - 1;
+    return pre;
+}
+
+int main(void)
+{
+    crc16_init();
+    stats_t st;
+    const uint32_t frame_blocks = OSC_FRAME_POINTS / OSC_DMA_POINTS;
+
+    // Без триггера, передача успевает: все отсчёты ровно по разу
+    if (run(TRIG_OFF, 0, 0, 100000, 0, 0, &st)) return 1;
+    if (st.gap || cap.dropped || st.first_idx != 0) return fail("free run: samples lost", st.frames);
+    if (st.frames < 100000 / frame_blocks - 1) return fail("free run: frames missing", st.frames);
+    printf("free run, fast link:  %llu frames, 0 lost, 0 duplicated\n", (unsigned long long)st.frames);
+
+    // Передача медленнее захвата: теряются только целые кадры
+    uint32_t slow[] = {frame_blocks - 1, frame_blocks, frame_blocks + 1, 3 * frame_blocks};
+    for (size_t i = 0; i < sizeof(slow) / sizeof(slow[0]); i++) {
+        for (int r = 0; r < 2; r++) {
+            if (run(TRIG_OFF, 0, 0, 100000, slow[i], r, &st)) return 1;
+            if (st.gap > (uint64_t)cap.dropped * OSC_FRAME_POINTS || st.gap % OSC_FRAME_POINTS) {
+                return fail("free run: partial frame lost", st.frames);
+            }
+            printf("free run, tx %2u blk%s: %6llu frames, %6u dropped, gap %llu samples\n", slow[i],
+                   r ? " rnd" : "    ", (unsigned long long)st.frames, cap.dropped, (unsigned long long)st.gap);
+        }
+    }
+
+    // С триггером: пила 0..65535, срабатывание раз в 65536 отсчётов
+    static const uint8_t pres[] = {0, 10, 50, 90, 100};
+    static const uint16_t levels[] = {1000, 0x8000, 0x8000 + 777, 65000};
+    for (size_t p = 0; p < sizeof(pres) / sizeof(pres[0]); p++) {
+        for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+            uint64_t nblocks = 20000;
+            if (run(TRIG_NORM, levels[l], pres[p], nblocks, 1, 0, &st)) return 1;
+            uint32_t pre = pre_points(pres[p]);
+            if (st.frames && (st.pretrig_min != pre || st.pretrig_max != pre)) {
+                return fail("pretrig != pre", st.frames);
+            }
+            // Срабатывания с достаточной предысторией, кадр которых успел закончиться
+            uint64_t total = nblocks * OSC_DMA_POINTS, expect = 0;
+            for (uint64_t t = levels[l]; t + (OSC_FRAME_POINTS - pre) + 2 * OSC_DMA_POINTS < total; t += 65536) {
+                if (t >= pre) expect++;
+            }
+            if (st.frames != expect || cap.dropped) {
+                fprintf(stderr, "pre %u level %u: %llu frames, expected %llu\n", pre, levels[l], (unsigned long long)st.frames, (unsigned long long)expect);
+                return fail("trigger: frames missing", st.frames);
+            }
+        }
+    }
+    printf("norm trigger: every edge captured, data[pretrig] == level, pretrig == pre\n");
+
+    // auto без срабатываний (уровень выше сигнала не бывает — взвода нет)
+    if (run(TRIG_AUTO, 0, 50, 20000, 2, 1, &st)) return 1;
+    if (st.frames == 0) return fail("auto: no frames", 0);
+    printf("auto trigger: %llu frames, contiguous\n", (unsigned long long)st.frames);
+
+    // Несколько каналов: тот же поток и те же кадры, что у одного канала
+    for (sim_nch = 2; sim_nch <= OSC_MAX_CH; sim_nch++) {
+        sim_trig_ch = sim_nch - 1;
+        if (run(TRIG_OFF, 0, 0, 20000, frame_blocks - 1, 0, &st)) return 1;
+        if (st.gap || cap.dropped) return fail("multi-channel free run: samples lost", st.frames);
+        uint64_t free_frames = st.frames;
+        for (size_t p = 0; p < sizeof(pres) / sizeof(pres[0]); p++) {
+            if (run(TRIG_NORM, 0x8000 + 777, pres[p], 20000, 1, 0, &st)) return 1;
+            uint32_t pre = pre_points(pres[p]);
+            if (st.frames == 0 || st.pretrig_min != pre || st.pretrig_max != pre) {
+                fprintf(stderr, "nch %u pre %u: pretrig %u..%u\n", sim_nch, pre, st.pretrig_min, st.pretrig_max);
+                return fail("multi-channel pretrig", st.frames);
+            }
+        }
+        if (run(TRIG_AUTO, 0, 50, 20000, 2, 1, &st)) return 1;
+        printf("%u channels: free run %llu frames gapless, trigger on ch %u, auto %llu frames\n", sim_nch,
+               (unsigned long long)free_frames, sim_trig_ch, (unsigned long long)st.frames);
+    }
+    return 0;
+}
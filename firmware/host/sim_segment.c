@@ -0,0 +1,224 @@
+// Имитация сегментного захвата (segment.c) поверх DMA в двухбуферном
+// режиме, как в sim_capture: блок k+1 пишется по адресу из seg_block, пока
+// обрабатывается блок k. Память — как на плате: слоты 1..3 кольца.
+//
+// Проверяется: разметка памяти (история вмещает предысторию и два блока,
+// сегменты не вылезают за память, их столько, сколько помещается); каждый
+// сегмент — ровно тот кусок потока, что даёт эталон — тот же автомат
+// триггера по одному отсчёту без блоков: срабатывание на месте pretrig,
+// метка t — номер отсчёта, следующее срабатывание — первое после конца
+// сегмента (мёртвое время — только перевзвод). Редкие импульсы — ни один
+// не пропущен; частая пила — сегменты один за другим; без триггера —
+// сегменты встык; 2..4 канала — триггер по trig_ch, сегмент с канала 0.
+
+#include "segment.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define B OSC_DMA_POINTS
+#define POOL_POINTS (3 * sizeof(osc_slot_t) / sizeof(uint16_t))
+#define STREAM_BLOCKS 3000
+
+static osc_slot_t ring[4];
+static seg_t seg;
+static uint16_t stream[(STREAM_BLOCKS + 1) * B];
+static uint8_t sim_nch = 1, sim_trig_ch = 0;
+
+static int fail(const char *what, uint32_t k)
+{
+    fprintf(stderr, "sim_segment: %s (segment %u)\n", what, k);
+    return 1;
+}
+
+// Сигналы. Канал trig_ch — импульсы или пила, остальные — номер отсчёта.
+enum { SIG_PULSES, SIG_SAW };
+
+static void make_stream(int sig, uint32_t period)
+{
+    uint32_t rng = 777, next = 5000, k = 0;
+    for (uint64_t i = 0; i < sizeof(stream) / sizeof(stream[0]); i++) {
+        if (i % sim_nch != sim_trig_ch) {
+            stream[i] = (uint16_t)i;
+            continue;
+        }
+        if (sig == SIG_SAW) {
+            stream[i] = (uint16_t)(k++ % period * 4000 / period);
+            continue;
+        }
+        // Импульс 3000 шириной 20 отсчётов канала через 2000..32000
+        if (k >= next + 20) {
+            rng = rng * 1103515245u + 12345u;
+            next = k + 2000 + (rng >> 16) % 30000;
+        }
+        stream[i] = k >= next ? 3000 : 400 + (uint16_t)(k % 7);
+        k++;
+    }
+}
+
+// Прогон: nblocks блоков DMA
+static void run(uint8_t mode, uint16_t level, uint32_t len, uint32_t nseg, uint8_t pre_pct, uint32_t nblocks)
+{
+    memset(&seg, 0, sizeof(seg));
+    trigger_config(&seg.trig, mode, TRIG_RISING, level, 50);
+    seg.nch = sim_nch;
+    seg.trig_ch = sim_trig_ch;
+    seg.fs_hz = 100000;
+    seg_plan(&seg, (uint16_t *)&ring[1], POOL_POINTS, len, nseg, pre_pct);
+    seg_start(&seg);
+
+    uint64_t idx = 0;
+    memcpy(seg_target(&seg, 0), stream, B * sizeof(uint16_t));
+    idx += B;
+    for (uint32_t k = 0; k < nblocks; k++) {
+        memcpy(seg_target(&seg, (int)((k + 1) & 1)), stream + idx, B * sizeof(uint16_t));
+        idx += B;
+        seg_block(&seg, (int)(k & 1));
+    }
+}
+
+// Эталон: автомат по одному отсчёту по всему потоку. Сегмент засчитан, если
+// его конец не дальше обработанных блоков. Сверка с seg; число сегментов —
+// в *count.
+static int check(uint32_t nblocks, uint32_t *count)
+{
+    trigger_t t;
+    trigger_config(&t, seg.trig.mode, seg.trig.edge, seg.trig.level, seg.trig.hyst);
+    uint64_t done = (uint64_t)nblocks * B, from = 0;
+    uint32_t k = 0;
+    while (k < seg.nseg) {
+        uint64_t hit;
+        if (seg.trig.mode == TRIG_OFF) {
+            hit = from;
+        } else {
+            for (hit = from; hit < done; hit++) {
+                if (hit % sim_nch != sim_trig_ch) continue;
+                if (trigger_scan_scalar(&t, &stream[hit], 1) == 0 && hit >= seg.pre) break;
+            }
+        }
+        uint64_t start = hit - seg.pre;
+        if (start + seg.len > done) break;
+        if (k >= seg.filled) return fail("segment missing", k);
+        const seg_info_t *in = &seg.info[k];
+        if (in->t != hit || in->pretrig != seg.pre) {
+            fprintf(stderr, "t %llu, want %llu; pretrig %u, want %u\n", (unsigned long long)in->t,
+                    (unsigned long long)hit, in->pretrig, seg.pre);
+            return fail("timestamp", k);
+        }
+        if (in->phase != start % sim_nch) return fail("phase", k);
+        if (seg.trig.mode != TRIG_OFF && in->phase != 0) return fail("triggered segment not on channel 0", k);
+        if (memcmp(seg_data(&seg, k), &stream[start], seg.len * sizeof(uint16_t))) {
+            return fail("samples differ from stream", k);
+        }
+        from = start + seg.len;
+        trigger_rearm(&t);
+        k++;
+    }
+    if (seg.filled != k) return fail("extra segments", seg.filled);
+    if (seg.state != (k == seg.nseg ? SEG_DONE : SEG_ARMED)) return fail("state", k);
+    *count = k;
+    return 0;
+}
+
+static int check_layout(void)
+{
+    static const uint32_t lens[] = {1, 64, 100, 1000, 1024, 4097, 8192, 60000};
+    static const uint8_t pcts[] = {0, 10, 50, 100};
+    memset(&seg, 0, sizeof(seg));
+    for (sim_nch = 1; sim_nch <= OSC_MAX_CH; sim_nch++) {
+        seg.nch = sim_nch;
+        seg.trig_ch = sim_nch - 1;
+        for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+            for (size_t p = 0; p < sizeof(pcts) / sizeof(pcts[0]); p++) {
+                trigger_config(&seg.trig, pcts[p] ? TRIG_NORM : TRIG_OFF, TRIG_RISING, 1000, 10);
+                uint32_t n = seg_plan(&seg, (uint16_t *)&ring[1], POOL_POINTS, lens[l], 0, pcts[p]);
+                uint32_t fit = (POOL_POINTS - seg.hist_len) / seg.len;
+                if (fit > SEG_MAX) fit = SEG_MAX;
+                if (seg.len < SEG_MIN_POINTS - OSC_MAX_CH || seg.len > OSC_FRAME_POINTS || seg.len % sim_nch ||
+                    seg.hist_len % B || seg.hist_len < seg.pre + 2 * B ||
+                    seg.seg + n * seg.len > (uint16_t *)&ring[1] + POOL_POINTS || n != fit || n == 0) {
+                    fprintf(stderr, "len %u pct %u nch %u: len %u pre %u hist %u nseg %u\n", lens[l], pcts[p],
+                            sim_nch, seg.len, seg.pre, seg.hist_len, n);
+                    return fail("layout", 0);
+                }
+                if (seg.trig.mode != TRIG_OFF && seg.pre % sim_nch != seg.trig_ch) return fail("pre channel", 0);
+                if (sim_nch == 1 && p == 2 && (lens[l] == 64 || lens[l] == 1000 || lens[l] == 8192)) {
+                    printf("layout: %4u samples, pre 50%%: history %5u, %3u segments (pool %u)\n", seg.len,
+                           seg.hist_len, n, (unsigned)POOL_POINTS);
+                }
+            }
+        }
+        // Меньше, чем помещается, — сколько просили
+        if (seg_plan(&seg, (uint16_t *)&ring[1], POOL_POINTS, 1000, 3, 50) != 3) return fail("nseg = 3", 0);
+    }
+    sim_nch = 1;
+    return 0;
+}
+
+int main(void)
+{
+    uint32_t n;
+    if (check_layout()) return 1;
+
+    // Редкие импульсы: ни один не пропущен, сегментов — сколько импульсов
+    static const uint32_t lens[] = {64, 500, 2048, 8192};
+    static const uint8_t pres[] = {0, 25, 100};
+    make_stream(SIG_PULSES, 0);
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        for (size_t p = 0; p < sizeof(pres) / sizeof(pres[0]); p++) {
+            run(TRIG_NORM, 1500, lens[l], 0, pres[p], STREAM_BLOCKS);
+            if (check(STREAM_BLOCKS, &n)) return 1;
+            if (n < 2) return fail("pulses: too few segments", n);
+        }
+        printf("pulses, %4u samples: %3u segments of %3u, data and timestamps match\n", lens[l], n, seg.nseg);
+    }
+
+    // Частая пила: срабатывание каждые 300 отсчётов, сегменты длиннее —
+    // следующий с первого срабатывания после конца прошлого
+    make_stream(SIG_SAW, 300);
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        run(TRIG_NORM, 2000, lens[l], 0, 50, STREAM_BLOCKS);
+        if (check(STREAM_BLOCKS, &n)) return 1;
+        // От конца сегмента до следующего срабатывания — не больше двух
+        // периодов пилы (перевзвод и фронт)
+        uint64_t dead = 0;
+        for (uint32_t k = 1; k < n; k++) {
+            uint64_t d = seg.info[k].t - (seg.info[k - 1].t - seg.pre + seg.len);
+            if (d > 2 * 300) return fail("saw: trigger missed after segment", k);
+            dead += d;
+        }
+        printf("saw /300, %4u samples: %3u segments, end to next trigger %.1f samples avg\n", lens[l], n,
+               n > 1 ? (double)dead / (n - 1) : 0.0);
+    }
+
+    // Без триггера: сегменты встык — поток без пропусков
+    run(TRIG_OFF, 0, 1000, 0, 50, STREAM_BLOCKS);
+    if (check(STREAM_BLOCKS, &n)) return 1;
+    for (uint32_t k = 0; k < n; k++) {
+        if (seg.info[k].t != (uint64_t)k * seg.len || seg.info[k].pretrig != 0) return fail("free run: gap", k);
+    }
+    printf("free run: %u segments back to back\n", n);
+
+    // Захват кончился посреди потока, часть сегментов ещё не собрана
+    make_stream(SIG_PULSES, 0);
+    run(TRIG_NORM, 1500, 2048, 0, 50, 40);
+    if (check(40, &n)) return 1;
+    printf("partial: %u of %u segments after 40 blocks, state armed\n", n, seg.nseg);
+
+    // Несколько каналов: триггер по последнему
+    for (sim_nch = 2; sim_nch <= OSC_MAX_CH; sim_nch++) {
+        sim_trig_ch = sim_nch - 1;
+        make_stream(SIG_PULSES, 0);
+        for (size_t p = 0; p < sizeof(pres) / sizeof(pres[0]); p++) {
+            run(TRIG_NORM, 1500, 1000, 0, pres[p], STREAM_BLOCKS);
+            if (check(STREAM_BLOCKS, &n)) return 1;
+        }
+        run(TRIG_OFF, 0, 999, 0, 0, STREAM_BLOCKS);
+        uint32_t n_off;
+        if (check(STREAM_BLOCKS, &n_off)) return 1;
+        printf("%u channels: trigger on ch %u, %u segments; free run %u segments\n", sim_nch, sim_trig_ch, n,
+               n_off);
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+#include "capture.h"
+
+#include <stdbool.h>
+
+#define N OSC_FRAME_POINTS
+#define B OSC_DMA_POINTS
+#define M OSC_SLOT_POINTS
+
+void capture_init(capture_t *c, osc_slot_t *ring, uint8_t nslots)
+{
+    c->ring = ring;
+    c->nslots = nslots;
+    c->pre_pct = 50;
+    c->fs_hz = 100000;
+    c->nch = 1;
+    c->trig_ch = 0;
+    c->phase = 0;
+    c->bits = 12;
+    c->dropped = 0;
+    trigger_config(&c->trig, TRIG_OFF, TRIG_RISING, 0, 0);
+    // До запуска DMA: блоки 0 и 1 первого слота
+    c->tgt_slot[0] = c->tgt_slot[1] = 0;
+    c->tgt_pos[0] = 0;
+    c->tgt_pos[1] = B;
+    c->asg_slot = 0;
+    c->asg_pos = 2 * B;
+    c->rd = c->wr = c->cap_slot = 0;
+    c->pending = -1;
+    capture_restart(c);
+}
+
+void capture_restart(capture_t *c)
+{
+    c->filled = 0;
+    c->wait = 0;
+    c->post = -1;
+    trigger_rearm(&c->trig);
+}
+
+void capture_flush(capture_t *c)
+{
+    // Блоки, уже идущие в другие слоты, отбросит capture_block
+    c->rd = c->wr = c->cap_slot = c->asg_slot;
+    c->pending = -1;
+    capture_restart(c);
+}
+
+static void publish(capture_t *c)
+{
+    c->wr = (c->wr + 1) % c->nslots;
+}
+
+// Канал отсчёта в позиции p слота; блок в позиции pos начинается с c->phase.
+// Кадр не длиннее слота, поэтому p — не дальше блока вперёд или M - B назад.
+static uint8_t phase_at(const capture_t *c, uint32_t pos, uint32_t p)
+{
+    uint32_t rel = (p + M - pos) % M;
+    if (rel < B) return (uint8_t)((c->phase + rel) % c->nch);
+    return (uint8_t)((c->phase + c->nch - (M - rel) % c->nch) % c->nch);
+}
+
+// Кадр готов: N отсчётов слота с позиции start (канал phase). Если кольцо
+// полно, слот не отдаём (в rd может идти передача) — кадр теряется, захват
+// начинается заново в том же слоте.
+static void complete(capture_t *c, uint32_t start, uint8_t phase, int other)
+{
+    osc_slot_t *f = &c->ring[c->cap_slot];
+    uint8_t next = (c->cap_slot + 1) % c->nslots;
+
+    capture_restart(c);
+    // Без триггера следующий блок назначается в новый слот заранее; если
+    // этого не случилось (кольцо было полно), отдавать кадр нельзя: блок
+    // после него пропал бы в запасе и кадры перестали бы идти встык
+    if (next == c->rd || (c->trig.mode == TRIG_OFF && c->tgt_slot[other] == c->cap_slot)) {
+        c->dropped++;
+        return;
+    }
+    f->fs_hz = c->fs_hz;
+    f->nsamples = N;
+    f->pretrig = (uint16_t)((c->trig_pos + M - start) % M);
+    f->start = (uint16_t)start;
+    f->nch = c->nch;
+    f->phase = phase;
+    f->nseg = 0;
+    f->bits = c->bits;
+
+    if (c->tgt_slot[other] == c->cap_slot) {
+        // Следующий блок уже пишется в этот слот (в запас) — отдаём после него
+        c->pending = (int8_t)c->cap_slot;
+    } else {
+        publish(c);
+    }
+    c->cap_slot = next;
+    if (c->asg_slot != next) {
+        c->asg_slot = next;
+        c->asg_pos = 0;
+    }
+}
+
+// Следующее срабатывание в блоке начиная с src[off] — по отсчётам канала
+// trig_ch, если каналов несколько. Индекс в блоке или -1.
+static int32_t scan(capture_t *c, const uint16_t *src, uint32_t off)
+{
+    if (c->nch == 1) {
+        int32_t hit = trigger_scan(&c->trig, src + off, B - off);
+        return hit < 0 ? -1 : (int32_t)off + hit;
+    }
+    uint32_t first = off + (c->trig_ch + 2 * c->nch - (c->phase + off) % c->nch) % c->nch;
+    if (first >= B) return -1;
+    int32_t k = trigger_scan_stride(&c->trig, src + first, B - first, c->nch);
+    return k < 0 ? -1 : (int32_t)(first + (uint32_t)k * c->nch);
+}
+
+// Обработка блока на месте: тот же алгоритм, что и при копировании —
+// без триггера кадр заполняется подряд, с триггером по кругу до
+// срабатывания с достаточной предысторией, затем N - pre отсчётов после
+static void process(capture_t *c, const uint16_t *src, uint32_t pos, int other)
+{
+    uint32_t end = (pos + B) % M;
+    uint32_t before = c->filled;
+    c->filled = before + B > N ? N : before + B;
+
+    if (c->trig.mode == TRIG_OFF) {
+        c->trig_pos = (end + M - N) % M;
+        c->post = (int32_t)(N - c->filled);
+        if (c->post == 0) complete(c, c->trig_pos, phase_at(c, pos, c->trig_pos), other);
+        return;
+    }
+
+    uint32_t pre = N * c->pre_pct / 100;
+    if (c->nch > 1) {
+        // pre ≡ trig_ch (mod nch): тогда кадр начинается с канала 0
+        pre = pre - pre % c->nch + c->trig_ch;
+        if (pre > N - 1) pre -= c->nch;
+    }
+    if (pre > N - 1) pre = N - 1;       // точка триггера — последний отсчёт кадра
+    if (c->post < 0) {
+        bool fired = false;
+        // Пропускаем срабатывания, до которых в слоте ещё нет pre отсчётов
+        uint32_t off = 0;
+        while (off < B) {
+            int32_t hit = scan(c, src, off);
+            if (hit < 0) break;
+            off = (uint32_t)hit;
+            if (before + off >= pre) {
+                c->trig_pos = pos + off;
+                c->post = (int32_t)(N - pre) - (int32_t)(B - off);
+                fired = true;
+                break;
+            }
+            off++;
+        }
+        c->wait += B;
+        if (c->post < 0 && c->trig.mode == TRIG_AUTO && c->wait >= TRIG_AUTO_TIMEOUT && c->filled >= pre) {
+            // auto: срабатывания нет — условная точка в конце блока
+            c->trig_pos = end;
+            c->post = (int32_t)(N - pre);
+            fired = true;
+        }
+        if (!fired) return;
+    } else {
+        c->post -= B;
+    }
+
+    // Конец кадра в этом блоке; остаток блока после него — в запасе
+    if (c->post <= 0) {
+        uint32_t start = (c->trig_pos + M - pre) % M;
+        complete(c, start, phase_at(c, pos, start), other);
+    }
+}
+
+uint16_t *capture_block(capture_t *c, int i)
+{
+    int other = i ^ 1;
+    uint8_t slot = c->tgt_slot[i];
+
+    if (slot == c->cap_slot) {
+        process(c, c->ring[slot].data + c->tgt_pos[i], c->tgt_pos[i], other);
+    } else if (slot == c->pending) {
+        // Блок в запас уже готового слота — теперь его можно отдавать
+        c->pending = -1;
+        publish(c);
+    }
+    // Иначе блок из слота до capture_flush — отбрасываем
+    c->phase = (uint8_t)((c->phase + B) % c->nch);
+
+    // Назначаем блок через один. Если кадр закончится на блоке, который
+    // пишется сейчас, следующий сразу направляем в новый слот
+    uint8_t next = (c->cap_slot + 1) % c->nslots;
+    if (c->tgt_slot[other] == c->cap_slot && c->asg_slot == c->cap_slot &&
+        c->post >= 0 && c->post <= (int32_t)B && next != c->rd) {
+        c->asg_slot = next;
+        c->asg_pos = 0;
+    }
+    c->tgt_slot[i] = c->asg_slot;
+    c->tgt_pos[i] = c->asg_pos;
+    c->asg_pos = (c->asg_pos + B) % M;
+    return capture_target(c, i);
+}
@@ -0,0 +1,82 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+// Сборка кадров прямо в слотах кольца. DMA АЦП пишет блоками по
+// OSC_DMA_POINTS в два адреса по очереди (двухбуферный режим DMA); в
+// прерывании по концу блока capture_block() обрабатывает блок на месте
+// (триггер, счёт отсчётов) и возвращает адрес, куда DMA писать блок через
+// один. Копирования нет — только учёт.
+//
+// Слот вмещает N + 2 блока и пишется по кругу. Кадр с триггером начинается
+// ровно за pre отсчётов до срабатывания и кончается посреди блока (хвост
+// блока — запас); адрес назначается на блок вперёд, и блок, уже идущий в
+// слот на момент готовности кадра, ложится во второй блок запаса. Не зависит от HAL —
+// собирается и на ПК (firmware/host/sim_capture).
+//
+// Несколько каналов: АЦП в режиме сканирования пишет в тот же поток
+// отсчёты nch каналов по очереди (a0 b0 c0 a1 b1 ...), кадр — те же N
+// отсчётов потока. Триггер смотрит только отсчёты канала trig_ch; кадр
+// с триггером начинается с канала 0, у остальных (без триггера, auto)
+// канал первого отсчёта — в osc_slot_t.phase.
+
+#include <stdint.h>
+
+#include "osc_frame.h"
+#include "trigger.h"
+
+typedef struct {
+    osc_slot_t *ring;
+    uint8_t nslots;
+    volatile uint8_t wr;        // слоты rd..wr-1 готовы к отправке
+    volatile uint8_t rd;        // освобождает передача (capture_release)
+    uint8_t cap_slot;           // слот, в котором собирается кадр
+    int8_t pending;             // готовый слот ждёт конца блока DMA в него; -1 нет
+
+    trigger_t trig;
+    uint8_t pre_pct;
+    uint32_t fs_hz;
+    uint8_t nch;                // каналов в потоке (1..OSC_MAX_CH)
+    uint8_t trig_ch;            // канал-источник триггера
+    uint8_t phase;              // канал первого отсчёта обрабатываемого блока
+    uint8_t bits;               // разрядность отсчётов (передискретизация — больше 12)
+
+    // Обработка текущего кадра
+    uint32_t filled;            // заполнено отсчётов (до N)
+    uint32_t wait;              // отсчётов с начала ожидания триггера (для auto)
+    int32_t post;               // сколько ещё собрать после триггера; -1 — ждём
+    uint32_t trig_pos;          // позиция срабатывания в слоте
+
+    // Куда пишет DMA: два адреса, по блоку на каждый
+    uint8_t tgt_slot[2];
+    uint32_t tgt_pos[2];
+    uint8_t asg_slot;           // следующий назначаемый блок
+    uint32_t asg_pos;
+
+    uint32_t dropped;           // кадров потеряно из-за полного кольца
+} capture_t;
+
+#define TRIG_AUTO_TIMEOUT (OSC_FRAME_POINTS * 2) // auto: без триггера дольше — кадр как есть
+
+// Сброс к началу потока: вызывать при остановленном DMA (и при смене nch)
+void capture_init(capture_t *c, osc_slot_t *ring, uint8_t nslots);
+// Кольцо пусто, кадр собирается заново (DMA может продолжать писать)
+void capture_flush(capture_t *c);
+// Кадр собирается заново в том же слоте (смена настроек триггера)
+void capture_restart(capture_t *c);
+
+// Адрес i-го буфера DMA (0/1) — для запуска DMA
+static inline uint16_t *capture_target(const capture_t *c, int i)
+{
+    return c->ring[c->tgt_slot[i]].data + c->tgt_pos[i];
+}
+
+// Прерывание: DMA заполнил буфер i. Возвращает новый адрес для буфера i.
+uint16_t *capture_block(capture_t *c, int i);
+
+// Передача слота rd закончена
+static inline void capture_release(capture_t *c)
+{
+    c->rd = (c->rd + 1) % c->nslots;
+}
+
+#endif
@@ -7,44 +7,135 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-// Настройки буферов
-#define OSC_DMA_POINTS    2048             // размер половины DMA буфера
-#define OSC_FRAME_POINTS  8192             // сколько точек отправляем в одном кадре
+#include "crc16.h"          // common/crc16.c
+#include "capture.h"
+#include "osc_codec.h"        // common/osc_codec.c
+#include "osc_frame.h"
+#include "oversample.h"
+#include "segment.h"
+#include "trigger.h"
+
+// Настройки буферов (OSC_FRAME_POINTS, OSC_DMA_POINTS — в osc_frame.h)
 #define OSC_RING_FRAMES   4                // количество кадров в кольце
 
+// 1 — DMA АЦП в двухбуферном режиме пишет прямо в слоты кольца (F2/F4/F7/H7).
+// 0 — для МК без двухбуферного DMA (F0/F1/G0/L4): кольцевой dma_buf и
+// копирование половины в слот в прерывании.
+#ifndef OSC_DMA_DIRECT
+#define OSC_DMA_DIRECT 1
+#endif
+
+// Передискретизация (set_oversample): 4^k преобразований на отсчёт, отсчёт
+// 12 + k бит. 1 — аппаратный блок АЦП (G4/L4/H7/U5: OVSR = 4^k, OVSS = k),
+// таймер на fs и DMA как без неё. 0 — программно (oversample.c): таймер на
+// fs · 4^k, DMA по кругу в dma_buf, половины сворачиваются в блоки кадра.
+#ifndef OSC_HW_OVERSAMPLE
+#define OSC_HW_OVERSAMPLE 0
+#endif
+#define OSC_ADC_MAX_HZ 2000000   // преобразований АЦП в секунду, все каналы (F4: 2,4 МГц при 12 битах)
+
 // Коды команд (см. docs/protocol.md)
 #define CMD_STREAM_ON 0x24
+#define CMD_SET_ENC   0x25
+#define CMD_SET_CH    0x26
 #define CMD_SET_FS    0x20
+#define CMD_SET_GAIN  0x21
 #define CMD_SET_TRIG  0x22
-#define CMD_OSC_DATA  0x40
-
-// Простая структура кадра для очереди
-typedef struct {
-    uint32_t fs_hz;
-    uint16_t nsamples;
-    uint16_t pretrig;
-    uint16_t data[OSC_FRAME_POINTS];
-} osc_frame_t;
-
-// Кольцевой буфер кадров
-static osc_frame_t ring[OSC_RING_FRAMES];
-static volatile uint8_t ring_wr = 0;
-static volatile uint8_t ring_rd = 0;
+#define CMD_CAPTURE_ONCE 0x23
+#define CMD_SEG_STATUS 0x27
+#define CMD_SEG_READ  0x28
+#define CMD_SEG_STOP  0x29
+#define CMD_SET_OVS   0x2A
+#define CMD_OSC_STATS 0x2E
+#define CMD_OSC_STATUS 0x2F
+#define CMD_RESP      0x80   // ответ: cmd | 0x80
+
+// Коды ошибок в первом байте ответа
+enum { ERR_OK = 0, ERR_PARAM = 1, ERR_UNKNOWN = 2 };
+
+// Кольцевой буфер кадров. Слоты cap.rd..cap.wr-1 готовы к отправке,
+// cap.rd может быть в передаче по DMA; захват — в capture.c.
+static osc_slot_t ring[OSC_RING_FRAMES];
+static capture_t cap;
 static volatile bool stream_on = false;
+static uint16_t osc_seq = 0;
+
+// Сегментный режим (capture_once): захват в память слотов 1.. кольца
+// (segment.c), поток кадров стоит. Слот 0 — под выгрузку сегментов.
+#define SEG_POOL_POINTS ((OSC_RING_FRAMES - 1) * sizeof(osc_slot_t) / sizeof(uint16_t))
+static seg_t seg;
+static volatile bool seg_mode = false;
+static volatile bool seg_pending = false;   // захват ждёт свободной линии (кадр из кольца)
+static volatile bool seg_leave = false;     // stream_on: обратно к потоку при свободной линии
+static int32_t seg_seq = -1;                // seq последнего capture_once (повтор не перезапускает)
+static uint16_t seg_rd, seg_rd_end;         // выгрузка сегментов seg_rd..seg_rd_end-1
+static int32_t seg_rd_seq = -1;             // seq последнего seg_read (повтор не выгружает заново)
+
+// Передача: одна DMA операция за раз — кадр из кольца или ответ на команду.
+// Ответы — очередь: ПК шлёт до 8 команд подряд, не дожидаясь ответов.
+enum { TX_IDLE, TX_FRAME, TX_REPLY, TX_SEG };
+static volatile uint8_t tx_state = TX_IDLE;
+#define REPLY_MAX_PAYLOAD 40
+#define REPLY_SLOTS       8
+static uint8_t reply_buf[REPLY_SLOTS][8 + REPLY_MAX_PAYLOAD + 2];
+static uint16_t reply_len[REPLY_SLOTS];
+static volatile uint8_t reply_rd = 0, reply_wr = 0;   // reply_rd двигает tx_done
 
-// DMA буфер (ping-pong)
+// Приём команд: кадры протокола с payload до CMD_MAX_PAYLOAD байт
+#define CMD_MAX_PAYLOAD 32
+static uint8_t cmd_buf[8 + CMD_MAX_PAYLOAD + 2];
+static uint16_t cmd_fill = 0;
+
+// Телеметрия (get_osc_stats). Такты — DWT->CYCCNT.
+static uint32_t frames_sent;
+static uint32_t rx_crc_errors;
+static uint32_t isr_cyc_max, isr_cyc_sum, isr_count;
+static uint32_t lat_cyc_max, lat_cyc_sum, lat_count;   // кадр готов -> передан
+static uint8_t backlog_max;
+static uint32_t ready_cyc[OSC_RING_FRAMES];              // когда слот отдан на передачу
+
+// Текущие настройки (отдаются в get_osc_status)
+static uint32_t fs_hz = 100000;
+static uint8_t gain_step = 0;                // индекс в gain_x
+static uint8_t trig_mode = TRIG_OFF;
+static int16_t trig_level_mV = 0;
+static uint8_t trig_edge = TRIG_RISING;
+static uint16_t trig_hyst_mV = 20;
+static uint8_t trig_pre_pct = 50;
+static uint8_t trig_src = 0;                // канал-источник триггера
+static uint8_t osc_enc = OSC_ENC_RAW16;   // кодирование кадров, OSC_ENC_*
+static uint8_t osc_nch = 1;               // каналов в режиме сканирования
+static uint8_t ovs_bits = 12;             // запрошенная разрядность (set_oversample)
+static uint8_t ovs_shift = 0;             // действующая: 12 + ovs_shift бит
+static volatile bool adc_pending = false; // смена nch или передискретизации ждёт свободной линии
+
+#if !OSC_DMA_DIRECT || !OSC_HW_OVERSAMPLE
+// DMA буфер (ping-pong): сырые отсчёты, в кадр — копией или суммами (ovs)
 static uint16_t dma_buf[OSC_DMA_POINTS * 2];
+static ovs_t ovs;
+static uint8_t raw_blk;                   // блок кадра, который заполняют половины dma_buf
+static uint32_t raw_fill;                 // отсчётов в нём
+#endif
 
 // Прототипы
 static void SystemClock_Config(void);
-static void MX_ADC_Init(void);
+static void MX_ADC_Init(uint8_t nch, uint8_t ovs_shift);
 static void MX_USB_UART_Init(void);
-static void MX_TIM_Sample_Init(uint32_t fs_hz);
+static void MX_TIM_Sample_Init(uint32_t trig_hz);
 static void start_adc_dma(void);
-static void handle_command(uint8_t *pkt, uint16_t len);
-static void push_block(uint16_t *src, uint16_t count);
-static void send_frame(osc_frame_t *f);
-static uint16_t crc16_ibm(const uint8_t *data, uint16_t len);
+static void stop_adc_dma(void);
+static void apply_adc(void);
+static void seg_arm(void);
+static void seg_exit(void);
+static void poll_commands(void);
+static void handle_command(uint16_t seq, uint8_t cmd, const uint8_t *p, uint16_t len);
+static void apply_trigger(void);
+static void tx_kick(void);
+static void tx_done(void);
+static void send_reply(uint16_t seq, uint8_t cmd, const uint8_t *payload, uint16_t len);
+static void reply_err(uint16_t seq, uint8_t cmd, uint8_t err);
+static void link_write_dma(const uint8_t *data, uint16_t len);
+static uint16_t link_read(uint8_t *data, uint16_t max);
 
 // Можно улучшить: вынести протокол в отдельный модуль и разделить обработку команд/потока.
 
@@ -52,19 +143,91 @@ int main(void)
 {
     HAL_Init();
     SystemClock_Config();
-    MX_ADC_Init();
+    // Счётчик тактов для телеметрии (Cortex-M3 и старше)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    crc16_init();
+    capture_init(&cap, ring, OSC_RING_FRAMES);
+#if !OSC_DMA_DIRECT || !OSC_HW_OVERSAMPLE
+    ovs_config(&ovs, 0, osc_nch);
+#endif
+    MX_ADC_Init(osc_nch, 0);
     MX_USB_UART_Init();
-    MX_TIM_Sample_Init(100000); // 100 кГц по умолчанию
+    MX_TIM_Sample_Init(fs_hz); // 100 кГц по умолчанию
+    apply_trigger();
     start_adc_dma();
 
     // Главный цикл: принимаем команды, отправляем готовые кадры
     while (1) {
-        // TODO: читать из USB CDC/UART входящие кадры и вызывать handle_command()
-        // Здесь можно вставить неблокирующий опрос очереди USB CDC.
+        poll_commands();
+        if (seg_leave && tx_state == TX_IDLE) seg_exit();
+        if (adc_pending && tx_state == TX_IDLE) apply_adc();
+        if (seg_pending && tx_state == TX_IDLE) seg_arm();
+        tx_kick();
+    }
+}
+
+// Учёт времени прерывания и момента готовности кадра
+static void isr_account(uint32_t t0, uint8_t wr)
+{
+    uint32_t t1 = DWT->CYCCNT;
+    if (cap.wr != wr) ready_cyc[wr] = t1;
+    uint32_t d = t1 - t0;
+    if (d > isr_cyc_max) isr_cyc_max = d;
+    isr_cyc_sum += d;
+    isr_count++;
+    uint8_t backlog = (cap.wr + OSC_RING_FRAMES - cap.rd) % OSC_RING_FRAMES;
+    if (backlog > backlog_max) backlog_max = backlog;
+}
+
+// Адреса DMA АЦП: слоты кольца или история сегментного режима
+static inline uint16_t *dma_target(int i)
+{
+    return seg_mode ? seg_target(&seg, i) : capture_target(&cap, i);
+}
+
+static inline uint16_t *dma_block(int i)
+{
+    return seg_mode ? seg_block(&seg, i) : capture_block(&cap, i);
+}
 
-        if (stream_on && ring_rd != ring_wr) {
-            send_frame(&ring[ring_rd]);
-            ring_rd = (ring_rd + 1) % OSC_RING_FRAMES;
+#if OSC_DMA_DIRECT
+// Колбэки двухбуферного DMA: буфер 0/1 заполнен, DMA уже пишет в другой.
+// Обработка на месте, затем адрес блока через один.
+void dma_m0_done(DMA_HandleTypeDef *hdma)
+{
+    uint32_t t0 = DWT->CYCCNT;
+    uint8_t wr = cap.wr;
+    HAL_DMAEx_ChangeMemory(hdma, (uint32_t)dma_block(0), MEMORY0);
+    isr_account(t0, wr);
+}
+
+void dma_m1_done(DMA_HandleTypeDef *hdma)
+{
+    uint32_t t0 = DWT->CYCCNT;
+    uint8_t wr = cap.wr;
+    HAL_DMAEx_ChangeMemory(hdma, (uint32_t)dma_block(1), MEMORY1);
+    isr_account(t0, wr);
+}
+#endif
+
+#if !OSC_DMA_DIRECT || !OSC_HW_OVERSAMPLE
+// Половина dma_buf готова: отсчёты (с передискретизацией — суммы, 4^k
+// половин на блок) — в блок кадра; блок заполнен — как конец блока у
+// двухбуферного DMA
+static void raw_done(const uint16_t *src)
+{
+    uint32_t left = OSC_DMA_POINTS;
+    while (left) {
+        uint32_t n = left;
+        raw_fill += ovs_run(&ovs, src, &n, dma_target(raw_blk) + raw_fill, OSC_DMA_POINTS - raw_fill);
+        src += n;
+        left -= n;
+        if (raw_fill == OSC_DMA_POINTS) {
+            dma_block(raw_blk);
+            raw_blk ^= 1;
+            raw_fill = 0;
         }
     }
 }
@@ -72,103 +235,512 @@ int main(void)
 // Колбэк DMA: половина буфера
 void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
 {
-    push_block(&dma_buf[0], OSC_DMA_POINTS);
+    uint32_t t0 = DWT->CYCCNT;
+    uint8_t wr = cap.wr;
+    raw_done(&dma_buf[0]);
+    isr_account(t0, wr);
 }
 
 // Колбэк DMA: весь буфер
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
 {
-    push_block(&dma_buf[OSC_DMA_POINTS], OSC_DMA_POINTS);
+    uint32_t t0 = DWT->CYCCNT;
+    uint8_t wr = cap.wr;
+    raw_done(&dma_buf[OSC_DMA_POINTS]);
+    isr_account(t0, wr);
 }
+#endif
 
-// Складываем блок выборок в кольцо кадров
-static void push_block(uint16_t *src, uint16_t count)
+// Колбэк конца передачи DMA (для USB CDC — из CDC_TransmitCplt_FS)
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 {
-    static uint16_t collected = 0;
-    osc_frame_t *f = &ring[ring_wr];
+    tx_done();
+}
+
+// Коэффициент входного каскада по шагу set_gain; ПК по тому же шагу
+// переводит коды в мВ (pc-app/measure.c)
+static const uint8_t gain_x[] = {1, 2, 5, 10};
+
+// Пересчёт настроек триггера в отсчёты АЦП (шкала 0..3300 мВ на входе АЦП,
+// на входе платы — в gain_x раз меньше)
+static uint16_t mv_to_counts(int32_t mv)
+{
+    int32_t c = mv * gain_x[gain_step] * 4095 / 3300;
+    if (c < 0) c = 0;
+    if (c > 4095) c = 4095;
+    return (uint16_t)c;
+}
+
+// С передискретизацией отсчёт — 12 + k бит, пороги в тех же единицах
+static void apply_trigger(void)
+{
+    __disable_irq();
+    trigger_config(&cap.trig, trig_mode, trig_edge, (uint16_t)(mv_to_counts(trig_level_mV) << ovs_shift),
+                   (uint16_t)(mv_to_counts(trig_hyst_mV) << ovs_shift));
+    cap.pre_pct = trig_pre_pct;
+    cap.fs_hz = fs_hz;
+    cap.trig_ch = trig_src < cap.nch ? trig_src : 0;
+    capture_restart(&cap);
+    __enable_irq();
+}
 
-    if (!stream_on) return;
+// Сдвиг передискретизации при частоте fs: запрошенный, если АЦП успевает
+// fs · nch · 4^k преобразований в секунду, иначе наибольший, что успевает
+static uint8_t ovs_fit(uint32_t fs)
+{
+    uint8_t k = ovs_bits - 12;
+    while (k && ((uint64_t)fs * osc_nch << 2 * k) > OSC_ADC_MAX_HZ) k--;
+    return k;
+}
 
-    uint16_t to_copy = (collected + count > OSC_FRAME_POINTS) ? (OSC_FRAME_POINTS - collected) : count;
-    memcpy(&f->data[collected], src, to_copy * sizeof(uint16_t));
-    collected += to_copy;
+// Частота запусков АЦП таймером: программно — скан на каждое слагаемое,
+// аппаратный блок сам делает 4^k преобразований на запуск
+static uint32_t adc_trig_hz(void)
+{
+    return OSC_HW_OVERSAMPLE ? fs_hz : fs_hz << 2 * ovs_shift;
+}
+
+// Смена числа каналов или передискретизации: АЦП перенастраивается, поток
+// начинается заново с канала 0. Только при свободной линии — capture_init
+// сбрасывает кольцо, а из слота rd могла идти передача.
+static void apply_adc(void)
+{
+    adc_pending = false;
+    stop_adc_dma();
+    capture_init(&cap, ring, OSC_RING_FRAMES);
+    cap.nch = osc_nch;
+    ovs_shift = ovs_fit(fs_hz);
+    cap.bits = 12 + ovs_shift;
+#if !OSC_DMA_DIRECT || !OSC_HW_OVERSAMPLE
+    ovs_config(&ovs, OSC_HW_OVERSAMPLE ? 0 : ovs_shift, osc_nch);
+#endif
+    MX_ADC_Init(osc_nch, ovs_shift);
+    MX_TIM_Sample_Init(adc_trig_hz());
+    apply_trigger();
+    start_adc_dma();
+}
+
+// Старт сегментного захвата по разметке из capture_once. Только при
+// свободной линии: история и сегменты затирают слоты кольца, а из слота
+// могла идти передача кадра.
+static void seg_arm(void)
+{
+    seg_pending = false;
+    stop_adc_dma();
+    seg_mode = true;
+    seg_rd = seg_rd_end = 0;
+    seg_rd_seq = -1;
+    seg_start(&seg);
+    start_adc_dma();
+}
+
+// Обратно к потоку кадров: сегменты теряются, кольцо — с начала
+static void seg_exit(void)
+{
+    seg_leave = false;
+    stop_adc_dma();
+    seg_mode = false;
+    seg_seq = -1;
+    seg_rd = seg_rd_end = 0;
+    seg_rd_seq = -1;
+    capture_init(&cap, ring, OSC_RING_FRAMES);
+    cap.nch = osc_nch;
+    cap.bits = 12 + ovs_shift;
+    apply_trigger();
+    start_adc_dma();
+}
+
+// Сегмент k — в слот 0 кадром OSC_DATA_EXT (seg, nseg, t в расширении)
+static osc_slot_t *seg_load(uint16_t k)
+{
+    osc_slot_t *s = &ring[0];
+    memcpy(s->data, seg_data(&seg, k), seg.len * sizeof(uint16_t));
+    s->fs_hz = seg.fs_hz;
+    s->nsamples = (uint16_t)seg.len;
+    s->pretrig = seg.info[k].pretrig;
+    s->start = 0;
+    s->nch = seg.nch;
+    s->phase = seg.info[k].phase;
+    s->seg = k;
+    s->nseg = (uint16_t)seg.nseg;
+    s->t = seg.info[k].t;
+    s->bits = cap.bits;                 // в сегментном режиме не меняется
+    return s;
+}
 
-    if (collected >= OSC_FRAME_POINTS) {
-        f->fs_hz = 100000; // TODO: хранить текущую частоту дискретизации
-        f->nsamples = OSC_FRAME_POINTS;
-        f->pretrig = 0;    // TODO: считать долю предтриггера
-        ring_wr = (ring_wr + 1) % OSC_RING_FRAMES;
-        if (ring_wr == ring_rd) {
-            // Можно улучшить: счётчик пропусков кадров, если очередь переполнена
-            ring_rd = (ring_rd + 1) % OSC_RING_FRAMES;
+// Приём команд: копим байты линии, ищем sync, проверяем длину и CRC.
+// Битый кадр сдвигает поиск на байт (как приёмник ПК, pc-app/proto.c).
+static void poll_commands(void)
+{
+    cmd_fill += link_read(cmd_buf + cmd_fill, sizeof(cmd_buf) - cmd_fill);
+    while (cmd_fill >= 8) {
+        uint16_t skip = 1;
+        if (cmd_buf[0] == 0x55 && cmd_buf[1] == 0xAA) {
+            uint16_t len = cmd_buf[6] | (cmd_buf[7] << 8);
+            if (cmd_buf[2] == 0x01 && len <= CMD_MAX_PAYLOAD) {
+                uint16_t total = 8 + len + 2;
+                if (cmd_fill < total) return;   // ждём остаток кадра
+                // Очередь ответов полна — команда ждёт в cmd_buf, остальные
+                // в буфере линии
+                if ((uint8_t)(reply_wr - reply_rd) == REPLY_SLOTS) return;
+                uint16_t crc = cmd_buf[8 + len] | (cmd_buf[9 + len] << 8);
+                if (crc16_ibm(&cmd_buf[2], 6 + len) == crc) {
+                    handle_command(cmd_buf[3] | (cmd_buf[4] << 8), cmd_buf[5], &cmd_buf[8], len);
+                    skip = total;
+                } else {
+                    rx_crc_errors++;
+                }
+            }
         }
-        collected = 0;
+        cmd_fill -= skip;
+        memmove(cmd_buf, cmd_buf + skip, cmd_fill);
     }
 }
 
-// Простая обработка команд (упрощена)
-static void handle_command(uint8_t *pkt, uint16_t len)
+static void put32(uint8_t *p, uint32_t v)
 {
-    if (len < 6) return; // минимальный размер без CRC
-    uint8_t cmd = pkt[5]; // sync(2)+ver(1)+seq(2)+cmd(1)
+    memcpy(p, &v, 4);
+}
 
+// Обработка команды; p — payload длиной len
+static void handle_command(uint16_t seq, uint8_t cmd, const uint8_t *p, uint16_t len)
+{
     switch (cmd) {
     case CMD_STREAM_ON:
-        if (len >= 7) {
-            stream_on = pkt[6];
-            if (stream_on) {
-                ring_rd = ring_wr = 0;
+        if (len >= 1) {
+            stream_on = p[0];
+            // Из сегментного режима — обратно к потоку (сегменты теряются)
+            if (stream_on && (seg_mode || seg_pending)) {
+                seg_pending = false;
+                seg_leave = seg_mode;
+            }
+            if (stream_on && tx_state != TX_FRAME) {
+                __disable_irq();
+                capture_flush(&cap);
+                __enable_irq();
+            }
+            apply_trigger();
+        }
+        reply_err(seq, cmd, len >= 1 ? ERR_OK : ERR_PARAM);
+        break;
+    case CMD_SET_ENC: {
+        // {u8 enc} -> {u8 err}; действует с ближайшего кадра
+        uint8_t err = len >= 1 && p[0] < OSC_ENC_COUNT ? 0 : 1;
+        if (!err) osc_enc = p[0];
+        send_reply(seq, cmd, &err, 1);
+        break;
+    }
+    case CMD_SET_CH: {
+        // {u8 nch} -> {u8 err}; таймер задаёт частоту сканов, у каждого
+        // канала — fs, поток по линии — fs * nch отсчётов в секунду
+        // В сегментном режиме нельзя: АЦП перезапустился бы в кольцо
+        uint8_t err = len >= 1 && p[0] >= 1 && p[0] <= OSC_MAX_CH && !seg_mode && !seg_pending ? 0 : 1;
+        if (!err && p[0] != osc_nch) {
+            osc_nch = p[0];
+            adc_pending = true;
+        }
+        send_reply(seq, cmd, &err, 1);
+        break;
+    }
+    case CMD_SET_FS: {
+        // С передискретизацией на новой fs АЦП может не успевать 4^k
+        // преобразований — тогда разрядность меньше, через apply_adc (в
+        // сегментном режиме так нельзя — ошибка)
+        uint32_t fs = 0;
+        if (len >= 4) memcpy(&fs, &p[0], 4);
+        bool refit = fs && ovs_fit(fs) != ovs_shift;
+        if (refit && (seg_mode || seg_pending)) fs = 0;
+        if (fs) {
+            fs_hz = fs;
+            if (refit) {
+                adc_pending = true;
+            } else {
+                MX_TIM_Sample_Init(adc_trig_hz());
+                apply_trigger();
             }
         }
+        reply_err(seq, cmd, fs ? ERR_OK : ERR_PARAM);
+        break;
+    }
+    case CMD_SET_OVS: {
+        // {u8 bits} -> {u8 err; u8 bits}: 12 — без передискретизации, до 16;
+        // в ответе — сколько выйдет при текущих fs и nch
+        uint8_t r[2] = {ERR_PARAM, 12 + ovs_shift};
+        if (len >= 1 && p[0] >= 12 && p[0] <= 12 + OVS_MAX_SHIFT && !seg_mode && !seg_pending) {
+            ovs_bits = p[0];
+            r[0] = ERR_OK;
+            r[1] = 12 + ovs_fit(fs_hz);
+            if (r[1] != 12 + ovs_shift) adc_pending = true;
+        }
+        send_reply(seq, cmd, r, sizeof(r));
         break;
-    case CMD_SET_FS:
-        // TODO: распарсить частоту и перенастроить таймер
+    }
+    case CMD_SET_GAIN:
+        // {u8 step}: уровень триггера в мВ — на входе, пересчитываем
+        if (len >= 1 && p[0] < sizeof(gain_x)) {
+            gain_step = p[0];
+            apply_trigger();
+        }
+        reply_err(seq, cmd, len >= 1 && p[0] < sizeof(gain_x) ? ERR_OK : ERR_PARAM);
         break;
     case CMD_SET_TRIG:
-        // TODO: настроить триггер (пока триггер выключен)
+        // {u8 mode; i16 level_mV; u8 edge} [+ u16 hyst_mV; u8 pre_pct] [+ u8 src]
+        if (len >= 4) {
+            trig_mode = p[0] <= TRIG_AUTO ? p[0] : TRIG_OFF;
+            memcpy(&trig_level_mV, &p[1], 2);
+            trig_edge = p[3] ? TRIG_FALLING : TRIG_RISING;
+            if (len >= 7) {
+                memcpy(&trig_hyst_mV, &p[4], 2);
+                trig_pre_pct = p[6] <= 100 ? p[6] : 100;
+            }
+            if (len >= 8) trig_src = p[7] < OSC_MAX_CH ? p[7] : 0;
+            apply_trigger();
+        }
+        reply_err(seq, cmd, len >= 4 ? ERR_OK : ERR_PARAM);
+        break;
+    case CMD_CAPTURE_ONCE: {
+        // {u16 pre_pct; u16 samples} [+ {u16 segments}] -> {u8 err; u16 nseg}.
+        // Разметка сразу, захват — когда линия свободна (seg_arm). Триггер,
+        // fs и каналы — текущие; их смена на идущий захват не влияет.
+        uint8_t r[3] = {ERR_PARAM, 0, 0};
+        uint16_t pct = 0, n = 0, want = 1;
+        if (len >= 4) {
+            memcpy(&pct, &p[0], 2);
+            memcpy(&n, &p[2], 2);
+        }
+        if (len >= 6) memcpy(&want, &p[4], 2);
+        if (len >= 4 && (seg_mode || seg_pending) && seq == seg_seq) {
+            // Повтор той же команды: захват уже идёт
+            uint16_t nseg = (uint16_t)seg.nseg;
+            r[0] = ERR_OK;
+            memcpy(&r[1], &nseg, 2);
+        } else if (len >= 4 && !adc_pending) {
+            if (seg_mode) {
+                stop_adc_dma();             // прошлый захват прерываем
+                seg_mode = false;
+                seg_leave = true;           // если разметка не выйдет — к потоку
+            }
+            seg.trig = cap.trig;
+            seg.nch = cap.nch;
+            seg.trig_ch = cap.trig_ch;
+            seg.fs_hz = fs_hz;
+            uint16_t nseg = (uint16_t)seg_plan(&seg, (uint16_t *)&ring[1], SEG_POOL_POINTS, n, want,
+                                               pct > 100 ? 100 : (uint8_t)pct);
+            if (nseg) {
+                r[0] = ERR_OK;
+                seg_pending = true;
+                seg_leave = false;
+                seg_seq = seq;
+            }
+            memcpy(&r[1], &nseg, 2);
+        }
+        send_reply(seq, cmd, r, sizeof(r));
         break;
+    }
+    case CMD_SEG_STATUS: {
+        // {u8 err; u8 state; u16 filled; u16 nseg; u16 samples; u16 pretrig; u32 pool_points}
+        uint8_t st[14];
+        uint16_t filled = seg_mode ? (uint16_t)seg.filled : 0;
+        uint16_t nseg = seg_mode || seg_pending ? (uint16_t)seg.nseg : 0;
+        uint16_t samples = (uint16_t)seg.len, pretrig = (uint16_t)seg.pre;
+        st[0] = 0;
+        st[1] = seg_pending ? SEG_ARMED : seg_mode ? seg.state : SEG_IDLE;
+        memcpy(&st[2], &filled, 2);
+        memcpy(&st[4], &nseg, 2);
+        memcpy(&st[6], &samples, 2);
+        memcpy(&st[8], &pretrig, 2);
+        put32(&st[10], SEG_POOL_POINTS);
+        send_reply(seq, cmd, st, sizeof(st));
+        break;
+    }
+    case CMD_SEG_READ: {
+        // {u16 first; u16 count} -> {u8 err}, затем count кадров сегментов.
+        // Готовые сегменты можно читать и во время захвата.
+        uint16_t first = 0, count = 0;
+        if (len >= 4) {
+            memcpy(&first, &p[0], 2);
+            memcpy(&count, &p[2], 2);
+        }
+        // Повтор той же команды (ответ потерян): пачка уже идёт или ушла
+        if (len >= 4 && seg_mode && seq == seg_rd_seq) {
+            reply_err(seq, cmd, ERR_OK);
+            break;
+        }
+        bool ok = len >= 4 && seg_mode && count && (uint32_t)first + count <= seg.filled;
+        if (ok) {
+            seg_rd = first;
+            seg_rd_end = first + count;
+            seg_rd_seq = seq;
+        }
+        reply_err(seq, cmd, ok ? ERR_OK : ERR_PARAM);
+        break;
+    }
+    case CMD_SEG_STOP: {
+        // -> {u8 err; u16 filled}: захват кончается, готовые сегменты остаются
+        uint8_t r[3] = {ERR_PARAM, 0, 0};
+        if (seg_mode) {
+            __disable_irq();
+            if (seg.state == SEG_ARMED) seg.state = SEG_DONE;
+            __enable_irq();
+            stop_adc_dma();
+            uint16_t filled = (uint16_t)seg.filled;
+            r[0] = ERR_OK;
+            memcpy(&r[1], &filled, 2);
+        } else if (seg_pending) {
+            seg_pending = false;            // захват ещё не начался — поток идёт дальше
+            r[0] = ERR_OK;
+        }
+        send_reply(seq, cmd, r, sizeof(r));
+        break;
+    }
+    case CMD_OSC_STATS: {
+        // {u8 err; u32 frames_sent; u32 overruns; u32 rx_crc_errors; u32 core_hz;
+        //  u32 isr_max_cyc; u32 isr_avg_cyc; u32 lat_max_cyc; u32 lat_avg_cyc;
+        //  u8 backlog; u8 backlog_max; u8 ring_frames}
+        uint8_t st[36];
+        st[0] = 0;
+        __disable_irq();
+        put32(&st[1], frames_sent);
+        put32(&st[5], cap.dropped);
+        put32(&st[9], rx_crc_errors);
+        put32(&st[13], SystemCoreClock);
+        put32(&st[17], isr_cyc_max);
+        put32(&st[21], isr_count ? isr_cyc_sum / isr_count : 0);
+        put32(&st[25], lat_cyc_max);
+        put32(&st[29], lat_count ? lat_cyc_sum / lat_count : 0);
+        st[33] = (cap.wr + OSC_RING_FRAMES - cap.rd) % OSC_RING_FRAMES;
+        st[34] = backlog_max;
+        st[35] = OSC_RING_FRAMES;
+        // Максимумы и средние — за интервал между запросами
+        isr_cyc_max = isr_cyc_sum = isr_count = 0;
+        lat_cyc_max = lat_cyc_sum = lat_count = 0;
+        backlog_max = 0;
+        __enable_irq();
+        send_reply(seq, cmd, st, sizeof(st));
+        break;
+    }
+    case CMD_OSC_STATUS: {
+        // {u8 err; u32 fs; u8 gain; u8 mode; i16 level_mV; u8 edge; u16 frame_points;
+        //  u8 enc_mask; u8 nch; u8 max_ch; u8 bits; u8 max_bits}
+        uint8_t st[17];
+        uint16_t points = OSC_FRAME_POINTS;
+        st[0] = 0;
+        memcpy(&st[1], &fs_hz, 4);
+        st[5] = gain_step;
+        st[6] = trig_mode;
+        memcpy(&st[7], &trig_level_mV, 2);
+        st[9] = trig_edge;
+        memcpy(&st[10], &points, 2);
+        st[12] = OSC_ENC_BIT(OSC_ENC_RAW16) | OSC_ENC_BIT(OSC_ENC_PACK12) | OSC_ENC_BIT(OSC_ENC_DELTA);
+        st[13] = osc_nch;
+        st[14] = OSC_MAX_CH;
+        st[15] = 12 + ovs_shift;
+        st[16] = 12 + OVS_MAX_SHIFT;
+        send_reply(seq, cmd, st, sizeof(st));
+        break;
+    }
     default:
-        // Можно улучшить: отправлять ошибку "неизвестная команда"
+        reply_err(seq, cmd, ERR_UNKNOWN);
         break;
     }
 }
 
-// Отправка кадра данных (голый пример, без очереди USB)
-static void send_frame(osc_frame_t *f)
+// Ответ на команду: тот же seq, cmd | 0x80. Уходит следующей передачей,
+// раньше очередного кадра; место в очереди проверил poll_commands.
+static void send_reply(uint16_t seq, uint8_t cmd, const uint8_t *payload, uint16_t len)
 {
-    uint8_t hdr[9];
-    uint16_t payload_len = sizeof(uint32_t) + 1 + 2 + 2 + f->nsamples * 2;
+    if (len > REPLY_MAX_PAYLOAD || (uint8_t)(reply_wr - reply_rd) == REPLY_SLOTS) return;
+    uint8_t *buf = reply_buf[reply_wr % REPLY_SLOTS];
     uint16_t idx = 0;
-    hdr[idx++] = 0x55; // sync low
-    hdr[idx++] = 0xAA; // sync high
-    hdr[idx++] = 0x01; // ver
-    hdr[idx++] = 0x00; // seq low (пока 0)
-    hdr[idx++] = 0x00; // seq high
-    hdr[idx++] = CMD_OSC_DATA;
-    hdr[idx++] = payload_len & 0xFF;
-    hdr[idx++] = payload_len >> 8;
+    buf[idx++] = 0x55;
+    buf[idx++] = 0xAA;
+    buf[idx++] = 0x01;
+    buf[idx++] = seq & 0xFF;
+    buf[idx++] = seq >> 8;
+    buf[idx++] = cmd | CMD_RESP;
+    buf[idx++] = len & 0xFF;
+    buf[idx++] = len >> 8;
+    memcpy(&buf[idx], payload, len);
+    idx += len;
+    uint16_t crc = crc16_ibm(&buf[2], idx - 2);
+    buf[idx++] = crc & 0xFF;
+    buf[idx++] = crc >> 8;
+    reply_len[reply_wr % REPLY_SLOTS] = idx;
+    reply_wr++;
+}
 
-    // Можно улучшить: использовать DMA для передачи
-    // TODO: собрать буфер: hdr + meta + данные + crc и отправить по USB CDC/UART
+static void reply_err(uint16_t seq, uint8_t cmd, uint8_t err)
+{
+    send_reply(seq, cmd, &err, 1);
+}
+
+// Запуск следующей передачи, если линия свободна. Кадр уходит по DMA прямо
+// из слота кольца, без копии; слот освобождается в tx_done().
+static void tx_kick(void)
+{
+    if (tx_state != TX_IDLE) return;
+    if (reply_rd != reply_wr) {
+        tx_state = TX_REPLY;
+        link_write_dma(reply_buf[reply_rd % REPLY_SLOTS], reply_len[reply_rd % REPLY_SLOTS]);
+        return;
+    }
+    if (seg_mode && seg_rd != seg_rd_end) {
+        osc_slot_t *s = seg_load(seg_rd);
+        uint16_t n = osc_slot_finalize(s, osc_seq++, 0, osc_enc);
+        tx_state = TX_SEG;
+        link_write_dma(osc_slot_wire(s), n);
+        return;
+    }
+    if (stream_on && !seg_mode && cap.rd != cap.wr) {
+        osc_slot_t *s = &ring[cap.rd];
+        uint16_t n = osc_slot_finalize(s, osc_seq++, 0, osc_enc);
+        // На МК с D-кэшем (F7/H7): SCB_CleanDCache_by_Addr по кадру перед DMA
+        tx_state = TX_FRAME;
+        link_write_dma(osc_slot_wire(s), n);
+    }
+}
+
+static void tx_done(void)
+{
+    if (tx_state == TX_FRAME) {
+        uint32_t d = DWT->CYCCNT - ready_cyc[cap.rd];
+        if (d > lat_cyc_max) lat_cyc_max = d;
+        lat_cyc_sum += d;
+        lat_count++;
+        frames_sent++;
+        capture_release(&cap);
+    } else if (tx_state == TX_REPLY) {
+        reply_rd++;
+    } else if (tx_state == TX_SEG) {
+        seg_rd++;
+    }
+    tx_state = TX_IDLE;
 }
 
 // Заглушки инициализаций — заполните под конкретную плату
 static void SystemClock_Config(void) { /* TODO */ }
-static void MX_ADC_Init(void) { /* TODO */ }
+// nch > 1: ScanConvMode = ENABLE, NbrOfConversion = nch (ранги 1..nch —
+// каналы 0..nch-1), один запуск таймером на скан; DMA пишет отсчёты подряд
+// ovs_shift > 0 с OSC_HW_OVERSAMPLE: OversamplingMode = ENABLE, Ratio = 4^k,
+// RightBitShift = k, TriggeredMode — все 4^k преобразований на один запуск
+static void MX_ADC_Init(uint8_t nch, uint8_t ovs_shift) { /* TODO */ }
 static void MX_USB_UART_Init(void) { /* TODO */ }
-static void MX_TIM_Sample_Init(uint32_t fs_hz) { /* TODO */ }
-static void start_adc_dma(void) { /* TODO */ }
-
-// Простой CRC16/IBM
-static uint16_t crc16_ibm(const uint8_t *data, uint16_t len)
-{
-    uint16_t crc = 0xFFFF;
-    for (uint16_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (uint8_t b = 0; b < 8; b++) {
-            if (crc & 1) crc = (crc >> 1) ^ 0xA001;
-            else crc >>= 1;
-        }
-    }
-    return crc;
+static void MX_TIM_Sample_Init(uint32_t trig_hz) { /* TODO */ }
+// OSC_DMA_DIRECT: hdma_adc.XferCpltCallback = dma_m0_done, XferM1CpltCallback =
+// dma_m1_done; HAL_DMAEx_MultiBufferStart_IT(&hdma_adc, (uint32_t)&ADCx->DR,
+// dma_target(0), dma_target(1), OSC_DMA_POINTS), затем
+// ADC_CR2_DMA | ADC_CR2_DDS и HAL_ADC_Start. Иначе (и при программной
+// передискретизации, ovs.shift > 0) HAL_ADC_Start_DMA(dma_buf, 2 * OSC_DMA_POINTS).
+static void start_adc_dma(void)
+{
+#if !OSC_DMA_DIRECT || !OSC_HW_OVERSAMPLE
+    raw_blk = 0;
+    raw_fill = 0;
+    ovs_config(&ovs, ovs.shift, ovs.nch);   // суммы — с начала
+#endif
+    /* TODO */
 }
+// HAL_ADC_Stop и HAL_DMA_Abort; следующий start_adc_dma снова с dma_target(0)
+static void stop_adc_dma(void) { /* TODO */ }
+static void link_write_dma(const uint8_t *data, uint16_t len) { /* TODO: CDC_Transmit_FS / HAL_UART_Transmit_DMA */ }
+static uint16_t link_read(uint8_t *data, uint16_t max) { /* TODO: из кольца CDC_Receive_FS / UART RX DMA */ return 0; }
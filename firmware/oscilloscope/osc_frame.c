@@ -0,0 +1,95 @@
+#include "osc_frame.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "crc16.h"          // common/crc16.c
+
+// Разворачиваем кольцевую запись кадра в линейную (три разворота, на месте)
+static void reverse16(uint16_t *a, uint32_t n)
+{
+    for (uint32_t i = 0, j = n - 1; i < j; i++, j--) {
+        uint16_t t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+    }
+}
+
+static void rotate_slot(osc_slot_t *s)
+{
+    if (s->start == 0) return;
+    reverse16(s->data, s->start);
+    reverse16(s->data + s->start, OSC_SLOT_POINTS - s->start);
+    reverse16(s->data, OSC_SLOT_POINTS);
+    s->start = 0;
+}
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+// Кодировка кадра: DELTA на месте возможна только без 3-байтовых токенов
+// (см. osc_codec.h) и нужна, только если короче PACK12. Подсчёт — лишний
+// проход по кадру, но он дешевле передачи сэкономленных байт.
+static uint8_t pick_enc(const osc_slot_t *s, uint8_t enc)
+{
+    if (enc != OSC_ENC_DELTA) return enc;
+    size_t wide;
+    size_t bytes = osc_delta_size(s->data, s->nsamples, &wide);
+    return wide == 0 && bytes < OSC_PACK12_BYTES(s->nsamples) ? OSC_ENC_DELTA : OSC_ENC_PACK12;
+}
+
+uint16_t osc_slot_finalize(osc_slot_t *s, uint16_t seq, uint8_t ch, uint8_t enc)
+{
+    rotate_slot(s);
+
+    uint8_t *d = (uint8_t *)s->data;
+    uint16_t data_len;
+    bool wide = s->bits > 12;           // PACK12 и DELTA — только 12 бит
+    enc = wide ? OSC_ENC_RAW16 : pick_enc(s, enc);
+    if (enc == OSC_ENC_PACK12) data_len = (uint16_t)osc_pack12_encode(s->data, s->nsamples, d);
+    else if (enc == OSC_ENC_DELTA) data_len = (uint16_t)osc_delta_encode(s->data, s->nsamples, d);
+    else data_len = s->nsamples * 2;
+
+    // Поля расширения идут по порядку: для bits нужны и поля сегмента
+    // (у кадра потока — нули)
+    bool ext = enc != OSC_ENC_RAW16 || s->nch > 1 || s->nseg || wide;
+    uint8_t ext_len = ext ? OSC_EXT_LEN : 0;
+    if (s->nseg || wide) ext_len += OSC_SEG_EXT_LEN;
+    if (wide) ext_len += OSC_BITS_EXT_LEN;
+    uint16_t payload_len = OSC_META_LEN + ext_len + data_len;
+    s->wire_pad = OSC_SLOT_PAD - ext_len;
+    uint8_t *h = s->head + s->wire_pad;
+    h[0] = 0x55; // sync low
+    h[1] = 0xAA; // sync high
+    h[2] = 0x01; // ver
+    put16(&h[3], seq);
+    h[5] = ext ? CMD_OSC_DATA_EXT : CMD_OSC_DATA;
+    put16(&h[6], payload_len);
+
+    uint8_t *m = h + OSC_HDR_LEN;
+    memcpy(&m[0], &s->fs_hz, 4);
+    m[4] = ch;
+    put16(&m[5], s->nsamples);
+    put16(&m[7], s->pretrig);
+    if (ext) {
+        m[9] = ext_len - 1;
+        m[10] = enc;
+        m[11] = s->nch > 1 ? s->nch : 1;
+        m[12] = s->phase;
+    }
+    if (s->nseg || wide) {
+        uint64_t t = s->nseg ? s->t : 0;
+        put16(&m[13], s->nseg ? s->seg : 0);
+        put16(&m[15], s->nseg);
+        memcpy(&m[17], &t, 8);
+    }
+    if (wide) m[25] = s->bits;
+
+    // CRC от ver до конца отсчётов (с CRC16_USE_STM32_HW — аппаратный блок)
+    uint16_t crc = crc16_ibm(&h[2], OSC_HDR_LEN - 2 + payload_len);
+    put16(d + data_len, crc);
+    return OSC_HDR_LEN + payload_len + OSC_CRC_LEN;
+}
@@ -0,0 +1,89 @@
+#ifndef OSC_FRAME_H
+#define OSC_FRAME_H
+
+// Слот кольца кадров — готовый кадр OSC_DATA в том виде, в каком он уходит
+// по линии: заголовок, meta, отсчёты и CRC лежат подряд, DMA передачи
+// читает прямо из слота. Не зависит от HAL — собирается и на ПК (firmware/host).
+//
+// Раскладка слота:
+//   head[0..wire_pad)           не передаётся
+//   head[wire_pad..)            sync ver seq cmd len | fs_hz ch nsamples pretrig
+//                               [| ext_len enc nch phase — у OSC_DATA_EXT]
+//                               [| seg nseg t — у сегмента (segment.h)]
+//                               [| bits — отсчёты шире 12 бит (oversample.h)]
+//   data[0..nsamples)           отсчёты, начало выровнено на 4 (для DMA АЦП);
+//                               у OSC_DATA_EXT — закодированные на месте байты
+//   data[nsamples]              CRC-16/IBM (у OSC_DATA_EXT — сразу за байтами)
+//   data[..OSC_SLOT_POINTS)     запас на два блока DMA (см. capture.h)
+// Заголовок и meta растут от data назад, поэтому выравнивание отсчётов не
+// зависит от длины заголовка.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "osc_codec.h"      // common/osc_codec.c
+
+#ifndef OSC_FRAME_POINTS
+#define OSC_FRAME_POINTS  8192             // сколько точек отправляем в одном кадре
+#endif
+#ifndef OSC_DMA_POINTS
+#define OSC_DMA_POINTS    1024             // блок DMA (половина буфера)
+#endif
+#define OSC_SLOT_POINTS   (OSC_FRAME_POINTS + 2 * OSC_DMA_POINTS)
+
+#define OSC_HDR_LEN   8    // sync(2) + ver(1) + seq(2) + cmd(1) + len(2)
+#define OSC_META_LEN  9    // fs_hz(4) + ch(1) + nsamples(2) + pretrig(2)
+#define OSC_CRC_LEN   2
+#define OSC_SLOT_HEAD 36
+#define OSC_EXT_LEN   4    // ext_len(1) + enc(1) + nch(1) + phase(1)
+#define OSC_SEG_EXT_LEN 12 // seg(2) + nseg(2) + t(8)
+#define OSC_BITS_EXT_LEN 1 // bits(1)
+#define OSC_SLOT_PAD  (OSC_SLOT_HEAD - OSC_HDR_LEN - OSC_META_LEN)
+#define OSC_SLOT_PAD_EXT (OSC_SLOT_PAD - OSC_EXT_LEN)
+#define OSC_SLOT_PAD_SEG (OSC_SLOT_PAD_EXT - OSC_SEG_EXT_LEN)
+#define OSC_SLOT_PAD_BITS (OSC_SLOT_PAD_SEG - OSC_BITS_EXT_LEN)
+
+#define CMD_OSC_DATA     0x40
+#define CMD_OSC_DATA_EXT 0x41
+
+#define OSC_MAX_CH    4    // каналов в режиме сканирования
+
+// payload OSC_DATA = meta(9) + 2*N должен помещаться в поле len (u16)
+_Static_assert(OSC_META_LEN + OSC_FRAME_POINTS * 2 <= 0xFFFF, "OSC_FRAME_POINTS too large for OSC_DATA");
+// Кадр собирается целыми блоками DMA, блоков в кадре не меньше двух
+_Static_assert(OSC_FRAME_POINTS % OSC_DMA_POINTS == 0 && OSC_FRAME_POINTS >= 2 * OSC_DMA_POINTS,
+               "OSC_FRAME_POINTS must be a multiple of OSC_DMA_POINTS");
+
+typedef struct {
+    uint8_t head[OSC_SLOT_HEAD];
+    uint16_t data[OSC_SLOT_POINTS];        // отсчёты по кругу + запас (и CRC)
+    // Служебное, не передаётся
+    uint32_t fs_hz;
+    uint16_t nsamples;
+    uint16_t pretrig;
+    uint16_t start;        // кадр записан по кругу (OSC_SLOT_POINTS): первый отсчёт в data[start]
+    uint8_t nch;           // каналов в кадре, отсчёты чередуются
+    uint8_t phase;         // канал первого отсчёта
+    uint8_t wire_pad;      // начало кадра в head, ставит osc_slot_finalize
+    uint16_t seg, nseg;    // сегмент seg из nseg (nseg = 0 — кадр потока)
+    uint64_t t;            // сегмент: номер отсчёта срабатывания с начала захвата
+    uint8_t bits;          // разрядность отсчётов: 12, с передискретизацией до 16
+} osc_slot_t;
+
+_Static_assert(offsetof(osc_slot_t, data) == OSC_SLOT_HEAD, "osc_slot_t.data must follow head");
+_Static_assert(OSC_SLOT_HEAD % 4 == 0 && OSC_SLOT_PAD_BITS >= 0, "bad OSC_SLOT_HEAD");
+
+// Разворачивает запись по кругу, кодирует отсчёты на месте (enc — OSC_ENC_*;
+// OSC_ENC_DELTA выбирается, только если выходит короче PACK12, иначе PACK12),
+// пишет заголовок, meta и CRC. Кадр из нескольких каналов и сегмент всегда
+// уходят как OSC_DATA_EXT (nch и phase, seg, nseg и t — в расширении). Возвращает длину кадра на
+// линии; сам кадр — osc_slot_wire(). Отсчёты шире 12 бит (bits > 12) — всегда
+// u16, bits — в расширении.
+uint16_t osc_slot_finalize(osc_slot_t *s, uint16_t seq, uint8_t ch, uint8_t enc);
+
+static inline const uint8_t *osc_slot_wire(const osc_slot_t *s)
+{
+    return s->head + s->wire_pad;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "oversample.h"
+
+#include <string.h>
+
+void ovs_config(ovs_t *o, uint8_t shift, uint8_t nch)
+{
+    if (shift > OVS_MAX_SHIFT) shift = OVS_MAX_SHIFT;
+    o->shift = shift;
+    o->nch = nch ? nch : 1;
+    o->ratio = 1u << 2 * shift;
+    o->ch = 0;
+    o->cnt = 0;
+    memset(o->acc, 0, sizeof(o->acc));
+}
+
+// Один канал: целые группы — суммой в два аккумулятора без проверок на
+// каждом отсчёте; по одному — только хвосты на границах кусков
+static uint32_t run_one(ovs_t *o, const uint16_t *src, uint32_t len, uint16_t *dst, uint32_t room, uint32_t *used)
+{
+    const uint32_t r = o->ratio, rnd = 1u << (o->shift - 1);
+    uint32_t acc = o->acc[0], cnt = o->cnt, i = 0, out = 0;
+    while (i < len && out < room) {
+        if (cnt == 0 && len - i >= r) {
+            uint32_t s0 = 0, s1 = 0;
+            for (uint32_t j = 0; j < r; j += 2) {
+                s0 += src[i + j];
+                s1 += src[i + j + 1];
+            }
+            dst[out++] = (uint16_t)((s0 + s1 + rnd) >> o->shift);
+            i += r;
+            continue;
+        }
+        acc += src[i++];
+        if (++cnt == r) {
+            dst[out++] = (uint16_t)((acc + rnd) >> o->shift);
+            acc = 0;
+            cnt = 0;
+        }
+    }
+    o->acc[0] = acc;
+    o->cnt = cnt;
+    *used = i;
+    return out;
+}
+
+// Несколько каналов: отсчёт — в сумму своего канала; на последнем скане
+// группы сумма канала уходит на выход, каналы — в том же порядке
+static uint32_t run_scan(ovs_t *o, const uint16_t *src, uint32_t len, uint16_t *dst, uint32_t room, uint32_t *used)
+{
+    const uint32_t last = o->ratio - 1, rnd = 1u << (o->shift - 1);
+    uint32_t cnt = o->cnt, i = 0, out = 0;
+    uint8_t ch = o->ch;
+    while (i < len && out < room) {
+        uint32_t a = o->acc[ch] + src[i++];
+        if (cnt == last) {
+            dst[out++] = (uint16_t)((a + rnd) >> o->shift);
+            a = 0;
+        }
+        o->acc[ch] = a;
+        if (++ch == o->nch) {
+            ch = 0;
+            cnt = cnt == last ? 0 : cnt + 1;
+        }
+    }
+    o->ch = ch;
+    o->cnt = cnt;
+    *used = i;
+    return out;
+}
+
+uint32_t ovs_run(ovs_t *o, const uint16_t *src, uint32_t *n, uint16_t *dst, uint32_t room)
+{
+    if (!o->shift) {
+        uint32_t m = *n < room ? *n : room;
+        memcpy(dst, src, m * sizeof(uint16_t));
+        *n = m;
+        return m;
+    }
+    if (o->nch == 1) return run_one(o, src, *n, dst, room, n);
+    return run_scan(o, src, *n, dst, room, n);
+}
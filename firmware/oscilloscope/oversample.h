@@ -0,0 +1,40 @@
+#ifndef OVERSAMPLE_H
+#define OVERSAMPLE_H
+
+// Передискретизация: АЦП работает в 4^k раз быстрее заданной fs, сумма
+// 4^k отсчётов канала подряд, сдвинутая на k, — один отсчёт 12 + k бит
+// (шкала 0..4095·2^k). Прибавка разрядов настоящая, если шум на входе не
+// меньше полкода АЦП (иначе усреднять нечего); заодно это фильтр
+// «скользящее среднее» перед прореживанием — помехи выше fs/2 ослабляются.
+//
+// Сырые отсчёты приходят кусками (половины буфера DMA), выход пишется в
+// блоки кадра; куски и блоки не обязаны совпадать с группами 4^k — суммы
+// переносятся между вызовами. Несколько каналов: поток a0 b0 c0 a1 ...,
+// у каждого канала своя сумма, выход — в том же порядке каналов. Не
+// зависит от HAL — собирается и на ПК (firmware/host/check_oversample).
+
+#include <stdint.h>
+
+#include "osc_frame.h"
+
+#define OVS_MAX_SHIFT 4         // 4^4 = 256 отсчётов -> 16 бит
+
+typedef struct {
+    uint8_t shift;              // k: 0 — выкл., отсчёты проходят как есть
+    uint8_t nch;
+    uint32_t ratio;             // 4^k
+    // Перенос между вызовами
+    uint8_t ch;                 // канал следующего сырого отсчёта
+    uint32_t cnt;               // сканов в текущей группе
+    uint32_t acc[OSC_MAX_CH];
+} ovs_t;
+
+// Настройка и сброс сумм (при остановленном DMA)
+void ovs_config(ovs_t *o, uint8_t shift, uint8_t nch);
+
+// До *n сырых отсчётов из src, выход — в dst, не больше room отсчётов.
+// Возвращает число выходных отсчётов, в *n — сколько сырых взято (меньше
+// исходного, только если dst заполнен).
+uint32_t ovs_run(ovs_t *o, const uint16_t *src, uint32_t *n, uint16_t *dst, uint32_t room);
+
+#endif
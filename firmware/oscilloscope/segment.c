@@ -0,0 +1,155 @@
+#include "segment.h"
+
+#include <string.h>
+
+#define B OSC_DMA_POINTS
+
+uint32_t seg_plan(seg_t *s, uint16_t *pool, uint32_t pool_len, uint32_t len, uint32_t nseg, uint8_t pre_pct)
+{
+    s->pool = pool;
+    s->pool_len = pool_len;
+    if (len < SEG_MIN_POINTS) len = SEG_MIN_POINTS;
+    if (len > OSC_FRAME_POINTS) len = OSC_FRAME_POINTS;
+    len -= len % s->nch;                // у каналов поровну отсчётов
+    if (pre_pct > 100) pre_pct = 100;
+
+    uint32_t pre = 0;
+    if (s->trig.mode != TRIG_OFF) {
+        // Как в capture.c: pre ≡ trig_ch (mod nch) — сегмент с канала 0
+        pre = len * pre_pct / 100;
+        if (s->nch > 1) {
+            pre = pre - pre % s->nch + s->trig_ch;
+            if (pre > len - 1) pre -= s->nch;
+        }
+        if (pre > len - 1) pre = len - 1;
+    }
+    // История: предыстория срабатывания в первом же блоке плюс блок в
+    // обработке и блок, который пишет DMA
+    uint32_t hist = (pre + B - 1) / B * B + 2 * B;
+    uint32_t fit = pool_len > hist ? (pool_len - hist) / len : 0;
+    if (fit > SEG_MAX) fit = SEG_MAX;
+    if (nseg == 0 || nseg > fit) nseg = fit;
+
+    s->hist = pool;
+    s->hist_len = hist;
+    s->seg = pool + hist;
+    s->len = len;
+    s->nseg = nseg;
+    s->pre = pre;
+    return nseg;
+}
+
+void seg_start(seg_t *s)
+{
+    s->filled = 0;
+    s->blk = 0;
+    s->phase = 0;
+    s->tgt_pos[0] = 0;
+    s->tgt_pos[1] = B;
+    s->asg_pos = 2 * B % s->hist_len;
+    s->busy = false;
+    s->scan_from = 0;
+    trigger_rearm(&s->trig);
+    s->state = s->nseg ? SEG_ARMED : SEG_DONE;
+}
+
+// Позиция в истории отсчёта x; блок blk лежит с позиции pos. x — не
+// раньше hist_len отсчётов до блока и не дальше его конца.
+static uint32_t hist_pos(const seg_t *s, uint32_t pos, uint64_t x)
+{
+    int32_t p = (int32_t)pos + (int32_t)(x - s->blk);
+    if (p < 0) p += (int32_t)s->hist_len;
+    return (uint32_t)p % s->hist_len;
+}
+
+// n отсчётов истории с позиции p — с учётом перехода через конец
+static void copy_hist(const seg_t *s, uint16_t *dst, uint32_t p, uint32_t n)
+{
+    uint32_t first = s->hist_len - p;
+    if (first > n) first = n;
+    memcpy(dst, s->hist + p, first * sizeof(uint16_t));
+    memcpy(dst + first, s->hist, (n - first) * sizeof(uint16_t));
+}
+
+// Следующее срабатывание в блоке начиная с src[off] — по отсчётам канала
+// trig_ch, если каналов несколько. Индекс в блоке или -1.
+static int32_t scan(seg_t *s, const uint16_t *src, uint32_t off)
+{
+    if (s->nch == 1) {
+        int32_t hit = trigger_scan(&s->trig, src + off, B - off);
+        return hit < 0 ? -1 : (int32_t)off + hit;
+    }
+    uint32_t first = off + (s->trig_ch + 2 * s->nch - (s->phase + off) % s->nch) % s->nch;
+    if (first >= B) return -1;
+    int32_t k = trigger_scan_stride(&s->trig, src + first, B - first, s->nch);
+    return k < 0 ? -1 : (int32_t)(first + (uint32_t)k * s->nch);
+}
+
+// Канал отсчёта x (блок blk начинается с канала phase)
+static uint8_t phase_of(const seg_t *s, uint64_t x)
+{
+    if (x >= s->blk) return (uint8_t)((s->phase + (uint32_t)(x - s->blk)) % s->nch);
+    uint32_t back = (uint32_t)(s->blk - x) % s->nch;
+    return (uint8_t)((s->phase + s->nch - back) % s->nch);
+}
+
+// Блок blk..blk+B, лежит в истории с позиции pos. Сегмент в сборке
+// дописывается до конца блока; после его конца в том же блоке ищется
+// следующее срабатывание. Сегмент начинается в истории за pre отсчётов
+// до срабатывания — их DMA ещё не перезаписал (hist_len >= pre + 2B).
+static void process(seg_t *s, uint32_t pos)
+{
+    const uint16_t *src = s->hist + pos;
+    uint64_t end = s->blk + B;
+
+    while (s->state == SEG_ARMED) {
+        if (s->busy) {
+            uint64_t seg_end = s->start + s->len;
+            uint64_t from = s->start + s->copied;
+            uint32_t n = (uint32_t)((seg_end < end ? seg_end : end) - from);
+            copy_hist(s, s->seg + s->filled * s->len + s->copied, hist_pos(s, pos, from), n);
+            s->copied += n;
+            if (s->copied < s->len) return;
+            s->busy = false;
+            s->scan_from = seg_end;
+            trigger_rearm(&s->trig);
+            s->filled++;                // сегмент готов — виден выгрузке
+            if (s->filled == s->nseg) s->state = SEG_DONE;
+            continue;
+        }
+        uint32_t off = s->scan_from > s->blk ? (uint32_t)(s->scan_from - s->blk) : 0;
+        if (off >= B) return;
+        uint64_t t;
+        if (s->trig.mode == TRIG_OFF) {
+            t = s->blk + off;           // встык за прошлым сегментом
+        } else {
+            // auto в сегментном режиме — как norm: ждём именно событий
+            int32_t hit = scan(s, src, off);
+            if (hit < 0) return;
+            t = s->blk + (uint32_t)hit;
+            if (t < s->pre) {
+                // Предыстория до начала захвата — пропускаем
+                s->scan_from = t + 1;
+                continue;
+            }
+        }
+        seg_info_t *in = &s->info[s->filled];
+        in->t = t;
+        in->pretrig = (uint16_t)s->pre;
+        in->phase = phase_of(s, t - s->pre);
+        s->start = t - s->pre;
+        s->copied = 0;
+        s->busy = true;
+    }
+}
+
+uint16_t *seg_block(seg_t *s, int i)
+{
+    if (s->state == SEG_ARMED) process(s, s->tgt_pos[i]);
+    s->blk += B;
+    s->phase = (uint8_t)((s->phase + B) % s->nch);
+    // Блок через один — следующий по кругу истории
+    s->tgt_pos[i] = s->asg_pos;
+    s->asg_pos = (s->asg_pos + B) % s->hist_len;
+    return seg_target(s, i);
+}
@@ -0,0 +1,86 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+// Сегментная память: серия коротких захватов по триггеру на полной частоте
+// АЦП, без линии. Память (на плате — кольцо кадров, пока поток стоит)
+// делится на историю и nseg сегментов по len отсчётов. DMA пишет блоки по
+// OSC_DMA_POINTS в историю по кругу; на срабатывании сегмент — pre
+// отсчётов до него и len - pre после — копируется из истории, по мере
+// прихода блоков. Следующее срабатывание ищется сразу с конца сегмента:
+// мёртвое время — только перевзвод триггера. Метка сегмента — номер
+// отсчёта срабатывания с начала захвата (время — по fs). Без триггера
+// (TRIG_OFF) сегменты идут встык — один длинный захват, нарезанный на
+// куски. Выгрузка — после, по сегменту в кадре (seg_read). Не зависит от
+// HAL — собирается и на ПК (firmware/host/sim_segment).
+//
+// Несколько каналов — как в capture.h: отсчёт потока n — канал n % nch
+// (захват начинается с канала 0), триггер — по каналу trig_ch, сегмент с
+// триггером начинается с канала 0.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "osc_frame.h"
+#include "trigger.h"
+
+#define SEG_MAX         256     // сегментов в каталоге
+#define SEG_MIN_POINTS  64
+
+enum { SEG_IDLE = 0, SEG_ARMED = 1, SEG_DONE = 2 };
+
+typedef struct {
+    uint64_t t;                 // отсчёт срабатывания с начала захвата
+    uint16_t pretrig;           // срабатывание — отсчёт pretrig сегмента
+    uint8_t phase;              // канал первого отсчёта
+} seg_info_t;
+
+typedef struct {
+    // Разметка (seg_plan)
+    uint16_t *pool;
+    uint32_t pool_len;
+    uint16_t *hist;             // история, hist_len отсчётов (кратно блоку)
+    uint32_t hist_len;
+    uint16_t *seg;              // сегменты подряд, по len
+    uint32_t len, nseg, pre;
+    uint8_t nch, trig_ch;
+    uint32_t fs_hz;
+    trigger_t trig;             // копия настроек на момент захвата
+
+    volatile uint8_t state;     // SEG_*
+    volatile uint32_t filled;   // готовых сегментов: info и данные не меняются
+    seg_info_t info[SEG_MAX];
+
+    // Обработка
+    uint64_t blk;               // номер первого отсчёта обрабатываемого блока
+    uint8_t phase;              // его канал
+    uint32_t tgt_pos[2];        // куда в историю пишет DMA
+    uint32_t asg_pos;
+    bool busy;                  // сегмент filled собирается
+    uint64_t start;             // его первый отсчёт
+    uint32_t copied;
+    uint64_t scan_from;         // срабатывания раньше не ищем (конец прошлого сегмента)
+} seg_t;
+
+// Разметка памяти pool под сегменты по len отсчётов (SEG_MIN_POINTS..
+// OSC_FRAME_POINTS), предыстория pre_pct %. nseg = 0 — сколько поместится
+// (не больше SEG_MAX). Триггер, fs и каналы — заранее в s->trig, fs_hz,
+// nch, trig_ch. Возвращает число сегментов, 0 — не помещается ни один.
+uint32_t seg_plan(seg_t *s, uint16_t *pool, uint32_t pool_len, uint32_t len, uint32_t nseg, uint8_t pre_pct);
+// Старт захвата по разметке: вызывать при остановленном DMA
+void seg_start(seg_t *s);
+
+// Адрес i-го буфера DMA (0/1) — для запуска DMA
+static inline uint16_t *seg_target(const seg_t *s, int i)
+{
+    return s->hist + s->tgt_pos[i];
+}
+
+// Прерывание: DMA заполнил буфер i. Возвращает новый адрес для буфера i.
+uint16_t *seg_block(seg_t *s, int i);
+
+static inline const uint16_t *seg_data(const seg_t *s, uint32_t k)
+{
+    return s->seg + k * s->len;
+}
+
+#endif
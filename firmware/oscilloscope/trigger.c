@@ -0,0 +1,117 @@
+#include "trigger.h"
+
+#include <stddef.h>
+
+// Сравнение двух беззнаковых u16 в слове за раз (SWAR): в бите 15 каждой
+// половины результата — x >= t. Переносов между половинами нет, поэтому
+// годится для любой разрядности отсчётов, в том числе 16 бит.
+#define HI_BITS 0x80008000u
+
+static inline uint32_t ge_mask(uint32_t x, uint32_t t)
+{
+    uint32_t d = (x | HI_BITS) - (t & ~HI_BITS);
+    return ((x & ~t) | (~(x ^ t) & d)) & HI_BITS;
+}
+
+static inline uint32_t rep(uint16_t v)
+{
+    return v * 0x00010001u;
+}
+
+void trigger_config(trigger_t *t, uint8_t mode, uint8_t edge, uint16_t level, uint16_t hyst)
+{
+    if (level > 0xFFFE) level = 0xFFFE;
+    t->mode = mode;
+    t->edge = edge;
+    t->level = level;
+    t->hyst = hyst;
+    t->armed = false;
+    if (edge == TRIG_RISING) {
+        uint16_t lo = level > hyst ? level - hyst : 0;
+        t->arm_thr = rep(lo);               // взвод: x < lo
+        t->fire_thr = rep(level);           // срабатывание: x >= level
+    } else {
+        uint32_t hi = (uint32_t)level + hyst;
+        if (hi > 0xFFFE) hi = 0xFFFE;
+        t->arm_thr = rep((uint16_t)(hi + 1));  // взвод: x > hi
+        t->fire_thr = rep(level + 1);          // срабатывание: x <= level
+    }
+}
+
+void trigger_rearm(trigger_t *t)
+{
+    t->armed = false;
+}
+
+// Есть ли в слове отсчёт, меняющий состояние автомата
+static inline uint32_t event_mask(const trigger_t *t, uint32_t w)
+{
+    if (t->armed) {
+        uint32_t m = ge_mask(w, t->fire_thr);
+        return t->edge == TRIG_RISING ? m : m ^ HI_BITS;
+    }
+    uint32_t m = ge_mask(w, t->arm_thr);
+    return t->edge == TRIG_RISING ? m ^ HI_BITS : m;
+}
+
+static inline bool step(trigger_t *t, uint16_t v)
+{
+    uint16_t thr = t->armed ? (uint16_t)t->fire_thr : (uint16_t)t->arm_thr;
+    bool ge = v >= thr;
+    bool hit = (t->edge == TRIG_RISING) ? (t->armed ? ge : !ge) : (t->armed ? !ge : ge);
+    if (!hit) return false;
+    if (!t->armed) {
+        t->armed = true;
+        return false;
+    }
+    t->armed = false;
+    return true;
+}
+
+int32_t trigger_scan_scalar(trigger_t *t, const uint16_t *src, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        if (step(t, src[i])) return (int32_t)i;
+    }
+    return -1;
+}
+
+// Отсчёты канала идут через stride — слова SWAR не подходят, автомат по
+// одному; отсчётов в nch раз меньше, чем в блоке
+int32_t trigger_scan_stride(trigger_t *t, const uint16_t *src, uint32_t n, uint32_t stride)
+{
+    for (uint32_t i = 0, k = 0; i < n; i += stride, k++) {
+        if (step(t, src[i])) return (int32_t)k;
+    }
+    return -1;
+}
+
+int32_t trigger_scan(trigger_t *t, const uint16_t *src, uint32_t n)
+{
+    uint32_t i = 0;
+
+    if (((uintptr_t)src & 3) && n) {
+        if (step(t, src[0])) return 0;
+        i = 1;
+    }
+    // Основной цикл: 4 отсчёта (2 слова) за проход; пока в словах нет
+    // событий для текущего состояния, отсчёты по одному не смотрим
+    const uint32_t *w = (const uint32_t *)(src + i);
+    while (i + 4 <= n) {
+        uint32_t w0 = w[0], w1 = w[1];
+        if (!(event_mask(t, w0) | event_mask(t, w1))) {
+            i += 4;
+            w += 2;
+            continue;
+        }
+        for (uint32_t k = 0; k < 4; k++) {
+            if (step(t, src[i + k])) return (int32_t)(i + k);
+        }
+        i += 4;
+        w += 2;
+    }
+    for (; i < n; i++) {
+        if (step(t, src[i])) return (int32_t)i;
+    }
+    return -1;
+}
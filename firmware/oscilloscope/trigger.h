@@ -0,0 +1,42 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+// Программный триггер по фронту с гистерезисом. Не зависит от HAL —
+// собирается и на ПК (firmware/host).
+//
+// Фронт вверх: взвод, когда сигнал опустился ниже level - hyst, срабатывание
+// на первом отсчёте >= level. Фронт вниз — зеркально. Состояние взвода
+// переносится между блоками DMA.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum { TRIG_OFF = 0, TRIG_NORM = 1, TRIG_AUTO = 2 };
+enum { TRIG_RISING = 0, TRIG_FALLING = 1 };
+
+typedef struct {
+    uint8_t mode;
+    uint8_t edge;
+    uint16_t level;     // в отсчётах АЦП
+    uint16_t hyst;
+    bool armed;
+    // Пороги, упакованные по два в слово (см. trigger_config)
+    uint32_t arm_thr;
+    uint32_t fire_thr;
+} trigger_t;
+
+void trigger_config(trigger_t *t, uint8_t mode, uint8_t edge, uint16_t level, uint16_t hyst);
+void trigger_rearm(trigger_t *t);
+
+// Индекс первого срабатывания в src[0..n) или -1
+int32_t trigger_scan(trigger_t *t, const uint16_t *src, uint32_t n);
+
+// То же по каждому stride-му отсчёту (src[0], src[stride], ...), n — длина
+// src; возвращает номер срабатывания k (отсчёт src[k * stride]) или -1.
+// Для кадров из нескольких каналов: триггер по одному из них.
+int32_t trigger_scan_stride(trigger_t *t, const uint16_t *src, uint32_t n, uint32_t stride);
+
+// Эталон: тот же автомат по одному отсчёту (для сверки на ПК)
+int32_t trigger_scan_scalar(trigger_t *t, const uint16_t *src, uint32_t n);
+
+#endif
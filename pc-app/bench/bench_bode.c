@@ -0,0 +1,254 @@
+// Частотная характеристика (bode.c): Гёрцель против прямого ДПФ на шуме;
+// разбор сегмента с известными усилением и фазой — с phase кадра 0 и 1
+// (каналы до phase начинаются скан спустя), 12 и 16 бит; свип против двух
+// симуляторов (devsim.c) в петле: генератор -> фильтр 2-го порядка ->
+// осциллограф, через cmdchan и osc_reader_run, как в GUI. Точки сверяются
+// с devsim_loop_h (где усиление выше -30 дБ). Время свипа — конвейером и
+// по одной команде, рядом — сумма длительностей сегментов (предел снизу);
+// ответ плат — через LINK_US, как у USB.
+//
+//   ./bench_bode [точек]
+
+#include "../bode.h"
+#include "../devsim.h"
+#include "osc_codec.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOOP_FC_HZ 5000
+#define SWEEP_F0   100.0
+#define SWEEP_F1   100000.0
+#define LINK_US    1000        // ответ платы — через кадр USB
+
+static uint32_t rnd_x = 12345;
+
+static uint32_t rnd(void)
+{
+    rnd_x = rnd_x * 1103515245u + 12345u;
+    return rnd_x >> 8;
+}
+
+static void *reader_thread(void *arg)
+{
+    osc_reader_run(arg);
+    return NULL;
+}
+
+// Фаза в пределах ±180
+static double wrap180(double deg)
+{
+    return deg - 360 * round(deg / 360);
+}
+
+static int check_goertzel(void)
+{
+    enum { N = 1000 };
+    static uint16_t x[N];
+    static float win[N];
+    for (unsigned i = 0; i < N; i++) {
+        x[i] = (uint16_t)(rnd() & 0x0FFF);
+        win[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / (N - 1)));
+    }
+    double mean = 0, err = 0, ref_max = 0;
+    for (unsigned i = 0; i < N; i++) mean += x[i];
+    mean /= N;
+    static const double ws[] = {0.01, 0.3, 1.0, 2.5, M_PI - 0.01};
+    for (size_t k = 0; k < sizeof(ws) / sizeof(ws[0]); k++) {
+        for (int w_on = 0; w_on < 2; w_on++) {
+            double re = 0, im = 0, gr, gi;
+            for (unsigned i = 0; i < N; i++) {
+                double v = (x[i] - mean) * (w_on ? win[i] : 1.0f);
+                re += v * cos(ws[k] * i);
+                im -= v * sin(ws[k] * i);
+            }
+            bode_goertzel(x, N, ws[k], w_on ? win : NULL, &gr, &gi);
+            double e = hypot(gr - re, gi - im);
+            if (e > err) err = e;
+            if (hypot(re, im) > ref_max) ref_max = hypot(re, im);
+        }
+    }
+    printf("goertzel vs direct DFT, %u samples, 5 frequencies, with/without window: max error %.2e of %.0f\n", N,
+           err, ref_max);
+    if (err > 1e-6 * ref_max) {
+        fprintf(stderr, "check_goertzel: differs from DFT\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Два канала вперемешку с первого отсчёта канала phase: канал 1 — канал 0
+// с усилением g и сдвигом sh (рад); шум ±3 МЗР
+static void make_frame(osc_frame_t *fr, uint16_t *buf, uint32_t n, uint8_t phase, uint8_t bits, double f,
+                       double g, double sh)
+{
+    uint32_t fs = bode_fs(f), len[2] = {0, 0};
+    double scale = 1 << (bits - 12);
+    // Отсчёт i кадра — скан (i + phase) / 2, канал (i + phase) % 2
+    for (uint32_t i = 0; i < n; i++) len[(i + phase) % 2]++;
+    fr->samples = buf;
+    fr->nch = 2;
+    fr->phase = phase;
+    fr->fs_hz = fs;
+    fr->bits = bits;
+    fr->nsamples = (uint16_t)n;
+    fr->ch_off[0] = 0;
+    fr->ch_len[0] = (uint16_t)len[0];
+    fr->ch_off[1] = (uint16_t)len[0];
+    fr->ch_len[1] = (uint16_t)len[1];
+    uint32_t k[2] = {0, 0};
+    for (uint32_t i = 0; i < n; i++) {
+        unsigned c = (i + phase) % 2;
+        double t = (double)((i + phase) / 2) / fs, ph = 2 * M_PI * f * t + 0.7;
+        double v = c ? 2048 + 1000 * g * sin(ph + sh) : 2048 + 1000 * sin(ph);
+        buf[fr->ch_off[c] + k[c]++] = (uint16_t)lrint(v * scale + (int)(rnd() % 7) - 3);
+    }
+}
+
+static int check_measure(void)
+{
+    static uint16_t buf[BODE_SEG_SAMPLES];
+    static const struct { double f, g, sh_deg; uint8_t phase, bits; } cases[] = {
+        {1000, 1.0, 0, 0, 12},  {1000, 0.5, -45, 1, 12}, {20000, 2.0, 120, 0, 12},
+        {37000, 0.1, -170, 1, 12}, {150, 0.7, -90, 0, 16}, {250000, 1.0, -30, 1, 12},
+    };
+    double gerr = 0, perr = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        osc_frame_t fr = {0};
+        make_frame(&fr, buf, BODE_SEG_SAMPLES - cases[i].phase, cases[i].phase, cases[i].bits, cases[i].f,
+                   cases[i].g, cases[i].sh_deg * M_PI / 180);
+        bode_point_t pt;
+        if (!bode_measure(&fr, cases[i].f, &pt) || !pt.ok) {
+            fprintf(stderr, "check_measure: case %zu not measured\n", i);
+            return 1;
+        }
+        double ge = fabs(pt.gain_db - 20 * log10(cases[i].g)), pe = fabs(wrap180(pt.phase_deg - cases[i].sh_deg));
+        double ae = fabs(pt.in_amp - 1000);
+        if (ge > gerr) gerr = ge;
+        if (pe > perr) perr = pe;
+        if (ge > 0.05 || pe > 0.5 || ae > 5) {
+            fprintf(stderr, "check_measure: f %.0f, phase %u, %u bits: gain %.3f dB (want %.3f), phase %.2f (want %.1f), "
+                    "amp %.1f\n", cases[i].f, cases[i].phase, cases[i].bits, pt.gain_db, 20 * log10(cases[i].g),
+                    pt.phase_deg, cases[i].sh_deg, pt.in_amp);
+            return 1;
+        }
+    }
+    printf("measure, 6 cases (frame phase 0/1, 12/16 bits): max gain error %.4f dB, phase error %.3f deg\n", gerr,
+           perr);
+    return 0;
+}
+
+typedef struct {
+    devsim_t sim;
+    osc_reader_t rd;
+    cmdchan_t cc;
+    pthread_t rt;
+} board_t;
+
+static bool board_open(board_t *b, const devsim_cfg_t *cfg)
+{
+    if (!devsim_start(&b->sim, cfg) || !osc_reader_init(&b->rd, cfg->points) || !cmdchan_init(&b->cc)) return false;
+    b->rd.fd = port_open(b->sim.path, 115200);
+    if (b->rd.fd < 0) return false;
+    b->rd.cmd = &b->cc;
+    cmdchan_reset(&b->cc, b->rd.fd, b->rd.wake_fd);
+    atomic_store(&b->rd.run, true);
+    pthread_create(&b->rt, NULL, reader_thread, &b->rd);
+    return true;
+}
+
+static void board_close(board_t *b)
+{
+    osc_reader_cancel(&b->rd);
+    pthread_join(b->rt, NULL);
+    cmdchan_free(&b->cc);
+    close(b->rd.fd);
+    osc_reader_free(&b->rd);
+    devsim_stop(&b->sim);
+}
+
+static int run_sweep(bode_t *bd, bool serial)
+{
+    bd->serial = serial;
+    if (!bode_start(bd)) {
+        fprintf(stderr, "bode_start failed\n");
+        return 1;
+    }
+    while (atomic_load(&bd->state) == BODE_RUN) usleep(10000);
+    bode_stop(bd);
+    unsigned done = atomic_load(&bd->done);
+    printf("%-10s %u points %.0f..%.0f Hz: %.2f s, segments alone %.2f s, %.1f ms/point over capture\n",
+           serial ? "serial" : "pipelined", done, bd->f0_hz, bd->f1_hz, bd->total_s, bd->capture_s,
+           (bd->total_s - bd->capture_s) * 1e3 / (done ? done : 1));
+    if (atomic_load(&bd->state) != BODE_DONE || done != bd->npoints) {
+        fprintf(stderr, "  sweep: %s\n", bd->msg);
+        return 1;
+    }
+    double gerr = 0, perr = 0;
+    unsigned checked = 0;
+    for (unsigned i = 0; i < done; i++) {
+        const bode_point_t *p = &bd->pt[i];
+        double g, sh;
+        devsim_loop_h(LOOP_FC_HZ, p->f_hz, &g, &sh);
+        if (20 * log10(g) < -30) continue;
+        double ge = fabs(p->gain_db - 20 * log10(g)), pe = fabs(wrap180(p->phase_deg - sh * 180 / M_PI));
+        if (ge > gerr) gerr = ge;
+        if (pe > perr) perr = pe;
+        checked++;
+        if (!p->ok || ge > 0.2 || pe > 2) {
+            fprintf(stderr, "  %.1f Hz: gain %.2f dB (want %.2f), phase %.1f (want %.1f)\n", p->f_hz, p->gain_db,
+                    20 * log10(g), p->phase_deg, sh * 180 / M_PI);
+            return 1;
+        }
+        // Непрерывность: соседние точки не дальше 90 градусов
+        if (i && fabs(p->phase_deg - bd->pt[i - 1].phase_deg) > 90) {
+            fprintf(stderr, "  %.1f Hz: phase jump\n", p->f_hz);
+            return 1;
+        }
+    }
+    printf("           %u points above -30 dB vs filter: max gain error %.3f dB, phase error %.2f deg\n", checked, gerr,
+           perr);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned n = argc > 1 ? (unsigned)atoi(argv[1]) : 100;
+    crc16_init();
+    int rc = check_goertzel() | check_measure();
+    if (rc) return rc;
+
+    static board_t gen, osc;
+    static bode_t bd;
+    devsim_cfg_t gcfg = {.points = 1024, .reply_delay_us = LINK_US};
+    if (!board_open(&gen, &gcfg)) {
+        fprintf(stderr, "generator init failed\n");
+        return 1;
+    }
+    devsim_cfg_t ocfg = {.points = 8192, .fs_hz = 500000, .nch = 1, .enc = OSC_ENC_PACK12, .loop = &gen.sim,
+                         .loop_fc_hz = LOOP_FC_HZ, .reply_delay_us = LINK_US};
+    if (!board_open(&osc, &ocfg) || !bode_init(&bd)) {
+        fprintf(stderr, "scope init failed\n");
+        return 1;
+    }
+    bd.f0_hz = SWEEP_F0;
+    bd.f1_hz = SWEEP_F1;
+    bd.npoints = n;
+    bd.log = true;
+    bd.gen = &gen.cc;
+    bd.osc = &osc.cc;
+    bd.rd = &osc.rd;
+    rc |= run_sweep(&bd, false);
+    double t_pipe = bd.total_s;
+    rc |= run_sweep(&bd, true);
+    printf("pipelined is %.2fx faster than one command at a time\n", bd.total_s / t_pipe);
+
+    bode_free(&bd);
+    board_close(&osc);
+    board_close(&gen);
+    return rc;
+}
@@ -0,0 +1,289 @@
+// Канал команд (cmdchan.c) против симулятора платы (devsim.c): тот же
+// osc_reader_run, что в GUI, сверяет ответы по seq. Команды по одной (ждём
+// ответа на каждую) и подряд (в полёте до CMDCHAN_WINDOW); подряд — на фоне
+// потока кадров; с потерей ответов (повторы по таймауту, все команды должны
+// завершиться успешно); «зависшая» плата — cmdchan_send не ждёт, команды
+// снимаются по таймауту, после оживления канал работает дальше.
+// Для каждого режима: команд/с, задержка ответа p50/p90/p99/макс.
+// Сегментный захват: capture_once, опрос seg_status до конца захвата,
+// выгрузка seg_read — все сегменты по порядку, с метками и pretrig; с
+// передискретизацией (set_oversample) — ещё и разрядность кадров; повтор
+// seg_read с тем же seq пачку второй раз не выгружает.
+//
+//   ./bench_cmd [команд_на_режим]
+
+#include "../cmdchan.h"
+#include "../devsim.h"
+#include "../reader.h"
+#include "osc_codec.h"
+
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { CMD_BENCH_SERIAL = 1, CMD_BENCH_MUTE = 2 };
+
+typedef struct {
+    _Atomic unsigned inflight;
+    _Atomic unsigned done[4];           // по статусу CMD_*
+    sem_t sem;                          // +1 на завершение: ожидание без опроса
+} counts_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void on_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    counts_t *c = ctx;
+    (void)resp;
+    atomic_fetch_add(&c->done[status], 1);
+    atomic_fetch_sub(&c->inflight, 1);
+    sem_post(&c->sem);
+}
+
+static void *reader_thread(void *arg)
+{
+    osc_reader_run(arg);
+    return NULL;
+}
+
+// Команды генератора по кругу: все с ответом {u8 err}
+static bool send_one(cmdchan_t *cc, counts_t *c, unsigned i)
+{
+    uint8_t p[4] = {(uint8_t)(i % 6), (uint8_t)i, 0, 0};
+    static const uint8_t cmds[] = {0x10, 0x11, 0x12, 0x13, 0x14};
+    static const uint16_t lens[] = {1, 4, 2, 2, 2};
+    atomic_fetch_add(&c->inflight, 1);
+    if (cmdchan_send(cc, cmds[i % 5], p, lens[i % 5], on_done, c)) return true;
+    atomic_fetch_sub(&c->inflight, 1);
+    return false;
+}
+
+static bool wait_idle(counts_t *c, double secs)
+{
+    double t0 = now_s();
+    while (atomic_load(&c->inflight) && now_s() - t0 < secs) usleep(200);
+    return atomic_load(&c->inflight) == 0;
+}
+
+static int run(const char *name, const devsim_cfg_t *cfg, unsigned n, int flags)
+{
+    static devsim_t sim;
+    static osc_reader_t rd;
+    static cmdchan_t cc;
+    static counts_t c;
+    int rc = 0;
+    memset(&c, 0, sizeof(c));
+    sem_init(&c.sem, 0, 0);
+    if (!devsim_start(&sim, cfg) || !osc_reader_init(&rd, cfg->points) || !cmdchan_init(&cc)) {
+        fprintf(stderr, "init failed\n");
+        return 1;
+    }
+    rd.fd = port_open(sim.path, 115200);
+    if (rd.fd < 0) {
+        perror(sim.path);
+        return 1;
+    }
+    rd.cmd = &cc;
+    cmdchan_reset(&cc, rd.fd, rd.wake_fd);
+    atomic_store(&rd.run, true);
+    pthread_t rt;
+    pthread_create(&rt, NULL, reader_thread, &rd);
+    if (flags & CMD_BENCH_MUTE) {
+        // Симулятор перестаёт читать порт со следующего ожидания (до 50 мс)
+        atomic_store(&sim.mute, true);
+        usleep(100000);
+    }
+
+    double t0 = now_s(), send_max = 0;
+    if (flags & CMD_BENCH_MUTE) {
+        // Плата молчит: отправка не ждёт ответа, всё снимается по таймауту
+        for (unsigned i = 0; i < n; i++) {
+            double s0 = now_s();
+            if (!send_one(&cc, &c, i)) break;
+            if (now_s() - s0 > send_max) send_max = now_s() - s0;
+        }
+        wait_idle(&c, 5.0);
+    } else {
+        for (unsigned i = 0; i < n; i++) {
+            while (!send_one(&cc, &c, i)) usleep(100);      // очередь полна
+            if (flags & CMD_BENCH_SERIAL) sem_wait(&c.sem);
+        }
+        wait_idle(&c, 10.0);
+    }
+    double dt = now_s() - t0;
+
+    cmd_latency_t l;
+    cmdchan_latency(&cc, &l);
+    unsigned ok = atomic_load(&c.done[CMD_OK]), tmo = atomic_load(&c.done[CMD_TIMEOUT]);
+    printf("%-26s %8.0f cmd/s  p50 %.3f p90 %.3f p99 %.3f max %.3f ms  resent %llu timeouts %llu",
+           name, n / dt, l.p50_ms, l.p90_ms, l.p99_ms, l.max_ms, (unsigned long long)atomic_load(&cc.resent),
+           (unsigned long long)atomic_load(&cc.timeouts));
+    if (flags & CMD_BENCH_MUTE) printf("  send max %.3f ms", send_max * 1e3);
+    printf("\n");
+
+    if (flags & CMD_BENCH_MUTE) {
+        if (tmo != n || send_max > 0.005) {
+            fprintf(stderr, "  %u of %u timed out, slowest send %.3f ms\n", tmo, n, send_max * 1e3);
+            rc = 1;
+        }
+        // Плата ожила: старые команды из порта она выполнит (ответы уже
+        // никому не нужны — unmatched), новые проходят
+        atomic_store(&sim.mute, false);
+        for (unsigned i = 0; i < 4; i++) atomic_store(&c.done[i], 0);
+        for (unsigned i = 0; i < 8; i++) send_one(&cc, &c, i);
+        wait_idle(&c, 2.0);
+        if (atomic_load(&c.done[CMD_OK]) != 8) {
+            fprintf(stderr, "  after stall: %u of 8 ok\n", atomic_load(&c.done[CMD_OK]));
+            rc = 1;
+        }
+    } else {
+        uint64_t dropped = atomic_load(&sim.replies_dropped);
+        if (ok != n || atomic_load(&cc.unmatched) || atomic_load(&cc.resent) != dropped) {
+            fprintf(stderr, "  %u of %u ok, %llu unmatched, %llu resent for %llu lost replies\n", ok, n,
+                    (unsigned long long)atomic_load(&cc.unmatched), (unsigned long long)atomic_load(&cc.resent),
+                    (unsigned long long)dropped);
+            rc = 1;
+        }
+    }
+
+    osc_reader_cancel(&rd);
+    pthread_join(rt, NULL);
+    cmdchan_free(&cc);
+    close(rd.fd);
+    osc_reader_free(&rd);
+    devsim_stop(&sim);
+    sem_destroy(&c.sem);
+    return rc;
+}
+
+// Сегменты: захват nseg по len отсчётов в bits бит, выгрузка, сверка кадров
+static int run_segments(uint8_t nch, uint16_t len, uint16_t nseg, uint8_t bits)
+{
+    static devsim_t sim;
+    static osc_reader_t rd;
+    static cmdchan_t cc;
+    static counts_t c;
+    static frameq_t q;
+    devsim_cfg_t cfg = {.points = 8192, .fs_hz = 500000, .nch = nch, .enc = OSC_ENC_PACK12};
+    int rc = 0;
+    memset(&c, 0, sizeof(c));
+    sem_init(&c.sem, 0, 0);
+    if (!devsim_start(&sim, &cfg) || !osc_reader_init(&rd, cfg.points) || !cmdchan_init(&cc) ||
+        !frameq_init(&q, PROTO_SEG_MAX, cfg.points)) {
+        fprintf(stderr, "init failed\n");
+        return 1;
+    }
+    rd.fd = port_open(sim.path, 115200);
+    rd.cmd = &cc;
+    atomic_store(&rd.seg_out, &q);
+    cmdchan_reset(&cc, rd.fd, rd.wake_fd);
+    atomic_store(&rd.run, true);
+    pthread_t rt;
+    pthread_create(&rt, NULL, reader_thread, &rd);
+
+    if (bits > 12) {
+        atomic_fetch_add(&c.inflight, 1);
+        cmdchan_send(&cc, PROTO_CMD_SET_OVS, &bits, 1, on_done, &c);
+        wait_idle(&c, 2.0);
+    }
+    double t0 = now_s();
+    uint8_t p[6] = {25, 0, (uint8_t)len, (uint8_t)(len >> 8), (uint8_t)nseg, (uint8_t)(nseg >> 8)};
+    atomic_fetch_add(&c.inflight, 1);
+    cmdchan_send(&cc, PROTO_CMD_CAPTURE_ONCE, p, sizeof(p), on_done, &c);
+    wait_idle(&c, 2.0);
+    // Опрос состояния, как GUI
+    while (atomic_load(&rd.seg_state) != PROTO_SEG_DONE && now_s() - t0 < 5.0) {
+        atomic_fetch_add(&c.inflight, 1);
+        cmdchan_send(&cc, PROTO_CMD_SEG_STATUS, NULL, 0, on_done, &c);
+        wait_idle(&c, 2.0);
+        usleep(20000);
+    }
+    double t1 = now_s();
+    uint16_t got_n = (uint16_t)atomic_load(&rd.seg_nseg);
+    uint8_t r[4] = {0, 0, (uint8_t)got_n, (uint8_t)(got_n >> 8)};
+    atomic_fetch_add(&c.inflight, 1);
+    cmdchan_send(&cc, PROTO_CMD_SEG_READ, r, sizeof(r), on_done, &c);
+    wait_idle(&c, 2.0);
+    unsigned frames = 0;
+    uint64_t last_t = 0;
+    while (frames < got_n && now_s() - t1 < 5.0) {
+        const osc_frame_t *fr = frameq_next(&q);
+        if (!fr) {
+            frameq_wait(&q, 100000);
+            continue;
+        }
+        uint16_t want_len = len - len % nch;
+        if (fr->seg != frames || fr->nseg != got_n || fr->nsamples != want_len || fr->nch != nch || fr->bits != bits ||
+            fr->pretrig != (want_len / 4) - (want_len / 4) % nch || (frames && fr->seg_t <= last_t)) {
+            fprintf(stderr, "  segment %u: seg %u/%u, %u samples, pretrig %u, t %llu, %u bits\n", frames, fr->seg,
+                    fr->nseg, fr->nsamples, fr->pretrig, (unsigned long long)fr->seg_t, fr->bits);
+            rc = 1;
+            break;
+        }
+        last_t = fr->seg_t;
+        frames++;
+    }
+    double t2 = now_s();
+    printf("segments, %u ch x %u samples, %u bits: %u of %u captured in %.0f ms, uploaded in %.1f ms\n", nch, len,
+           bits, frames, nseg, (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+    if (got_n != nseg || frames != got_n || atomic_load(&c.done[CMD_OK]) != atomic_load(&cc.sent)) rc = 1;
+
+    // Повтор seg_read с тем же seq (ответ потерян) — пачка не должна прийти дважды
+    uint8_t raw[32];
+    size_t rn = proto_build(raw, 0x7000, PROTO_CMD_SEG_READ, r, sizeof(r));
+    // Повтор — когда пачка уже пошла
+    unsigned again = 0;
+    bool resent = false;
+    if (write(rd.fd, raw, rn) != (ssize_t)rn) rc = 1;
+    for (double t3 = now_s(); now_s() - t3 < 0.3;) {
+        if (!frameq_next(&q)) {
+            frameq_wait(&q, 20000);
+            continue;
+        }
+        if (!again++ && write(rd.fd, raw, rn) != (ssize_t)rn) rc = 1;
+        resent = true;
+    }
+    if (!resent) rc = 1;
+    if (again != got_n) {
+        fprintf(stderr, "  repeated seg_read: %u frames, want %u\n", again, got_n);
+        rc = 1;
+    }
+
+    osc_reader_cancel(&rd);
+    pthread_join(rt, NULL);
+    cmdchan_free(&cc);
+    close(rd.fd);
+    osc_reader_free(&rd);
+    frameq_free(&q);
+    devsim_stop(&sim);
+    sem_destroy(&c.sem);
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned n = argc > 1 ? (unsigned)atoi(argv[1]) : CMDCHAN_LAT_RING;
+    crc16_init();
+    int rc = 0;
+    devsim_cfg_t quiet = {.points = 1024};
+    rc |= run("one at a time", &quiet, n, CMD_BENCH_SERIAL);
+    rc |= run("pipelined", &quiet, n, 0);
+    devsim_cfg_t stream = {.points = 1024, .rate = 500, .stream = true};
+    rc |= run("one at a time, 500 fr/s", &stream, n, CMD_BENCH_SERIAL);
+    rc |= run("pipelined, 500 fr/s", &stream, n, 0);
+    devsim_cfg_t lossy = {.points = 1024, .reply_drop_ppm = 20000};
+    rc |= run("pipelined, 2% replies lost", &lossy, n, 0);
+    rc |= run("board stalled", &quiet, CMDCHAN_WINDOW * 2, CMD_BENCH_MUTE);
+    rc |= run_segments(1, 1000, 20, 12);
+    rc |= run_segments(3, 4096, 5, 12);
+    rc |= run_segments(2, 2000, 8, 16);
+    return rc;
+}
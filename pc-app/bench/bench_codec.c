@@ -0,0 +1,173 @@
+// Кодирование отсчётов OSC_DATA_EXT: кодер прошивки (на месте и в отдельный
+// буфер) и все ядра распаковки сверяются с исходным кадром на синусе,
+// меандре, шуме и кадре с 16-битными скачками; затем степень сжатия и
+// скорость распаковки по каждому ядру.
+
+#include "../unpack.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define N 8192
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t rnd_state = 1;
+static uint32_t rnd(void)
+{
+    rnd_state = rnd_state * 1103515245u + 12345u;
+    return rnd_state >> 16;
+}
+
+enum { SIG_SINE, SIG_SQUARE, SIG_NOISE, SIG_WIDE, SIG_COUNT };
+static const char *sig_names[SIG_COUNT] = {"sine", "square", "noise", "wide"};
+
+// 12-битные кадры, как с АЦП; «wide» — скачки больше 13 бит (escape-токены)
+static void make_signal(int kind, uint16_t *x, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        switch (kind) {
+        case SIG_SINE:
+            x[i] = (uint16_t)(2048 + 1500 * sin(2 * M_PI * i / 500.0) + (int)(rnd() % 5) - 2);
+            break;
+        case SIG_SQUARE:
+            x[i] = (i / 300) % 2 ? 3900 : 200;
+            break;
+        case SIG_NOISE:
+            x[i] = rnd() & 0x0FFF;
+            break;
+        default:
+            x[i] = (i % 97 == 13) ? (uint16_t)(rnd() | 0x8000) : (uint16_t)(1000 + i % 7);
+            break;
+        }
+    }
+}
+
+typedef struct {
+    const char *name;
+    int enc;
+    const unpack_fn *fn;
+} kernel_t;
+
+static const kernel_t kernels[] = {
+    {"pack12 scalar", OSC_ENC_PACK12, &unpack12_scalar},
+    {"pack12 ssse3", OSC_ENC_PACK12, &unpack12_ssse3},
+    {"pack12 avx2", OSC_ENC_PACK12, &unpack12_avx2},
+    {"delta scalar", OSC_ENC_DELTA, &undelta_scalar},
+    {"delta sse2", OSC_ENC_DELTA, &undelta_sse2},
+};
+#define N_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static bool kernel_usable(const kernel_t *k)
+{
+    if (!*k->fn) return false;
+#if defined(__x86_64__) || defined(__i386__)
+    if (*k->fn == unpack12_avx2) return __builtin_cpu_supports("avx2");
+    if (*k->fn == unpack12_ssse3) return __builtin_cpu_supports("ssse3");
+#endif
+    return true;
+}
+
+static size_t encode(int enc, const uint16_t *src, size_t n, uint8_t *dst)
+{
+    return enc == OSC_ENC_PACK12 ? osc_pack12_encode(src, n, dst) : osc_delta_encode(src, n, dst);
+}
+
+// Все длины 0..300 и полный кадр: распаковка даёт исходные 12 (или 16) бит,
+// кодер на месте пишет то же, что в отдельный буфер, а усечённый поток
+// отвергается
+static int check(int kind, const uint16_t *x)
+{
+    static uint8_t enc_out[N * 3 + 16];
+    static uint16_t inplace[N * 2], out[N + 64];
+    size_t lens[302];
+    for (size_t i = 0; i <= 300; i++) lens[i] = i;
+    lens[301] = N;
+
+    for (size_t li = 0; li < 302; li++) {
+        size_t n = lens[li];
+        for (size_t k = 0; k < N_KERNELS; k++) {
+            const kernel_t *kr = &kernels[k];
+            if (!kernel_usable(kr)) continue;
+            size_t wide = 0;
+            if (kr->enc == OSC_ENC_DELTA) osc_delta_size(x, n, &wide);
+            size_t len = encode(kr->enc, x, n, enc_out);
+            if (kr->enc == OSC_ENC_DELTA && len != osc_delta_size(x, n, NULL)) {
+                fprintf(stderr, "%s: delta_size mismatch n %zu\n", sig_names[kind], n);
+                return 1;
+            }
+            // Прошивка кодирует на месте; для DELTA — только без escape-токенов
+            if (kr->enc == OSC_ENC_PACK12 || wide == 0) {
+                memcpy(inplace, x, n * 2);
+                size_t len2 = encode(kr->enc, inplace, n, (uint8_t *)inplace);
+                if (len2 != len || memcmp(inplace, enc_out, len) != 0) {
+                    fprintf(stderr, "%s %s: in-place encode differs n %zu\n", sig_names[kind], kr->name, n);
+                    return 1;
+                }
+            }
+            memset(out, 0xA5, sizeof(out));
+            if (!(*kr->fn)(enc_out, len, out, n)) {
+                fprintf(stderr, "%s %s: decode failed n %zu\n", sig_names[kind], kr->name, n);
+                return 1;
+            }
+            uint16_t mask = kr->enc == OSC_ENC_PACK12 ? 0x0FFF : 0xFFFF;
+            for (size_t i = 0; i < n; i++) {
+                if (out[i] != (x[i] & mask)) {
+                    fprintf(stderr, "%s %s: n %zu sample %zu: %u != %u\n", sig_names[kind], kr->name, n, i,
+                            out[i], x[i] & mask);
+                    return 1;
+                }
+            }
+            if (out[n] != 0xA5A5) {
+                fprintf(stderr, "%s %s: write past n %zu\n", sig_names[kind], kr->name, n);
+                return 1;
+            }
+            if (n > 0 && (*kr->fn)(enc_out, len - 1, out, n)) {
+                fprintf(stderr, "%s %s: truncated stream accepted n %zu\n", sig_names[kind], kr->name, n);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static uint16_t sig[SIG_COUNT][N];
+    static uint8_t enc_out[N * 3 + 16];
+    static uint16_t out[N];
+
+    __builtin_cpu_init();
+    for (int s = 0; s < SIG_COUNT; s++) {
+        make_signal(s, sig[s], N);
+        if (check(s, sig[s])) return 1;
+    }
+    printf("all kernels match source frames\n");
+
+    for (int s = 0; s < SIG_WIDE; s++) {
+        size_t wide, dsz = osc_delta_size(sig[s], N, &wide);
+        printf("%-6s: u16 %u B, pack12 %zu B (%.2fx), delta %zu B (%.2fx)%s\n", sig_names[s], N * 2,
+               OSC_PACK12_BYTES(N), N * 2.0 / OSC_PACK12_BYTES(N), dsz, N * 2.0 / dsz,
+               wide ? ", escapes" : "");
+        for (size_t k = 0; k < N_KERNELS; k++) {
+            const kernel_t *kr = &kernels[k];
+            if (!kernel_usable(kr)) continue;
+            size_t len = encode(kr->enc, sig[s], N, enc_out);
+            size_t reps = 4000;
+            double t0 = now_s();
+            for (size_t i = 0; i < reps; i++) (*kr->fn)(enc_out, len, out, N);
+            double t = now_s() - t0;
+            printf("    %-14s %6.2f Gsamples/s  %6.2f GB/s out\n", kr->name, N * reps / t / 1e9,
+                   N * 2.0 * reps / t / 1e9);
+        }
+    }
+    return 0;
+}
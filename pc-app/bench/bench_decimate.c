@@ -0,0 +1,126 @@
+// Прореживание min/max для draw_scope: сверка SIMD-ядер со скалярным и
+// время отрисовки кадра 4k/16k/64k отсчётов в Cairo (image surface 640x240):
+// по отрезку на отсчёт (как было) против отрезка на столбец.
+
+#include "../decimate.h"
+
+#include <cairo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define W 640
+#define H 240
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void draw_full(cairo_t *cr, const uint16_t *d, size_t n)
+{
+    cairo_set_source_rgb(cr, 0.05, 0.05, 0.08);
+    cairo_paint(cr);
+    cairo_set_source_rgb(cr, 0.2, 0.7, 0.2);
+    cairo_set_line_width(cr, 1.2);
+    for (size_t i = 0; i < n; i++) {
+        double x = (double)i / (n - 1) * W;
+        double y = H - (d[i] / 4095.0) * H;
+        if (i == 0) cairo_move_to(cr, x, y);
+        else cairo_line_to(cr, x, y);
+    }
+    cairo_stroke(cr);
+}
+
+static void draw_decimated(cairo_t *cr, const uint16_t *d, size_t n, uint16_t *mn, uint16_t *mx)
+{
+    cairo_set_source_rgb(cr, 0.05, 0.05, 0.08);
+    cairo_paint(cr);
+    cairo_set_source_rgb(cr, 0.2, 0.7, 0.2);
+    cairo_set_line_width(cr, 1.0);
+    decimate_minmax(d, n, W, mn, mx);
+    for (int x = 0; x < W; x++) {
+        double y0 = H - (mx[x] / 4095.0) * H;
+        double y1 = H - (mn[x] / 4095.0) * H;
+        if (y1 - y0 < 1.0) y1 = y0 + 1.0;
+        cairo_move_to(cr, x + 0.5, y0);
+        cairo_line_to(cr, x + 0.5, y1);
+    }
+    cairo_stroke(cr);
+}
+
+int main(void)
+{
+    static const size_t sizes[] = {4096, 16384, 65536};
+    uint16_t mn[W], mx[W], rmn[W], rmx[W];
+    uint16_t *d = malloc(65536 * sizeof(uint16_t));
+    uint32_t x = 7;
+
+    for (size_t i = 0; i < 65536; i++) {
+        x = x * 1103515245u + 12345u;
+        d[i] = (uint16_t)(2048 + 1500 * ((i / 97) % 2 ? 1 : -1) / 2 + ((x >> 16) & 63));
+    }
+    // Одиночные выбросы вверх и вниз должны пережить прореживание при любом n
+    d[1234] = 4095;
+    d[3000] = 0;
+
+    static const struct { const char *name; const decimate_span_fn *fn; } kernels[] = {
+        {"scalar", &decimate_span_scalar},
+        {"sse2", &decimate_span_sse2},
+        {"avx2", &decimate_span_avx2},
+    };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        decimate_minmax_with(decimate_span_scalar, d, n, W, rmn, rmx);
+        for (size_t k = 1; k < 3; k++) {
+            if (!*kernels[k].fn) continue;
+            decimate_minmax_with(*kernels[k].fn, d, n, W, mn, mx);
+            for (int c = 0; c < W; c++) {
+                if (mn[c] != rmn[c] || mx[c] != rmx[c]) {
+                    fprintf(stderr, "%s mismatch at n=%zu col=%d\n", kernels[k].name, n, c);
+                    return 1;
+                }
+            }
+        }
+        int seen_hi = 0, seen_lo = 0;
+        for (int c = 0; c < W; c++) {
+            seen_hi |= rmx[c] == 4095;
+            seen_lo |= rmn[c] == 0;
+        }
+        if (!seen_hi || !seen_lo) {
+            fprintf(stderr, "glitch lost at n=%zu\n", n);
+            return 1;
+        }
+    }
+    printf("SIMD kernels match scalar, glitches preserved\n");
+
+    cairo_surface_t *surf = cairo_image_surface_create(CAIRO_FORMAT_RGB24, W, H);
+    cairo_t *cr = cairo_create(surf);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        printf("%6zu pts:", n);
+        for (size_t k = 0; k < 3; k++) {
+            if (!*kernels[k].fn) continue;
+            int reps = (int)(2e8 / n);
+            double t0 = now_s();
+            for (int i = 0; i < reps; i++) decimate_minmax_with(*kernels[k].fn, d, n, W, mn, mx);
+            printf("  %s %6.2f us", kernels[k].name, (now_s() - t0) / reps * 1e6);
+        }
+
+        int reps = 20;
+        double t0 = now_s();
+        for (int i = 0; i < reps; i++) draw_full(cr, d, n);
+        double t_full = (now_s() - t0) / reps;
+        reps = 200;
+        t0 = now_s();
+        for (int i = 0; i < reps; i++) draw_decimated(cr, d, n, mn, mx);
+        double t_dec = (now_s() - t0) / reps;
+        printf("  | draw: per-sample %8.1f us, min/max %7.1f us\n", t_full * 1e6, t_dec * 1e6);
+    }
+    cairo_destroy(cr);
+    cairo_surface_destroy(surf);
+    free(d);
+    return 0;
+}
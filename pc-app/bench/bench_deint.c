@@ -0,0 +1,96 @@
+// Разбор кадра из нескольких каналов: SIMD-ядра сверяются со скалярным на
+// всех длинах 0..200 и всех phase, затем скорость на кадре 8192 отсчёта
+// (2, 3, 4 канала) против копирования одноканального кадра того же размера.
+
+#include "../deinterleave.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define N 8192
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const struct { unsigned nch; const char *name; const deint_fn *fn; const char *isa; } kernels[] = {
+    {2, "sse2", &deint2_sse2, "sse2"},
+    {3, "ssse3", &deint3_ssse3, "ssse3"},
+    {4, "sse2", &deint4_sse2, "sse2"},
+};
+#define N_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static int usable(size_t k)
+{
+    if (!*kernels[k].fn) return 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (!strcmp(kernels[k].isa, "ssse3")) return __builtin_cpu_supports("ssse3");
+#endif
+    return 1;
+}
+
+int main(void)
+{
+    static uint16_t src[N], ref[4][N + 8], out[4][N + 8];
+    uint16_t *rp[4] = {ref[0], ref[1], ref[2], ref[3]};
+    uint16_t *op[4] = {out[0], out[1], out[2], out[3]};
+    uint32_t x = 1;
+    for (size_t i = 0; i < N; i++) {
+        x = x * 1103515245u + 12345u;
+        src[i] = (uint16_t)(x >> 16);
+    }
+
+    __builtin_cpu_init();
+    for (size_t k = 0; k < N_KERNELS; k++) {
+        if (!usable(k)) continue;
+        unsigned nch = kernels[k].nch;
+        for (unsigned phase = 0; phase < nch; phase++) {
+            for (size_t n = 0; n <= 200; n++) {
+                size_t rc[4], oc[4];
+                deinterleave_with(NULL, src, n, nch, phase, rp, rc);
+                memset(out, 0xA5, sizeof(out));
+                deinterleave_with(*kernels[k].fn, src, n, nch, phase, op, oc);
+                for (unsigned c = 0; c < nch; c++) {
+                    if (oc[c] != rc[c] || memcmp(out[c], ref[c], rc[c] * 2) || out[c][rc[c]] != 0xA5A5) {
+                        fprintf(stderr, "%u ch %s mismatch: phase %u n %zu ch %u\n", nch, kernels[k].name, phase,
+                                n, c);
+                        return 1;
+                    }
+                }
+                // Отсчёт i — канал (phase + i) % nch, по порядку
+                size_t seen[4] = {0};
+                for (size_t i = 0; i < n; i++) {
+                    unsigned c = (phase + i) % nch;
+                    if (ref[c][seen[c]++] != src[i]) {
+                        fprintf(stderr, "scalar reference wrong: nch %u phase %u i %zu\n", nch, phase, i);
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    printf("all kernels match scalar, all phases\n");
+
+    size_t reps = 20000;
+    double t0 = now_s();
+    for (size_t r = 0; r < reps; r++) memcpy(out[0], src, sizeof(src));
+    double tc = now_s() - t0;
+    printf("1 ch  memcpy   %6.2f Gsamples/s\n", N * reps / tc / 1e9);
+    for (size_t k = 0; k < N_KERNELS; k++) {
+        unsigned nch = kernels[k].nch;
+        for (int simd = 0; simd < 2; simd++) {
+            if (simd && !usable(k)) continue;
+            deint_fn fn = simd ? *kernels[k].fn : NULL;
+            t0 = now_s();
+            for (size_t r = 0; r < reps; r++) deinterleave_with(fn, src, N, nch, (unsigned)(r % nch), op, NULL);
+            double t = now_s() - t0;
+            printf("%u ch  %-7s %6.2f Gsamples/s\n", nch, simd ? kernels[k].name : "scalar", N * reps / t / 1e9);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,325 @@
+// Сквозной прогон приёма без плат: симулятор платы (devsim.c) на
+// псевдотерминале, приём — тот же osc_reader_run, что в GUI, в своём потоке,
+// кадры забирает поток-потребитель (frameq_next, как послесвечение).
+// Для каждого режима: МБ/с по линии, кадры/с, потери, CPU потока чтения и
+// всего процесса (без симулятора) на МБ. Прогон с ошибками сверяет счётчики
+// приёмника с тем, что внёс симулятор. Прежний цикл чтения (read + сон 1 мс)
+// против epoll: пробуждения в секунду без потока и при 500 кадр/с по 1024
+// точки (кадр — один write() в pty), задержка от write() симулятора до кадра
+// в очереди. Ответ get_osc_status с кадром больше текущего: кольцо приёма
+// растёт, enc_mask из того же ответа не теряется. Переподключение обнуляет
+// счётчики ошибок приёма.
+//
+//   ./bench_e2e [секунд_на_режим]
+
+#include "../devsim.h"
+#include "../reader.h"
+#include "../unpack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_LAT 65536
+
+enum { E2E_ERRORS = 1, E2E_LEGACY = 2, E2E_LATENCY = 4, E2E_IDLE = 8 };
+
+typedef struct {
+    osc_reader_t rd;
+    frameq_t q;
+    _Atomic bool consume;
+    bool legacy;
+    double reader_cpu_s;
+    uint64_t consumed;
+    devsim_t *sim;
+    int64_t lat_us[MAX_LAT];
+    size_t nlat;
+} e2e_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double thread_cpu_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double process_cpu_s(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+// Прежний цикл чтения: неблокирующий read(), пусто — сон 1 мс
+static void legacy_reader_run(osc_reader_t *rd)
+{
+    proto_rx_t *rx = &rd->rx;
+    proto_frame_t f;
+
+    proto_rx_reset(rx);
+    while (atomic_load_explicit(&rd->run, memory_order_relaxed)) {
+        linkstats_on_wakeup(&rd->link);
+        size_t space;
+        uint8_t *dst = proto_rx_write_ptr(rx, &space);
+        ssize_t r = read(rd->fd, dst, space);
+        if (r <= 0) {
+            usleep(1000);
+            continue;
+        }
+        proto_rx_commit(rx, (size_t)r);
+        linkstats_on_read(&rd->link, (size_t)r);
+        while (proto_rx_next(rx, &f)) osc_reader_dispatch(rd, &f);
+        linkstats_sync_rx(&rd->link, rx);
+    }
+}
+
+static void *reader_thread(void *arg)
+{
+    e2e_t *e = arg;
+    double c0 = thread_cpu_s();
+    if (e->legacy) legacy_reader_run(&e->rd);
+    else osc_reader_run(&e->rd);
+    e->reader_cpu_s = thread_cpu_s() - c0;
+    return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+    e2e_t *e = arg;
+    while (atomic_load(&e->consume)) {
+        frameq_wait(&e->q, 10000);
+        const osc_frame_t *fr;
+        while ((fr = frameq_next(&e->q))) {
+            int64_t t = atomic_load_explicit(&e->sim->sent_us[fr->seq], memory_order_acquire);
+            if (e->nlat < MAX_LAT) e->lat_us[e->nlat++] = fr->rx_us - t;
+            e->consumed++;
+        }
+    }
+    return NULL;
+}
+
+// Поток симулятора для учёта его CPU: pthread_getcpuclockid
+static double sim_cpu_s(devsim_t *d)
+{
+    clockid_t cid;
+    struct timespec ts;
+    if (pthread_getcpuclockid(d->thread, &cid) != 0 || clock_gettime(cid, &ts) != 0) return 0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int run(const char *name, const devsim_cfg_t *cfg, double secs, int flags)
+{
+    static devsim_t sim;
+    static e2e_t e;
+    memset(&e, 0, sizeof(e));
+    e.legacy = flags & E2E_LEGACY;
+    e.sim = &sim;
+    if (!devsim_start(&sim, cfg)) {
+        perror("devsim_start");
+        return 1;
+    }
+    if (!osc_reader_init(&e.rd, cfg->points) || !frameq_init(&e.q, 4, OSC_MAX_POINTS)) {
+        fprintf(stderr, "no memory\n");
+        return 1;
+    }
+    e.rd.fd = port_open(sim.path, 115200);
+    if (e.rd.fd < 0) {
+        perror(sim.path);
+        return 1;
+    }
+    atomic_store(&e.rd.out, &e.q);
+    atomic_store(&e.rd.run, true);
+    atomic_store(&e.consume, true);
+    pthread_t rt, ct;
+    pthread_create(&rt, NULL, reader_thread, &e);
+    pthread_create(&ct, NULL, consumer_thread, &e);
+
+    // Команда до потока: ответ get_osc_status разбирает тот же поток чтения
+    uint8_t req[PROTO_HDR_LEN + PROTO_CRC_LEN];
+    if (write(e.rd.fd, req, proto_build(req, 1, PROTO_CMD_OSC_STATUS, NULL, 0)) != (ssize_t)sizeof(req)) {
+        perror("write");
+        return 1;
+    }
+    double p0 = process_cpu_s(), s0 = sim_cpu_s(&sim), t0 = now_s();
+    if (!(flags & E2E_IDLE)) atomic_store(&sim.streaming, true);
+    // Время или cfg.frames; затем ждём, пока приёмник дочитает всё отправленное
+    while (now_s() - t0 < secs && !atomic_load(&sim.done)) usleep(10000);
+    atomic_store(&sim.streaming, false);
+    double t_stop = now_s();
+    for (int quiet = 0; quiet < 5 && now_s() - t_stop < 2.0; usleep(1000)) {
+        quiet = atomic_load(&e.rd.link.bytes) == atomic_load(&sim.bytes_sent) ? quiet + 1 : 0;
+    }
+    double dt = now_s() - t0;
+    double sim_cpu = sim_cpu_s(&sim) - s0;
+    osc_reader_cancel(&e.rd);
+    pthread_join(rt, NULL);
+    atomic_store(&e.consume, false);
+    pthread_join(ct, NULL);
+    double proc_cpu = process_cpu_s() - p0 - sim_cpu;
+    devsim_stop(&sim);
+
+    linkstats_t *ls = &e.rd.link;
+    uint64_t bytes = atomic_load(&ls->bytes), frames = atomic_load(&ls->frames);
+    uint64_t sent = atomic_load(&sim.frames_sent), sent_bytes = atomic_load(&sim.bytes_sent);
+    uint64_t crc_inj = atomic_load(&sim.crc_injected), drop_inj = atomic_load(&sim.drop_injected);
+    uint64_t lost = atomic_load(&ls->seq_lost);
+    uint64_t qdrop = atomic_load(&e.q.dropped);
+    double wps = atomic_load(&ls->wakeups) / dt;
+    double mb = bytes / 1e6;
+    if (flags & E2E_IDLE) {
+        printf("%-22s %7.0f wakeups/s, reader CPU %.2f%%\n", name, wps, e.reader_cpu_s / dt * 100);
+    } else if (flags & E2E_LATENCY) {
+        qsort(e.lat_us, e.nlat, sizeof(e.lat_us[0]), cmp_i64);
+        double sum = 0;
+        for (size_t i = 0; i < e.nlat; i++) sum += e.lat_us[i];
+        printf("%-22s %7.0f wakeups/s, latency avg %.0f us, p50 %lld us, p99 %lld us, reader CPU %.2f%%\n", name,
+               wps, e.nlat ? sum / e.nlat : 0, e.nlat ? (long long)e.lat_us[e.nlat / 2] : 0,
+               e.nlat ? (long long)e.lat_us[e.nlat * 99 / 100] : 0, e.reader_cpu_s / dt * 100);
+    } else {
+        printf("%-22s %7.1f MB/s %7.0f fr/s  lost %llu (seq) + %llu (queue)  reader %.2f ms/MB  process %.2f ms/MB\n",
+               name, mb / dt, frames / dt, (unsigned long long)lost, (unsigned long long)qdrop,
+               e.reader_cpu_s * 1e3 / mb, proc_cpu * 1e3 / mb);
+    }
+
+    int rc = 0;
+    if (bytes != sent_bytes) {
+        fprintf(stderr, "  read %llu of %llu bytes sent\n", (unsigned long long)bytes, (unsigned long long)sent_bytes);
+        rc = 1;
+    }
+    if (frames + crc_inj != sent || atomic_load(&e.rd.rejected_size)) {
+        fprintf(stderr, "  %llu frames parsed, %llu sent, %llu corrupted, %llu rejected\n",
+                (unsigned long long)frames, (unsigned long long)sent, (unsigned long long)crc_inj,
+                (unsigned long long)atomic_load(&e.rd.rejected_size));
+        rc = 1;
+    }
+    if (e.consumed + qdrop != frames) {
+        fprintf(stderr, "  consumer got %llu + %llu dropped of %llu\n", (unsigned long long)e.consumed,
+                (unsigned long long)qdrop, (unsigned long long)frames);
+        rc = 1;
+    }
+    if (atomic_load(&e.rd.enc_mask) != 7 || atomic_load(&sim.commands) != 1) {
+        fprintf(stderr, "  no get_osc_status reply\n");
+        rc = 1;
+    }
+    if (flags & E2E_ERRORS) {
+        // Разрыв seq — выброшенные и битые кадры; пропущенные байты — мусор
+        // и битые кадры целиком (в u16-отсчётах ложного sync не бывает)
+        uint64_t skipped = atomic_load(&ls->skipped_bytes);
+        uint64_t want_skip = atomic_load(&sim.garbage_bytes) + atomic_load(&sim.crc_bytes);
+        printf("  injected: crc %llu, drop %llu, garbage %llu B; seen: crc %llu, seq lost %llu, skipped %llu B\n",
+               (unsigned long long)crc_inj, (unsigned long long)drop_inj,
+               (unsigned long long)atomic_load(&sim.garbage_bytes), (unsigned long long)atomic_load(&ls->crc_errors),
+               (unsigned long long)lost, (unsigned long long)skipped);
+        if (atomic_load(&ls->crc_errors) != crc_inj || lost != crc_inj + drop_inj || skipped != want_skip) {
+            fprintf(stderr, "  error counters do not match injected errors\n");
+            rc = 1;
+        }
+    } else if (lost || atomic_load(&ls->crc_errors) || atomic_load(&ls->skipped_bytes)) {
+        fprintf(stderr, "  clean stream reported errors\n");
+        rc = 1;
+    }
+    close(e.rd.fd);
+    osc_reader_free(&e.rd);
+    frameq_free(&e.q);
+    return rc;
+}
+
+// Рост кольца приёма освобождает старое — payload ответа после него не читать
+static int check_status_grow(void)
+{
+    static osc_reader_t rd;
+    uint8_t p[13] = {0}, frame[64];
+    uint16_t points = 32000;
+    p[10] = points & 0xFF;
+    p[11] = points >> 8;
+    p[12] = 0x07;
+    if (!osc_reader_init(&rd, 16384)) return 1;
+    size_t n = proto_build(frame, 1, PROTO_CMD_OSC_STATUS | PROTO_RESP, p, sizeof(p));
+    proto_frame_t f;
+    proto_rx_feed(&rd.rx, frame, n);
+    while (proto_rx_next(&rd.rx, &f)) osc_reader_dispatch(&rd, &f);
+    int rc = rd.max_points != points || atomic_load(&rd.enc_mask) != 0x07;
+    printf("osc_status, frame %u points over 16384: ring grown, enc_mask %s\n", points, rc ? "lost" : "kept");
+    osc_reader_free(&rd);
+    return rc;
+}
+
+// Переподключение: linkstats_reset и новый сеанс приёма (proto_rx_reset в
+// osc_reader_run) — ошибки прежнего сеанса не возвращаются
+static int check_reconnect(void)
+{
+    static osc_reader_t rd;
+    uint8_t frame[64], junk[5] = {1, 2, 3, 4, 5};
+    if (!osc_reader_init(&rd, 1024)) return 1;
+    size_t n = proto_build(frame, 1, PROTO_CMD_OSC_STATUS, NULL, 0);
+    proto_frame_t f;
+    frame[n - 1] ^= 0xFF;
+    proto_rx_feed(&rd.rx, junk, sizeof(junk));
+    proto_rx_feed(&rd.rx, frame, n);
+    while (proto_rx_next(&rd.rx, &f)) osc_reader_dispatch(&rd, &f);
+    linkstats_sync_rx(&rd.link, &rd.rx);
+    uint64_t crc0 = atomic_load(&rd.link.crc_errors), skip0 = atomic_load(&rd.link.skipped_bytes);
+
+    linkstats_reset(&rd.link);
+    proto_rx_reset(&rd.rx);
+    frame[n - 1] ^= 0xFF;
+    proto_rx_feed(&rd.rx, frame, n);
+    while (proto_rx_next(&rd.rx, &f)) osc_reader_dispatch(&rd, &f);
+    linkstats_sync_rx(&rd.link, &rd.rx);
+    uint64_t crc1 = atomic_load(&rd.link.crc_errors), skip1 = atomic_load(&rd.link.skipped_bytes);
+    int rc = !crc0 || !skip0 || crc1 || skip1 || atomic_load(&rd.link.bad_headers);
+    printf("reconnect: crc %llu, skipped %llu B before reset; after: crc %llu, skipped %llu B\n",
+           (unsigned long long)crc0, (unsigned long long)skip0, (unsigned long long)crc1, (unsigned long long)skip1);
+    osc_reader_free(&rd);
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    double secs = argc > 1 ? atof(argv[1]) : 2.0;
+    crc16_init();
+
+    static const struct { const char *name; uint8_t enc; uint8_t nch; } modes[] = {
+        {"u16, 1 ch", OSC_ENC_RAW16, 1},
+        {"pack12, 1 ch", OSC_ENC_PACK12, 1},
+        {"delta, 1 ch", OSC_ENC_DELTA, 1},
+        {"u16, 4 ch", OSC_ENC_RAW16, 4},
+    };
+    int rc = check_status_grow() | check_reconnect();
+    printf("max rate, 8192 points:\n");
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        devsim_cfg_t cfg = {.points = 8192, .enc = modes[i].enc, .nch = modes[i].nch};
+        rc |= run(modes[i].name, &cfg, secs, false);
+    }
+
+    printf("1000 frames/s, 8192 points, u16, 1%% crc / drop / garbage:\n");
+    devsim_cfg_t cfg = {.points = 8192, .rate = 1000, .frames = (uint64_t)(secs * 1000),
+                        .crc_ppm = 10000, .drop_ppm = 10000, .garbage_ppm = 10000};
+    rc |= run("errors", &cfg, secs + 1, E2E_ERRORS);
+
+    printf("read loop: sleep 1 ms vs epoll\n");
+    devsim_cfg_t idle = {.points = 8192};
+    rc |= run("idle, sleep 1 ms", &idle, 1.0, E2E_IDLE | E2E_LEGACY);
+    rc |= run("idle, epoll", &idle, 1.0, E2E_IDLE);
+    devsim_cfg_t paced = {.points = 1024, .rate = 500};
+    rc |= run("500 fr/s, sleep 1 ms", &paced, secs, E2E_LATENCY | E2E_LEGACY);
+    rc |= run("500 fr/s, epoll", &paced, secs, E2E_LATENCY);
+    return rc;
+}
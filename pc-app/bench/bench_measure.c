@@ -0,0 +1,178 @@
+// Измерения (measure.c): SIMD-ядра против скалярного (результат бит в бит),
+// точность на синусе и на меандре с наклонными фронтами и шумом против
+// известных значений, и цена кадра 1k/4k/16k по ядрам — какая доля одного
+// ядра уходит на измерения при 500 кS/s.
+
+#include "../measure.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FS 500000.0
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const meas_kernels_t *kernels[] = {&meas_scalar, &meas_sse2, &meas_avx2};
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static uint32_t rnd = 1;
+
+static int noise(int amp)
+{
+    rnd = rnd * 1103515245u + 12345u;
+    return (int)((rnd >> 16) % (2u * amp + 1)) - amp;
+}
+
+static uint16_t clamp12(double v)
+{
+    return (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : lround(v));
+}
+
+// Меандр: период p отсчётов, доля верха duty, фронты линейные по edge
+// отсчётов (по уровню 50 % — ровно duty)
+static void make_square(uint16_t *x, uint32_t n, double p, double duty, double edge, int nz)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        double ph = fmod(i + 0.37, p);
+        double up = ph < edge / 2 ? 0.5 + ph / edge : ph < duty * p - edge / 2 ? 1.0
+                  : ph < duty * p + edge / 2 ? 0.5 - (ph - duty * p) / edge
+                  : ph < p - edge / 2 ? 0.0 : (ph - p) / edge + 0.5;
+        x[i] = clamp12(400 + 3000 * up + noise(nz));
+    }
+}
+
+static int check_same(void)
+{
+    static const uint32_t sizes[] = {1, 2, 7, 15, 16, 17, 1000, 4099, 16384};
+    static uint16_t x[16384];
+    int rc = 0;
+    for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+        uint32_t n = sizes[z];
+        for (int form = 0; form < 3; form++) {
+            if (form == 0) {
+                for (uint32_t i = 0; i < n; i++) x[i] = (uint16_t)(rnd = rnd * 1103515245u + 12345u) >> 4;
+            } else if (form == 1) {
+                make_square(x, n, 97.3, 0.3, 6, 40);
+            } else {
+                for (uint32_t i = 0; i < n; i++) x[i] = (uint16_t)(0xFFFF - (i * 7919u) % 3000u);
+            }
+            meas_t ref, m;
+            measure_with(&meas_scalar, x, n, &ref);
+            for (size_t k = 1; k < NKERNELS; k++) {
+                if (!kernels[k]->reduce) continue;
+                measure_with(kernels[k], x, n, &m);
+                if (memcmp(&m, &ref, sizeof(m))) {
+                    fprintf(stderr, "  %s differs from scalar: n=%u form %d\n", kernels[k]->name, n, form);
+                    rc = 1;
+                }
+            }
+        }
+    }
+    printf("kernels vs scalar: %s\n", rc ? "MISMATCH" : "identical");
+    return rc;
+}
+
+static int near(const char *what, double got, double want, double tol)
+{
+    bool ok = fabs(got - want) <= tol;
+    printf("  %-10s %12.4f (want %12.4f)%s\n", what, got, want, ok ? "" : "  <-- FAIL");
+    return !ok;
+}
+
+static int check_sine(void)
+{
+    enum { N = 16384 };
+    static uint16_t x[N];
+    const double f = 1234.5, a = 1800, mid = 2048;
+    double sum = 0, sum2 = 0;
+    for (uint32_t i = 0; i < N; i++) {
+        x[i] = clamp12(mid + a * sin(2 * M_PI * f * i / FS) + noise(3));
+        sum += x[i];
+        sum2 += (double)x[i] * x[i];
+    }
+    meas_t m;
+    measure(x, N, &m);
+    double mean = sum / N;
+    // 10–90 % синуса: от -0.8 до 0.8 амплитуды
+    double rise = 2 * asin(0.8) / (2 * M_PI * f) * FS;
+    printf("sine %.1f Hz, %.0f codes peak, noise +-3:\n", f, a);
+    int rc = 0;
+    rc |= near("vpp", m.max - m.min, 2 * a, 8);
+    rc |= near("mean", m.mean, mean, 1e-3);
+    rc |= near("rms", m.rms, sqrt(sum2 / N), 1e-2);
+    rc |= near("ac_rms", m.ac_rms, a / sqrt(2), 2);
+    rc |= near("freq", FS / m.period, f, f * 1e-4);
+    rc |= near("duty", m.duty, 0.5, 0.005);
+    rc |= near("rise", m.rise, rise, rise * 0.01);
+    rc |= near("fall", m.fall, rise, rise * 0.01);
+    return rc;
+}
+
+static int check_square(void)
+{
+    enum { N = 16384 };
+    static uint16_t x[N];
+    const double p = 250.7, duty = 0.3, edge = 20;
+    make_square(x, N, p, duty, edge, 60);
+    meas_t m;
+    measure(x, N, &m);
+    printf("square %.1f Hz, duty %.2f, edges %.0f samples, noise +-60 codes:\n", FS / p, duty, edge);
+    int rc = 0;
+    rc |= near("freq", FS / m.period, FS / p, FS / p * 1e-3);
+    rc |= near("duty", m.duty, duty, 0.01);
+    rc |= near("rise", m.rise, edge * 0.8, 1.0);
+    rc |= near("fall", m.fall, edge * 0.8, 1.0);
+    rc |= near("edges", m.edges, 2 * floor(N / p), 2);
+    // Постоянное напряжение с шумом — ни фронтов, ни частоты
+    for (uint32_t i = 0; i < N; i++) x[i] = clamp12(1500 + noise(8));
+    measure(x, N, &m);
+    printf("dc with noise +-8: edges %u, period %.1f\n", m.edges, m.period);
+    if (m.edges || m.period != 0) rc = 1;
+    return rc;
+}
+
+static void bench(void)
+{
+    static const uint32_t sizes[] = {1024, 4096, 16384};
+    static uint16_t sq[16384], sn[16384];
+    make_square(sq, 16384, 61.3, 0.5, 2, 4);
+    for (uint32_t i = 0; i < 16384; i++) sn[i] = clamp12(2048 + 1500 * sin(i * 0.01) + noise(4));
+    for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+        uint32_t n = sizes[z];
+        for (size_t k = 0; k < NKERNELS; k++) {
+            if (!kernels[k]->reduce) continue;
+            double dt[2];
+            const uint16_t *src[2] = {sn, sq};
+            for (int s = 0; s < 2; s++) {
+                meas_t m;
+                unsigned iters = 200u * 16384 / n;
+                double t0 = now_s();
+                for (unsigned it = 0; it < iters; it++) measure_with(kernels[k], src[s], n, &m);
+                dt[s] = (now_s() - t0) / iters;
+            }
+            // 500 кS/s кадрами по n: доля одного ядра на худшем сигнале
+            double worst = dt[0] > dt[1] ? dt[0] : dt[1];
+            printf("N=%-5u %-6s sine %6.2f us, square %6.2f us per frame -> %.3f%% of a core at 500 kS/s\n",
+                   n, kernels[k]->name, dt[0] * 1e6, dt[1] * 1e6, worst * FS / n * 100);
+        }
+    }
+}
+
+int main(void)
+{
+    int rc = 0;
+    rc |= check_same();
+    rc |= check_sine();
+    rc |= check_square();
+    bench();
+    return rc;
+}
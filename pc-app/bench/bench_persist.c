@@ -0,0 +1,130 @@
+// Послесвечение (persist.c): SSE2-ядра строк и затухания сверяются со
+// скалярным хвостом того же ядра (вызов по одному отсчёту идёт только
+// через него) на нечётных длинах, maxv 4095 и 65535, сдвигах 1..8; затем
+// кадров/с у persist_accumulate на 4k/16k отсчётов в поле 640x240 и доля
+// в нём persist_rows (остальное — скалярная раскладка попаданий).
+
+#include "../persist.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define W 640
+#define H 240
+#define N_MAX 16384
+
+static uint32_t rnd_x = 99;
+
+static uint32_t rnd(void)
+{
+    rnd_x = rnd_x * 1103515245u + 12345u;
+    return rnd_x >> 8;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int check_rows(void)
+{
+    static uint16_t src[N_MAX], out[N_MAX + 1], ref[N_MAX];
+    static const uint16_t maxvs[] = {4095, 65535};
+    static const int hs[] = {2, 240, 1081};
+    static const uint32_t lens[] = {1, 7, 9, 15, 17, 63, 255, 4097, N_MAX - 1};
+    for (size_t m = 0; m < sizeof(maxvs) / sizeof(maxvs[0]); m++) {
+        // Выше maxv тоже: отсчёт прижимается к верхней строке
+        for (uint32_t i = 0; i < N_MAX; i++) src[i] = (uint16_t)(rnd() % ((uint32_t)maxvs[m] + 200));
+        src[0] = 0;
+        src[1] = maxvs[m];
+        src[2] = 0xFFFF;
+        for (size_t k = 0; k < sizeof(hs) / sizeof(hs[0]); k++) {
+            for (uint32_t i = 0; i < N_MAX; i++) persist_rows(src + i, 1, maxvs[m], hs[k], ref + i);
+            for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+                for (uint32_t off = 0; off < 2; off++) {
+                    uint32_t n = lens[l] - off;
+                    out[n] = 0xA5A5;
+                    persist_rows(src + off, n, maxvs[m], hs[k], out);
+                    if (memcmp(out, ref + off, n * sizeof(uint16_t)) || out[n] != 0xA5A5) {
+                        fprintf(stderr, "persist_rows: maxv %u, h %d, n %u, offset %u differs from scalar\n",
+                                maxvs[m], hs[k], n, off);
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int check_decay(void)
+{
+    static uint16_t src[N_MAX], out[N_MAX + 1], ref[N_MAX];
+    static const uint32_t lens[] = {1, 7, 9, 15, 17, 63, 255, 4097, N_MAX - 1};
+    for (uint32_t i = 0; i < N_MAX; i++) {
+        uint32_t r = rnd();
+        src[i] = (uint16_t)(r % 4 == 0 ? 0 : r % 4 == 1 ? r % 8 : r >> 4);
+    }
+    src[0] = 0xFFFF;
+    src[1] = 1;
+    for (uint8_t shift = 1; shift <= 8; shift++) {
+        memcpy(ref, src, sizeof(ref));
+        for (uint32_t i = 0; i < N_MAX; i++) persist_decay(ref + i, 1, shift);
+        for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+            for (uint32_t off = 0; off < 2; off++) {
+                uint32_t n = lens[l] - off;
+                memcpy(out, src + off, n * sizeof(uint16_t));
+                out[n] = 0xA5A5;
+                persist_decay(out, n, shift);
+                if (memcmp(out, ref + off, n * sizeof(uint16_t)) || out[n] != 0xA5A5) {
+                    fprintf(stderr, "persist_decay: shift %u, n %u, offset %u differs from scalar\n", shift, n, off);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int rc = check_rows() | check_decay();
+    if (rc) return rc;
+    printf("SSE2 rows (maxv 4095/65535) and decay (shift 1..8) match scalar, odd lengths\n");
+
+    static uint16_t frame[N_MAX], rows[N_MAX];
+    static persist_t p;
+    persist_init(&p);
+    atomic_store(&p.want_w, W);
+    atomic_store(&p.want_h, H);
+    static const uint32_t sizes[] = {4096, 16384};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint32_t n = sizes[s];
+        // Синус в 3 периода с шумом и меандр поверх — есть и крутые фронты
+        for (uint32_t i = 0; i < n; i++) {
+            double v = 2048 + 1200 * sin(6 * M_PI * i / n) + ((i / 512) % 2 ? 400 : -400);
+            frame[i] = (uint16_t)(v + (int)(rnd() % 33) - 16);
+        }
+        persist_clear(&p);
+        int reps = (int)(2e8 / n);
+        double t0 = now_s();
+        for (int i = 0; i < reps; i++) persist_accumulate(&p, frame, n, 4095);
+        double t_acc = (now_s() - t0) / reps;
+        t0 = now_s();
+        for (int i = 0; i < reps; i++) persist_rows(frame, n, 4095, H, rows);
+        double t_rows = (now_s() - t0) / reps;
+        printf("%6u pts: accumulate %7.1f us (%8.0f frames/s), of it rows %5.1f us\n", n, t_acc * 1e6, 1 / t_acc,
+               t_rows * 1e6);
+    }
+    int reps = 2000;
+    double t0 = now_s();
+    for (int i = 0; i < reps; i++) persist_render(&p);
+    printf("render %dx%d (decay + colour): %.1f us\n", W, H, (now_s() - t0) / reps * 1e6);
+    persist_free(&p);
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Бенчмарк разбора входящего потока: новое кольцо (proto.c) против старого
+// плоского буфера с memmove. Поток — синтетические кадры OSC_DATA, с
+// вставками мусора и битыми CRC, либо записанный поток из файла.
+//
+//   ./bench_proto [записанный_поток.bin]
+
+#include "../proto.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHUNK 4096 // столько обычно отдаёт один read()
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t rng = 12345;
+static uint32_t rnd(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Поток из n_frames кадров по ns отсчётов; garbage — доля мусора между
+// кадрами (в процентах), в мусоре много 0x55, чтобы нагрузить ресинхронизацию
+static uint8_t *make_stream(size_t n_frames, uint16_t ns, unsigned garbage, size_t *out_len, size_t *good)
+{
+    size_t frame_max = PROTO_HDR_LEN + 9 + ns * 2 + PROTO_CRC_LEN;
+    size_t cap = n_frames * (frame_max * (100 + garbage * 2) / 100 + 64);
+    uint8_t *s = malloc(cap);
+    uint8_t payload[9 + 0xFFFF];
+    size_t len = 0;
+    *good = 0;
+
+    for (size_t i = 0; i < n_frames; i++) {
+        uint32_t fs = 500000;
+        memcpy(payload, &fs, 4);
+        payload[4] = 0;
+        memcpy(payload + 5, &ns, 2);
+        memset(payload + 7, 0, 2);
+        for (uint16_t k = 0; k < ns; k++) {
+            uint16_t v = (uint16_t)(2048 + (k * 37 + i) % 1024);
+            memcpy(payload + 9 + k * 2, &v, 2);
+        }
+        size_t n = proto_build(s + len, (uint16_t)i, PROTO_CMD_OSC_DATA, payload, (uint16_t)(9 + ns * 2));
+        if (garbage && rnd() % 100 < garbage) {
+            s[len + PROTO_HDR_LEN + 20] ^= 0x5A; // битый CRC
+        } else {
+            (*good)++;
+        }
+        len += n;
+        if (garbage) {
+            size_t g = rnd() % (frame_max * garbage / 100 + 1);
+            for (size_t k = 0; k < g; k++) s[len++] = (rnd() & 3) ? PROTO_SYNC0 : (uint8_t)rnd();
+        }
+    }
+    *out_len = len;
+    return s;
+}
+
+// Прежний разбор из osc_reader_thread: плоский буфер и memmove
+static size_t legacy_parse(const uint8_t *stream, size_t len)
+{
+    static uint8_t buf[8192];
+    size_t have = 0, frames = 0, off = 0;
+
+    while (off < len) {
+        size_t r = len - off;
+        if (r > CHUNK) r = CHUNK;
+        if (r > sizeof(buf) - have) r = sizeof(buf) - have;
+        memcpy(buf + have, stream + off, r);
+        off += r;
+        have += r;
+
+        size_t pos = 0;
+        while (have >= 8) {
+            if (!(buf[pos] == 0x55 && buf[pos + 1] == 0xAA)) { pos++; have--; continue; }
+            if (pos > 0) { memmove(buf, buf + pos, have); pos = 0; }
+            if (have < 8) break;
+            uint8_t ver = buf[2];
+            uint16_t l = buf[6] | (buf[7] << 8);
+            if (ver != 1) { memmove(buf, buf + 2, have - 2); have -= 2; continue; }
+            size_t frame_len = 8 + l + 2;
+            if (frame_len > sizeof(buf)) { memmove(buf, buf + 2, have - 2); have -= 2; continue; }
+            if (have < frame_len) break;
+            uint16_t crc_calc = crc16_ibm(&buf[2], 6 + l);
+            uint16_t crc_rx = buf[8 + l] | (buf[9 + l] << 8);
+            if (crc_calc != crc_rx) {
+                memmove(buf, buf + 2, have - 2);
+                have -= 2;
+                continue;
+            }
+            frames++;
+            memmove(buf, buf + frame_len, have - frame_len);
+            have -= frame_len;
+        }
+        if (pos > 0) memmove(buf, buf + pos, have);
+    }
+    return frames;
+}
+
+static size_t ring_parse(proto_rx_t *rx, const uint8_t *stream, size_t len)
+{
+    proto_frame_t f;
+    size_t frames = 0, off = 0;
+
+    proto_rx_reset(rx);
+    while (off < len) {
+        size_t r = len - off;
+        if (r > CHUNK) r = CHUNK;
+        off += proto_rx_feed(rx, stream + off, r);
+        while (proto_rx_next(rx, &f)) frames++;
+    }
+    return frames;
+}
+
+static void run(const char *name, const uint8_t *s, size_t len, size_t expect, int legacy)
+{
+    proto_rx_t rx;
+    if (!proto_rx_init(&rx, PROTO_MAX_FRAME * 2)) {
+        fprintf(stderr, "proto_rx_init failed\n");
+        exit(1);
+    }
+    int reps = (int)(256e6 / len) + 1;
+
+    double t0 = now_s();
+    size_t frames = 0;
+    for (int i = 0; i < reps; i++) frames = ring_parse(&rx, s, len);
+    double t_ring = now_s() - t0;
+    if (expect && frames != expect) {
+        fprintf(stderr, "%s: ring parser got %zu frames, expected %zu\n", name, frames, expect);
+        exit(1);
+    }
+    printf("%-22s ring   : %8.1f MB/s %10.0f frames/s (%zu frames, crc err %llu)\n", name,
+           len * reps / t_ring / 1e6, frames * reps / t_ring, frames,
+           (unsigned long long)rx.crc_errors);
+
+    if (legacy) {
+        t0 = now_s();
+        size_t lf = 0;
+        for (int i = 0; i < reps; i++) lf = legacy_parse(s, len);
+        double t_leg = now_s() - t0;
+        printf("%-22s memmove: %8.1f MB/s %10.0f frames/s (%zu frames)\n", name,
+               len * reps / t_leg / 1e6, lf * reps / t_leg, lf);
+    }
+    proto_rx_free(&rx);
+}
+
+int main(int argc, char **argv)
+{
+    crc16_init();
+    if (argc > 1) {
+        FILE *fp = fopen(argv[1], "rb");
+        if (!fp) {
+            perror(argv[1]);
+            return 1;
+        }
+        fseek(fp, 0, SEEK_END);
+        long n = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        uint8_t *s = malloc((size_t)n);
+        if (fread(s, 1, (size_t)n, fp) != (size_t)n) {
+            perror(argv[1]);
+            return 1;
+        }
+        fclose(fp);
+        run("recorded", s, (size_t)n, 0, 1);
+        free(s);
+        return 0;
+    }
+
+    static const struct { const char *name; uint16_t ns; unsigned garbage; } cases[] = {
+        {"clean 2048 pts", 2048, 0},
+        {"clean 16384 pts", 16384, 0},
+        {"garbage 5% 2048 pts", 2048, 5},
+        {"garbage 30% 2048 pts", 2048, 30},
+        {"garbage 30% 16384 pts", 16384, 30},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t len, good;
+        uint8_t *s = make_stream(64, cases[i].ns, cases[i].garbage, &len, &good);
+        // старый разбор не вмещает кадры больше 8 КБ — сравниваем только малые
+        run(cases[i].name, s, len, good, cases[i].ns <= 2048);
+        free(s);
+    }
+    return 0;
+}
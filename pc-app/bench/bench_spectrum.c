@@ -0,0 +1,187 @@
+// Спектр (spectrum.c): ядра БПФ против прямого ДПФ в double на кадре из
+// шума, точность маркеров на синусе между бинами (частота и уровень по
+// каждому окну), удержание пиков, и время кадра 1k/4k/16k по ядрам —
+// сколько кадров в секунду держит поток спектра.
+
+#include "../spectrum.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char *win_name[SPEC_WIN_COUNT] = {"hann", "blackman", "flat-top"};
+
+// Прямое ДПФ окна в double: амплитуда^2 в масштабе spectrum_power_with
+static double dft_pow(const uint16_t *x, const float *w, uint32_t n, uint32_t k, double scale)
+{
+    double re = 0, im = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        double a = 2 * M_PI * (double)k * i / n;
+        re += x[i] * (double)w[i] * cos(a);
+        im -= x[i] * (double)w[i] * sin(a);
+    }
+    double p = (re * re + im * im) * scale;
+    return k == 0 || k == n / 2 ? p * 0.25 : p;
+}
+
+static int check_fft(void)
+{
+    static const struct { const char *name; const spec_fft_fn *fn; } kernels[] = {
+        {"scalar", &spec_fft_scalar},
+        {"sse2", &spec_fft_sse2},
+        {"avx2", &spec_fft_avx2},
+    };
+    enum { N = 1024 };
+    static uint16_t x[N];
+    static spectrum_t s;
+    static double ref[N / 2 + 1];
+    int rc = 0;
+    uint32_t r = 1;
+    for (uint32_t i = 0; i < N; i++) {
+        r = r * 1103515245u + 12345u;
+        x[i] = (uint16_t)(2048 + 900 * sin(2 * M_PI * 37.3 * i / N) + ((r >> 16) & 511) - 256);
+    }
+    spectrum_init(&s);
+    spectrum_plan(&s, N, SPEC_WIN_HANN);
+    double peak = 0;
+    for (uint32_t k = 0; k <= N / 2; k++) {
+        ref[k] = dft_pow(x, s.w, N, k, s.amp_scale);
+        if (ref[k] > peak) peak = ref[k];
+    }
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (!*kernels[i].fn) continue;
+        spectrum_power_with(&s, *kernels[i].fn, x);
+        // Ошибка — относительно самого сильного бина (float против double)
+        double worst = 0;
+        for (uint32_t k = 0; k <= N / 2; k++) {
+            double e = fabs(s.pow[k] - ref[k]) / peak;
+            if (e > worst) worst = e;
+        }
+        printf("fft %-6s vs DFT, N=%u: max error %.2e of peak power\n", kernels[i].name, N, worst);
+        if (worst > 1e-5) rc = 1;
+    }
+    spectrum_free(&s);
+    return rc;
+}
+
+// Синус с амплитудой a кодов на частоте f: маркер 1 должен найти его
+static int check_markers(void)
+{
+    enum { N = 16384 };
+    static uint16_t x[N];
+    static spectrum_t s;
+    const uint32_t fs = 500000;
+    const double f = 12345.678, amp = 1500;
+    // Допуск уровня: у flat-top плоская вершина, у остальных остаток
+    // «гребешка» после параболы
+    static const double tol_db[SPEC_WIN_COUNT] = {0.5, 0.4, 0.05};
+    int rc = 0;
+    for (uint32_t i = 0; i < N; i++) {
+        double v = 2048 + amp * sin(2 * M_PI * f * i / fs) + 40 * sin(2 * M_PI * 3 * f * i / fs);
+        x[i] = (uint16_t)lround(v);
+    }
+    for (int w = 0; w < SPEC_WIN_COUNT; w++) {
+        spectrum_init(&s);
+        atomic_store(&s.want_win, w);
+        spectrum_process(&s, x, N, fs, 12);
+        spectrum_publish(&s);
+        const spec_out_t *o = spectrum_front(&s);
+        double want_db = 20 * log10(amp / 2048), bin = (double)fs / N;
+        if (!o || o->nmk < 2) {
+            fprintf(stderr, "  %s: %u markers\n", win_name[w], o ? o->nmk : 0);
+            rc = 1;
+            spectrum_free(&s);
+            continue;
+        }
+        double df = fabs(o->mk[0].freq_hz - f) / bin, dl = o->mk[0].level - want_db;
+        double df3 = fabs(o->mk[1].freq_hz - 3 * f) / bin, dl3 = o->mk[1].level - 20 * log10(40 / 2048.0);
+        printf("marker %-9s f %.3f Hz (%.3f bin off), %.2f dBFS (%+.3f dB); 3rd harmonic %+.2f dB, %.3f bin off\n",
+               win_name[w], o->mk[0].freq_hz, df, o->mk[0].level, dl, dl3, df3);
+        if (df > 0.1 || fabs(dl) > tol_db[w] || df3 > 0.2 || fabs(dl3) > tol_db[w] + 0.5) rc = 1;
+        spectrum_free(&s);
+    }
+    return rc;
+}
+
+// Удержание: синус ушёл — пик остаётся; сброс — пропадает
+static int check_hold(void)
+{
+    enum { N = 4096 };
+    static uint16_t a[N], b[N];
+    static spectrum_t s;
+    for (uint32_t i = 0; i < N; i++) {
+        a[i] = (uint16_t)lround(2048 + 1000 * sin(2 * M_PI * 200.25 * i / N));
+        b[i] = 2048 + (i & 1);
+    }
+    spectrum_init(&s);
+    atomic_store(&s.want_hold, true);
+    spectrum_process(&s, a, N, 100000, 12);
+    spectrum_process(&s, b, N, 100000, 12);
+    spectrum_publish(&s);
+    const spec_out_t *o = spectrum_front(&s);
+    float held = o->peak[200], now = o->mag[200];
+    atomic_store(&s.want_reset, true);
+    spectrum_process(&s, b, N, 100000, 12);
+    spectrum_publish(&s);
+    o = spectrum_front(&s);
+    printf("peak hold: bin 200 held %.1f dBFS, now %.1f dBFS, after reset %.1f dBFS\n", held, now, o->peak[200]);
+    int rc = held < -7 || now > -100 || o->peak[200] > -100;
+    spectrum_free(&s);
+    return rc;
+}
+
+static void bench(void)
+{
+    static const uint32_t sizes[] = {1024, 4096, 16384};
+    static const struct { const char *name; const spec_fft_fn *fn; } kernels[] = {
+        {"scalar", &spec_fft_scalar},
+        {"sse2", &spec_fft_sse2},
+        {"avx2", &spec_fft_avx2},
+    };
+    static uint16_t x[SPEC_MAX_N];
+    static spectrum_t s;
+    uint32_t r = 3;
+    for (uint32_t i = 0; i < SPEC_MAX_N; i++) {
+        r = r * 1103515245u + 12345u;
+        x[i] = (uint16_t)(2048 + 1500 * sin(i * 0.01) + ((r >> 16) & 255));
+    }
+    for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+        uint32_t n = sizes[z];
+        for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+            if (!*kernels[i].fn) continue;
+            spectrum_init(&s);
+            spectrum_plan(&s, n, SPEC_WIN_BLACKMAN);
+            s.fft = *kernels[i].fn;
+            unsigned iters = 50u * SPEC_MAX_N / n;
+            double t0 = now_s();
+            for (unsigned it = 0; it < iters; it++) spectrum_process(&s, x, n, 500000, 12);
+            double fft_dt = (now_s() - t0) / iters;
+            t0 = now_s();
+            for (unsigned it = 0; it < iters / 10; it++) spectrum_publish(&s);
+            double pub_dt = (now_s() - t0) / (iters / 10);
+            // 500 кS/s кадрами n — столько кадров в секунду
+            printf("N=%-5u %-6s frame %7.1f us, publish %6.1f us -> %7.0f frames/s (at 500 kS/s needed %.0f)\n", n,
+                   kernels[i].name, fft_dt * 1e6, pub_dt * 1e6, 1 / fft_dt, 500000.0 / n);
+            spectrum_free(&s);
+        }
+    }
+}
+
+int main(void)
+{
+    int rc = 0;
+    rc |= check_fft();
+    rc |= check_markers();
+    rc |= check_hold();
+    bench();
+    return rc;
+}
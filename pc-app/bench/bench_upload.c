@@ -0,0 +1,298 @@
+// Загрузка формы кусками (upload.c) против симулятора генератора
+// (devsim.c) через cmdchan и osc_reader_run, как в GUI. Таблица 4096 точек:
+// окно 1 (кусок за куском) и UPLOAD_WINDOW; с потерей ответов (повторы по
+// таймауту cmdchan); с испорченными кусками (повтор по err = 1); старая
+// прошивка без 0x19 — одним кадром upload_wave. После каждой загрузки
+// таблица в симуляторе сверяется с отправленной. Затем upload_load_file:
+// CSV (точка/запятая), WAV 16 бит и float, передискретизация.
+//
+//   ./bench_upload [загрузок_на_режим]
+
+#include "../cmdchan.h"
+#include "../devsim.h"
+#include "../reader.h"
+#include "../upload.h"
+
+#include <math.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    sem_t sem;
+    int status;
+    char msg[96];
+    _Atomic unsigned progress;          // вызовов progress
+} wait_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void on_progress(void *ctx, unsigned acked, unsigned total)
+{
+    wait_t *w = ctx;
+    (void)acked;
+    (void)total;
+    atomic_fetch_add(&w->progress, 1);
+}
+
+static void on_done(void *ctx, int status, const char *msg)
+{
+    wait_t *w = ctx;
+    w->status = status;
+    snprintf(w->msg, sizeof(w->msg), "%s", msg);
+    sem_post(&w->sem);
+}
+
+static void *reader_thread(void *arg)
+{
+    osc_reader_run(arg);
+    return NULL;
+}
+
+// Форма с изломами: синус, ступени и шум — для сверки по точкам
+static void make_wave(uint16_t *pts, uint32_t n, unsigned k)
+{
+    uint32_t r = 12345 + k;
+    for (uint32_t i = 0; i < n; i++) {
+        r = r * 1103515245u + 12345u;
+        double v = 2048 + 1500 * sin(2 * M_PI * i / n * (k + 1)) + (i % 64 < 8 ? 300 : 0) + (r >> 16) % 64;
+        pts[i] = (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v);
+    }
+}
+
+static int run(const char *name, const devsim_cfg_t *cfg, unsigned reps, uint32_t n, unsigned window,
+               uint16_t chunk)
+{
+    static devsim_t sim;
+    static osc_reader_t rd;
+    static cmdchan_t cc;
+    static upload_t up;
+    static uint16_t pts[UPLOAD_MAX_POINTS];
+    wait_t w;
+    int rc = 0;
+    memset(&w, 0, sizeof(w));
+    sem_init(&w.sem, 0, 0);
+    if (!devsim_start(&sim, cfg) || !osc_reader_init(&rd, cfg->points) || !cmdchan_init(&cc) ||
+        !upload_init(&up)) {
+        fprintf(stderr, "init failed\n");
+        return 1;
+    }
+    rd.fd = port_open(sim.path, 115200);
+    if (rd.fd < 0) {
+        perror(sim.path);
+        return 1;
+    }
+    rd.cmd = &cc;
+    cmdchan_reset(&cc, rd.fd, rd.wake_fd);
+    atomic_store(&rd.run, true);
+    pthread_t rt;
+    pthread_create(&rt, NULL, reader_thread, &rd);
+    up.window = window;
+
+    double dt = 0, worst = 0;
+    unsigned ok = 0;
+    for (unsigned k = 0; k < reps; k++) {
+        make_wave(pts, n, k);
+        double t0 = now_s();
+        if (!upload_start(&up, &cc, pts, n, chunk, on_progress, on_done, &w)) {
+            fprintf(stderr, "  upload_start failed\n");
+            rc = 1;
+            break;
+        }
+        sem_wait(&w.sem);
+        double t = now_s() - t0;
+        dt += t;
+        if (t > worst) worst = t;
+        // Ответ на commit уходит после переноса таблицы — симулятор уже с ней
+        if (w.status != CMD_OK || sim.user_len != n || memcmp(sim.user, pts, n * 2)) {
+            fprintf(stderr, "  upload %u: %s, table %s\n", k, w.msg,
+                    sim.user_len == n && !memcmp(sim.user, pts, n * 2) ? "ok" : "differs");
+            rc = 1;
+        } else {
+            ok++;
+        }
+    }
+    printf("%-30s %6.1f ms/upload (max %6.1f)  %7.1f KB/s  resent %u (CRC) + %llu (timeout), legacy %u\n", name,
+           dt / reps * 1e3, worst * 1e3, n * 2.0 * reps / dt / 1024, atomic_load(&up.resent),
+           (unsigned long long)atomic_load(&cc.resent), atomic_load(&up.legacy));
+    if (ok != reps) rc = 1;
+    if (cfg->chunk_corrupt_ppm && atomic_load(&up.resent) != atomic_load(&sim.chunks_corrupted)) {
+        fprintf(stderr, "  %u chunks resent for %llu corrupted\n", atomic_load(&up.resent),
+                (unsigned long long)atomic_load(&sim.chunks_corrupted));
+        rc = 1;
+    }
+    if (cfg->no_chunked != (atomic_load(&up.legacy) == reps)) {
+        fprintf(stderr, "  legacy uploads: %u of %u\n", atomic_load(&up.legacy), reps);
+        rc = 1;
+    }
+
+    osc_reader_cancel(&rd);
+    pthread_join(rt, NULL);
+    cmdchan_free(&cc);
+    close(rd.fd);
+    osc_reader_free(&rd);
+    devsim_stop(&sim);
+    upload_free(&up);
+    sem_destroy(&w.sem);
+    return rc;
+}
+
+static bool write_file(const char *path, const void *data, size_t len)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+// WAV из n отсчётов канала 0 (второй канал — мусор: берётся первый)
+static size_t make_wav(uint8_t *buf, const double *x, uint32_t n, unsigned fmt, unsigned bits)
+{
+    unsigned nch = 2, bps = bits / 8;
+    uint32_t data = n * nch * bps;
+    memcpy(buf, "RIFF", 4);
+    uint32_t v = 36 + data;
+    memcpy(buf + 4, &v, 4);
+    memcpy(buf + 8, "WAVEfmt ", 8);
+    v = 16;
+    memcpy(buf + 16, &v, 4);
+    uint16_t h[] = {(uint16_t)fmt, (uint16_t)nch};
+    memcpy(buf + 20, h, 4);
+    v = 48000;
+    memcpy(buf + 24, &v, 4);
+    v = 48000 * nch * bps;
+    memcpy(buf + 28, &v, 4);
+    uint16_t h2[] = {(uint16_t)(nch * bps), (uint16_t)bits};
+    memcpy(buf + 32, h2, 4);
+    memcpy(buf + 36, "data", 4);
+    memcpy(buf + 40, &data, 4);
+    uint8_t *p = buf + 44;
+    for (uint32_t i = 0; i < n; i++) {
+        if (fmt == 3) {
+            float a = (float)x[i], b = -1;
+            memcpy(p, &a, 4);
+            memcpy(p + 4, &b, 4);
+        } else {
+            int16_t a = (int16_t)lround(x[i] * 32767), b = 32767;
+            memcpy(p, &a, 2);
+            memcpy(p + 2, &b, 2);
+        }
+        p += nch * bps;
+    }
+    return 44 + data;
+}
+
+// Ожидаемые коды: размах на 0..4095
+static int check_codes(const char *name, const uint16_t *got, uint32_t m, const double *x, uint32_t n, int tol)
+{
+    double lo = x[0], hi = x[0];
+    for (uint32_t i = 1; i < n; i++) {
+        if (x[i] < lo) lo = x[i];
+        if (x[i] > hi) hi = x[i];
+    }
+    int worst = 0;
+    for (uint32_t i = 0; i < m; i++) {
+        double pos = (double)i * n / m;
+        uint32_t k = (uint32_t)pos;
+        double v = x[k] + (k + 1 < n ? (x[k + 1] - x[k]) * (pos - k) : 0);
+        int d = abs((int)got[i] - (int)lround((v - lo) / (hi - lo) * 4095));
+        if (d > worst) worst = d;
+    }
+    printf("load %-25s %5u points, max error %d code\n", name, m, worst);
+    return worst > tol;
+}
+
+static int run_files(void)
+{
+    static uint16_t pts[UPLOAD_MAX_POINTS];
+    static double x[8192];
+    static uint8_t buf[44 + 8192 * 8];
+    char path[] = "/tmp/bench_upload_XXXXXX", err[128];
+    int fd = mkstemp(path), rc = 0;
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    // CSV: заголовок, время и значение через запятую
+    uint32_t n = 1000;
+    FILE *f = fopen(path, "w");
+    fprintf(f, "t,v\n");
+    for (uint32_t i = 0; i < n; i++) {
+        x[i] = sin(2 * M_PI * i / n) + 0.3 * sin(6 * M_PI * i / n);
+        fprintf(f, "%.6f,%.9f\r\n", i * 1e-5, x[i]);
+    }
+    fclose(f);
+    uint32_t m = upload_load_file(path, pts, UPLOAD_MAX_POINTS, err, sizeof(err));
+    rc |= m != n || check_codes("CSV ','", pts, m, x, n, 1);
+
+    // CSV: ';' и десятичная запятая, один столбец
+    f = fopen(path, "w");
+    for (uint32_t i = 0; i < n; i++) {
+        char s[32];
+        snprintf(s, sizeof(s), "%.9f", x[i]);
+        char *c = strchr(s, '.');
+        if (c) *c = ',';
+        fprintf(f, "%u;%s\n", i, s);
+    }
+    fclose(f);
+    m = upload_load_file(path, pts, UPLOAD_MAX_POINTS, err, sizeof(err));
+    rc |= m != n || check_codes("CSV ';' decimal comma", pts, m, x, n, 1);
+
+    // WAV 16 бит стерео, 8192 отсчёта — передискретизация до 4096
+    n = 8192;
+    for (uint32_t i = 0; i < n; i++) x[i] = 0.9 * sin(2 * M_PI * i / n) * (i < n / 2 ? 1 : 0.5);
+    write_file(path, buf, make_wav(buf, x, n, 1, 16));
+    m = upload_load_file(path, pts, UPLOAD_MAX_POINTS, err, sizeof(err));
+    for (uint32_t i = 0; i < n; i++) x[i] = lround(x[i] * 32767);     // что лежит в файле
+    rc |= m != UPLOAD_MAX_POINTS || check_codes("WAV PCM16 8192 -> 4096", pts, m, x, n, 1);
+
+    // WAV float 32
+    n = 2000;
+    for (uint32_t i = 0; i < n; i++) x[i] = (i % 500) / 500.0 - 0.25;
+    write_file(path, buf, make_wav(buf, x, n, 3, 32));
+    m = upload_load_file(path, pts, UPLOAD_MAX_POINTS, err, sizeof(err));
+    for (uint32_t i = 0; i < n; i++) x[i] = (float)x[i];
+    rc |= m != n || check_codes("WAV float32", pts, m, x, n, 1);
+
+    // Не форма: ошибка, а не пустая таблица
+    f = fopen(path, "w");
+    fprintf(f, "no numbers here\n");
+    fclose(f);
+    m = upload_load_file(path, pts, UPLOAD_MAX_POINTS, err, sizeof(err));
+    printf("load %-25s -> %u (%s)\n", "text without numbers", m, err);
+    rc |= m != 0;
+
+    unlink(path);
+    if (rc) fprintf(stderr, "  file loading failed\n");
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned reps = argc > 1 ? (unsigned)atoi(argv[1]) : 20;
+    crc16_init();
+    int rc = 0;
+    devsim_cfg_t gen = {.points = 2, .nch = 1};
+    rc |= run("4096 pts, window 1", &gen, reps, 4096, 1, PROTO_UPLOAD_CHUNK_MAX);
+    rc |= run("4096 pts, window 4", &gen, reps, 4096, UPLOAD_WINDOW, PROTO_UPLOAD_CHUNK_MAX);
+    rc |= run("4096 pts, 64-pt chunks", &gen, reps, 4096, UPLOAD_WINDOW, 64);
+    rc |= run("1000 pts, uneven last chunk", &gen, reps, 1000, UPLOAD_WINDOW, 300);
+    devsim_cfg_t lossy = {.points = 2, .nch = 1, .reply_drop_ppm = 20000};
+    rc |= run("4096 pts, 2% replies lost", &lossy, reps, 4096, UPLOAD_WINDOW, 128);
+    devsim_cfg_t corrupt = {.points = 2, .nch = 1, .chunk_corrupt_ppm = 20000};
+    rc |= run("4096 pts, 2% chunks corrupted", &corrupt, reps, 4096, UPLOAD_WINDOW, 128);
+    devsim_cfg_t old = {.points = 2, .nch = 1, .no_chunked = true};
+    rc |= run("1000 pts, old firmware", &old, reps, 1000, UPLOAD_WINDOW, PROTO_UPLOAD_CHUNK_MAX);
+    rc |= run_files();
+    return rc;
+}
@@ -0,0 +1,341 @@
+#include "bode.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool bode_init(bode_t *b)
+{
+    memset(b, 0, sizeof(*b));
+    if (sem_init(&b->sem, 0, 0) != 0) return false;
+    // Один сегмент за раз; запас — на повтор seg_read
+    return frameq_init(&b->q, 2, BODE_SEG_SAMPLES);
+}
+
+void bode_free(bode_t *b)
+{
+    bode_stop(b);
+    frameq_free(&b->q);
+    sem_destroy(&b->sem);
+}
+
+double bode_freq(const bode_t *b, unsigned i)
+{
+    if (b->npoints < 2) return b->f0_hz;
+    double t = (double)i / (b->npoints - 1);
+    double f = b->log ? b->f0_hz * pow(b->f1_hz / b->f0_hz, t) : b->f0_hz + (b->f1_hz - b->f0_hz) * t;
+    return round(f * 1000) / 1000;      // set_freq — в мГц
+}
+
+uint32_t bode_fs(double f_hz)
+{
+    double fs = f_hz * (BODE_SEG_SAMPLES / 2) / (BODE_CYCLES + BODE_SETTLE_CYCLES);
+    if (fs > BODE_FS_MAX) return BODE_FS_MAX;
+    return fs < 1 ? 1 : (uint32_t)lround(fs);
+}
+
+void bode_goertzel(const uint16_t *x, uint32_t n, double w, const float *win, double *re, double *im)
+{
+    double mean = 0;
+    for (uint32_t i = 0; i < n; i++) mean += x[i];
+    mean = n ? mean / n : 0;
+    // s[i] = x[i] + 2cos(w)·s[i-1] - s[i-2]; X = e^{-jw(n-1)}·(s[n-1] - e^{-jw}·s[n-2])
+    double c = cos(w), k = 2 * c, s1 = 0, s2 = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        double v = (x[i] - mean) * (win ? win[i] : 1.0f);
+        double s0 = v + k * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    double yr = s1 - c * s2, yi = sin(w) * s2;
+    double a = -w * (n ? n - 1 : 0), cr = cos(a), ci = sin(a);
+    *re = yr * cr - yi * ci;
+    *im = yr * ci + yi * cr;
+}
+
+bool bode_measure(const osc_frame_t *fr, double f_hz, bode_point_t *pt)
+{
+    static _Thread_local float win[BODE_SEG_SAMPLES];
+    static _Thread_local uint32_t win_n;
+    if (fr->nch < 2 || !fr->fs_hz) return false;
+    // Каналы до phase начинаются скан спустя: у остальных первый отсчёт лишний
+    uint32_t off[2], len[2];
+    for (unsigned c = 0; c < 2; c++) {
+        off[c] = fr->phase && c >= fr->phase ? 1 : 0;
+        len[c] = fr->ch_len[c] > off[c] ? fr->ch_len[c] - off[c] : 0;
+    }
+    uint32_t n = len[0] < len[1] ? len[0] : len[1];
+    // Начало сегмента — установление цепи; окно — до BODE_SEG_SAMPLES последних
+    uint32_t skip = (uint32_t)ceil(BODE_SETTLE_CYCLES * fr->fs_hz / f_hz);
+    if (skip > n / 2) skip = n / 2;
+    n -= skip;
+    if (n > BODE_SEG_SAMPLES) {
+        skip += n - BODE_SEG_SAMPLES;
+        n = BODE_SEG_SAMPLES;
+    }
+    if (n < 16) return false;
+    if (n != win_n) {
+        for (uint32_t i = 0; i < n; i++) win[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / (n - 1)));
+        win_n = n;
+    }
+
+    double w = 2 * M_PI * f_hz / fr->fs_hz, re[2], im[2];
+    for (unsigned c = 0; c < 2; c++) {
+        bode_goertzel(fr->samples + fr->ch_off[c] + off[c] + skip, n, w, win, &re[c], &im[c]);
+    }
+    // Амплитуда: |X|·2 / сумма окна (у Ханна — (n-1)/2), в кодах 12 бит
+    double scale = 4.0 / (n - 1) / (1u << (fr->bits > 12 ? fr->bits - 12 : 0));
+    pt->f_hz = f_hz;
+    pt->fs_hz = fr->fs_hz;
+    pt->in_amp = hypot(re[0], im[0]) * scale;
+    pt->out_amp = hypot(re[1], im[1]) * scale;
+    pt->ok = pt->in_amp >= BODE_MIN_AMP;
+    pt->gain_db = 20 * log10((pt->out_amp + 1e-12) / (pt->in_amp + 1e-12));
+    // arg(X1 / X0)
+    pt->phase_deg = atan2(im[1] * re[0] - re[1] * im[0], re[1] * re[0] + im[1] * im[0]) * 180 / M_PI;
+    return true;
+}
+
+// Завершение команды (поток чтения платы): первая неудача запоминается
+static void cmd_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    bode_t *b = ctx;
+    if (status == CMD_OK && resp && resp->cmd == (PROTO_CMD_SEG_STATUS | PROTO_RESP) && resp->len >= 2) {
+        atomic_store(&b->seg_state, resp->payload[1]);
+    }
+    if (status != CMD_OK) {
+        int ok = CMD_OK;
+        atomic_compare_exchange_strong(&b->failed, &ok, status);
+    }
+    atomic_fetch_sub(&b->pending, 1);
+    sem_post(&b->sem);
+}
+
+static bool fail(bode_t *b, const char *msg)
+{
+    snprintf(b->msg, sizeof(b->msg), "%s", msg);
+    return false;
+}
+
+static bool send(bode_t *b, cmdchan_t *cc, uint8_t cmd, const void *p, uint16_t len)
+{
+    atomic_fetch_add(&b->pending, 1);
+    if (cmdchan_send(cc, cmd, p, len, cmd_done, b)) return true;
+    atomic_fetch_sub(&b->pending, 1);
+    return fail(b, "порт закрыт");
+}
+
+// Ответы на все отправленные; cmdchan сам снимает команду по таймауту.
+// false — остановлен (stop), ответы ещё не все
+static bool drain(bode_t *b, bool stoppable)
+{
+    while (atomic_load(&b->pending) > 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 50000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        sem_timedwait(&b->sem, &ts);
+        if (stoppable && atomic_load(&b->stop)) return false;
+    }
+    return true;
+}
+
+static bool wait_acks(bode_t *b)
+{
+    if (!drain(b, true)) return fail(b, "остановлен");
+    int st = atomic_load(&b->failed);
+    if (st == CMD_OK) return true;
+    return fail(b, st == CMD_TIMEOUT ? "плата не отвечает" : st == CMD_ERR ? "плата вернула ошибку" : "команда отменена");
+}
+
+// Команда свипа: конвейером — без ожидания ответа, serial — с ожиданием
+static bool cmd(bode_t *b, cmdchan_t *cc, uint8_t c, const void *p, uint16_t len)
+{
+    return send(b, cc, c, p, len) && (!b->serial || wait_acks(b));
+}
+
+// Точка i: частота генератору, fs осциллографу
+static bool set_point(bode_t *b, unsigned i)
+{
+    uint32_t mhz = (uint32_t)lround(bode_freq(b, i) * 1000), fs = bode_fs(bode_freq(b, i));
+    return cmd(b, b->gen, PROTO_CMD_GEN_SET_FREQ, &mhz, 4) && cmd(b, b->osc, PROTO_CMD_SET_FS, &fs, 4);
+}
+
+// Команда с ответом; err — плата ещё перестраивает АЦП (смена каналов,
+// выход из сегментного режима идут в главном цикле платы), тогда повтор
+static bool send_retry(bode_t *b, cmdchan_t *cc, uint8_t cmd, const void *p, uint16_t len)
+{
+    for (int t = 0; t < BODE_CAPTURE_TRIES; t++) {
+        atomic_store(&b->failed, CMD_OK);
+        if (!send(b, cc, cmd, p, len)) return false;
+        if (wait_acks(b)) return true;
+        if (atomic_load(&b->failed) != CMD_ERR) return false;
+        usleep(BODE_RETRY_US);
+    }
+    return false;
+}
+
+// Один сегмент без триггера: с ожиданием ответа (и повтором) или без
+static const uint8_t capture_p[6] = {0, 0, BODE_SEG_SAMPLES & 0xFF, BODE_SEG_SAMPLES >> 8, 1, 0};
+
+static bool capture(bode_t *b)
+{
+    return send_retry(b, b->osc, PROTO_CMD_CAPTURE_ONCE, capture_p, sizeof(capture_p));
+}
+
+// Ответ на capture_once, отправленный без ожидания; err — повтор с ожиданием
+static bool capture_acked(bode_t *b, double *t_cap)
+{
+    if (wait_acks(b)) return true;
+    if (atomic_load(&b->failed) != CMD_ERR) return false;
+    usleep(BODE_RETRY_US);
+    if (!capture(b)) return false;
+    *t_cap = now_s();
+    return true;
+}
+
+// Конец захвата: до расчётного времени спим, потом опрос seg_status
+static bool wait_captured(bode_t *b, double t_cap, uint32_t fs)
+{
+    double end = t_cap + (double)(BODE_SEG_SAMPLES / 2) / fs;
+    double left = end - now_s();
+    if (left > 0) usleep((useconds_t)(left * 1e6));
+    for (;;) {
+        atomic_store(&b->seg_state, PROTO_SEG_ARMED);
+        if (!send(b, b->osc, PROTO_CMD_SEG_STATUS, NULL, 0) || !wait_acks(b)) return false;
+        if (atomic_load(&b->seg_state) == PROTO_SEG_DONE) return true;
+        if (now_s() - end > BODE_WAIT_US * 1e-6) return fail(b, "сегмент не записался");
+        usleep(BODE_POLL_US);
+    }
+}
+
+static const osc_frame_t *wait_segment(bode_t *b)
+{
+    double t0 = now_s();
+    for (;;) {
+        const osc_frame_t *fr = frameq_next(&b->q);
+        if (fr) return fr;
+        if (atomic_load(&b->stop)) {
+            fail(b, "остановлен");
+            return NULL;
+        }
+        if (now_s() - t0 > BODE_WAIT_US * 1e-6) {
+            fail(b, "сегмент не пришёл");
+            return NULL;
+        }
+        frameq_wait(&b->q, 50000);
+    }
+}
+
+// Фаза без скачков: ближайшая к фазе прошлой точки из phase + 360·k
+static void unwrap(bode_t *b, unsigned i)
+{
+    if (i == 0) return;
+    double prev = b->pt[i - 1].phase_deg, *ph = &b->pt[i].phase_deg;
+    *ph -= 360 * round((*ph - prev) / 360);
+}
+
+static bool sweep(bode_t *b)
+{
+    // Из сегментного режима (прошлый свип, вкладка «Сегменты») — через
+    // поток: иначе каналы не сменить. Два канала, 12 бит (передискретизация
+    // запретила бы менять fs между сегментами; старая прошивка её не знает —
+    // ответ не ждём), без триггера. Генератор — синус в DDS (без DDS частота
+    // ближайшая табличная — на отношение каналов это не влияет).
+    uint8_t on = 1, off = 0, nch = 2, bits = 12, sine = 0, dds = PROTO_GEN_MODE_DDS, trig[4] = {0};
+    if (!send(b, b->osc, PROTO_CMD_STREAM_ON, &on, 1) || !send(b, b->osc, PROTO_CMD_STREAM_ON, &off, 1) ||
+        !wait_acks(b) || !send_retry(b, b->osc, PROTO_CMD_SET_CH, &nch, 1) ||
+        !cmdchan_send(b->osc, PROTO_CMD_SET_OVS, &bits, 1, NULL, NULL) ||
+        !send(b, b->osc, PROTO_CMD_SET_TRIG, trig, sizeof(trig)) || !send(b, b->gen, PROTO_CMD_GEN_SET_WAVE, &sine, 1) ||
+        !cmdchan_send(b->gen, PROTO_CMD_GEN_SET_MODE, &dds, 1, NULL, NULL) || !set_point(b, 0) || !wait_acks(b) ||
+        !capture(b)) {
+        return false;
+    }
+    double t_cap = now_s();
+    for (unsigned i = 0; i < b->npoints; i++) {
+        uint32_t fs = bode_fs(bode_freq(b, i));
+        b->capture_s += (double)(BODE_SEG_SAMPLES / 2) / fs;
+        if (!capture_acked(b, &t_cap) || !wait_captured(b, t_cap, fs)) return false;
+        // Следующая точка — пока сегмент идёт по линии
+        uint8_t rd[4] = {0, 0, 1, 0};
+        bool next = i + 1 < b->npoints;
+        if (!cmd(b, b->osc, PROTO_CMD_SEG_READ, rd, sizeof(rd)) || (next && !set_point(b, i + 1))) return false;
+        const osc_frame_t *fr = wait_segment(b);
+        if (!fr || !wait_acks(b)) return false;
+        if (next) {
+            // Захват i+1 без ожидания ответа; разбор точки i — пока он пишется.
+            // Кадр держим до следующего frameq_next
+            bool ok = b->serial ? capture(b) : send(b, b->osc, PROTO_CMD_CAPTURE_ONCE, capture_p, sizeof(capture_p));
+            if (!ok) return false;
+            t_cap = now_s();
+        }
+        bode_point_t pt;
+        if (!bode_measure(fr, bode_freq(b, i), &pt)) return fail(b, "в сегменте меньше двух каналов");
+        b->pt[i] = pt;
+        unwrap(b, i);
+        atomic_store(&b->done, i + 1);
+    }
+    return true;
+}
+
+static void *bode_thread(void *arg)
+{
+    bode_t *b = arg;
+    double t0 = now_s();
+    bool ok = sweep(b), stopped = atomic_load(&b->stop);
+    // Ответы на отправленное — до возврата очереди сегментов
+    drain(b, false);
+    atomic_store(&b->rd->seg_out, b->prev_out);
+    b->total_s = now_s() - t0;
+    atomic_store(&b->state, ok ? BODE_DONE : stopped ? BODE_STOPPED : BODE_FAILED);
+    return NULL;
+}
+
+bool bode_start(bode_t *b)
+{
+    if (atomic_load(&b->state) == BODE_RUN) return false;
+    bode_stop(b);
+    if (b->npoints < 1 || b->npoints > BODE_MAX_POINTS || b->f0_hz <= 0 || b->f1_hz <= 0 ||
+        b->f0_hz > BODE_F_MAX || b->f1_hz > BODE_F_MAX) {
+        return false;
+    }
+    atomic_store(&b->done, 0);
+    atomic_store(&b->stop, false);
+    atomic_store(&b->failed, CMD_OK);
+    atomic_store(&b->pending, 0);
+    while (sem_trywait(&b->sem) == 0) {
+    }
+    while (frameq_next(&b->q)) {
+    }
+    b->msg[0] = 0;
+    b->total_s = b->capture_s = 0;
+    b->prev_out = atomic_exchange(&b->rd->seg_out, &b->q);
+    atomic_store(&b->state, BODE_RUN);
+    if (pthread_create(&b->thread, NULL, bode_thread, b) != 0) {
+        atomic_store(&b->rd->seg_out, b->prev_out);
+        atomic_store(&b->state, BODE_IDLE);
+        return false;
+    }
+    b->started = true;
+    return true;
+}
+
+void bode_stop(bode_t *b)
+{
+    if (!b->started) return;
+    atomic_store(&b->stop, true);
+    pthread_join(b->thread, NULL);
+    b->started = false;
+}
@@ -0,0 +1,100 @@
+#ifndef BODE_H
+#define BODE_H
+
+// Частотная характеристика цепи (Боде): генератор -> цепь -> осциллограф.
+// Канал 0 осциллографа — вход цепи (выход генератора), канал 1 — её выход.
+// Генератор идёт по точкам (set_freq, DDS), на каждой осциллограф пишет
+// один сегмент (capture_once без триггера, fs — под частоту точки), сегмент
+// выгружается (seg_read) и разбирается: амплитуда и фаза каждого канала —
+// одним бином (Гёрцель) на частоте точки с окном Ханна, H = X1 / X0.
+// Частотная характеристика самого тракта (задержка между каналами в скане,
+// разброс входов) убирается калибровкой: свип без цепи, вход на оба канала.
+//
+// Конвейер: пока сегмент точки i идёт по линии, генератор уже переходит на
+// точку i+1 и осциллограф получает её fs; разбор точки i идёт, пока пишется
+// сегмент i+1. На точку — время захвата и один-два обмена командами.
+//
+// Свой поток; команды — через cmdchan обеих плат, сегменты — в свою
+// очередь (на время свипа вместо rd->seg_out). Без GTK: GUI только читает
+// готовые точки, bench/bench_bode — против симулятора в петле (devsim.c).
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cmdchan.h"
+#include "frameq.h"
+#include "reader.h"
+
+#define BODE_MAX_POINTS    1000
+#define BODE_SEG_SAMPLES   4096        // отсчётов сегмента, оба канала
+#define BODE_CYCLES        8           // периодов в окне разбора (больше, если упёрлись в fs)
+#define BODE_SETTLE_CYCLES 2           // периодов в начале сегмента на установление цепи
+#define BODE_FS_MAX        1000000     // fs на канал: два канала — 2 млн преобразований АЦП в секунду
+#define BODE_F_MAX         (BODE_FS_MAX / 4)
+#define BODE_MIN_AMP       20.0        // амплитуда входа меньше (коды 12 бит) — точке не верить
+#define BODE_POLL_US       1000        // опрос seg_status после расчётного конца захвата
+#define BODE_WAIT_US       2000000     // сегмент или захват не пришёл — свип прерывается
+#define BODE_CAPTURE_TRIES 5           // capture_once с ошибкой (плата перестраивает АЦП) — повтор
+#define BODE_RETRY_US      2000
+
+enum { BODE_IDLE = 0, BODE_RUN, BODE_DONE, BODE_FAILED, BODE_STOPPED };
+
+typedef struct {
+    double f_hz;                // частота генератора (с точностью до мГц)
+    uint32_t fs_hz;
+    double in_amp, out_amp;     // амплитуды каналов, коды 12 бит
+    double gain_db;
+    double phase_deg;           // непрерывная по точкам (без скачков на ±180)
+    bool ok;                    // вход не меньше BODE_MIN_AMP
+} bode_point_t;
+
+typedef struct {
+    // Настройки, до bode_start
+    double f0_hz, f1_hz;
+    unsigned npoints;
+    bool log;                   // точки по логарифму частоты
+    bool serial;                // без конвейера: команда — после ответа на прошлую (для сравнения)
+    cmdchan_t *gen, *osc;
+    osc_reader_t *rd;           // поток чтения осциллографа
+    // Результат: точки 0..done-1 готовы
+    bode_point_t pt[BODE_MAX_POINTS];
+    _Atomic unsigned done;
+    _Atomic int state;          // BODE_*
+    char msg[96];               // почему FAILED
+    double total_s;             // весь свип
+    double capture_s;           // из него — сумма длительностей сегментов
+    // Поток свипа
+    pthread_t thread;
+    bool started;
+    _Atomic bool stop;
+    frameq_t q;                 // сегменты
+    frameq_t *prev_out;         // rd->seg_out до свипа
+    sem_t sem;                  // +1 на ответ команды
+    _Atomic int pending;        // команд без ответа
+    _Atomic int failed;         // CMD_* первой неудачной, CMD_OK — нет
+    _Atomic int seg_state;      // из ответа seg_status
+} bode_t;
+
+bool bode_init(bode_t *b);
+void bode_free(bode_t *b);
+
+// Запуск свипа по настройкам; false — идёт прежний или настройки неверны
+bool bode_start(bode_t *b);
+// Остановить (если идёт) и дождаться потока
+void bode_stop(bode_t *b);
+// Частота точки i
+double bode_freq(const bode_t *b, unsigned i);
+// fs точки: BODE_CYCLES + BODE_SETTLE_CYCLES периодов на сегмент, не выше BODE_FS_MAX
+uint32_t bode_fs(double f_hz);
+
+// Гёрцель: X(w) = sum x[i]·win[i]·e^{-j·w·i}, w — рад/отсчёт; win — окно
+// Ханна на n отсчётов (или NULL — без окна); среднее вычитается
+void bode_goertzel(const uint16_t *x, uint32_t n, double w, const float *win, double *re, double *im);
+// Разбор сегмента из двух каналов на частоте f: амплитуды, усиление и
+// фаза (в pt->phase_deg — в пределах ±180); false — в кадре меньше двух каналов
+bool bode_measure(const osc_frame_t *fr, double f_hz, bode_point_t *pt);
+
+#endif
@@ -0,0 +1,241 @@
+#include "cmdchan.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CMDCHAN_WRITE_MS 20     // порт не принимает кадр целиком: сколько ждать
+
+typedef struct {
+    cmd_done_fn done;
+    void *ctx;
+} cmd_done_t;
+
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool cmdchan_init(cmdchan_t *cc)
+{
+    memset(cc, 0, sizeof(*cc));
+    cc->fd = -1;
+    cc->wake_fd = -1;
+    cc->timeout_us = CMDCHAN_TIMEOUT_US;
+    cc->retries = CMDCHAN_RETRIES;
+    return pthread_mutex_init(&cc->lock, NULL) == 0;
+}
+
+void cmdchan_free(cmdchan_t *cc)
+{
+    cmdchan_reset(cc, -1, -1);
+    pthread_mutex_destroy(&cc->lock);
+}
+
+// Кадры к отправке целиком: порт неблокирующий, при полном буфере
+// передачи ждём недолго. Недописанный кадр плата отбросит по CRC, команда
+// уйдёт повтором. Только поток чтения и без cc->lock: ни GTK, ни разбор
+// ответов медленный порт не держит.
+static void write_frames(cmdchan_t *cc, int fd, const uint8_t *buf, size_t len)
+{
+    size_t off = 0;
+    int64_t until = mono_us() + CMDCHAN_WRITE_MS * 1000;
+    while (off < len) {
+        ssize_t w = write(fd, buf + off, len - off);
+        if (w > 0) {
+            off += (size_t)w;
+            continue;
+        }
+        if (w < 0 && errno != EAGAIN && errno != EINTR) break;
+        int64_t left = until - mono_us();
+        if (left <= 0) break;
+        struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+        poll(&pfd, 1, (int)(left / 1000) + 1);
+    }
+    if (off < len) atomic_fetch_add_explicit(&cc->write_errors, 1, memory_order_relaxed);
+}
+
+// Кадр — в буфер передачи (под cc->lock); в порт его пишет cmdchan_poll.
+// В буфере не больше окна: слот уходит снова только после ответа или по
+// таймауту, а то и другое — в потоке чтения, после записи прошлого
+static void transmit(cmdchan_t *cc, cmd_slot_t *s, int64_t now)
+{
+    if (s->tries == 0) s->first_us = now;
+    s->tries++;
+    s->deadline_us = now + cc->timeout_us;
+    if (cc->tx_len + s->len > sizeof(cc->tx)) {
+        atomic_fetch_add_explicit(&cc->write_errors, 1, memory_order_relaxed);
+        return;
+    }
+    memcpy(cc->tx + cc->tx_len, s->frame, s->len);
+    cc->tx_len += s->len;
+}
+
+// Очередь -> свободные места окна, по порядку seq
+static void fill_window(cmdchan_t *cc, int64_t now)
+{
+    for (unsigned i = 0; i < CMDCHAN_WINDOW && cc->q_count; i++) {
+        if (cc->busy[i]) continue;
+        cc->win[i] = cc->queue[cc->q_head];
+        cc->q_head = (cc->q_head + 1) % CMDCHAN_QUEUE;
+        cc->q_count--;
+        cc->busy[i] = true;
+        cc->inflight++;
+        transmit(cc, &cc->win[i], now);
+    }
+}
+
+void cmdchan_reset(cmdchan_t *cc, int fd, int wake_fd)
+{
+    cmd_done_t gone[CMDCHAN_WINDOW + CMDCHAN_QUEUE];
+    unsigned n = 0;
+    pthread_mutex_lock(&cc->lock);
+    for (unsigned i = 0; i < CMDCHAN_WINDOW; i++) {
+        if (cc->busy[i]) gone[n++] = (cmd_done_t){cc->win[i].done, cc->win[i].ctx};
+        cc->busy[i] = false;
+    }
+    for (; cc->q_count; cc->q_count--) {
+        const cmd_slot_t *s = &cc->queue[cc->q_head];
+        gone[n++] = (cmd_done_t){s->done, s->ctx};
+        cc->q_head = (cc->q_head + 1) % CMDCHAN_QUEUE;
+    }
+    cc->inflight = 0;
+    cc->tx_len = 0;
+    cc->fd = fd;
+    cc->wake_fd = wake_fd;
+    pthread_mutex_unlock(&cc->lock);
+    for (unsigned i = 0; i < n; i++) {
+        if (gone[i].done) gone[i].done(gone[i].ctx, CMD_CANCELLED, NULL);
+    }
+}
+
+bool cmdchan_send(cmdchan_t *cc, uint8_t cmd, const void *payload, uint16_t len, cmd_done_fn done, void *ctx)
+{
+    if (len > CMDCHAN_MAX_PAYLOAD) return false;
+    pthread_mutex_lock(&cc->lock);
+    if (cc->fd < 0 || cc->q_count == CMDCHAN_QUEUE) {
+        if (cc->fd >= 0) atomic_fetch_add_explicit(&cc->overflow, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&cc->lock);
+        return false;
+    }
+    cmd_slot_t *s = &cc->queue[(cc->q_head + cc->q_count) % CMDCHAN_QUEUE];
+    s->seq = ++cc->seq;
+    s->cmd = cmd;
+    s->tries = 0;
+    s->done = done;
+    s->ctx = ctx;
+    s->len = (uint16_t)proto_build(s->frame, s->seq, cmd, payload, len);
+    cc->q_count++;
+    atomic_fetch_add_explicit(&cc->sent, 1, memory_order_relaxed);
+    // Кадр ушёл в буфер передачи — разбудить поток чтения: он пишет в порт
+    // и считает таймаут. Окно полно — разбудит ответ.
+    fill_window(cc, mono_us());
+    bool wake = cc->tx_len > 0;
+    int wake_fd = cc->wake_fd;
+    pthread_mutex_unlock(&cc->lock);
+    if (wake && wake_fd >= 0) {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0) {}
+    }
+    return true;
+}
+
+bool cmdchan_on_response(cmdchan_t *cc, const proto_frame_t *f)
+{
+    if (!(f->cmd & PROTO_RESP)) return false;
+    pthread_mutex_lock(&cc->lock);
+    unsigned i;
+    for (i = 0; i < CMDCHAN_WINDOW; i++) {
+        if (cc->busy[i] && cc->win[i].seq == f->seq && cc->win[i].cmd == (f->cmd & ~PROTO_RESP)) break;
+    }
+    if (i == CMDCHAN_WINDOW) {
+        pthread_mutex_unlock(&cc->lock);
+        atomic_fetch_add_explicit(&cc->unmatched, 1, memory_order_relaxed);
+        return false;
+    }
+    int64_t now = mono_us();
+    cmd_slot_t *s = &cc->win[i];
+    cmd_done_t d = {s->done, s->ctx};
+    cc->lat_us[cc->lat_n++ % CMDCHAN_LAT_RING] = (uint32_t)(now - s->first_us);
+    cc->busy[i] = false;
+    cc->inflight--;
+    fill_window(cc, now);
+    pthread_mutex_unlock(&cc->lock);
+
+    int status = f->len >= 1 && f->payload[0] ? CMD_ERR : CMD_OK;
+    atomic_fetch_add_explicit(status == CMD_OK ? &cc->acked : &cc->errors, 1, memory_order_relaxed);
+    if (d.done) d.done(d.ctx, status, f);
+    return true;
+}
+
+int cmdchan_poll(cmdchan_t *cc, int64_t now_us)
+{
+    static _Thread_local uint8_t tx[sizeof(((cmdchan_t *)0)->tx)];
+    cmd_done_t gone[CMDCHAN_WINDOW];
+    unsigned n = 0;
+    pthread_mutex_lock(&cc->lock);
+    for (unsigned i = 0; i < CMDCHAN_WINDOW; i++) {
+        cmd_slot_t *s = &cc->win[i];
+        if (!cc->busy[i] || s->deadline_us > now_us) continue;
+        if (s->tries <= cc->retries) {
+            // Тот же кадр с тем же seq, ответ на любую из отправок закрывает
+            // команду. Повтор должен быть безвреден: у неидемпотентных
+            // (capture_once, seg_read) плата узнаёт его по seq и не выполняет
+            // второй раз
+            atomic_fetch_add_explicit(&cc->resent, 1, memory_order_relaxed);
+            transmit(cc, s, now_us);
+        } else {
+            gone[n++] = (cmd_done_t){s->done, s->ctx};
+            cc->busy[i] = false;
+            cc->inflight--;
+        }
+    }
+    if (n) fill_window(cc, now_us);
+    int64_t next = -1;
+    for (unsigned i = 0; i < CMDCHAN_WINDOW; i++) {
+        if (cc->busy[i] && (next < 0 || cc->win[i].deadline_us < next)) next = cc->win[i].deadline_us;
+    }
+    size_t tx_len = cc->tx_len;
+    int fd = cc->fd;
+    memcpy(tx, cc->tx, tx_len);
+    cc->tx_len = 0;
+    pthread_mutex_unlock(&cc->lock);
+
+    if (tx_len && fd >= 0) write_frames(cc, fd, tx, tx_len);
+
+    atomic_fetch_add_explicit(&cc->timeouts, n, memory_order_relaxed);
+    for (unsigned i = 0; i < n; i++) {
+        if (gone[i].done) gone[i].done(gone[i].ctx, CMD_TIMEOUT, NULL);
+    }
+    if (next < 0) return -1;
+    return next <= now_us ? 0 : (int)((next - now_us + 999) / 1000);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+void cmdchan_latency(cmdchan_t *cc, cmd_latency_t *out)
+{
+    uint32_t v[CMDCHAN_LAT_RING];
+    pthread_mutex_lock(&cc->lock);
+    unsigned n = cc->lat_n < CMDCHAN_LAT_RING ? cc->lat_n : CMDCHAN_LAT_RING;
+    memcpy(v, cc->lat_us, n * sizeof(v[0]));
+    pthread_mutex_unlock(&cc->lock);
+
+    memset(out, 0, sizeof(*out));
+    out->n = n;
+    if (!n) return;
+    qsort(v, n, sizeof(v[0]), cmp_u32);
+    out->p50_ms = v[(n - 1) * 50 / 100] / 1000.0;
+    out->p90_ms = v[(n - 1) * 90 / 100] / 1000.0;
+    out->p99_ms = v[(n - 1) * 99 / 100] / 1000.0;
+    out->max_ms = v[n - 1] / 1000.0;
+}
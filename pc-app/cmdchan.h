@@ -0,0 +1,102 @@
+#ifndef CMDCHAN_H
+#define CMDCHAN_H
+
+// Команды одной плате без ожидания ответа: у канала свой счётчик seq и
+// таблица команд «в полёте» по seq. Отправитель (GTK) только кладёт кадр в
+// буфер передачи и будит поток чтения порта; в порт пишет он (cmdchan_poll),
+// так что медленный порт не держит ни GTK, ни разбор ответов. Ответ
+// cmd|0x80 с тем же seq находит тот же поток (osc_reader_dispatch ->
+// cmdchan_on_response), он же повторяет команды без ответа и снимает их
+// по таймауту.
+// В полёте до CMDCHAN_WINDOW команд подряд, без ожидания ответа на каждую;
+// сверх окна — очередь, команда уходит, когда освободится место.
+//
+// Завершение — callback done(ctx, status, resp) в потоке чтения (или в
+// cmdchan_reset), resp — ответ (только при CMD_OK/CMD_ERR). GTK из него
+// не трогать: через g_idle_add.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "proto.h"
+
+#define CMDCHAN_WINDOW      8           // команд в полёте
+#define CMDCHAN_QUEUE       64          // ждут места в окне
+#define CMDCHAN_MAX_PAYLOAD 2050        // upload_wave старой прошивки: 2 + 1024 точки × 2
+#define CMDCHAN_TIMEOUT_US  200000      // ждём ответа, потом повтор
+#define CMDCHAN_RETRIES     2           // повторов до CMD_TIMEOUT
+#define CMDCHAN_LAT_RING    1024        // последних задержек для перцентилей
+
+enum {
+    CMD_OK = 0,         // ответ, err = 0 (или ответ без поля err)
+    CMD_ERR,            // ответ с err != 0 в первом байте
+    CMD_TIMEOUT,        // нет ответа после всех повторов
+    CMD_CANCELLED,      // канал сброшен (переподключение, выход)
+};
+
+typedef void (*cmd_done_fn)(void *ctx, int status, const proto_frame_t *resp);
+
+typedef struct {
+    uint16_t seq;
+    uint8_t cmd;
+    uint8_t tries;                      // отправок, с повторами
+    int64_t first_us;                   // первая отправка: отсюда задержка
+    int64_t deadline_us;
+    cmd_done_fn done;
+    void *ctx;
+    uint16_t len;
+    uint8_t frame[PROTO_HDR_LEN + CMDCHAN_MAX_PAYLOAD + PROTO_CRC_LEN];
+} cmd_slot_t;
+
+typedef struct {
+    int fd;                             // порт платы, -1 — не подключена
+    int wake_fd;                        // eventfd потока чтения: окно было пустым
+    pthread_mutex_t lock;
+    uint16_t seq;
+    cmd_slot_t win[CMDCHAN_WINDOW];
+    bool busy[CMDCHAN_WINDOW];
+    unsigned inflight;
+    cmd_slot_t queue[CMDCHAN_QUEUE];    // кольцо, q_head — самая старая
+    unsigned q_head, q_count;
+    uint8_t tx[CMDCHAN_WINDOW * sizeof(((cmd_slot_t *)0)->frame)];  // кадры к записи в порт
+    size_t tx_len;
+    int64_t timeout_us;
+    unsigned retries;
+    uint32_t lat_us[CMDCHAN_LAT_RING];  // задержки ответов, кольцо
+    unsigned lat_n;                     // всего записано
+    // Счётчики
+    _Atomic uint64_t sent;              // команд принято к отправке
+    _Atomic uint64_t acked;             // ответов с err = 0
+    _Atomic uint64_t errors;            // ответов с err != 0
+    _Atomic uint64_t resent;            // повторных отправок
+    _Atomic uint64_t timeouts;
+    _Atomic uint64_t unmatched;         // ответ без команды (поздний, чужой seq)
+    _Atomic uint64_t overflow;          // очередь полна, команда не принята
+    _Atomic uint64_t write_errors;      // кадр не ушёл в порт (уйдёт повтором)
+} cmdchan_t;
+
+typedef struct {
+    unsigned n;                         // задержек в выборке
+    double p50_ms, p90_ms, p99_ms, max_ms;
+} cmd_latency_t;
+
+bool cmdchan_init(cmdchan_t *cc);
+void cmdchan_free(cmdchan_t *cc);
+// Новый порт: все команды завершаются CMD_CANCELLED, seq продолжается
+void cmdchan_reset(cmdchan_t *cc, int fd, int wake_fd);
+
+// Поставить команду; false — порт не открыт, payload велик или очередь
+// полна (done не вызывается). done может быть NULL.
+bool cmdchan_send(cmdchan_t *cc, uint8_t cmd, const void *payload, uint16_t len, cmd_done_fn done, void *ctx);
+// Кадр cmd|0x80 из потока чтения; false — не наша команда
+bool cmdchan_on_response(cmdchan_t *cc, const proto_frame_t *f);
+// Повторы и таймауты к моменту now_us, запись буфера передачи в порт (только
+// из потока чтения); мс до ближайшего срока, -1 — ждать нечего
+int cmdchan_poll(cmdchan_t *cc, int64_t now_us);
+
+// Перцентили задержки (отправка -> ответ) по последним CMDCHAN_LAT_RING ответам
+void cmdchan_latency(cmdchan_t *cc, cmd_latency_t *out);
+
+#endif
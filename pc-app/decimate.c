@@ -0,0 +1,116 @@
+#include "decimate.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DECIMATE_X86 1
+#endif
+
+static void span_scalar(const uint16_t *src, size_t n, uint16_t *mn, uint16_t *mx)
+{
+    uint16_t lo = 0xFFFF, hi = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (src[i] < lo) lo = src[i];
+        if (src[i] > hi) hi = src[i];
+    }
+    *mn = lo;
+    *mx = hi;
+}
+
+#ifdef DECIMATE_X86
+// В SSE2 нет беззнакового min/max для u16: сдвигаем в знаковый диапазон
+__attribute__((target("sse2")))
+static void span_sse2(const uint16_t *src, size_t n, uint16_t *mn, uint16_t *mx)
+{
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    __m128i vlo = _mm_set1_epi16(0x7FFF);
+    __m128i vhi = _mm_set1_epi16((short)0x8000);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + i)), bias);
+        vlo = _mm_min_epi16(vlo, v);
+        vhi = _mm_max_epi16(vhi, v);
+    }
+    // горизонтальная свёртка 8 -> 1
+    vlo = _mm_min_epi16(vlo, _mm_shuffle_epi32(vlo, _MM_SHUFFLE(1, 0, 3, 2)));
+    vhi = _mm_max_epi16(vhi, _mm_shuffle_epi32(vhi, _MM_SHUFFLE(1, 0, 3, 2)));
+    vlo = _mm_min_epi16(vlo, _mm_shuffle_epi32(vlo, _MM_SHUFFLE(2, 3, 0, 1)));
+    vhi = _mm_max_epi16(vhi, _mm_shuffle_epi32(vhi, _MM_SHUFFLE(2, 3, 0, 1)));
+    vlo = _mm_min_epi16(vlo, _mm_srli_epi32(vlo, 16));
+    vhi = _mm_max_epi16(vhi, _mm_srli_epi32(vhi, 16));
+    uint16_t lo = (uint16_t)(_mm_cvtsi128_si32(vlo) ^ 0x8000);
+    uint16_t hi = (uint16_t)(_mm_cvtsi128_si32(vhi) ^ 0x8000);
+    for (; i < n; i++) {
+        if (src[i] < lo) lo = src[i];
+        if (src[i] > hi) hi = src[i];
+    }
+    *mn = lo;
+    *mx = hi;
+}
+
+__attribute__((target("avx2")))
+static void span_avx2(const uint16_t *src, size_t n, uint16_t *mn, uint16_t *mx)
+{
+    if (n < 16) {
+        span_sse2(src, n, mn, mx);
+        return;
+    }
+    __m256i vlo = _mm256_set1_epi16((short)0xFFFF);
+    __m256i vhi = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        vlo = _mm256_min_epu16(vlo, v);
+        vhi = _mm256_max_epu16(vhi, v);
+    }
+    // хвост — перекрывающейся загрузкой последних 16 отсчётов
+    if (i < n) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + n - 16));
+        vlo = _mm256_min_epu16(vlo, v);
+        vhi = _mm256_max_epu16(vhi, v);
+    }
+    __m128i lo = _mm_min_epu16(_mm256_castsi256_si128(vlo), _mm256_extracti128_si256(vlo, 1));
+    __m128i hi = _mm_max_epu16(_mm256_castsi256_si128(vhi), _mm256_extracti128_si256(vhi, 1));
+    // _mm_minpos_epu16 даёт минимум из 8; максимум — через инверсию
+    *mn = (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(lo));
+    *mx = (uint16_t)~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(hi, _mm_set1_epi16(-1))));
+}
+
+const decimate_span_fn decimate_span_sse2 = span_sse2;
+const decimate_span_fn decimate_span_avx2 = span_avx2;
+#else
+const decimate_span_fn decimate_span_sse2 = NULL;
+const decimate_span_fn decimate_span_avx2 = NULL;
+#endif
+
+const decimate_span_fn decimate_span_scalar = span_scalar;
+
+static decimate_span_fn pick_span(void)
+{
+#ifdef DECIMATE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return span_avx2;
+    if (__builtin_cpu_supports("sse2")) return span_sse2;
+#endif
+    return span_scalar;
+}
+
+// Столбец c покрывает [c*n/cols, (c+1)*n/cols] — с захватом первого отсчёта
+// следующего столбца, чтобы соседние вертикальные отрезки смыкались.
+void decimate_minmax_with(decimate_span_fn span, const uint16_t *src, size_t n, size_t cols,
+                          uint16_t *mn, uint16_t *mx)
+{
+    for (size_t c = 0; c < cols; c++) {
+        size_t a = c * n / cols;
+        size_t b = (c + 1) * n / cols + 1;
+        if (b > n) b = n;
+        if (a >= b) a = b - 1;
+        span(src + a, b - a, &mn[c], &mx[c]);
+    }
+}
+
+void decimate_minmax(const uint16_t *src, size_t n, size_t cols, uint16_t *mn, uint16_t *mx)
+{
+    static decimate_span_fn span;
+    if (!span) span = pick_span();
+    decimate_minmax_with(span, src, n, cols, mn, mx);
+}
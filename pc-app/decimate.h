@@ -0,0 +1,23 @@
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+// Пиковое прореживание для отрисовки: кадр из n отсчётов сводится к cols
+// парам min/max (по одной на столбец пикселей). Одиночные выбросы остаются
+// видны, а Cairo рисует O(cols) отрезков вместо O(n).
+//
+// Ядра: AVX2, SSE2 и скалярное; выбор при первом вызове по CPUID.
+
+#include <stddef.h>
+#include <stdint.h>
+
+void decimate_minmax(const uint16_t *src, size_t n, size_t cols, uint16_t *mn, uint16_t *mx);
+
+// Для бенчмарка: конкретные ядра (avx2/sse2 — NULL, если не собраны)
+typedef void (*decimate_span_fn)(const uint16_t *src, size_t n, uint16_t *mn, uint16_t *mx);
+extern const decimate_span_fn decimate_span_scalar;
+extern const decimate_span_fn decimate_span_sse2;
+extern const decimate_span_fn decimate_span_avx2;
+void decimate_minmax_with(decimate_span_fn span, const uint16_t *src, size_t n, size_t cols,
+                          uint16_t *mn, uint16_t *mx);
+
+#endif
@@ -0,0 +1,155 @@
+#include "deinterleave.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DEINT_X86 1
+#endif
+
+#define MAX_CH 4
+
+static void scans_scalar(const uint16_t *src, size_t scans, unsigned nch, uint16_t *const *dst)
+{
+    for (unsigned c = 0; c < nch; c++) {
+        const uint16_t *s = src + c;
+        uint16_t *d = dst[c];
+        for (size_t i = 0; i < scans; i++) d[i] = s[i * nch];
+    }
+}
+
+#ifdef DEINT_X86
+// Пара векторов по 8 отсчётов -> чётные и нечётные: в каждой половине
+// слова 0,2,1,3, затем двойные слова 0,2,1,3 и склейка половин
+__attribute__((target("sse2")))
+static inline void split2(__m128i a, __m128i b, __m128i *ev, __m128i *od)
+{
+    a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+    a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+    *ev = _mm_unpacklo_epi64(a, b);
+    *od = _mm_unpackhi_epi64(a, b);
+}
+
+__attribute__((target("sse2")))
+static void d2_sse2(const uint16_t *src, size_t scans, uint16_t *const *dst)
+{
+    size_t i = 0;
+    for (; i + 8 <= scans; i += 8) {
+        __m128i e, o;
+        split2(_mm_loadu_si128((const __m128i *)(src + 2 * i)),
+               _mm_loadu_si128((const __m128i *)(src + 2 * i + 8)), &e, &o);
+        _mm_storeu_si128((__m128i *)(dst[0] + i), e);
+        _mm_storeu_si128((__m128i *)(dst[1] + i), o);
+    }
+    uint16_t *rest[2] = {dst[0] + i, dst[1] + i};
+    scans_scalar(src + 2 * i, scans - i, 2, rest);
+}
+
+// Четыре канала — два раза по чётным/нечётным: после первого прохода в
+// чётных каналы 0 и 2, в нечётных 1 и 3
+__attribute__((target("sse2")))
+static void d4_sse2(const uint16_t *src, size_t scans, uint16_t *const *dst)
+{
+    size_t i = 0;
+    for (; i + 8 <= scans; i += 8) {
+        const __m128i *s = (const __m128i *)(src + 4 * i);
+        __m128i e0, o0, e1, o1, c0, c1, c2, c3;
+        split2(_mm_loadu_si128(s), _mm_loadu_si128(s + 1), &e0, &o0);
+        split2(_mm_loadu_si128(s + 2), _mm_loadu_si128(s + 3), &e1, &o1);
+        split2(e0, e1, &c0, &c2);
+        split2(o0, o1, &c1, &c3);
+        _mm_storeu_si128((__m128i *)(dst[0] + i), c0);
+        _mm_storeu_si128((__m128i *)(dst[1] + i), c1);
+        _mm_storeu_si128((__m128i *)(dst[2] + i), c2);
+        _mm_storeu_si128((__m128i *)(dst[3] + i), c3);
+    }
+    uint16_t *rest[4] = {dst[0] + i, dst[1] + i, dst[2] + i, dst[3] + i};
+    scans_scalar(src + 4 * i, scans - i, 4, rest);
+}
+
+// Три канала: 24 отсчёта (3 вектора) -> по 8 на канал. Отсчёт j канала c —
+// номер 3j + c, вектор (3j + c) / 8; из остальных векторов в маске pshufb
+// байт 0x80 (ноль), затем OR трёх.
+#define D3_B(c, v, j, hi) ((3 * (j) + (c)) / 8 == (v) ? 2 * ((3 * (j) + (c)) % 8) + (hi) : 0x80)
+#define D3_W(c, v, j)     (char)D3_B(c, v, j, 0), (char)D3_B(c, v, j, 1)
+#define D3_MASK(c, v)     _mm_setr_epi8(D3_W(c, v, 0), D3_W(c, v, 1), D3_W(c, v, 2), D3_W(c, v, 3), \
+                                        D3_W(c, v, 4), D3_W(c, v, 5), D3_W(c, v, 6), D3_W(c, v, 7))
+
+__attribute__((target("ssse3")))
+static void d3_ssse3(const uint16_t *src, size_t scans, uint16_t *const *dst)
+{
+    const __m128i mask[3][3] = {
+        {D3_MASK(0, 0), D3_MASK(0, 1), D3_MASK(0, 2)},
+        {D3_MASK(1, 0), D3_MASK(1, 1), D3_MASK(1, 2)},
+        {D3_MASK(2, 0), D3_MASK(2, 1), D3_MASK(2, 2)},
+    };
+    size_t i = 0;
+    for (; i + 8 <= scans; i += 8) {
+        const __m128i *s = (const __m128i *)(src + 3 * i);
+        __m128i a = _mm_loadu_si128(s), b = _mm_loadu_si128(s + 1), d = _mm_loadu_si128(s + 2);
+        for (unsigned c = 0; c < 3; c++) {
+            __m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mask[c][0]), _mm_shuffle_epi8(b, mask[c][1])),
+                                     _mm_shuffle_epi8(d, mask[c][2]));
+            _mm_storeu_si128((__m128i *)(dst[c] + i), r);
+        }
+    }
+    uint16_t *rest[3] = {dst[0] + i, dst[1] + i, dst[2] + i};
+    scans_scalar(src + 3 * i, scans - i, 3, rest);
+}
+
+const deint_fn deint2_sse2 = d2_sse2;
+const deint_fn deint3_ssse3 = d3_ssse3;
+const deint_fn deint4_sse2 = d4_sse2;
+#else
+const deint_fn deint2_sse2 = NULL;
+const deint_fn deint3_ssse3 = NULL;
+const deint_fn deint4_sse2 = NULL;
+#endif
+
+static deint_fn pick(unsigned nch)
+{
+#ifdef DEINT_X86
+    __builtin_cpu_init();
+    if (nch == 2 && __builtin_cpu_supports("sse2")) return d2_sse2;
+    if (nch == 3 && __builtin_cpu_supports("ssse3")) return d3_ssse3;
+    if (nch == 4 && __builtin_cpu_supports("sse2")) return d4_sse2;
+#endif
+    (void)nch;
+    return NULL;
+}
+
+// Голова до первого отсчёта канала 0 и хвост неполного скана — по одному,
+// середина — ядром (fn == NULL — скалярно)
+void deinterleave_with(deint_fn fn, const uint16_t *src, size_t n, unsigned nch, unsigned phase,
+                       uint16_t *const *dst, size_t *counts)
+{
+    size_t cnt[MAX_CH] = {0};
+    size_t head = (nch - phase) % nch;
+    if (head > n) head = n;
+    for (size_t i = 0; i < head; i++) dst[phase + i][cnt[phase + i]++] = src[i];
+
+    size_t scans = (n - head) / nch;
+    uint16_t *body[MAX_CH];
+    for (unsigned c = 0; c < nch; c++) body[c] = dst[c] + cnt[c];
+    if (fn) fn(src + head, scans, body);
+    else scans_scalar(src + head, scans, nch, body);
+    for (unsigned c = 0; c < nch; c++) cnt[c] += scans;
+
+    for (size_t i = head + scans * nch, c = 0; i < n; i++, c++) dst[c][cnt[c]++] = src[i];
+    if (counts) {
+        for (unsigned c = 0; c < nch; c++) counts[c] = cnt[c];
+    }
+}
+
+void deinterleave(const uint16_t *src, size_t n, unsigned nch, unsigned phase, uint16_t *const *dst,
+                  size_t *counts)
+{
+    static deint_fn fns[MAX_CH + 1];
+    static int picked[MAX_CH + 1];
+    if (nch < 1 || nch > MAX_CH || phase >= nch) return;
+    if (!picked[nch]) {
+        fns[nch] = pick(nch);
+        picked[nch] = 1;
+    }
+    deinterleave_with(fns[nch], src, n, nch, phase, dst, counts);
+}
@@ -0,0 +1,35 @@
+#ifndef DEINTERLEAVE_H
+#define DEINTERLEAVE_H
+
+// Разбор кадра из нескольких каналов (режим сканирования АЦП): отсчёты
+// идут по очереди a0 b0 c0 a1 b1 c1 ..., отсчёт i потока — канал
+// (phase + i) % nch. Каждый канал — в свой буфер.
+//
+// Ядра для nch 2 и 4: SSE2 (перестановки слов), для nch 3: SSSE3 (pshufb);
+// скалярное — для любого nch. Выбор при первом вызове по CPUID.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// dst[c] — буфер канала c (не меньше deinterleave_count отсчётов); в
+// counts[c] (можно NULL) — сколько отсчётов получил канал
+void deinterleave(const uint16_t *src, size_t n, unsigned nch, unsigned phase, uint16_t *const *dst,
+                  size_t *counts);
+
+// Сколько из n отсчётов придётся на канал c
+static inline size_t deinterleave_count(size_t n, unsigned nch, unsigned phase, unsigned c)
+{
+    size_t first = (c + nch - phase) % nch;
+    return first < n ? (n - first + nch - 1) / nch : 0;
+}
+
+// Для бенчмарка: ядро для целых сканов с канала 0 (scans сканов по nch
+// отсчётов); NULL, если не собрано
+typedef void (*deint_fn)(const uint16_t *src, size_t scans, uint16_t *const *dst);
+extern const deint_fn deint2_sse2;
+extern const deint_fn deint3_ssse3;
+extern const deint_fn deint4_sse2;
+void deinterleave_with(deint_fn fn, const uint16_t *src, size_t n, unsigned nch, unsigned phase,
+                       uint16_t *const *dst, size_t *counts);
+
+#endif
@@ -0,0 +1,642 @@
+#define _GNU_SOURCE
+#include "devsim.h"
+#include "crc16.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "measure.h"
+#include "osc_codec.h"
+
+#define DEVSIM_MAX_POINTS ((0xFFFF - OSC_META_LEN - 4) / 2)  // с расширением OSC_DATA_EXT
+#define DEVSIM_GARBAGE_MAX 64
+#define DEVSIM_TX_BYTES    (PROTO_MAX_FRAME + DEVSIM_GARBAGE_MAX)
+#define DEVSIM_IDLE_NS     50000000L   // без потока — опрос команд раз в 50 мс
+#define DEVSIM_SEG_POOL    30816       // память сегментов платы, отсчётов (segment.c)
+#define DEVSIM_SEG_HIST    3072        // и её история при pre до блока
+#define DEVSIM_SEG_RATE    50          // событий в секунду
+
+static int64_t mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t next_rnd(devsim_t *d)
+{
+    d->rnd = d->rnd * 1103515245u + 12345u;
+    return d->rnd >> 8;
+}
+
+static bool chance(devsim_t *d, uint32_t ppm)
+{
+    return ppm && next_rnd(d) % 1000000u < ppm;
+}
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+static void put32(uint8_t *p, uint32_t v) { put16(p, v & 0xFFFF); put16(p + 2, v >> 16); }
+static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t get32(const uint8_t *p) { return get16(p) | (uint32_t)get16(p + 2) << 16; }
+
+// DELTA — только если короче PACK12, как на плате
+static uint8_t pick_enc(const uint16_t *s, unsigned n, uint8_t enc)
+{
+    if (enc == OSC_ENC_DELTA && osc_delta_size(s, n, NULL) > OSC_PACK12_BYTES(n)) return OSC_ENC_PACK12;
+    return enc;
+}
+
+static size_t encode(uint8_t *p, const uint16_t *s, unsigned n, uint8_t enc)
+{
+    if (enc == OSC_ENC_PACK12) return osc_pack12_encode(s, n, p);
+    if (enc == OSC_ENC_DELTA) return osc_delta_encode(s, n, p);
+    for (unsigned i = 0; i < n; i++) put16(p + 2 * i, s[i]);
+    return n * 2u;
+}
+
+// Расширение после phase: поля сегмента и bits (у кадра потока — нули)
+static size_t put_seg_bits(const devsim_t *d, uint8_t *p, uint16_t seg, uint16_t nseg, uint64_t t)
+{
+    put16(p, seg);
+    put16(p + 2, nseg);
+    put32(p + 4, (uint32_t)t);
+    put32(p + 8, (uint32_t)(t >> 32));
+    if (d->bits == 12) return 12;
+    p[12] = d->bits;
+    return 13;
+}
+
+// Синусы разной частоты по каналам, сдвиг фазы по варианту и шум ±3 МЗР;
+// u16 — или OSC_DATA, или OSC_DATA_EXT в кодировке cfg.enc (DELTA — только
+// если короче PACK12, как на плате). С передискретизацией (bits > 12) —
+// отсчёты в 2^(bits-12) раз крупнее, шум — те же ±3 МЗР, всегда u16.
+static void build_payloads(devsim_t *d)
+{
+    const devsim_cfg_t *c = &d->cfg;
+    uint16_t *s = malloc(c->points * sizeof(uint16_t));
+    if (!s) return;
+    bool wide = d->bits > 12;
+    bool ext = c->enc != OSC_ENC_RAW16 || c->nch > 1 || wide;
+    d->payload_cmd = ext ? PROTO_CMD_OSC_DATA_EXT : PROTO_CMD_OSC_DATA;
+    for (unsigned v = 0; v < DEVSIM_VARIANTS; v++) {
+        for (unsigned i = 0; i < c->points; i++) {
+            unsigned ch = i % c->nch, k = i / c->nch;
+            double ph = 2 * M_PI * ((double)k * 4 * (ch + 1) / (c->points / c->nch) + (double)v / DEVSIM_VARIANTS);
+            int x = (int)lrint((2048 + 1800 * sin(ph)) * (1 << (d->bits - 12))) + (int)(next_rnd(d) % 7) - 3;
+            s[i] = (uint16_t)x;
+        }
+        uint8_t *p = d->payload[v];
+        put32(p, c->fs_hz);
+        p[4] = 0;
+        put16(p + 5, c->points);
+        put16(p + 7, c->points / 2);
+        size_t n = OSC_META_LEN;
+        if (!ext) {
+            for (unsigned i = 0; i < c->points; i++) put16(p + n + 2 * i, s[i]);
+            n += c->points * 2u;
+        } else {
+            uint8_t enc = wide ? OSC_ENC_RAW16 : pick_enc(s, c->points, c->enc);
+            p[n++] = wide ? 16 : 3;
+            p[n++] = enc;
+            p[n++] = c->nch;
+            p[n++] = 0;
+            if (wide) n += put_seg_bits(d, p + n, 0, 0, 0);
+            n += encode(p + n, s, c->points, enc);
+        }
+        d->payload_len[v] = (uint16_t)n;
+    }
+    free(s);
+}
+
+static void reply(devsim_t *d, const proto_frame_t *f, const uint8_t *p, uint16_t len)
+{
+    if (chance(d, d->cfg.reply_drop_ppm)) {
+        atomic_fetch_add_explicit(&d->replies_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    if (d->reply_len + PROTO_HDR_LEN + len + PROTO_CRC_LEN > sizeof(d->reply)) return;
+    if (!d->reply_len) d->reply_due_ns = mono_ns() + (int64_t)d->cfg.reply_delay_us * 1000;
+    d->reply_len += proto_build(d->reply + d->reply_len, f->seq, f->cmd | PROTO_RESP, p, len);
+}
+
+static void reply_err(devsim_t *d, const proto_frame_t *f, uint8_t err)
+{
+    reply(d, f, &err, 1);
+}
+
+void devsim_loop_h(uint32_t fc_hz, double f_hz, double *gain, double *phase)
+{
+    // H = w0^2 / (w0^2 - w^2 + j·w·w0/Q)
+    double w0 = 2 * M_PI * fc_hz, w = 2 * M_PI * f_hz;
+    double re = w0 * w0 - w * w, im = w * w0 / DEVSIM_LOOP_Q;
+    *gain = w0 * w0 / hypot(re, im);
+    *phase = -atan2(im, re);
+}
+
+// Срабатывание сегмента k — номер отсчёта потока с начала захвата:
+// события через fs·nch / DEVSIM_SEG_RATE отсчётов с разбросом, не чаще
+// длины сегмента. Петля — без триггера: сегменты встык.
+static uint64_t seg_trigger(const devsim_t *d, uint16_t k)
+{
+    if (d->cfg.loop) return d->seg_pre + (uint64_t)k * d->seg_len;
+    uint64_t gap = (uint64_t)d->seg_fs * d->cfg.nch / DEVSIM_SEG_RATE;
+    if (gap < d->seg_len) gap = d->seg_len;
+    return d->seg_pre + (k + 1) * gap + (k * 7919u) % (gap / 4 + 1);
+}
+
+// Готовых сегментов: конец сегмента уже «оцифрован»
+static uint16_t seg_filled(const devsim_t *d)
+{
+    if (!d->seg_mode) return 0;
+    if (d->seg_stopped >= 0) return (uint16_t)d->seg_stopped;
+    double now = (mono_ns() - d->seg_t0_ns) * 1e-9 * d->seg_fs * d->cfg.nch;
+    uint16_t k = 0;
+    while (k < d->seg_n && seg_trigger(d, k) - d->seg_pre + d->seg_len <= now) k++;
+    return k;
+}
+
+// Петля: канал 0 — синус генератора, 1 — он же после фильтра, 2 и 3 —
+// середина шкалы; отсчёт i сегмента k — скан (seg_trigger - pre + i) / nch
+static double loop_sample(const devsim_t *d, uint16_t k, unsigned i, double gain, double shift)
+{
+    unsigned ch = i % d->cfg.nch;
+    if (ch > 1) return 2048;
+    double t = (double)(seg_trigger(d, k) - d->seg_pre + i - ch) / d->cfg.nch / d->seg_fs;
+    double ph = 2 * M_PI * (d->seg_mhz * 1e-3 * t + d->seg_phase / 4294967296.0);
+    return ch ? 2048 + DEVSIM_LOOP_AMP * gain * sin(ph + shift) : 2048 + DEVSIM_LOOP_AMP * sin(ph);
+}
+
+// Кадр сегмента k в tx: OSC_DATA_EXT с seg, nseg и t в расширении
+static void next_segment(devsim_t *d)
+{
+    const devsim_cfg_t *c = &d->cfg;
+    uint16_t k = d->seg_rd++;
+    uint16_t s[DEVSIM_MAX_POINTS];
+    double amp = 600 + (k * 37u) % 1200, gain = 1, shift = 0;
+    if (c->loop) devsim_loop_h(c->loop_fc_hz, d->seg_mhz * 1e-3, &gain, &shift);
+    for (unsigned i = 0; i < d->seg_len; i++) {
+        // Затухающая синусоида с триггера, у каналов своя частота
+        int ch = i % c->nch, j = (int)(i / c->nch) - d->seg_pre / c->nch;
+        double x = j < 0 ? 0 : amp * exp(-j * 5.0 / d->seg_len) * sin(2 * M_PI * j * (ch + 1) * 8 / d->seg_len);
+        if (c->loop) x = loop_sample(d, k, i, gain, shift) - 2048;
+        s[i] = (uint16_t)(lrint((2048 + x) * (1 << (d->bits - 12))) + (int)(next_rnd(d) % 7) - 3);
+    }
+    uint8_t *p = d->seg_payload;
+    put32(p, d->seg_fs);
+    p[4] = 0;
+    put16(p + 5, d->seg_len);
+    put16(p + 7, d->seg_pre);
+    uint8_t enc = d->bits > 12 ? OSC_ENC_RAW16 : pick_enc(s, d->seg_len, c->enc);
+    size_t n = OSC_META_LEN;
+    p[n++] = d->bits > 12 ? 16 : 15;
+    p[n++] = enc;
+    p[n++] = c->nch;
+    p[n++] = 0;
+    n += put_seg_bits(d, p + n, k, d->seg_n, seg_trigger(d, k));
+    n += encode(p + n, s, d->seg_len, enc);
+    d->tx_len = proto_build(d->tx, d->seq++, PROTO_CMD_OSC_DATA_EXT, p, (uint16_t)n);
+    d->tx_off = 0;
+    d->tx_data = false;
+}
+
+static void handle_cmd(devsim_t *d, const proto_frame_t *f)
+{
+    const uint8_t *p = f->payload;
+    uint8_t r[40] = {0};
+    atomic_fetch_add_explicit(&d->commands, 1, memory_order_relaxed);
+    switch (f->cmd) {
+    case 0x10: if (f->len >= 1) d->wave = p[0]; reply_err(d, f, 0); break;
+    case 0x11:
+        if (f->len >= 4) memcpy(&d->freq_mhz, p, 4);
+        atomic_store(&d->out_mhz, d->freq_mhz);
+        reply_err(d, f, 0);
+        break;
+    case 0x12: if (f->len >= 2) memcpy(&d->ampl_mvpp, p, 2); reply_err(d, f, 0); break;
+    case 0x13: if (f->len >= 2) memcpy(&d->offset_mv, p, 2); reply_err(d, f, 0); break;
+    case 0x14: if (f->len >= 2) memcpy(&d->duty_permille, p, 2); reply_err(d, f, 0); break;
+    case PROTO_CMD_GEN_SET_ALL:
+        if (f->len < 11) {
+            reply_err(d, f, PROTO_ERR_PARAM);
+            break;
+        }
+        d->wave = p[0];
+        memcpy(&d->freq_mhz, p + 1, 4);
+        memcpy(&d->ampl_mvpp, p + 5, 2);
+        memcpy(&d->offset_mv, p + 7, 2);
+        memcpy(&d->duty_permille, p + 9, 2);
+        atomic_store(&d->out_mhz, d->freq_mhz);
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_GEN_SET_MODE:
+        if (f->len < 1 || p[0] > PROTO_GEN_MODE_DDS) {
+            reply_err(d, f, PROTO_ERR_PARAM);
+            break;
+        }
+        d->gen_mode = p[0];
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_GEN_SWEEP:
+        reply_err(d, f, f->len >= 13 && d->gen_mode == PROTO_GEN_MODE_DDS ? 0 : PROTO_ERR_PARAM);
+        break;
+    case PROTO_CMD_GEN_UPLOAD:
+        if (f->len < 2 || get16(p) < 1 || get16(p) > PROTO_UPLOAD_MAX_POINTS || f->len < 2 + get16(p) * 2) {
+            reply_err(d, f, PROTO_ERR_PARAM);
+            break;
+        }
+        d->user_len = get16(p);
+        memcpy(d->user, p + 2, d->user_len * 2);
+        d->wave = 6;                        // user
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_GEN_UPLOAD_BEGIN:
+        if (d->cfg.no_chunked) {
+            reply_err(d, f, PROTO_ERR_UNKNOWN);
+            break;
+        }
+        if (f->len < 8 || get32(p) < 1 || get32(p) > PROTO_UPLOAD_MAX_POINTS || get16(p + 4) < 1 ||
+            get16(p + 4) > PROTO_UPLOAD_CHUNK_MAX) {
+            reply_err(d, f, PROTO_ERR_PARAM);
+            break;
+        }
+        d->up_n = get32(p);
+        d->up_chunk = get16(p + 4);
+        d->up_crc = get16(p + 6);
+        memset(d->up_got, 0, sizeof(d->up_got));
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_GEN_UPLOAD_CHUNK: {
+        // Как прошивка: кусок по границе, полный (кроме последнего), CRC данных
+        uint32_t off = f->len >= 8 ? get32(p) : 0, k = d->up_chunk ? off / d->up_chunk : 0;
+        uint16_t n = f->len >= 8 ? get16(p + 4) : 0;
+        bool ok = d->up_n && f->len >= 8 && off % d->up_chunk == 0 && off < d->up_n &&
+                  n == (d->up_n - off < d->up_chunk ? d->up_n - off : d->up_chunk) && f->len >= 8 + n * 2;
+        if (ok && chance(d, d->cfg.chunk_corrupt_ppm)) {
+            atomic_fetch_add_explicit(&d->chunks_corrupted, 1, memory_order_relaxed);
+            ok = false;
+        }
+        if (ok && crc16_ibm(p + 8, n * 2u) == get16(p + 6)) {
+            memcpy(d->up_buf + off, p + 8, n * 2u);
+            d->up_got[k / 8] |= (uint8_t)(1u << (k % 8));
+            reply_err(d, f, 0);
+        } else {
+            reply_err(d, f, PROTO_ERR_PARAM);
+        }
+        break;
+    }
+    case PROTO_CMD_GEN_UPLOAD_COMMIT: {
+        uint16_t missing = 0;
+        r[0] = PROTO_ERR_PARAM;
+        if (d->up_n) {
+            for (uint32_t k = 0; k < (d->up_n + d->up_chunk - 1) / d->up_chunk; k++) {
+                if (!(d->up_got[k / 8] & (1u << (k % 8)))) missing++;
+            }
+            if (!missing && crc16_ibm((const uint8_t *)d->up_buf, d->up_n * 2) == d->up_crc) {
+                memcpy(d->user, d->up_buf, d->up_n * 2);
+                d->user_len = d->up_n;
+                d->wave = 6;                        // user
+                r[0] = 0;
+            }
+        }
+        put16(r + 1, missing);
+        reply(d, f, r, 3);
+        break;
+    }
+    case 0x1F:
+        r[1] = d->wave;
+        put32(r + 2, d->freq_mhz);
+        put16(r + 6, d->ampl_mvpp);
+        put16(r + 8, (uint16_t)d->offset_mv);
+        put16(r + 10, d->duty_permille);
+        r[12] = d->gen_mode;
+        reply(d, f, r, 13);
+        break;
+    case 0x20:
+        if (f->len >= 4 && p[0] | p[1] | p[2] | p[3]) {
+            // Отсчёты кадров от fs не зависят — только поле fs в meta
+            memcpy(&d->cfg.fs_hz, p, 4);
+            for (unsigned v = 0; v < DEVSIM_VARIANTS; v++) put32(d->payload[v], d->cfg.fs_hz);
+        }
+        reply_err(d, f, 0);
+        break;
+    case 0x24:
+        atomic_store(&d->streaming, f->len >= 1 && p[0]);
+        if (f->len >= 1 && p[0]) d->seg_mode = false;     // сегменты теряются
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_CAPTURE_ONCE: {
+        // Разметка как у платы: pre кратно каналам, сегментов — сколько просили
+        // или сколько помещается
+        if (f->len < 4) {
+            reply_err(d, f, PROTO_ERR_PARAM);
+            break;
+        }
+        unsigned pct = get16(p) > 100 ? 100 : get16(p), len = get16(p + 2), want = f->len >= 6 ? get16(p + 4) : 1;
+        if (len < 64) len = 64;
+        if (len > d->cfg.points) len = d->cfg.points;
+        len -= len % d->cfg.nch;
+        unsigned pre = len * pct / 100;
+        pre -= pre % d->cfg.nch;
+        if (pre > len - 1) pre = len - d->cfg.nch;
+        unsigned fit = (DEVSIM_SEG_POOL - DEVSIM_SEG_HIST) / len;
+        if (fit > PROTO_SEG_MAX) fit = PROTO_SEG_MAX;
+        d->seg_mode = true;
+        d->seg_len = (uint16_t)len;
+        d->seg_pre = (uint16_t)pre;
+        d->seg_n = (uint16_t)(want == 0 || want > fit ? fit : want);
+        d->seg_t0_ns = mono_ns();
+        d->seg_fs = d->cfg.fs_hz;
+        if (d->cfg.loop) {
+            d->seg_mhz = atomic_load(&d->cfg.loop->out_mhz);
+            d->seg_phase = next_rnd(d) << 8;
+        }
+        d->seg_stopped = -1;
+        d->seg_rd = d->seg_rd_end = 0;
+        d->seg_rd_seq = -1;
+        r[0] = 0;
+        put16(r + 1, d->seg_n);
+        reply(d, f, r, 3);
+        break;
+    }
+    case PROTO_CMD_SEG_STATUS: {
+        uint16_t filled = seg_filled(d);
+        r[1] = !d->seg_mode ? PROTO_SEG_IDLE : filled == d->seg_n || d->seg_stopped >= 0 ? PROTO_SEG_DONE
+                                                                                          : PROTO_SEG_ARMED;
+        put16(r + 2, filled);
+        put16(r + 4, d->seg_mode ? d->seg_n : 0);
+        put16(r + 6, d->seg_len);
+        put16(r + 8, d->seg_pre);
+        put32(r + 10, DEVSIM_SEG_POOL);
+        reply(d, f, r, 14);
+        break;
+    }
+    case PROTO_CMD_SEG_READ:
+        // Повтор того же seq (ответ потерян) пачку заново не шлёт, как плата
+        if (f->len >= 4 && d->seg_mode && f->seq == d->seg_rd_seq) {
+            reply_err(d, f, 0);
+            break;
+        }
+        if (f->len < 4 || !get16(p + 2) || (uint32_t)get16(p) + get16(p + 2) > seg_filled(d)) {
+            reply_err(d, f, PROTO_ERR_PARAM);
+            break;
+        }
+        d->seg_rd = get16(p);
+        d->seg_rd_end = get16(p) + get16(p + 2);
+        d->seg_rd_seq = f->seq;
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_SEG_STOP:
+        if (!d->seg_mode) {
+            reply_err(d, f, PROTO_ERR_PARAM);
+            break;
+        }
+        if (d->seg_stopped < 0) d->seg_stopped = seg_filled(d);
+        put16(r + 1, (uint16_t)d->seg_stopped);
+        reply(d, f, r, 3);
+        break;
+    case PROTO_CMD_SET_ENC:
+        if (f->len < 1 || p[0] >= OSC_ENC_COUNT) {
+            reply_err(d, f, 1);
+            break;
+        }
+        d->cfg.enc = p[0];
+        build_payloads(d);
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_SET_GAIN:
+        if (f->len < 1 || p[0] >= MEAS_GAIN_STEPS) {
+            reply_err(d, f, 1);
+            break;
+        }
+        d->gain_step = p[0];
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_SET_CH:
+        if (f->len < 1 || p[0] < 1 || p[0] > OSC_MAX_CH) {
+            reply_err(d, f, 1);
+            break;
+        }
+        d->cfg.nch = p[0];
+        build_payloads(d);
+        reply_err(d, f, 0);
+        break;
+    case PROTO_CMD_SET_OVS:
+        // Разрядность — какую просили: АЦП симулятора успевает всегда
+        if (f->len < 1 || p[0] < 12 || p[0] > PROTO_OVS_MAX_BITS || d->seg_mode) {
+            r[0] = 1;
+            r[1] = d->bits;
+            reply(d, f, r, 2);
+            break;
+        }
+        d->bits = p[0];
+        build_payloads(d);
+        r[1] = d->bits;
+        reply(d, f, r, 2);
+        break;
+    case PROTO_CMD_OSC_STATS:
+        // Счётчики платы; такты — микросекунды, задержек нет
+        put32(r + 1, (uint32_t)atomic_load(&d->frames_sent));
+        put32(r + 5, (uint32_t)atomic_load(&d->overruns));
+        put32(r + 13, 1000000);
+        r[35] = 1;
+        reply(d, f, r, 36);
+        break;
+    case PROTO_CMD_OSC_STATUS:
+        put32(r + 1, d->cfg.fs_hz);
+        r[5] = d->gain_step;
+        put16(r + 10, d->cfg.points);
+        r[12] = OSC_ENC_BIT(OSC_ENC_RAW16) | OSC_ENC_BIT(OSC_ENC_PACK12) | OSC_ENC_BIT(OSC_ENC_DELTA);
+        r[13] = d->cfg.nch;
+        r[14] = OSC_MAX_CH;
+        r[15] = d->bits;
+        r[16] = PROTO_OVS_MAX_BITS;
+        reply(d, f, r, 17);
+        break;
+    default:
+        // set_trigger: принять и подтвердить
+        reply_err(d, f, 0);
+        break;
+    }
+}
+
+// Следующий кадр данных в tx: мусор, заголовок, payload, CRC
+static bool next_frame(devsim_t *d)
+{
+    const devsim_cfg_t *c = &d->cfg;
+    uint64_t sent = atomic_load_explicit(&d->frames_sent, memory_order_relaxed);
+    bool last = c->frames && sent + 1 == c->frames;
+    uint16_t seq = d->seq++;
+    if (!last && chance(d, c->drop_ppm)) {
+        atomic_fetch_add_explicit(&d->drop_injected, 1, memory_order_relaxed);
+        return false;
+    }
+    size_t n = 0;
+    if (!last && chance(d, c->garbage_ppm)) {
+        size_t g = 1 + next_rnd(d) % DEVSIM_GARBAGE_MAX;
+        for (size_t i = 0; i < g; i++) {
+            uint8_t b = (uint8_t)next_rnd(d);
+            d->tx[n++] = b == PROTO_SYNC0 ? 0 : b;
+        }
+        atomic_fetch_add_explicit(&d->garbage_bytes, g, memory_order_relaxed);
+    }
+    unsigned v = d->variant++ % DEVSIM_VARIANTS;
+    size_t flen = proto_build(d->tx + n, seq, d->payload_cmd, d->payload[v], d->payload_len[v]);
+    if (!last && chance(d, c->crc_ppm)) {
+        d->tx[n + flen - 1] ^= 0x5A;
+        atomic_fetch_add_explicit(&d->crc_injected, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&d->crc_bytes, flen, memory_order_relaxed);
+    }
+    d->tx_len = n + flen;
+    d->tx_off = 0;
+    d->tx_data = true;
+    d->tx_seq = seq;
+    atomic_fetch_add_explicit(&d->frames_sent, 1, memory_order_relaxed);
+    if (last) atomic_store(&d->done, true);
+    return true;
+}
+
+static void read_commands(devsim_t *d)
+{
+    proto_frame_t f;
+    for (;;) {
+        size_t space;
+        uint8_t *dst = proto_rx_write_ptr(&d->rx, &space);
+        ssize_t r = read(d->master, dst, space);
+        if (r <= 0) break;
+        proto_rx_commit(&d->rx, (size_t)r);
+        while (proto_rx_next(&d->rx, &f)) handle_cmd(d, &f);
+    }
+}
+
+// Один поток: команды читаются между кадрами, ответы уходят на границе
+// кадров, поток данных идёт по часам (или так быстро, как читает приёмник)
+static void *devsim_thread(void *arg)
+{
+    devsim_t *d = arg;
+    int64_t due = mono_ns();
+
+    while (atomic_load(&d->run)) {
+        bool streaming = atomic_load(&d->streaming) && !atomic_load(&d->done) && !d->seg_mode;
+        int64_t now = mono_ns();
+        // Ответ ещё «в линии» (reply_delay_us): следом за ним — ничего
+        bool held = d->reply_len && now < d->reply_due_ns;
+        if (d->tx_off == d->tx_len && !held) {
+            if (d->reply_len) {
+                memcpy(d->tx, d->reply, d->reply_len);
+                d->tx_len = d->reply_len;
+                d->tx_off = 0;
+                d->tx_data = false;
+                d->reply_len = 0;
+            } else if (d->seg_rd != d->seg_rd_end) {
+                next_segment(d);
+                continue;
+            } else if (streaming && (d->cfg.rate == 0 || now >= due)) {
+                if (d->cfg.rate) {
+                    due += 1000000000LL / d->cfg.rate;
+                    if (now - due > 1000000000LL) due = now;   // отстали больше чем на секунду
+                }
+                next_frame(d);
+                continue;
+            }
+        }
+        // Линия не успевает: кадр, которому пора, теряется в «кольце платы»
+        // (seq не растёт, как на плате — см. get_osc_stats.overruns)
+        if (streaming && d->cfg.rate && d->tx_off < d->tx_len && now >= due) {
+            due += 1000000000LL / d->cfg.rate;
+            atomic_fetch_add_explicit(&d->overruns, 1, memory_order_relaxed);
+        }
+        struct pollfd pfd = {.fd = d->master, .events = atomic_load(&d->mute) ? 0 : POLLIN};
+        int64_t wait = DEVSIM_IDLE_NS;
+        if (d->tx_off < d->tx_len) {
+            pfd.events |= POLLOUT;
+        } else if (held) {
+            wait = d->reply_due_ns - now;
+        } else if (streaming) {
+            wait = due - now;
+            if (wait < 0) wait = 0;
+            if (wait > DEVSIM_IDLE_NS) wait = DEVSIM_IDLE_NS;
+        }
+        struct timespec ts = {wait / 1000000000, wait % 1000000000};
+        if (ppoll(&pfd, 1, &ts, NULL) <= 0) continue;
+        if (pfd.revents & POLLIN) read_commands(d);
+        if (pfd.revents & POLLOUT) {
+            if (d->tx_data) atomic_store_explicit(&d->sent_us[d->tx_seq], mono_ns() / 1000, memory_order_release);
+            ssize_t w = write(d->master, d->tx + d->tx_off, d->tx_len - d->tx_off);
+            if (w > 0) {
+                d->tx_off += (size_t)w;
+                atomic_fetch_add_explicit(&d->bytes_sent, (uint64_t)w, memory_order_relaxed);
+            }
+        }
+    }
+    return NULL;
+}
+
+bool devsim_start(devsim_t *d, const devsim_cfg_t *cfg)
+{
+    memset(d, 0, sizeof(*d));
+    d->cfg = *cfg;
+    if (d->cfg.points < 2) d->cfg.points = 2;
+    if (d->cfg.points > DEVSIM_MAX_POINTS) d->cfg.points = DEVSIM_MAX_POINTS;
+    if (d->cfg.nch < 1 || d->cfg.nch > OSC_MAX_CH) d->cfg.nch = 1;
+    if (d->cfg.enc >= OSC_ENC_COUNT) d->cfg.enc = OSC_ENC_RAW16;
+    if (!d->cfg.fs_hz) d->cfg.fs_hz = 1000000;
+    d->rnd = 1;
+    d->seg_rd_seq = -1;
+    d->bits = 12;
+    d->freq_mhz = 1000000;
+    atomic_store(&d->out_mhz, d->freq_mhz);
+    d->ampl_mvpp = 1000;
+    d->duty_permille = 500;
+
+    if (openpty(&d->master, &d->slave, d->path, NULL, NULL) != 0) return false;
+    // Сырой режим сразу: до открытия порта приёмником линия не должна
+    // ничего переделывать (эхо, канонический ввод)
+    struct termios tio;
+    tcgetattr(d->slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(d->slave, TCSANOW, &tio);
+    fcntl(d->master, F_SETFL, fcntl(d->master, F_GETFL) | O_NONBLOCK);
+
+    d->tx = malloc(DEVSIM_TX_BYTES);
+    d->sent_us = calloc(65536, sizeof(*d->sent_us));
+    bool ok = d->tx && d->sent_us && proto_rx_init(&d->rx, 4096);
+    for (unsigned v = 0; v < DEVSIM_VARIANTS && ok; v++) ok = (d->payload[v] = malloc(0x10000)) != NULL;
+    ok = ok && (d->seg_payload = malloc(0x10000)) != NULL;
+    if (ok) {
+        build_payloads(d);
+        atomic_store(&d->streaming, d->cfg.stream);
+        atomic_store(&d->run, true);
+        ok = pthread_create(&d->thread, NULL, devsim_thread, d) == 0;
+        if (!ok) atomic_store(&d->run, false);
+    }
+    if (!ok) {
+        devsim_stop(d);
+        return false;
+    }
+    return true;
+}
+
+void devsim_stop(devsim_t *d)
+{
+    if (atomic_exchange(&d->run, false)) pthread_join(d->thread, NULL);
+    if (d->master > 0) close(d->master);
+    if (d->slave > 0) close(d->slave);
+    d->master = d->slave = -1;
+    proto_rx_free(&d->rx);
+    free(d->tx);
+    d->tx = NULL;
+    free(d->sent_us);
+    d->sent_us = NULL;
+    for (unsigned v = 0; v < DEVSIM_VARIANTS; v++) {
+        free(d->payload[v]);
+        d->payload[v] = NULL;
+    }
+    free(d->seg_payload);
+    d->seg_payload = NULL;
+}
@@ -0,0 +1,135 @@
+#ifndef DEVSIM_H
+#define DEVSIM_H
+
+// Симулятор платы на псевдотерминале (openpty): отвечает на команды
+// docs/protocol.md за обе платы (генератор и осциллограф) и шлёт поток
+// OSC_DATA/OSC_DATA_EXT с заданными размером кадра, частотой кадров и
+// ошибками. Приёмник открывает devsim_t.path как обычный порт. Используют
+// bench/bench_e2e (в том же процессе) и osc_sim (для GUI без плат).
+//
+// Ошибки — детерминированные (свой генератор), на миллион кадров:
+//   crc_ppm     — у кадра испорчен CRC (приёмник теряет кадр целиком)
+//   drop_ppm    — кадр не отправлен, seq всё равно растёт (разрыв seq)
+//   garbage_ppm — перед кадром 1..64 байт мусора без байта sync
+//   reply_drop_ppm — на миллион команд: команда выполнена, ответ потерян
+//   chunk_corrupt_ppm — на миллион кусков upload_chunk: кусок пришёл
+//                    испорченным (CRC не сходится, ответ err = 1)
+//   reply_delay_us — ответ уходит не раньше стольких мкс после команды
+//                    (опрос USB, очередь платы); за ним ждёт и поток
+// Плата «зависла» (mute) — команды не читаются вовсе, поток идёт.
+// Сегментный захват (capture_once): поток стоит, события приходят по
+// часам — 50 в секунду, сегмент — затухающая синусоида с триггером на
+// pretrig; seg_read выгружает их кадрами между ответами, как плата.
+// При заданном cfg.frames последний кадр всегда целый: по нему приёмник
+// досчитывает разрыв seq.
+// Петля (cfg.loop — devsim генератора): сегменты — синус генератора с его
+// частотой на момент capture_once (канал 0) и он же после фильтра нижних
+// частот 2-го порядка с частотой среза cfg.loop_fc_hz (канал 1); триггер
+// не ждёт — сегменты идут встык. Для bench/bench_bode.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "proto.h"
+
+#define DEVSIM_VARIANTS 16  // разных кадров по кругу: картинка «бежит»
+#define DEVSIM_LOOP_Q   2.0 // добротность фильтра петли: подъём у среза
+#define DEVSIM_LOOP_AMP 800 // амплитуда синуса петли, коды 12 бит
+
+typedef struct devsim devsim_t;
+
+typedef struct {
+    uint16_t points;        // отсчётов в кадре (всех каналов)
+    uint32_t rate;          // кадров/с, 0 — сколько примет линия
+    uint32_t fs_hz;
+    uint8_t enc;            // OSC_ENC_*
+    uint8_t nch;            // 1..OSC_MAX_CH
+    bool stream;            // поток сразу, не дожидаясь stream_on
+    uint64_t frames;        // остановиться после стольких кадров, 0 — нет
+    uint32_t crc_ppm;
+    uint32_t drop_ppm;
+    uint32_t garbage_ppm;
+    uint32_t reply_drop_ppm;
+    uint32_t chunk_corrupt_ppm;
+    bool no_chunked;        // старая прошивка: upload_begin неизвестна
+    uint32_t reply_delay_us;
+    const devsim_t *loop;   // петля: генератор; NULL — сегменты как обычно
+    uint32_t loop_fc_hz;
+} devsim_cfg_t;
+
+struct devsim {
+    devsim_cfg_t cfg;
+    int master, slave;
+    char path[64];          // имя slave-конца (/dev/pts/N)
+    pthread_t thread;
+    _Atomic bool run;
+    _Atomic bool streaming;
+    _Atomic bool mute;      // не отвечать: команды копятся в порту
+    proto_rx_t rx;          // команды от ПК
+    // Передача: кадр (и ответы между кадрами) целиком, потом следующий
+    uint8_t *tx;
+    size_t tx_len, tx_off;
+    bool tx_data;           // в tx кадр данных tx_seq (а не ответы)
+    uint16_t tx_seq;
+    uint8_t reply[1024];
+    size_t reply_len;
+    int64_t reply_due_ns;   // первый ответ в reply[] — не раньше
+    // Заготовки payload (meta + отсчёты); при отправке — только заголовок и CRC
+    uint8_t *payload[DEVSIM_VARIANTS];
+    uint16_t payload_len[DEVSIM_VARIANTS];
+    uint8_t payload_cmd;
+    uint32_t variant;
+    uint16_t seq;
+    uint32_t rnd;
+    uint8_t gain_step;      // set_gain, для get_osc_status
+    uint8_t bits;           // set_oversample: отсчёты 12..16 бит
+    // Сегментный захват
+    bool seg_mode;
+    uint16_t seg_len, seg_pre, seg_n;
+    int64_t seg_t0_ns;      // начало захвата
+    int seg_stopped;        // seg_stop: сколько было готово, -1 — идёт
+    uint16_t seg_rd, seg_rd_end;
+    int32_t seg_rd_seq;     // seq последнего seg_read, -1 — нет
+    uint8_t *seg_payload;
+    uint32_t seg_fs;        // fs на момент capture_once, как у платы
+    uint32_t seg_mhz;       // петля: частота генератора тогда же
+    uint32_t seg_phase;     // петля: фаза синуса в начале сегмента, 1/2^32 периода
+    // Состояние генератора (get_gen_status)
+    uint8_t wave, gen_mode;
+    uint32_t freq_mhz;
+    uint16_t ampl_mvpp, duty_permille;
+    int16_t offset_mv;
+    _Atomic uint32_t out_mhz;           // частота на выходе — её читает петля осциллографа
+    // Форма user: последняя принятая (upload_wave или upload_commit)
+    uint16_t user[PROTO_UPLOAD_MAX_POINTS];
+    uint32_t user_len;
+    uint16_t up_buf[PROTO_UPLOAD_MAX_POINTS];
+    uint32_t up_n;          // 0 — загрузка не начата
+    uint16_t up_chunk, up_crc;
+    uint8_t up_got[PROTO_UPLOAD_MAX_POINTS / 8];
+    // Счётчики
+    _Atomic uint64_t frames_sent;       // кадров данных отправлено (и с битым CRC)
+    _Atomic uint64_t bytes_sent;        // всего байт в линию
+    _Atomic uint64_t crc_injected;
+    _Atomic uint64_t crc_bytes;         // длина кадров с битым CRC
+    _Atomic uint64_t drop_injected;
+    _Atomic uint64_t garbage_bytes;
+    _Atomic uint64_t overruns;          // кадру пора, а линия занята (при cfg.rate)
+    _Atomic uint64_t commands;          // принято команд
+    _Atomic uint64_t replies_dropped;
+    _Atomic uint64_t chunks_corrupted;
+    _Atomic bool done;                  // отправлено cfg.frames кадров
+    // CLOCK_MONOTONIC, мкс: начало последнего write() кадра seq — отсюда
+    // задержка приёма (rx_us - sent_us[seq]) в bench_e2e
+    _Atomic int64_t *sent_us;           // 65536, по seq
+};
+
+bool devsim_start(devsim_t *d, const devsim_cfg_t *cfg);
+void devsim_stop(devsim_t *d);
+
+// Фильтр петли на частоте f: усиление (раз) и сдвиг фазы (рад)
+void devsim_loop_h(uint32_t fc_hz, double f_hz, double *gain, double *phase);
+
+#endif
@@ -0,0 +1,108 @@
+#include "frameq.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+bool frameq_init(frameq_t *q, uint32_t nslots, uint32_t max_points)
+{
+    memset(q, 0, sizeof(*q));
+    sem_init(&q->ready, 0, 0);
+    q->slots = calloc(nslots, sizeof(osc_frame_t));
+    if (!q->slots) return false;
+    q->nslots = nslots;
+    q->max_points = max_points;
+    for (uint32_t i = 0; i < nslots; i++) {
+        q->slots[i].samples = malloc(max_points * sizeof(uint16_t));
+        if (!q->slots[i].samples) {
+            frameq_free(q);
+            return false;
+        }
+    }
+    return true;
+}
+
+void frameq_free(frameq_t *q)
+{
+    if (q->slots) {
+        for (uint32_t i = 0; i < q->nslots; i++) free(q->slots[i].samples);
+        free(q->slots);
+    }
+    sem_destroy(&q->ready);
+    memset(q, 0, sizeof(*q));
+}
+
+osc_frame_t *frameq_begin(frameq_t *q)
+{
+    uint64_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head - tail >= q->nslots) {
+        atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    return &q->slots[head % q->nslots];
+}
+
+void frameq_publish(frameq_t *q)
+{
+    uint64_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&q->produced, 1, memory_order_relaxed);
+    sem_post(&q->ready);
+}
+
+bool frameq_has_new(frameq_t *q)
+{
+    uint64_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    return head - tail > (q->has_cur ? 1u : 0u);
+}
+
+const osc_frame_t *frameq_latest(frameq_t *q)
+{
+    uint64_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint64_t cur = q->has_cur ? tail + 1 : tail;
+
+    if (head > cur) {
+        // Берём новейший, промежуточные (и прежний текущий) освобождаем
+        uint64_t newest = head - 1;
+        atomic_fetch_add_explicit(&q->skipped, newest - cur, memory_order_relaxed);
+        atomic_fetch_add_explicit(&q->rendered, 1, memory_order_relaxed);
+        atomic_store_explicit(&q->tail, newest, memory_order_release);
+        q->has_cur = true;
+        tail = newest;
+    }
+    return q->has_cur ? &q->slots[tail % q->nslots] : NULL;
+}
+
+const osc_frame_t *frameq_next(frameq_t *q)
+{
+    uint64_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint64_t cur = q->has_cur ? tail + 1 : tail;
+
+    if (head == cur) return NULL;
+    atomic_fetch_add_explicit(&q->rendered, 1, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, cur, memory_order_release);
+    q->has_cur = true;
+    return &q->slots[cur % q->nslots];
+}
+
+void frameq_wait(frameq_t *q, unsigned timeout_us)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long)(timeout_us % 1000000) * 1000;
+    ts.tv_sec += timeout_us / 1000000 + ts.tv_nsec / 1000000000;
+    ts.tv_nsec %= 1000000000;
+    sem_timedwait(&q->ready, &ts);
+}
+
+void frameq_copy(osc_frame_t *dst, const osc_frame_t *src)
+{
+    uint16_t *samples = dst->samples;
+    *dst = *src;
+    dst->samples = samples;
+    memcpy(samples, src->samples, src->nsamples * sizeof(uint16_t));
+}
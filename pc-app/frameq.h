@@ -0,0 +1,69 @@
+#ifndef FRAMEQ_H
+#define FRAMEQ_H
+
+// Очередь кадров осциллографа: один писатель (поток чтения порта), один
+// читатель (отрисовка). Без блокировок: буферы выделены заранее, писатель
+// никогда не ждёт — при заполненной очереди кадр отбрасывается и считается.
+// Читатель забирает самый свежий готовый кадр (frameq_latest) или все по
+// порядку (frameq_next) и держит выданный кадр до следующего вызова.
+
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "measure.h"
+
+typedef struct {
+    uint32_t fs_hz;
+    uint8_t ch;
+    uint16_t seq;
+    uint16_t nsamples;
+    uint16_t pretrig;
+    int64_t rx_us;       // g_get_monotonic_time() при разборе (для задержки)
+    uint16_t *samples;   // max_points отсчётов
+    // Несколько каналов: канал c — samples[ch_off[c]..+ch_len[c]), подряд;
+    // у одного канала ch_off[0] = 0, ch_len[0] = nsamples
+    uint8_t nch;
+    uint8_t phase;       // канал первого отсчёта кадра: каналы до него начинаются скан спустя
+    uint16_t ch_off[4];  // OSC_MAX_CH
+    uint16_t ch_len[4];
+    meas_t meas[4];      // измерения по каналам, считает поток чтения
+    uint16_t seg, nseg;  // сегмент seg из nseg (capture_once); nseg = 0 — кадр потока
+    uint64_t seg_t;      // отсчёт срабатывания сегмента с начала захвата
+    uint8_t bits;        // разрядность: коды 0..4095·2^(bits-12)
+} osc_frame_t;
+
+typedef struct {
+    osc_frame_t *slots;
+    uint32_t nslots;
+    uint32_t max_points;
+    _Atomic uint64_t head;      // пишет только писатель
+    _Atomic uint64_t tail;      // пишет только читатель
+    bool has_cur;               // у читателя есть кадр (слот tail)
+    sem_t ready;                // для читателя в своём потоке (frameq_wait)
+    // Счётчики
+    _Atomic uint64_t produced;  // опубликовано писателем
+    _Atomic uint64_t dropped;   // очередь была полна, кадр не принят
+    _Atomic uint64_t rendered;  // выдано читателю
+    _Atomic uint64_t skipped;   // опубликовано, но вытеснено более свежим
+} frameq_t;
+
+bool frameq_init(frameq_t *q, uint32_t nslots, uint32_t max_points);
+void frameq_free(frameq_t *q);
+
+// Писатель: свободный слот или NULL (очередь полна), затем publish.
+osc_frame_t *frameq_begin(frameq_t *q);
+void frameq_publish(frameq_t *q);
+
+// Читатель: есть ли кадр новее текущего; самый свежий кадр (или NULL).
+bool frameq_has_new(frameq_t *q);
+const osc_frame_t *frameq_latest(frameq_t *q);
+const osc_frame_t *frameq_next(frameq_t *q);
+// Ждать публикации не дольше timeout_us (писателя не блокирует)
+void frameq_wait(frameq_t *q, unsigned timeout_us);
+
+// Кадр целиком (поля и nsamples отсчётов) в слот другой очереди
+void frameq_copy(osc_frame_t *dst, const osc_frame_t *src);
+
+#endif
@@ -0,0 +1,106 @@
+#include "linkstats.h"
+
+#include <string.h>
+
+void linkstats_reset(linkstats_t *ls)
+{
+    memset(ls, 0, sizeof(*ls));
+}
+
+void linkstats_on_read(linkstats_t *ls, size_t n)
+{
+    atomic_fetch_add_explicit(&ls->bytes, n, memory_order_relaxed);
+}
+
+void linkstats_on_wakeup(linkstats_t *ls)
+{
+    atomic_fetch_add_explicit(&ls->wakeups, 1, memory_order_relaxed);
+}
+
+// Разрыв seq: кадры OSC_DATA идут с seq+1; разница больше половины
+// диапазона — повтор или перестановка, а не потеря
+void linkstats_on_data(linkstats_t *ls, uint16_t seq)
+{
+    atomic_fetch_add_explicit(&ls->frames, 1, memory_order_relaxed);
+    if (ls->have_seq) {
+        uint16_t d = (uint16_t)(seq - ls->last_seq);
+        if (d == 0 || d > 0x8000) {
+            atomic_fetch_add_explicit(&ls->seq_errors, 1, memory_order_relaxed);
+        } else if (d > 1) {
+            atomic_fetch_add_explicit(&ls->seq_lost, d - 1, memory_order_relaxed);
+        }
+    }
+    ls->have_seq = true;
+    ls->last_seq = seq;
+}
+
+void linkstats_sync_rx(linkstats_t *ls, const proto_rx_t *rx)
+{
+    atomic_store_explicit(&ls->crc_errors, rx->crc_errors, memory_order_relaxed);
+    atomic_store_explicit(&ls->bad_headers, rx->bad_headers, memory_order_relaxed);
+    atomic_store_explicit(&ls->skipped_bytes, rx->skipped_bytes, memory_order_relaxed);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// {u8 err; u32 frames_sent; u32 overruns; u32 rx_crc_errors; u32 core_hz;
+//  u32 isr_max_cyc; u32 isr_avg_cyc; u32 lat_max_cyc; u32 lat_avg_cyc;
+//  u8 backlog; u8 backlog_max; u8 ring_frames}
+bool linkstats_on_board(linkstats_t *ls, const uint8_t *p, uint16_t len)
+{
+    if (len < 36 || p[0] != 0) return false;
+    uint32_t v = atomic_load_explicit(&ls->board_ver, memory_order_relaxed);
+    atomic_store_explicit(&ls->board_ver, v + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    ls->board.frames_sent = get32(&p[1]);
+    ls->board.overruns = get32(&p[5]);
+    ls->board.rx_crc_errors = get32(&p[9]);
+    ls->board.core_hz = get32(&p[13]);
+    ls->board.isr_max_cyc = get32(&p[17]);
+    ls->board.isr_avg_cyc = get32(&p[21]);
+    ls->board.lat_max_cyc = get32(&p[25]);
+    ls->board.lat_avg_cyc = get32(&p[29]);
+    ls->board.backlog = p[33];
+    ls->board.backlog_max = p[34];
+    ls->board.ring_frames = p[35];
+    atomic_store_explicit(&ls->board_ver, v + 2, memory_order_release);
+    return true;
+}
+
+bool linkstats_board(linkstats_t *ls, board_stats_t *out)
+{
+    for (;;) {
+        uint32_t v = atomic_load_explicit(&ls->board_ver, memory_order_acquire);
+        if (v == 0) return false;       // ответа ещё не было
+        if (v & 1) continue;
+        memcpy(out, &ls->board, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&ls->board_ver, memory_order_relaxed) == v) return true;
+    }
+}
+
+void linkstats_rates(linkstats_t *ls, int64_t now_us)
+{
+    uint64_t bytes = atomic_load_explicit(&ls->bytes, memory_order_relaxed);
+    uint64_t frames = atomic_load_explicit(&ls->frames, memory_order_relaxed);
+    uint64_t wakeups = atomic_load_explicit(&ls->wakeups, memory_order_relaxed);
+    if (ls->prev_us && now_us > ls->prev_us) {
+        double dt = (now_us - ls->prev_us) * 1e-6;
+        ls->mbps = (bytes - ls->prev_bytes) / dt / 1e6;
+        ls->fps = (frames - ls->prev_frames) / dt;
+        ls->wps = (wakeups - ls->prev_wakeups) / dt;
+    }
+    ls->prev_bytes = bytes;
+    ls->prev_frames = frames;
+    ls->prev_wakeups = wakeups;
+    ls->prev_us = now_us;
+}
+
+void linkstats_on_display(linkstats_t *ls, int64_t latency_us)
+{
+    if (ls->disp_lat_us == 0) ls->disp_lat_us = latency_us;
+    else ls->disp_lat_us += (latency_us - ls->disp_lat_us) / 16;
+}
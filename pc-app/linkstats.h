@@ -0,0 +1,60 @@
+#ifndef LINKSTATS_H
+#define LINKSTATS_H
+
+// Телеметрия линии осциллографа. Счётчики пишет поток чтения, читает GUI;
+// скорости считаются в GUI по разнице снимков (linkstats_rates).
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "proto.h"
+
+// Ответ get_osc_stats (см. docs/protocol.md)
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t overruns;          // кадров потеряно в кольце платы
+    uint32_t rx_crc_errors;     // битых команд на стороне платы
+    uint32_t core_hz;
+    uint32_t isr_max_cyc, isr_avg_cyc;
+    uint32_t lat_max_cyc, lat_avg_cyc;  // кадр готов -> передан
+    uint8_t backlog, backlog_max, ring_frames;
+} board_stats_t;
+
+typedef struct {
+    // Поток чтения
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t wakeups;       // пробуждений потока чтения
+    _Atomic uint64_t frames;        // OSC_DATA
+    _Atomic uint64_t seq_lost;      // кадров пропущено по разрыву seq
+    _Atomic uint64_t seq_errors;    // повтор или seq назад
+    _Atomic uint64_t crc_errors;    // из proto_rx_t
+    _Atomic uint64_t bad_headers;
+    _Atomic uint64_t skipped_bytes;
+    bool have_seq;
+    uint16_t last_seq;
+    // Ответ get_osc_stats: копия под seqlock (пишет поток чтения)
+    _Atomic uint32_t board_ver;     // нечётное — идёт запись
+    board_stats_t board;
+    // GUI: прошлый снимок для скоростей и задержка приём -> экран
+    uint64_t prev_bytes, prev_frames, prev_wakeups;
+    int64_t prev_us;
+    double mbps, fps, wps;
+    double disp_lat_us;             // скользящее среднее
+} linkstats_t;
+
+void linkstats_reset(linkstats_t *ls);
+
+// Поток чтения
+void linkstats_on_read(linkstats_t *ls, size_t n);
+void linkstats_on_wakeup(linkstats_t *ls);
+void linkstats_on_data(linkstats_t *ls, uint16_t seq);
+void linkstats_sync_rx(linkstats_t *ls, const proto_rx_t *rx);
+bool linkstats_on_board(linkstats_t *ls, const uint8_t *payload, uint16_t len);
+
+// GUI
+void linkstats_rates(linkstats_t *ls, int64_t now_us);
+void linkstats_on_display(linkstats_t *ls, int64_t latency_us);
+bool linkstats_board(linkstats_t *ls, board_stats_t *out);
+
+#endif
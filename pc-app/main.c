@@ -3,33 +3,267 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
-#include <termios.h>
-#include <fcntl.h>
 #include <string.h>
+#include <math.h>
+
+#include "proto.h"
+#include "frameq.h"
+#include "decimate.h"
+#include "persist.h"
+#include "spectrum.h"
+#include "linkstats.h"
+#include "unpack.h"
+#include "recorder.h"
+#include "reader.h"
+#include "cmdchan.h"
+#include "upload.h"
+#include "bode.h"
 
 // Коммуникация простая: посылаем кадры протокола (см. docs/protocol.md) по USB CDC/UART.
 // Здесь добавлен поток чтения осциллографа и минимальный рендер данных.
 
-// Можно улучшить: вынести протокол в отдельный модуль и добавить поток получения данных осциллографа.
-
 typedef struct {
     int fd_osc;
     int fd_gen;
     GtkDrawingArea *scope_area;
     GtkLabel *status_label;
+    GtkLabel *stats_label;
     GtkEntry *osc_entry;
     GtkEntry *gen_entry;
     GThread *osc_thread;
-    GMutex osc_lock;
-    bool osc_thread_run;
-    float osc_samples[4096];
-    uint16_t osc_count;
-    uint16_t seq;
+    osc_reader_t rd;            // поток чтения осциллографа (reader.c)
+    GThread *gen_thread;
+    osc_reader_t rd_gen;        // поток чтения генератора: только ответы
+    cmdchan_t cmd_osc;          // команды платам: свой seq и ответы (cmdchan.c)
+    cmdchan_t cmd_gen;
+    frameq_t osc_q;             // поток чтения -> отрисовка
+    _Atomic int view_mode;      // VIEW_*
+    frameq_t persist_q;         // поток чтения -> поток послесвечения
+    persist_t persist;
+    GThread *persist_thread;
+    bool persist_run;
+    uint16_t *col_min;          // прореживание для отрисовки, col_cap столбцов
+    uint16_t *col_max;
+    int col_cap;
+    int64_t drawn_rx_us;        // кадр, задержка которого уже учтена
+    int osc_enc;                // выбранная в GUI кодировка, OSC_ENC_*
+    int osc_nch;                // выбранное в GUI число каналов
+    int osc_gain;               // выбранный шаг усиления (set_gain): по нему коды -> мВ
+    int osc_bits;               // запрошенная разрядность (set_oversample), 12 — без передискретизации
+    // Измерения отрисованного кадра (считает поток чтения, osc_frame_t.meas)
+    meas_t shown_meas[OSC_MAX_CH];
+    unsigned shown_nch;
+    uint32_t shown_fs;
+    uint8_t shown_bits;
+    GtkLabel *meas_label;
+    unsigned baud;              // скорость UART (для USB CDC не важна)
+    upload_t upload;            // загрузка формы в генератор кусками (upload.c)
+    GtkEntry *wave_entry;
+    // Запись потока на диск (пишет поток чтения, rd.rec)
+    recorder_t rec;
+    GtkEntry *rec_entry;
+    // Воспроизведение записи: свой поток вместо потока чтения
+    rec_file_t play;
+    GThread *play_thread;
+    _Atomic bool play_run;
+    _Atomic bool play_pause;
+    _Atomic int play_speed;     // множитель времени, 0 — как можно быстрее
+    _Atomic int64_t play_seek;  // перемотка на t_us, -1 — нет
+    _Atomic int64_t play_pos;   // t_us последнего выданного кадра
+    GtkToggleButton *play_btn;
+    GtkRange *play_scale;
+    // Спектр: свой поток, кадры — копией из потока чтения (rd.tap), только
+    // пока открыта вкладка
+    frameq_t spec_q;
+    spectrum_t spec;
+    GThread *spec_thread;
+    bool spec_run;
+    _Atomic int spec_ch;        // канал кадра
+    GtkDrawingArea *spec_area;
+    GtkLabel *spec_label;
+    // Сегменты (capture_once): кадры seg_read — своя очередь (rd.seg_out),
+    // выгрузка пачками по SEG_READ_BATCH, копии сегментов держит GUI
+    frameq_t seg_q;
+    osc_frame_t seg_fr[PROTO_SEG_MAX];  // samples == NULL — не выгружен
+    int seg_rd, seg_rd_end;     // следующий к запросу и конец выгрузки
+    int seg_got;                // принято в текущей пачке
+    int seg_batch;              // запрошено в текущей пачке
+    gint64 seg_req_us;
+    GtkSpinButton *seg_len_spin;
+    GtkSpinButton *seg_n_spin;
+    GtkSpinButton *seg_pre_spin;
+    GtkSpinButton *seg_page;
+    GtkDrawingArea *seg_area;
+    GtkLabel *seg_label;
+    GtkLabel *seg_info;
+    // Частотная характеристика (bode.c): свой поток, готовые точки читает
+    // отрисовка; калибровка — копия свипа без цепи, вычитается при той же сетке
+    bode_t bode;
+    bool bode_calibrating;      // идущий свип — калибровка
+    bode_point_t bode_cal[BODE_MAX_POINTS];
+    unsigned bode_cal_n;        // 0 — калибровки нет
+    double bode_cal_f0, bode_cal_f1;
+    bool bode_cal_log;
+    GtkSpinButton *bode_f0_spin;
+    GtkSpinButton *bode_f1_spin;
+    GtkSpinButton *bode_n_spin;
+    GtkCheckButton *bode_log_check;
+    GtkCheckButton *bode_cal_check;
+    GtkDrawingArea *bode_area;
+    GtkLabel *bode_label;
+    GtkComboBox *ch_combo;      // вкладка осциллографа: свип ставит 2 канала и 12 бит
+    GtkComboBox *ovs_combo;
 } AppState;
 
-static bool send_cmd(int fd, uint8_t cmd, const uint8_t *payload, uint16_t len, uint16_t *seq);
+// Без ответа get_osc_status принимаем кадры до верхней границы из README
+#define OSC_DEFAULT_MAX_POINTS 16384
+#define OSC_QUEUE_FRAMES       4
+#define PERSIST_QUEUE_FRAMES   8
+#define PERSIST_RENDER_US      33000   // ~30 картинок в секунду
+#define OSC_STATS_PERIOD_US    1000000 // опрос get_osc_stats
+#define REPLAY_SLICE_US        20000   // шаг ожидания воспроизведения: реакция на перемотку и паузу
+#define SPEC_QUEUE_FRAMES      4
+#define SPEC_WAIT_US           50000
+#define SPEC_VIEW_DB           (-120.0) // низ шкалы дБFS
+#define SPEC_LABEL_US          250000  // маркеры в строке — 4 раза в секунду
+#define MEAS_LABEL_US          250000  // измерения рядом с осциллограммой — тоже
+#define SEG_POLL_US            200000  // опрос seg_status, пока открыта вкладка
+#define SEG_READ_BATCH         8       // сегментов на один seg_read (= слотов seg_q)
+#define SEG_READ_TIMEOUT_US    1000000 // пачка не дошла целиком — следующая
+
+enum { VIEW_LINE = 0, VIEW_PERSIST };
+
+// Итог команды -> строка состояния. done вызывается в потоке чтения,
+// поэтому надпись ставится через g_idle_add.
+typedef struct {
+    AppState *st;
+    const char *ok_msg;         // NULL — об успехе не сообщать
+    const char *fail_msg;
+    int status;
+} cmd_report_t;
+
+static const char *cmd_status_text(int status)
+{
+    return status == CMD_TIMEOUT ? "плата не отвечает" : "плата вернула ошибку";
+}
+
+static gboolean cmd_report_idle(gpointer data)
+{
+    cmd_report_t *r = data;
+    char msg[160];
+    if (r->status != CMD_OK) {
+        g_snprintf(msg, sizeof(msg), "%s: %s", r->fail_msg, cmd_status_text(r->status));
+        gtk_label_set_text(r->st->status_label, msg);
+    } else if (r->ok_msg) {
+        gtk_label_set_text(r->st->status_label, r->ok_msg);
+    }
+    g_free(r);
+    return G_SOURCE_REMOVE;
+}
+
+static void cmd_report_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    cmd_report_t *r = ctx;
+    (void)resp;
+    // Отменённая (переподключение, выход) — молча
+    if (status == CMD_CANCELLED || (status == CMD_OK && !r->ok_msg)) {
+        g_free(r);
+        return;
+    }
+    r->status = status;
+    g_idle_add(cmd_report_idle, r);
+}
+
+// Команда плате без ожидания; ответ придёт в строку состояния. false —
+// не отправлена (порт закрыт, очередь полна), надпись fail_msg сразу.
+static bool board_cmd(AppState *st, cmdchan_t *cc, uint8_t cmd, const void *payload, uint16_t len,
+                      const char *ok_msg, const char *fail_msg)
+{
+    cmd_report_t *r = g_new0(cmd_report_t, 1);
+    r->st = st;
+    r->ok_msg = ok_msg;
+    r->fail_msg = fail_msg;
+    if (cmdchan_send(cc, cmd, payload, len, cmd_report_done, r)) return true;
+    g_free(r);
+    gtk_label_set_text(st->status_label, fail_msg);
+    return false;
+}
+
+// Настройка генератора: одна команда set_all (таблица пересчитывается и
+// подменяется один раз). Старая прошивка её не знает — тогда пять команд
+// подряд, без ожидания ответов. Итог — по последнему ответу, худший из статусов.
+typedef struct {
+    AppState *st;
+    _Atomic int left;
+    _Atomic int status;
+    gint64 t0;
+    double ms;
+    uint8_t params[11];         // payload set_all
+} gen_batch_t;
+
+static gboolean gen_batch_idle(gpointer data)
+{
+    gen_batch_t *b = data;
+    char msg[160];
+    if (b->status == CMD_OK) {
+        g_snprintf(msg, sizeof(msg), "Генератор настроен (%.1f мс)", b->ms);
+    } else {
+        g_snprintf(msg, sizeof(msg), "Генератор: %s", cmd_status_text(b->status));
+    }
+    gtk_label_set_text(b->st->status_label, msg);
+    g_free(b);
+    return G_SOURCE_REMOVE;
+}
+
+static void gen_batch_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    gen_batch_t *b = ctx;
+    (void)resp;
+    int prev = atomic_load(&b->status);
+    while (status > prev && !atomic_compare_exchange_weak(&b->status, &prev, status)) {}
+    if (atomic_fetch_sub(&b->left, 1) != 1) return;
+    if (atomic_load(&b->status) == CMD_CANCELLED) {
+        g_free(b);
+        return;
+    }
+    b->ms = (g_get_monotonic_time() - b->t0) / 1000.0;
+    g_idle_add(gen_batch_idle, b);
+}
+
+// Те же параметры командами 0x10..0x14 (срезы payload set_all)
+static gboolean gen_separate_idle(gpointer data)
+{
+    gen_batch_t *b = data;
+    AppState *st = b->st;
+    // Пока последний не отправлен, пакет держит лишняя единица в left:
+    // ответы могут прийти раньше, чем уйдёт следующая команда
+    atomic_store(&b->left, 6);
+    atomic_store(&b->status, CMD_OK);
+    bool ok = true;
+    const struct { uint8_t cmd; uint8_t off; uint8_t len; } cmds[] = {
+        {0x10, 0, 1}, {0x11, 1, 4}, {0x12, 5, 2}, {0x13, 7, 2}, {0x14, 9, 2},
+    };
+    for (unsigned i = 0; i < G_N_ELEMENTS(cmds); i++) {
+        if (!cmdchan_send(&st->cmd_gen, cmds[i].cmd, b->params + cmds[i].off, cmds[i].len, gen_batch_done, b)) {
+            ok = false;
+            atomic_fetch_sub(&b->left, 1);
+        }
+    }
+    if (!ok) gtk_label_set_text(st->status_label, "Ошибка отправки команд генератору");
+    gen_batch_done(b, ok ? CMD_OK : CMD_CANCELLED, NULL);
+    return G_SOURCE_REMOVE;
+}
 
-// Отправка пакета настройки генератора (несколько команд подряд)
+static void gen_set_all_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    if (status == CMD_ERR && resp->payload[0] == PROTO_ERR_UNKNOWN) {
+        g_idle_add(gen_separate_idle, ctx);
+        return;
+    }
+    gen_batch_done(ctx, status, resp);
+}
+
+// Настройка генератора одной командой set_all
 static void on_apply_generator(GtkButton *btn, gpointer user_data)
 {
     AppState *st = user_data;
@@ -41,149 +275,285 @@ static void on_apply_generator(GtkButton *btn, gpointer user_data)
     GtkSpinButton *duty_spin = GTK_SPIN_BUTTON(g_object_get_data(G_OBJECT(box), "duty_spin"));
 
     uint8_t wave = gtk_combo_box_get_active(wave_combo);
-    uint32_t freq = (uint32_t)gtk_spin_button_get_value(freq_spin) * 1000; // Гц -> мГц
+    uint32_t freq = (uint32_t)llround(gtk_spin_button_get_value(freq_spin) * 1000); // Гц -> мГц
     uint16_t ampl = (uint16_t)gtk_spin_button_get_value(ampl_spin);
     int16_t offset = (int16_t)gtk_spin_button_get_value(offset_spin);
     uint16_t duty = (uint16_t)gtk_spin_button_get_value(duty_spin);
 
-    uint8_t p_wave[1] = {wave};
-    uint8_t p_freq[4]; memcpy(p_freq, &freq, 4);
-    uint8_t p_ampl[2]; memcpy(p_ampl, &ampl, 2);
-    uint8_t p_offs[2]; memcpy(p_offs, &offset, 2);
-    uint8_t p_duty[2]; memcpy(p_duty, &duty, 2);
+    gen_batch_t *b = g_new0(gen_batch_t, 1);
+    b->st = st;
+    b->left = 1;
+    b->t0 = g_get_monotonic_time();
+    b->params[0] = wave;
+    memcpy(b->params + 1, &freq, 4);
+    memcpy(b->params + 5, &ampl, 2);
+    memcpy(b->params + 7, &offset, 2);
+    memcpy(b->params + 9, &duty, 2);
+    if (!cmdchan_send(&st->cmd_gen, PROTO_CMD_GEN_SET_ALL, b->params, sizeof(b->params), gen_set_all_done, b)) {
+        g_free(b);
+        gtk_label_set_text(st->status_label, "Ошибка отправки команд генератору");
+        return;
+    }
+    gtk_label_set_text(st->status_label, "Настройка генератора...");
+}
 
-    bool ok = true;
-    ok &= send_cmd(st->fd_gen, 0x10, p_wave, 1, &st->seq);
-    ok &= send_cmd(st->fd_gen, 0x11, p_freq, 4, &st->seq);
-    ok &= send_cmd(st->fd_gen, 0x12, p_ampl, 2, &st->seq);
-    ok &= send_cmd(st->fd_gen, 0x13, p_offs, 2, &st->seq);
-    ok &= send_cmd(st->fd_gen, 0x14, p_duty, 2, &st->seq);
+// Режим генератора: DDS — постоянная частота ЦАП, частота с шагом в
+// доли миллигерца и меняется без разрыва; свип — только в нём
+static void on_dds_toggled(GtkCheckButton *check, gpointer user_data)
+{
+    AppState *st = user_data;
+    uint8_t mode = gtk_check_button_get_active(check) ? PROTO_GEN_MODE_DDS : 0;
+    board_cmd(st, &st->cmd_gen, PROTO_CMD_GEN_SET_MODE, &mode, 1, mode ? "Генератор: DDS" : "Генератор: таблица",
+              "Не удалось сменить режим генератора");
+}
+
+// Свип от текущей частоты до «Свип до» за заданное время
+static void on_sweep(GtkButton *btn, gpointer user_data)
+{
+    AppState *st = user_data;
+    GtkWidget *box = gtk_widget_get_parent(gtk_widget_get_parent(GTK_WIDGET(btn)));
+    GtkSpinButton *freq_spin = GTK_SPIN_BUTTON(g_object_get_data(G_OBJECT(box), "freq_spin"));
+    GtkSpinButton *to_spin = GTK_SPIN_BUTTON(g_object_get_data(G_OBJECT(box), "sweep_to_spin"));
+    GtkSpinButton *time_spin = GTK_SPIN_BUTTON(g_object_get_data(G_OBJECT(box), "sweep_time_spin"));
+    GtkCheckButton *log_check = GTK_CHECK_BUTTON(g_object_get_data(G_OBJECT(box), "sweep_log_check"));
+    GtkCheckButton *repeat_check = GTK_CHECK_BUTTON(g_object_get_data(G_OBJECT(box), "sweep_repeat_check"));
 
-    gtk_label_set_text(st->status_label, ok ? "Генератор настроен" : "Ошибка отправки команд генератору");
+    uint32_t f0 = (uint32_t)llround(gtk_spin_button_get_value(freq_spin) * 1000);
+    uint32_t f1 = (uint32_t)llround(gtk_spin_button_get_value(to_spin) * 1000);
+    uint32_t ms = (uint32_t)llround(gtk_spin_button_get_value(time_spin) * 1000);
+    uint8_t p[13];
+    memcpy(p, &f0, 4);
+    memcpy(p + 4, &f1, 4);
+    memcpy(p + 8, &ms, 4);
+    p[12] = (gtk_check_button_get_active(log_check) ? PROTO_SWEEP_LOG : 0) |
+            (gtk_check_button_get_active(repeat_check) ? PROTO_SWEEP_REPEAT : 0);
+    board_cmd(st, &st->cmd_gen, PROTO_CMD_GEN_SWEEP, p, sizeof(p), "Свип запущен",
+              "Свип не принят (нужен режим DDS)");
 }
 
-// Простейший расчёт CRC16/IBM
-static uint16_t crc16_ibm(const uint8_t *data, size_t len)
+// Загрузка формы из файла: файл читается в своём потоке, куски уходят
+// через cmdchan, прогресс и итог — из потока чтения через g_idle_add
+typedef struct {
+    AppState *st;
+    char *path;
+    char msg[160];
+} wave_job_t;
+
+static gboolean wave_note_idle(gpointer data)
 {
-    uint16_t crc = 0xFFFF;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (uint8_t b = 0; b < 8; b++) {
-            if (crc & 1) crc = (crc >> 1) ^ 0xA001;
-            else crc >>= 1;
-        }
+    wave_job_t *j = data;
+    gtk_label_set_text(j->st->status_label, j->msg);
+    g_free(j->path);
+    g_free(j);
+    return G_SOURCE_REMOVE;
+}
+
+static void wave_note(AppState *st, const char *msg)
+{
+    wave_job_t *j = g_new0(wave_job_t, 1);
+    j->st = st;
+    g_strlcpy(j->msg, msg, sizeof(j->msg));
+    g_idle_add(wave_note_idle, j);
+}
+
+static void wave_upload_progress(void *ctx, unsigned acked, unsigned total)
+{
+    char msg[64];
+    // Строка состояния — через каждые 10 %, не на каждый кусок
+    if (acked * 10 / total == (acked - 1) * 10 / total) return;
+    g_snprintf(msg, sizeof(msg), "Загрузка формы: %u%%", acked * 100 / total);
+    wave_note(ctx, msg);
+}
+
+static void wave_upload_done(void *ctx, int status, const char *msg)
+{
+    // Отменённая (переподключение, выход) — молча
+    if (status != CMD_CANCELLED) wave_note(ctx, msg);
+}
+
+static gpointer wave_load_thread(gpointer data)
+{
+    wave_job_t *j = data;
+    AppState *st = j->st;
+    uint16_t *pts = g_new(uint16_t, UPLOAD_MAX_POINTS);
+    char err[128];
+    uint32_t n = upload_load_file(j->path, pts, UPLOAD_MAX_POINTS, err, sizeof(err));
+    if (!n) {
+        wave_note(st, err);
+    } else if (!upload_start(&st->upload, &st->cmd_gen, pts, n, upload_chunk_points(st->baud),
+                             wave_upload_progress, wave_upload_done, st)) {
+        wave_note(st, "Форма не отправлена: генератор не подключён или загрузка уже идёт");
     }
-    return crc;
+    g_free(pts);
+    g_free(j->path);
+    g_free(j);
+    return NULL;
 }
 
-// Отправка кадра: sync, ver=1, seq++, cmd, len, payload, crc16
-static bool send_cmd(int fd, uint8_t cmd, const uint8_t *payload, uint16_t len, uint16_t *seq)
+static void on_upload_wave(GtkButton *btn, gpointer user_data)
 {
-    if (fd < 0) return false;
-    uint8_t buf[256];
-    if (len > sizeof(buf) - 9) return false;
-    uint16_t s = ++(*seq);
-    size_t idx = 0;
-    buf[idx++] = 0x55; // sync low
-    buf[idx++] = 0xAA; // sync high
-    buf[idx++] = 0x01; // ver
-    buf[idx++] = s & 0xFF;
-    buf[idx++] = s >> 8;
-    buf[idx++] = cmd;
-    buf[idx++] = len & 0xFF;
-    buf[idx++] = len >> 8;
-    if (payload && len) {
-        memcpy(&buf[idx], payload, len);
+    AppState *st = user_data;
+    (void)btn;
+    if (st->fd_gen <= 0) {
+        gtk_label_set_text(st->status_label, "Генератор не подключён");
+        return;
     }
-    size_t hdr_len = idx + len;
-    uint16_t crc = crc16_ibm(&buf[2], hdr_len - 2); // считаем от ver
-    buf[hdr_len] = crc & 0xFF;
-    buf[hdr_len + 1] = crc >> 8;
+    if (upload_busy(&st->upload)) {
+        gtk_label_set_text(st->status_label, "Загрузка формы уже идёт");
+        return;
+    }
+    wave_job_t *j = g_new0(wave_job_t, 1);
+    j->st = st;
+    j->path = g_strdup(gtk_editable_get_text(GTK_EDITABLE(st->wave_entry)));
+    gtk_label_set_text(st->status_label, "Загрузка формы...");
+    g_thread_unref(g_thread_new("wave_load", wave_load_thread, j));
+}
 
-    ssize_t w = write(fd, buf, hdr_len + 2);
-    return w == (ssize_t)(hdr_len + 2);
+// Поток послесвечения: копит все кадры в гистограмму, ~30 раз в секунду
+// выкладывает картинку для draw_scope
+static gpointer persist_thread(gpointer data)
+{
+    AppState *st = data;
+    gint64 last = 0;
+
+    persist_clear(&st->persist);
+    while (st->persist_run) {
+        frameq_wait(&st->persist_q, PERSIST_RENDER_US);
+        const osc_frame_t *fr;
+        while ((fr = frameq_next(&st->persist_q))) {
+            for (unsigned c = 0; c < fr->nch; c++) {
+                persist_accumulate(&st->persist, fr->samples + fr->ch_off[c], fr->ch_len[c],
+                                   (uint16_t)(4095u << (fr->bits - 12)));
+            }
+        }
+        gint64 now = g_get_monotonic_time();
+        if (now - last >= PERSIST_RENDER_US) {
+            last = now;
+            persist_render(&st->persist);
+        }
+    }
+    return NULL;
 }
 
-// Заглушка открытия порта
-static int open_port(const char *path)
+// Поток спектра: все кадры по порядку в среднее, после пачки — публикация
+static gpointer spectrum_thread(gpointer data)
 {
-    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (fd < 0) return -1;
-    struct termios tio = {0};
-    cfmakeraw(&tio);
-    cfsetspeed(&tio, B115200);
-    tio.c_cflag |= CLOCAL | CREAD;
-    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
-        close(fd);
-        return -1;
+    AppState *st = data;
+    while (st->spec_run) {
+        frameq_wait(&st->spec_q, SPEC_WAIT_US);
+        const osc_frame_t *fr;
+        bool fresh = false;
+        while ((fr = frameq_next(&st->spec_q))) {
+            int c = atomic_load(&st->spec_ch);
+            if (c >= fr->nch) c = 0;
+            spectrum_process(&st->spec, fr->samples + fr->ch_off[c], fr->ch_len[c], fr->fs_hz, fr->bits);
+            fresh = true;
+        }
+        if (fresh) spectrum_publish(&st->spec);
     }
-    return fd;
+    return NULL;
 }
 
-// Чтение осциллографа в отдельном потоке (очень упрощено)
 static gpointer osc_reader_thread(gpointer data)
+{
+    osc_reader_run(data);
+    return NULL;
+}
+
+// Оба потока чтения; команды без ответа отменяются (callback — здесь)
+static void osc_reader_stop(AppState *st)
+{
+    // Свип ждёт ответов через потоки чтения — он первым
+    bode_stop(&st->bode);
+    if (st->osc_thread) {
+        osc_reader_cancel(&st->rd);
+        g_thread_join(st->osc_thread);
+        st->osc_thread = NULL;
+    }
+    if (st->gen_thread) {
+        osc_reader_cancel(&st->rd_gen);
+        g_thread_join(st->gen_thread);
+        st->gen_thread = NULL;
+    }
+    cmdchan_reset(&st->cmd_osc, -1, -1);
+    cmdchan_reset(&st->cmd_gen, -1, -1);
+}
+
+// Кадр из записи: заголовок и CRC проверены ещё при приёме, разбираем
+// только заголовок и отдаём тому же разбору, что и кадры с линии
+static void replay_frame(AppState *st, const rec_frame_t *rf)
+{
+    const uint8_t *p = rf->raw;
+    if (rf->len < PROTO_HDR_LEN + PROTO_CRC_LEN) return;
+    proto_frame_t f = {
+        .ver = p[2],
+        .seq = p[3] | (p[4] << 8),
+        .cmd = p[5],
+        .len = p[6] | (p[7] << 8),
+        .payload = p + PROTO_HDR_LEN,
+        .raw = p,
+        .raw_len = rf->len,
+    };
+    if ((uint32_t)(PROTO_HDR_LEN + f.len + PROTO_CRC_LEN) != rf->len) return;
+    if (f.cmd == PROTO_CMD_OSC_DATA || f.cmd == PROTO_CMD_OSC_DATA_EXT) osc_reader_handle_data(&st->rd, &f);
+}
+
+// Поток воспроизведения: кадры прямо из отображения файла, по времени
+// записи / play_speed. Ждёт кусками по REPLAY_SLICE_US, чтобы сразу
+// откликаться на перемотку, паузу и остановку. В конце записи стоит.
+static gpointer replay_thread(gpointer data)
 {
     AppState *st = data;
-    uint8_t buf[8192];
-    size_t have = 0;
+    rec_cursor_t cur;
+    rec_frame_t rf;
+    int64_t base_t = -1, base_wall = 0;  // кадр base_t выдан в base_wall
+    int speed = -1;
 
-    while (st->osc_thread_run) {
-        ssize_t r = read(st->fd_osc, buf + have, sizeof(buf) - have);
-        if (r <= 0) {
-            g_usleep(1000);
+    recfile_seek(&st->play, 0, &cur);
+    while (atomic_load(&st->play_run)) {
+        int64_t seek = atomic_exchange(&st->play_seek, -1);
+        if (seek >= 0) {
+            recfile_seek(&st->play, seek, &cur);
+            base_t = -1;
+        }
+        if (atomic_load(&st->play_pause) || !recfile_next(&st->play, &cur, &rf)) {
+            g_usleep(REPLAY_SLICE_US);
+            base_t = -1;
             continue;
         }
-        have += (size_t)r;
-
-        // Поиск sync 0x55 0xAA
-        size_t pos = 0;
-        while (have >= 8) {
-            if (!(buf[pos] == 0x55 && buf[pos + 1] == 0xAA)) { pos++; have--; continue; }
-            if (pos > 0) { memmove(buf, buf + pos, have); pos = 0; }
-            if (have < 8) break; // ждём минимум заголовок без CRC
-            uint8_t ver = buf[2];
-            uint16_t seq = buf[3] | (buf[4] << 8);
-            uint8_t cmd = buf[5];
-            uint16_t len = buf[6] | (buf[7] << 8);
-            if (ver != 1) { memmove(buf, buf + 2, have - 2); have -= 2; continue; }
-            size_t frame_len = 8 + len + 2; // hdr+payload+crc
-            if (have < frame_len) break; // ждём весь кадр
-            uint16_t crc_calc = crc16_ibm(&buf[2], 6 + len);
-            uint16_t crc_rx = buf[8 + len] | (buf[9 + len] << 8);
-            if (crc_calc != crc_rx) {
-                // Можно улучшить: счётчик ошибок
-                memmove(buf, buf + 2, have - 2);
-                have -= 2;
-                continue;
-            }
-            if (cmd == 0x40) { // OSC_DATA
-                if (len >= 9) {
-                    uint32_t fs = buf[8] | (buf[9] << 8) | (buf[10] << 16) | (buf[11] << 24);
-                    uint8_t ch = buf[12];
-                    uint16_t ns = buf[13] | (buf[14] << 8);
-                    uint16_t pre = buf[15] | (buf[16] << 8);
-                    (void)fs; (void)ch; (void)pre; // пока не используем
-                    if (ns > 0 && ns <= 2048 && 17 + ns * 2 <= 8 + len) {
-                        GMutex *m = &st->osc_lock;
-                        g_mutex_lock(m);
-                        st->osc_count = ns;
-                        for (uint16_t i = 0; i < ns; i++) {
-                            uint16_t raw = buf[17 + i * 2] | (buf[18 + i * 2] << 8);
-                            st->osc_samples[i] = (float)raw;
-                        }
-                        g_mutex_unlock(m);
-                        gtk_widget_queue_draw(GTK_WIDGET(st->scope_area));
-                    }
-                }
+        int sp = atomic_load(&st->play_speed);
+        if (sp != speed || base_t < 0) {
+            speed = sp;
+            base_t = rf.t_us;
+            base_wall = g_get_monotonic_time();
+        }
+        bool late = false;
+        while (speed > 0) {
+            gint64 wait = base_wall + (rf.t_us - base_t) / speed - g_get_monotonic_time();
+            if (wait <= 0) break;
+            if (!atomic_load(&st->play_run) || atomic_load(&st->play_seek) >= 0 || atomic_load(&st->play_pause)) {
+                late = true;
+                break;
             }
-            memmove(buf, buf + frame_len, have - frame_len);
-            have -= frame_len;
-            (void)seq; // пока игнорируем
+            g_usleep(MIN(wait, REPLAY_SLICE_US));
         }
+        if (late) continue;
+        replay_frame(st, &rf);
+        atomic_store(&st->play_pos, rf.t_us);
     }
     return NULL;
 }
 
+static void replay_stop(AppState *st)
+{
+    if (st->play_thread) {
+        atomic_store(&st->play_run, false);
+        g_thread_join(st->play_thread);
+        st->play_thread = NULL;
+        recfile_close(&st->play);
+    }
+}
+
 static void on_connect_clicked(GtkButton *btn, gpointer user_data)
 {
     AppState *st = user_data;
@@ -191,23 +561,50 @@ static void on_connect_clicked(GtkButton *btn, gpointer user_data)
     const char *osc_path = gtk_editable_get_text(GTK_EDITABLE(st->osc_entry));
     const char *gen_path = gtk_editable_get_text(GTK_EDITABLE(st->gen_entry));
 
-    if (st->osc_thread) {
-        st->osc_thread_run = false;
-        g_thread_join(st->osc_thread);
-        st->osc_thread = NULL;
-    }
+    // Очередь кадров — с одним писателем: либо линия, либо запись
+    if (st->play_thread) gtk_toggle_button_set_active(st->play_btn, FALSE);
+    osc_reader_stop(st);
     if (st->fd_osc > 0) close(st->fd_osc);
     if (st->fd_gen > 0) close(st->fd_gen);
 
-    st->fd_osc = open_port(osc_path);
-    st->fd_gen = open_port(gen_path);
+    st->fd_osc = port_open(osc_path, st->baud);
+    st->fd_gen = port_open(gen_path, st->baud);
 
     if (st->fd_osc < 0 || st->fd_gen < 0) {
         gtk_label_set_text(st->status_label, "Ошибка открытия портов");
+    } else if (!st->rd.rx.buf || !st->osc_q.slots) {
+        gtk_label_set_text(st->status_label, "Нет памяти под приёмный буфер");
     } else {
-        st->osc_thread_run = true;
-        st->osc_thread = g_thread_new("osc_rx", osc_reader_thread, st);
+        linkstats_reset(&st->rd.link);
+        atomic_store(&st->rd.enc_mask, 0);
+        st->rd.fd = st->fd_osc;
+        st->rd_gen.fd = st->fd_gen;
+        cmdchan_reset(&st->cmd_osc, st->fd_osc, st->rd.wake_fd);
+        cmdchan_reset(&st->cmd_gen, st->fd_gen, st->rd_gen.wake_fd);
+        atomic_store(&st->rd.run, true);
+        atomic_store(&st->rd_gen.run, true);
+        st->osc_thread = g_thread_new("osc_rx", osc_reader_thread, &st->rd);
+        st->gen_thread = g_thread_new("gen_rx", osc_reader_thread, &st->rd_gen);
         gtk_label_set_text(st->status_label, "Порты открыты");
+        // Узнаём размер кадра и кодировки платы; ответ разбирает поток чтения.
+        // Команды уходят подряд, ответы сверяются по seq.
+        board_cmd(st, &st->cmd_osc, PROTO_CMD_OSC_STATUS, NULL, 0, "Осциллограф на связи", "get_osc_status");
+        if (st->osc_enc != OSC_ENC_RAW16) {
+            uint8_t enc = (uint8_t)st->osc_enc;
+            board_cmd(st, &st->cmd_osc, PROTO_CMD_SET_ENC, &enc, 1, NULL, "Не удалось сменить кодировку");
+        }
+        if (st->osc_nch > 1) {
+            uint8_t nch = (uint8_t)st->osc_nch;
+            board_cmd(st, &st->cmd_osc, PROTO_CMD_SET_CH, &nch, 1, NULL, "Не удалось сменить число каналов");
+        }
+        if (st->osc_gain) {
+            uint8_t step = (uint8_t)st->osc_gain;
+            board_cmd(st, &st->cmd_osc, PROTO_CMD_SET_GAIN, &step, 1, NULL, "Не удалось сменить усиление");
+        }
+        if (st->osc_bits > 12) {
+            uint8_t bits = (uint8_t)st->osc_bits;
+            board_cmd(st, &st->cmd_osc, PROTO_CMD_SET_OVS, &bits, 1, NULL, "Не удалось включить передискретизацию");
+        }
     }
 }
 
@@ -216,11 +613,7 @@ static void on_start_stream(GtkButton *btn, gpointer user_data)
     AppState *st = user_data;
     (void)btn;
     uint8_t payload[1] = {1};
-    if (send_cmd(st->fd_osc, 0x24, payload, 1, &st->seq)) {
-        gtk_label_set_text(st->status_label, "Стрим осциллографа запущен");
-    } else {
-        gtk_label_set_text(st->status_label, "Не удалось запустить стрим");
-    }
+    board_cmd(st, &st->cmd_osc, 0x24, payload, 1, "Стрим осциллографа запущен", "Не удалось запустить стрим");
 }
 
 static void on_stop_stream(GtkButton *btn, gpointer user_data)
@@ -228,39 +621,1113 @@ static void on_stop_stream(GtkButton *btn, gpointer user_data)
     AppState *st = user_data;
     (void)btn;
     uint8_t payload[1] = {0};
-    if (send_cmd(st->fd_osc, 0x24, payload, 1, &st->seq)) {
-        gtk_label_set_text(st->status_label, "Стрим остановлен");
+    board_cmd(st, &st->cmd_osc, 0x24, payload, 1, "Стрим остановлен", "Не удалось остановить стрим");
+}
+
+// Кодирование отсчётов: u16 / 12 бит / 12 бит + дельта. Старая прошивка
+// (нет enc_mask в get_osc_status) команду не знает — тогда только u16.
+static void on_encoding_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    st->osc_enc = gtk_combo_box_get_active(combo);
+    if (st->fd_osc <= 0) return;
+    int mask = atomic_load(&st->rd.enc_mask);
+    if (mask && !(mask & OSC_ENC_BIT(st->osc_enc))) {
+        gtk_label_set_text(st->status_label, "Плата не поддерживает эту кодировку");
+        return;
+    }
+    uint8_t enc = (uint8_t)st->osc_enc;
+    board_cmd(st, &st->cmd_osc, PROTO_CMD_SET_ENC, &enc, 1, NULL, "Не удалось сменить кодировку");
+}
+
+// Число каналов (режим сканирования АЦП): кадр прежнего размера делится
+// между каналами, поток по линии не растёт
+static void on_channels_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    st->osc_nch = gtk_combo_box_get_active(combo) + 1;
+    if (st->fd_osc <= 0) return;
+    uint8_t nch = (uint8_t)st->osc_nch;
+    board_cmd(st, &st->cmd_osc, PROTO_CMD_SET_CH, &nch, 1, NULL, "Не удалось сменить число каналов");
+}
+
+static void on_gain_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    st->osc_gain = MAX(gtk_combo_box_get_active(combo), 0);
+    if (st->fd_osc <= 0) return;
+    uint8_t step = (uint8_t)st->osc_gain;
+    board_cmd(st, &st->cmd_osc, PROTO_CMD_SET_GAIN, &step, 1, NULL, "Не удалось сменить усиление");
+}
+
+// Передискретизация: 4^(bits-12) отсчётов АЦП на точку. На высокой fs
+// плата даёт меньше бит, чем запрошено; сколько вышло — в каждом кадре
+static void on_ovs_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    st->osc_bits = 12 + MAX(gtk_combo_box_get_active(combo), 0);
+    if (st->fd_osc <= 0) return;
+    uint8_t bits = (uint8_t)st->osc_bits;
+    board_cmd(st, &st->cmd_osc, PROTO_CMD_SET_OVS, &bits, 1, NULL, "Не удалось включить передискретизацию");
+}
+
+// Запись потока в файл: поток чтения только кладёт кадры в кольцо,
+// на диск пишет поток записи (recorder.c)
+static void on_record_toggled(GtkToggleButton *btn, gpointer user_data)
+{
+    AppState *st = user_data;
+    char msg[160];
+    if (gtk_toggle_button_get_active(btn)) {
+        const char *path = gtk_editable_get_text(GTK_EDITABLE(st->rec_entry));
+        if (!recorder_start(&st->rec, path)) {
+            gtk_label_set_text(st->status_label, "Не удалось открыть файл записи");
+            gtk_toggle_button_set_active(btn, FALSE);
+            return;
+        }
+        atomic_store(&st->rd.rec, &st->rec);
+        g_snprintf(msg, sizeof(msg), "Запись в %s", path);
+    } else if (atomic_load(&st->rd.rec)) {
+        atomic_store(&st->rd.rec, NULL);
+        unsigned long long frames = atomic_load(&st->rec.frames), dropped = atomic_load(&st->rec.dropped);
+        if (recorder_stop(&st->rec)) {
+            g_snprintf(msg, sizeof(msg), "Запись сохранена: %llu кадров, потеряно %llu", frames, dropped);
+        } else {
+            g_snprintf(msg, sizeof(msg), "Ошибка записи на диск");
+        }
     } else {
-        gtk_label_set_text(st->status_label, "Не удалось остановить стрим");
+        return;
     }
+    gtk_label_set_text(st->status_label, msg);
+}
+
+// Воспроизведение файла записи вместо линии
+static void on_replay_toggled(GtkToggleButton *btn, gpointer user_data)
+{
+    AppState *st = user_data;
+    char msg[160];
+    if (!gtk_toggle_button_get_active(btn)) {
+        if (!st->play_thread) return;
+        replay_stop(st);
+        gtk_label_set_text(st->status_label, "Воспроизведение остановлено");
+        return;
+    }
+    const char *path = gtk_editable_get_text(GTK_EDITABLE(st->rec_entry));
+    osc_reader_stop(st);
+    if (!recfile_open(&st->play, path)) {
+        gtk_label_set_text(st->status_label, "Не удалось открыть запись");
+        gtk_toggle_button_set_active(btn, FALSE);
+        return;
+    }
+    // Запись могла быть сделана с кадрами больше текущего предела
+    osc_reader_set_max_points(&st->rd, OSC_MAX_POINTS);
+    linkstats_reset(&st->rd.link);
+    gtk_range_set_range(st->play_scale, 0, MAX(st->play.duration_us / 1e6, 0.001));
+    gtk_range_set_value(st->play_scale, 0);
+    atomic_store(&st->play_seek, -1);
+    atomic_store(&st->play_pos, 0);
+    atomic_store(&st->play_run, true);
+    st->play_thread = g_thread_new("replay", replay_thread, st);
+    g_snprintf(msg, sizeof(msg), "Воспроизведение: %llu кадров, %.1f с%s",
+               (unsigned long long)st->play.total_frames, st->play.duration_us / 1e6,
+               st->play.indexed ? "" : " (индекс восстановлен)");
+    gtk_label_set_text(st->status_label, msg);
+}
+
+static void on_replay_speed_changed(GtkComboBox *combo, gpointer user_data)
+{
+    static const int speeds[] = {1, 2, 10, 0};
+    AppState *st = user_data;
+    int i = gtk_combo_box_get_active(combo);
+    if (i >= 0 && i < (int)G_N_ELEMENTS(speeds)) atomic_store(&st->play_speed, speeds[i]);
+}
+
+static void on_replay_pause_toggled(GtkToggleButton *btn, gpointer user_data)
+{
+    AppState *st = user_data;
+    atomic_store(&st->play_pause, gtk_toggle_button_get_active(btn));
+}
+
+// Перемотка ползунком (change-value приходит только от пользователя)
+static gboolean on_replay_scrub(GtkRange *range, GtkScrollType scroll, double value, gpointer user_data)
+{
+    (void)range;
+    (void)scroll;
+    AppState *st = user_data;
+    if (st->play_thread) atomic_store(&st->play_seek, (int64_t)(MAX(value, 0.0) * 1e6));
+    return FALSE;
+}
+
+static void on_baud_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    int i = gtk_combo_box_get_active(combo);
+    if (i >= 0) st->baud = port_bauds[i];
+}
+
+// Цвета лучей по каналам
+static const double trace_rgb[OSC_MAX_CH][3] = {
+    {0.2, 0.7, 0.2}, {0.9, 0.8, 0.2}, {0.3, 0.6, 1.0}, {0.9, 0.3, 0.6},
+};
+
+// Луч одного канала: отрезками, если отсчётов не больше двух на пиксель,
+// иначе вертикалями min..max по столбцам
+// Шкала — по разрядности кадра: коды 0..4095·2^(bits-12)
+static void draw_trace(AppState *st, cairo_t *cr, const uint16_t *data, uint32_t n, uint8_t bits, int width,
+                       int height)
+{
+    float maxv = 4095.0f * (1u << (bits - 12));
+    if (n < 2) return;
+    if (n <= 2u * width) {
+        cairo_set_line_width(cr, 1.2);
+        for (uint32_t i = 0; i < n; i++) {
+            double x = (double)i / (n - 1) * width;
+            double y = height - (data[i] / maxv) * height;
+            if (i == 0) cairo_move_to(cr, x, y);
+            else cairo_line_to(cr, x, y);
+        }
+        cairo_stroke(cr);
+        return;
+    }
+
+    if (width > st->col_cap) {
+        st->col_min = g_realloc(st->col_min, width * sizeof(uint16_t));
+        st->col_max = g_realloc(st->col_max, width * sizeof(uint16_t));
+        st->col_cap = width;
+    }
+    decimate_minmax(data, n, (size_t)width, st->col_min, st->col_max);
+    cairo_set_line_width(cr, 1.0);
+    for (int x = 0; x < width; x++) {
+        double y0 = height - (st->col_max[x] / maxv) * height;
+        double y1 = height - (st->col_min[x] / maxv) * height;
+        if (y1 - y0 < 1.0) y1 = y0 + 1.0; // плоский участок — хотя бы точка
+        cairo_move_to(cr, x + 0.5, y0);
+        cairo_line_to(cr, x + 0.5, y1);
+    }
+    cairo_stroke(cr);
 }
 
 static void draw_scope(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data)
 {
     (void)area;
     AppState *st = user_data;
-    g_mutex_lock(&st->osc_lock);
-    uint16_t n = st->osc_count;
-    if (n == 0) {
+    if (atomic_load(&st->view_mode) == VIEW_PERSIST) {
+        atomic_store(&st->persist.want_w, width);
+        atomic_store(&st->persist.want_h, height);
+        const persist_img_t *img = persist_front(&st->persist);
+        if (!img) {
+            cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
+            cairo_paint(cr);
+            return;
+        }
+        cairo_surface_t *surf = cairo_image_surface_create_for_data((unsigned char *)img->px, CAIRO_FORMAT_RGB24,
+                                                                    img->w, img->h, img->stride);
+        cairo_save(cr);
+        cairo_scale(cr, (double)width / img->w, (double)height / img->h); // пока поток не подхватил новый размер
+        cairo_set_source_surface(cr, surf, 0, 0);
+        cairo_paint(cr);
+        cairo_restore(cr);
+        cairo_surface_destroy(surf);
+        return;
+    }
+
+    const osc_frame_t *fr = frameq_latest(&st->osc_q);
+    if (!fr || fr->nsamples < 2) {
         cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
         cairo_paint(cr);
-        g_mutex_unlock(&st->osc_lock);
         return;
     }
-    float *data = st->osc_samples;
-    float maxv = 4095.0f;
+    if (fr->rx_us != st->drawn_rx_us) {
+        st->drawn_rx_us = fr->rx_us;
+        linkstats_on_display(&st->rd.link, g_get_monotonic_time() - fr->rx_us);
+    }
     cairo_set_source_rgb(cr, 0.05, 0.05, 0.08);
     cairo_paint(cr);
-    cairo_set_source_rgb(cr, 0.2, 0.7, 0.2);
-    cairo_set_line_width(cr, 1.2);
-    for (uint16_t i = 0; i < n; i++) {
-        double x = (double)i / (n - 1) * width;
-        double y = height - (data[i] / maxv) * height;
-        if (i == 0) cairo_move_to(cr, x, y);
+    for (unsigned c = 0; c < fr->nch; c++) {
+        cairo_set_source_rgb(cr, trace_rgb[c][0], trace_rgb[c][1], trace_rgb[c][2]);
+        draw_trace(st, cr, fr->samples + fr->ch_off[c], fr->ch_len[c], fr->bits, width, height);
+    }
+    memcpy(st->shown_meas, fr->meas, sizeof(st->shown_meas));
+    st->shown_nch = fr->nch;
+    st->shown_fs = fr->fs_hz;
+    st->shown_bits = fr->bits;
+}
+
+// Частота и время — в подходящих единицах
+static void fmt_hz(char *buf, size_t len, double hz)
+{
+    if (hz >= 1e6) g_snprintf(buf, len, "%.4f МГц", hz / 1e6);
+    else if (hz >= 1e3) g_snprintf(buf, len, "%.4f кГц", hz / 1e3);
+    else g_snprintf(buf, len, "%.3f Гц", hz);
+}
+
+static void fmt_s(char *buf, size_t len, double s)
+{
+    if (s >= 1) g_snprintf(buf, len, "%.3f с", s);
+    else if (s >= 1e-3) g_snprintf(buf, len, "%.3f мс", s * 1e3);
+    else if (s >= 1e-6) g_snprintf(buf, len, "%.2f мкс", s * 1e6);
+    else g_snprintf(buf, len, "%.0f нс", s * 1e9);
+}
+
+// Измерения отрисованного кадра по каналам: коды -> мВ по шагу усиления и
+// разрядности кадра, отсчёты -> секунды по частоте дискретизации кадра
+static void update_meas_label(AppState *st)
+{
+    char buf[1024], f[32], per[32], duty[16], rise[32], fall[32];
+    int n = 0;
+    if (atomic_load(&st->view_mode) == VIEW_PERSIST || !st->shown_nch) {
+        gtk_label_set_text(st->meas_label, "Измерения — в режиме «Линия»");
+        return;
+    }
+    double mv = meas_mv_per_code((unsigned)st->osc_gain) / (1u << (st->shown_bits - 12));
+    double ts = st->shown_fs ? 1.0 / st->shown_fs : 0;
+    for (unsigned c = 0; c < st->shown_nch && (size_t)n < sizeof(buf); c++) {
+        const meas_t *m = &st->shown_meas[c];
+        if (m->period > 0 && ts > 0) {
+            fmt_hz(f, sizeof(f), 1.0 / (m->period * ts));
+            fmt_s(per, sizeof(per), m->period * ts);
+        } else {
+            g_strlcpy(f, "—", sizeof(f));
+            g_strlcpy(per, "—", sizeof(per));
+        }
+        if (m->duty >= 0) g_snprintf(duty, sizeof(duty), "%.1f %%", m->duty * 100);
+        else g_strlcpy(duty, "—", sizeof(duty));
+        if (m->rise > 0 && ts > 0) fmt_s(rise, sizeof(rise), m->rise * ts);
+        else g_strlcpy(rise, "—", sizeof(rise));
+        if (m->fall > 0 && ts > 0) fmt_s(fall, sizeof(fall), m->fall * ts);
+        else g_strlcpy(fall, "—", sizeof(fall));
+        n += g_snprintf(buf + n, sizeof(buf) - n,
+                        "%sКанал %u, %u бит\n"
+                        "Размах %.1f мВ\nСреднее %.1f мВ\nСКЗ %.1f мВ (перем. %.1f)\n"
+                        "Частота %s\nПериод %s\nЗаполнение %s\nФронт %s\nСпад %s",
+                        c ? "\n\n" : "", c + 1, st->shown_bits,
+                        (m->max - m->min) * mv, m->mean * mv, m->rms * mv, m->ac_rms * mv,
+                        f, per, duty, rise, fall);
+    }
+    gtk_label_set_text(st->meas_label, buf);
+}
+
+// Счётчики кадров и состояние линии в строках под осциллограммой
+static void update_stats(AppState *st)
+{
+    char buf[1280];
+    frameq_t *q = atomic_load(&st->view_mode) == VIEW_PERSIST ? &st->persist_q : &st->osc_q;
+    linkstats_t *ls = &st->rd.link;
+    linkstats_rates(ls, g_get_monotonic_time());
+    int n = g_snprintf(buf, sizeof(buf),
+                       "Кадры: принято %llu, отрисовано %llu, пропущено %llu, отброшено: очередь %llu, размер %llu\n"
+                       "Линия: %.2f МБ/с, %.1f кадр/с, пробуждений %.0f/с, потеряно по seq %llu, ошибки seq %llu, "
+                       "CRC %llu, заголовки %llu, мусор %llu Б%s",
+                       (unsigned long long)atomic_load(&q->produced),
+                       (unsigned long long)atomic_load(&q->rendered),
+                       (unsigned long long)atomic_load(&q->skipped),
+                       (unsigned long long)atomic_load(&q->dropped),
+                       (unsigned long long)atomic_load(&st->rd.rejected_size),
+                       ls->mbps, ls->fps, ls->wps,
+                       (unsigned long long)atomic_load(&ls->seq_lost),
+                       (unsigned long long)atomic_load(&ls->seq_errors),
+                       (unsigned long long)atomic_load(&ls->crc_errors),
+                       (unsigned long long)atomic_load(&ls->bad_headers),
+                       (unsigned long long)atomic_load(&ls->skipped_bytes),
+                       atomic_load(&st->rd.hangup) ? ", порт отключён" : "");
+
+    // Задержка: на плате от готовности кадра до конца передачи, на ПК от
+    // разбора до отрисовки (только режим «Линия»)
+    board_stats_t b;
+    if (linkstats_board(ls, &b) && b.core_hz && n > 0 && (size_t)n < sizeof(buf)) {
+        double us_per_cyc = 1e6 / b.core_hz;
+        double lat_board = b.lat_avg_cyc * us_per_cyc / 1000.0;
+        double lat_pc = ls->disp_lat_us / 1000.0;
+        g_snprintf(buf + n, sizeof(buf) - n,
+                   "\nПлата: отправлено %u, переполнений кольца %u, битых команд %u, "
+                   "прерывание %.1f/%.1f мкс (ср/макс), очередь %u/%u (макс %u)\n"
+                   "Задержка: плата %.2f мс (макс %.2f) + ПК %.2f мс = %.2f мс",
+                   b.frames_sent, b.overruns, b.rx_crc_errors,
+                   b.isr_avg_cyc * us_per_cyc, b.isr_max_cyc * us_per_cyc,
+                   b.backlog, b.ring_frames, b.backlog_max,
+                   lat_board, b.lat_max_cyc * us_per_cyc / 1000.0, lat_pc, lat_board + lat_pc);
+    }
+    n = (int)strlen(buf);
+    cmdchan_t *ccs[2] = {&st->cmd_osc, &st->cmd_gen};
+    for (unsigned i = 0; i < 2 && (size_t)n < sizeof(buf); i++) {
+        cmd_latency_t l;
+        cmdchan_latency(ccs[i], &l);
+        n += g_snprintf(buf + n, sizeof(buf) - n,
+                        "%s %llu, ответ %.1f/%.1f/%.1f мс (p50/p90/p99, макс %.1f), повторов %llu, "
+                        "таймаутов %llu, ошибок %llu",
+                        i ? ";\n  генератор" : "\nКоманды: осциллограф",
+                        (unsigned long long)atomic_load(&ccs[i]->sent), l.p50_ms, l.p90_ms, l.p99_ms, l.max_ms,
+                        (unsigned long long)atomic_load(&ccs[i]->resent),
+                        (unsigned long long)atomic_load(&ccs[i]->timeouts),
+                        (unsigned long long)atomic_load(&ccs[i]->errors));
+    }
+    n = (int)strlen(buf);
+    if (atomic_load(&st->rd.rec) && (size_t)n < sizeof(buf)) {
+        g_snprintf(buf + n, sizeof(buf) - n, "\nЗапись: кадров %llu, потеряно %llu, на диске %.1f МБ",
+                   (unsigned long long)atomic_load(&st->rec.frames),
+                   (unsigned long long)atomic_load(&st->rec.dropped),
+                   atomic_load(&st->rec.written) / 1e6);
+    }
+    gtk_label_set_text(st->stats_label, buf);
+}
+
+// Каждый кадр дисплея: если поток чтения выложил новый кадр — перерисовать.
+// С GTK работает только этот поток, читатель порта GTK не трогает.
+static gboolean on_scope_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
+{
+    (void)clock;
+    AppState *st = user_data;
+    static gint64 last_stats = 0, last_poll = 0, last_meas = 0;
+    if (atomic_load(&st->view_mode) == VIEW_PERSIST ? persist_has_new(&st->persist) : frameq_has_new(&st->osc_q)) {
+        gtk_widget_queue_draw(widget);
+    }
+    gint64 now = g_get_monotonic_time();
+    if (now - last_stats > G_USEC_PER_SEC / 2) {
+        last_stats = now;
+        update_stats(st);
+    }
+    if (now - last_meas > MEAS_LABEL_US) {
+        last_meas = now;
+        update_meas_label(st);
+    }
+    if (st->osc_thread && now - last_poll > OSC_STATS_PERIOD_US) {
+        last_poll = now;
+        cmdchan_send(&st->cmd_osc, PROTO_CMD_OSC_STATS, NULL, 0, NULL, NULL);
+    }
+    if (st->play_thread && atomic_load(&st->play_seek) < 0) {
+        gtk_range_set_value(st->play_scale, atomic_load(&st->play_pos) / 1e6);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void persist_stop(AppState *st)
+{
+    if (st->persist_thread) {
+        st->persist_run = false;
+        g_thread_join(st->persist_thread);
+        st->persist_thread = NULL;
+    }
+}
+
+// Линия / послесвечение
+static void on_view_mode_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    int mode = gtk_combo_box_get_active(combo);
+    if (mode == VIEW_PERSIST && !st->persist_thread) {
+        st->persist_run = true;
+        st->persist_thread = g_thread_new("persist", persist_thread, st);
+    }
+    atomic_store(&st->view_mode, mode);
+    atomic_store(&st->rd.out, mode == VIEW_PERSIST ? &st->persist_q : &st->osc_q);
+    if (mode != VIEW_PERSIST) persist_stop(st);
+    gtk_widget_queue_draw(GTK_WIDGET(st->scope_area));
+}
+
+// Спектр: лог. шкала — 0..SPEC_VIEW_DB дБFS, линейная — 0..2048 кодов
+static double spec_y(const spec_out_t *o, float v, int height)
+{
+    double t = o->log ? v / SPEC_VIEW_DB : 1.0 - v / 2048.0;
+    return t < 0 ? 0 : t > 1 ? height : t * height;
+}
+
+// Кривая спектра: бинов больше, чем пикселей — по столбцу максимум
+static void draw_spec_curve(cairo_t *cr, const spec_out_t *o, const float *v, int width, int height)
+{
+    uint32_t bins = o->bins, k = 0;
+    for (int x = 0; x < width; x++) {
+        uint32_t end = (uint32_t)((uint64_t)(x + 1) * bins / width);
+        float mx = v[k < bins ? k : bins - 1];
+        for (; k < end; k++) {
+            if (v[k] > mx) mx = v[k];
+        }
+        double y = spec_y(o, mx, height);
+        if (x == 0) cairo_move_to(cr, x, y);
         else cairo_line_to(cr, x, y);
     }
     cairo_stroke(cr);
-    g_mutex_unlock(&st->osc_lock);
+}
+
+static void draw_spectrum(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data)
+{
+    (void)area;
+    AppState *st = user_data;
+    const spec_out_t *o = spectrum_front(&st->spec);
+    cairo_set_source_rgb(cr, 0.05, 0.05, 0.08);
+    cairo_paint(cr);
+    if (!o) return;
+    // Сетка: 20 дБ (или 256 кодов) по вертикали, десятые fs/2 по горизонтали
+    cairo_set_source_rgb(cr, 0.18, 0.18, 0.22);
+    cairo_set_line_width(cr, 1.0);
+    for (int i = 1; i < 10; i++) {
+        cairo_move_to(cr, (int)(width * i / 10) + 0.5, 0);
+        cairo_line_to(cr, (int)(width * i / 10) + 0.5, height);
+    }
+    for (int i = 1; o->log ? i * 20 < -SPEC_VIEW_DB : i < 8; i++) {
+        double y = (int)spec_y(o, o->log ? -20.0f * i : 2048.0f - 256.0f * i, height) + 0.5;
+        cairo_move_to(cr, 0, y);
+        cairo_line_to(cr, width, y);
+    }
+    cairo_stroke(cr);
+    if (o->hold) {
+        cairo_set_source_rgb(cr, 0.9, 0.5, 0.1);
+        draw_spec_curve(cr, o, o->peak, width, height);
+    }
+    cairo_set_source_rgb(cr, trace_rgb[0][0], trace_rgb[0][1], trace_rgb[0][2]);
+    cairo_set_line_width(cr, 1.2);
+    draw_spec_curve(cr, o, o->mag, width, height);
+    // Маркеры: треугольник над пиком и номер
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    for (unsigned i = 0; i < o->nmk; i++) {
+        char label[8];
+        double x = o->mk[i].freq_hz / (o->fs_hz / 2.0) * width, y = spec_y(o, o->mk[i].level, height);
+        cairo_move_to(cr, x, y - 2);
+        cairo_line_to(cr, x - 4, y - 9);
+        cairo_line_to(cr, x + 4, y - 9);
+        cairo_close_path(cr);
+        cairo_fill(cr);
+        g_snprintf(label, sizeof(label), "%u", i + 1);
+        cairo_move_to(cr, x - 3, y - 11);
+        cairo_show_text(cr, label);
+    }
+}
+
+// Маркеры и загрузка потока спектра — строкой под графиком
+static void update_spec_label(AppState *st, const spec_out_t *o)
+{
+    char buf[512];
+    uint64_t frames = atomic_load(&st->spec.frames);
+    int n = g_snprintf(buf, sizeof(buf), "N = %u, %.2f Гц/бин, усреднено %u, БПФ %.0f мкс/кадр, отброшено %llu",
+                       (o->bins - 1) * 2, o->bin_hz, o->averaged,
+                       frames ? atomic_load(&st->spec.busy_ns) / 1e3 / frames : 0.0,
+                       (unsigned long long)atomic_load(&st->spec_q.dropped));
+    for (unsigned i = 0; i < o->nmk && n > 0 && (size_t)n < sizeof(buf); i++) {
+        n += g_snprintf(buf + n, sizeof(buf) - n, o->log ? "%sM%u %.2f Гц %.1f дБFS" : "%sM%u %.2f Гц %.1f кодов",
+                        i ? "; " : "\n", i + 1, o->mk[i].freq_hz, o->mk[i].level);
+    }
+    gtk_label_set_text(st->spec_label, buf);
+}
+
+static gboolean on_spec_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
+{
+    (void)clock;
+    AppState *st = user_data;
+    static gint64 last_label = 0;
+    if (!spectrum_has_new(&st->spec)) return G_SOURCE_CONTINUE;
+    const spec_out_t *o = spectrum_front(&st->spec);
+    gint64 now = g_get_monotonic_time();
+    if (o && now - last_label > SPEC_LABEL_US) {
+        last_label = now;
+        update_spec_label(st, o);
+    }
+    gtk_widget_queue_draw(widget);
+    return G_SOURCE_CONTINUE;
+}
+
+static void spectrum_stop(AppState *st)
+{
+    atomic_store(&st->rd.tap, NULL);
+    if (st->spec_thread) {
+        st->spec_run = false;
+        g_thread_join(st->spec_thread);
+        st->spec_thread = NULL;
+    }
+}
+
+// Поток спектра — только пока открыта его вкладка
+static void on_page_switched(GtkNotebook *nb, GtkWidget *page, guint num, gpointer user_data)
+{
+    (void)nb;
+    (void)num;
+    AppState *st = user_data;
+    if (page != gtk_widget_get_parent(GTK_WIDGET(st->spec_area))) {
+        spectrum_stop(st);
+        return;
+    }
+    if (!st->spec_thread) {
+        st->spec_run = true;
+        st->spec_thread = g_thread_new("spectrum", spectrum_thread, st);
+    }
+    atomic_store(&st->rd.tap, &st->spec_q);
+}
+
+static void on_spec_window_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    int w = gtk_combo_box_get_active(combo);
+    if (w >= 0 && w < SPEC_WIN_COUNT) atomic_store(&st->spec.want_win, w);
+}
+
+static void on_spec_scale_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    atomic_store(&st->spec.want_log, gtk_combo_box_get_active(combo) == 0);
+}
+
+static void on_spec_avg_changed(GtkSpinButton *spin, gpointer user_data)
+{
+    AppState *st = user_data;
+    atomic_store(&st->spec.want_avg, gtk_spin_button_get_value_as_int(spin));
+}
+
+static void on_spec_hold_toggled(GtkCheckButton *check, gpointer user_data)
+{
+    AppState *st = user_data;
+    atomic_store(&st->spec.want_hold, gtk_check_button_get_active(check));
+}
+
+static void on_spec_reset(GtkButton *btn, gpointer user_data)
+{
+    (void)btn;
+    AppState *st = user_data;
+    atomic_store(&st->spec.want_reset, true);
+}
+
+static void on_spec_channel_changed(GtkComboBox *combo, gpointer user_data)
+{
+    AppState *st = user_data;
+    atomic_store(&st->spec_ch, MAX(gtk_combo_box_get_active(combo), 0));
+    atomic_store(&st->spec.want_reset, true);
+}
+
+static GtkWidget *build_spectrum_tab(AppState *st)
+{
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+
+    GtkWidget *win_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(win_combo), "Ханн");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(win_combo), "Блэкман");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(win_combo), "Flat-top");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(win_combo), SPEC_WIN_HANN);
+    g_signal_connect(win_combo, "changed", G_CALLBACK(on_spec_window_changed), st);
+
+    GtkWidget *scale_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(scale_combo), "дБFS");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(scale_combo), "Линейная");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(scale_combo), 0);
+    g_signal_connect(scale_combo, "changed", G_CALLBACK(on_spec_scale_changed), st);
+
+    GtkWidget *avg_spin = gtk_spin_button_new_with_range(1, 256, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(avg_spin), 1);
+    g_signal_connect(avg_spin, "value-changed", G_CALLBACK(on_spec_avg_changed), st);
+
+    GtkWidget *hold_check = gtk_check_button_new_with_label("Удержание пиков");
+    g_signal_connect(hold_check, "toggled", G_CALLBACK(on_spec_hold_toggled), st);
+    GtkWidget *reset_btn = gtk_button_new_with_label("Сброс");
+    g_signal_connect(reset_btn, "clicked", G_CALLBACK(on_spec_reset), st);
+
+    GtkWidget *ch_combo = gtk_combo_box_text_new();
+    for (int c = 1; c <= OSC_MAX_CH; c++) {
+        char label[4];
+        g_snprintf(label, sizeof(label), "%d", c);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(ch_combo), label);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(ch_combo), 0);
+    g_signal_connect(ch_combo, "changed", G_CALLBACK(on_spec_channel_changed), st);
+
+    gtk_box_append(GTK_BOX(row), gtk_label_new("Окно"));
+    gtk_box_append(GTK_BOX(row), win_combo);
+    gtk_box_append(GTK_BOX(row), gtk_label_new("Шкала"));
+    gtk_box_append(GTK_BOX(row), scale_combo);
+    gtk_box_append(GTK_BOX(row), gtk_label_new("Усреднение, кадров"));
+    gtk_box_append(GTK_BOX(row), avg_spin);
+    gtk_box_append(GTK_BOX(row), hold_check);
+    gtk_box_append(GTK_BOX(row), reset_btn);
+    gtk_box_append(GTK_BOX(row), gtk_label_new("Канал"));
+    gtk_box_append(GTK_BOX(row), ch_combo);
+    gtk_box_append(GTK_BOX(box), row);
+
+    st->spec_area = GTK_DRAWING_AREA(gtk_drawing_area_new());
+    gtk_drawing_area_set_content_width(st->spec_area, 640);
+    gtk_drawing_area_set_content_height(st->spec_area, 300);
+    gtk_widget_set_vexpand(GTK_WIDGET(st->spec_area), TRUE);
+    gtk_drawing_area_set_draw_func(st->spec_area, draw_spectrum, st, NULL);
+    gtk_widget_add_tick_callback(GTK_WIDGET(st->spec_area), on_spec_tick, st, NULL);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(st->spec_area));
+
+    st->spec_label = GTK_LABEL(gtk_label_new("Нет кадров"));
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(st->spec_label));
+    return box;
+}
+
+// Сегменты: выгруженные копии — до нового захвата
+static void seg_clear(AppState *st)
+{
+    for (int k = 0; k < PROTO_SEG_MAX; k++) {
+        g_free(st->seg_fr[k].samples);
+        st->seg_fr[k].samples = NULL;
+    }
+    st->seg_rd = st->seg_rd_end = 0;
+    st->seg_got = st->seg_batch = 0;
+}
+
+static void on_seg_capture(GtkButton *btn, gpointer user_data)
+{
+    (void)btn;
+    AppState *st = user_data;
+    if (st->fd_osc <= 0) return;
+    uint16_t pre = (uint16_t)gtk_spin_button_get_value_as_int(st->seg_pre_spin);
+    uint16_t len = (uint16_t)gtk_spin_button_get_value_as_int(st->seg_len_spin);
+    uint16_t n = (uint16_t)gtk_spin_button_get_value_as_int(st->seg_n_spin);
+    uint8_t p[6] = {pre & 0xFF, pre >> 8, len & 0xFF, len >> 8, n & 0xFF, n >> 8};
+    seg_clear(st);
+    atomic_store(&st->rd.seg_filled, 0);
+    gtk_widget_queue_draw(GTK_WIDGET(st->seg_area));
+    board_cmd(st, &st->cmd_osc, PROTO_CMD_CAPTURE_ONCE, p, sizeof(p), "Сегментный захват запущен",
+              "Не удалось запустить захват");
+}
+
+static void on_seg_stop(GtkButton *btn, gpointer user_data)
+{
+    (void)btn;
+    AppState *st = user_data;
+    if (st->fd_osc <= 0) return;
+    board_cmd(st, &st->cmd_osc, PROTO_CMD_SEG_STOP, NULL, 0, "Захват остановлен, сегменты на плате",
+              "Не удалось остановить захват");
+}
+
+// Выгрузка всех готовых: пачки запрашивает on_seg_tick
+static void on_seg_upload(GtkButton *btn, gpointer user_data)
+{
+    (void)btn;
+    AppState *st = user_data;
+    if (st->fd_osc <= 0) return;
+    seg_clear(st);
+    st->seg_rd_end = MIN(atomic_load(&st->rd.seg_filled), PROTO_SEG_MAX);
+    if (!st->seg_rd_end) gtk_label_set_text(st->status_label, "Нет готовых сегментов");
+}
+
+static void seg_request_batch(AppState *st)
+{
+    uint16_t first = (uint16_t)st->seg_rd, count = (uint16_t)MIN(SEG_READ_BATCH, st->seg_rd_end - st->seg_rd);
+    uint8_t p[4] = {first & 0xFF, first >> 8, count & 0xFF, count >> 8};
+    if (!board_cmd(st, &st->cmd_osc, PROTO_CMD_SEG_READ, p, sizeof(p), NULL, "Не удалось выгрузить сегменты")) {
+        st->seg_rd_end = st->seg_rd;
+        return;
+    }
+    st->seg_rd += count;
+    st->seg_batch = count;
+    st->seg_got = 0;
+    st->seg_req_us = g_get_monotonic_time();
+}
+
+static void update_seg_info(AppState *st)
+{
+    char buf[256], t[32], dt[32];
+    int k = gtk_spin_button_get_value_as_int(st->seg_page) - 1;
+    const osc_frame_t *fr = k >= 0 && k < PROTO_SEG_MAX ? &st->seg_fr[k] : NULL;
+    if (!fr || !fr->samples) {
+        gtk_label_set_text(st->seg_info, "Сегмент не выгружен");
+        return;
+    }
+    // seg_t — номер отсчёта в общем потоке каналов
+    double rate = (double)fr->fs_hz * fr->nch;
+    fmt_s(t, sizeof(t), rate > 0 ? fr->seg_t / rate : 0);
+    if (k > 0 && st->seg_fr[k - 1].samples && rate > 0) {
+        fmt_s(dt, sizeof(dt), (fr->seg_t - st->seg_fr[k - 1].seg_t) / rate);
+    } else {
+        g_strlcpy(dt, "—", sizeof(dt));
+    }
+    g_snprintf(buf, sizeof(buf), "Сегмент %u из %u: срабатывание %s от начала захвата, от предыдущего %s",
+               fr->seg + 1, fr->nseg, t, dt);
+    gtk_label_set_text(st->seg_info, buf);
+}
+
+// Опрос seg_status, приём кадров сегментов и запрос следующей пачки.
+// Тик идёт, только пока вкладка на экране.
+static gboolean on_seg_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
+{
+    (void)clock;
+    AppState *st = user_data;
+    static gint64 last_poll = 0;
+    static uint64_t shown_rx = 0;
+    gint64 now = g_get_monotonic_time();
+    if (st->osc_thread && now - last_poll > SEG_POLL_US) {
+        last_poll = now;
+        cmdchan_send(&st->cmd_osc, PROTO_CMD_SEG_STATUS, NULL, 0, NULL, NULL);
+    }
+    const osc_frame_t *f;
+    bool got = false;
+    while ((f = frameq_next(&st->seg_q))) {
+        if (f->seg >= PROTO_SEG_MAX) continue;
+        osc_frame_t *dst = &st->seg_fr[f->seg];
+        // Пачка могла прийти дважды (повтор seg_read у старой прошивки):
+        // в счёт — только новые сегменты текущей пачки
+        if (!dst->samples && f->seg >= st->seg_rd - st->seg_batch && f->seg < st->seg_rd) st->seg_got++;
+        g_free(dst->samples);
+        dst->samples = g_new(uint16_t, MAX(f->nsamples, 1));
+        frameq_copy(dst, f);
+        got = true;
+    }
+    if (st->seg_rd < st->seg_rd_end &&
+        (st->seg_got >= st->seg_batch || now - st->seg_req_us > SEG_READ_TIMEOUT_US)) {
+        seg_request_batch(st);
+    }
+    uint64_t rx = atomic_load(&st->rd.seg_status_rx);
+    if (rx != shown_rx || got) {
+        static const char *const states[] = {"не идёт", "идёт", "завершён"};
+        char buf[160];
+        int state = atomic_load(&st->rd.seg_state), nseg = atomic_load(&st->rd.seg_nseg);
+        shown_rx = rx;
+        g_snprintf(buf, sizeof(buf), "Захват %s: готово %d из %d по %d отсчётов, выгружено %d",
+                   state >= 0 && state <= PROTO_SEG_DONE ? states[state] : "?", atomic_load(&st->rd.seg_filled),
+                   nseg, atomic_load(&st->rd.seg_samples), st->seg_rd - st->seg_batch + st->seg_got);
+        gtk_label_set_text(st->seg_label, buf);
+        gtk_spin_button_set_range(st->seg_page, 1, MAX(nseg, 1));
+    }
+    if (got) {
+        update_seg_info(st);
+        gtk_widget_queue_draw(widget);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_seg_page_changed(GtkSpinButton *spin, gpointer user_data)
+{
+    (void)spin;
+    AppState *st = user_data;
+    update_seg_info(st);
+    gtk_widget_queue_draw(GTK_WIDGET(st->seg_area));
+}
+
+// Сегмент: каналы, как на осциллограмме, и метка срабатывания
+static void draw_segment(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data)
+{
+    (void)area;
+    AppState *st = user_data;
+    int k = gtk_spin_button_get_value_as_int(st->seg_page) - 1;
+    const osc_frame_t *fr = k >= 0 && k < PROTO_SEG_MAX ? &st->seg_fr[k] : NULL;
+    cairo_set_source_rgb(cr, 0.05, 0.05, 0.08);
+    cairo_paint(cr);
+    if (!fr || !fr->samples || fr->nsamples < 2) return;
+    double x = (double)fr->pretrig / (fr->nsamples - 1) * width;
+    cairo_set_source_rgb(cr, 0.5, 0.5, 0.5);
+    cairo_set_line_width(cr, 1.0);
+    cairo_move_to(cr, x, 0);
+    cairo_line_to(cr, x, height);
+    cairo_stroke(cr);
+    for (unsigned c = 0; c < fr->nch; c++) {
+        cairo_set_source_rgb(cr, trace_rgb[c][0], trace_rgb[c][1], trace_rgb[c][2]);
+        draw_trace(st, cr, fr->samples + fr->ch_off[c], fr->ch_len[c], fr->bits, width, height);
+    }
+}
+
+static GtkWidget *build_segments_tab(AppState *st)
+{
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+
+    st->seg_len_spin = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(64, OSC_DEFAULT_MAX_POINTS, 64));
+    gtk_spin_button_set_value(st->seg_len_spin, 1024);
+    // 0 — сколько поместится в память платы
+    st->seg_n_spin = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(0, PROTO_SEG_MAX, 1));
+    gtk_spin_button_set_value(st->seg_n_spin, 0);
+    st->seg_pre_spin = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(0, 100, 5));
+    gtk_spin_button_set_value(st->seg_pre_spin, 20);
+
+    GtkWidget *capture_btn = gtk_button_new_with_label("Захват");
+    g_signal_connect(capture_btn, "clicked", G_CALLBACK(on_seg_capture), st);
+    GtkWidget *stop_btn = gtk_button_new_with_label("Стоп");
+    g_signal_connect(stop_btn, "clicked", G_CALLBACK(on_seg_stop), st);
+    GtkWidget *upload_btn = gtk_button_new_with_label("Выгрузить");
+    g_signal_connect(upload_btn, "clicked", G_CALLBACK(on_seg_upload), st);
+
+    gtk_box_append(GTK_BOX(row), gtk_label_new("Отсчётов"));
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(st->seg_len_spin));
+    gtk_box_append(GTK_BOX(row), gtk_label_new("Сегментов"));
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(st->seg_n_spin));
+    gtk_box_append(GTK_BOX(row), gtk_label_new("Предыстория, %"));
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(st->seg_pre_spin));
+    gtk_box_append(GTK_BOX(row), capture_btn);
+    gtk_box_append(GTK_BOX(row), stop_btn);
+    gtk_box_append(GTK_BOX(row), upload_btn);
+    gtk_box_append(GTK_BOX(box), row);
+
+    st->seg_label = GTK_LABEL(gtk_label_new("Захват не запускался"));
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(st->seg_label));
+
+    GtkWidget *page_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    st->seg_page = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(1, 1, 1));
+    g_signal_connect(st->seg_page, "value-changed", G_CALLBACK(on_seg_page_changed), st);
+    st->seg_info = GTK_LABEL(gtk_label_new(""));
+    gtk_box_append(GTK_BOX(page_row), gtk_label_new("Сегмент"));
+    gtk_box_append(GTK_BOX(page_row), GTK_WIDGET(st->seg_page));
+    gtk_box_append(GTK_BOX(page_row), GTK_WIDGET(st->seg_info));
+    gtk_box_append(GTK_BOX(box), page_row);
+
+    st->seg_area = GTK_DRAWING_AREA(gtk_drawing_area_new());
+    gtk_drawing_area_set_content_width(st->seg_area, 640);
+    gtk_drawing_area_set_content_height(st->seg_area, 300);
+    gtk_widget_set_vexpand(GTK_WIDGET(st->seg_area), TRUE);
+    gtk_drawing_area_set_draw_func(st->seg_area, draw_segment, st, NULL);
+    gtk_widget_add_tick_callback(GTK_WIDGET(st->seg_area), on_seg_tick, st, NULL);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(st->seg_area));
+    return box;
+}
+
+// Частотная характеристика: точка i с вычтенной калибровкой (если включена
+// и сетка частот та же); false — точке не верить
+static bool bode_value(AppState *st, unsigned i, double *gain_db, double *phase_deg)
+{
+    const bode_t *b = &st->bode;
+    *gain_db = b->pt[i].gain_db;
+    *phase_deg = b->pt[i].phase_deg;
+    if (!b->pt[i].ok) return false;
+    if (gtk_check_button_get_active(st->bode_cal_check) && st->bode_cal_n == b->npoints &&
+        st->bode_cal_f0 == b->f0_hz && st->bode_cal_f1 == b->f1_hz && st->bode_cal_log == b->log) {
+        if (!st->bode_cal[i].ok) return false;
+        *gain_db -= st->bode_cal[i].gain_db;
+        *phase_deg -= st->bode_cal[i].phase_deg;
+    }
+    return true;
+}
+
+static double bode_x(const bode_t *b, double f, int width)
+{
+    double lo = MIN(b->f0_hz, b->f1_hz), hi = MAX(b->f0_hz, b->f1_hz);
+    if (hi <= lo) return width / 2.0;
+    return (b->log ? log10(f / lo) / log10(hi / lo) : (f - lo) / (hi - lo)) * width;
+}
+
+// Один график: сетка по y с шагом step (пределы — по точкам), кривая,
+// подпись единиц; which: 0 — усиление, 1 — фаза
+static void draw_bode_plot(AppState *st, cairo_t *cr, unsigned done, int which, double step, int y0, int width,
+                           int height)
+{
+    const bode_t *b = &st->bode;
+    double lo = INFINITY, hi = -INFINITY, v[2];
+    for (unsigned i = 0; i < done; i++) {
+        if (!bode_value(st, i, &v[0], &v[1])) continue;
+        lo = MIN(lo, v[which]);
+        hi = MAX(hi, v[which]);
+    }
+    if (lo > hi) return;
+    lo = floor(lo / step) * step;
+    hi = MAX(ceil(hi / step) * step, lo + step);
+    char label[32];
+    cairo_set_source_rgb(cr, 0.18, 0.18, 0.22);
+    cairo_set_line_width(cr, 1.0);
+    for (double g = lo; g <= hi + step / 2; g += step) {
+        double y = (int)(y0 + (hi - g) / (hi - lo) * (height - 1)) + 0.5;
+        cairo_move_to(cr, 0, y);
+        cairo_line_to(cr, width, y);
+    }
+    cairo_stroke(cr);
+    cairo_set_source_rgb(cr, 0.6, 0.6, 0.6);
+    for (double g = lo; g <= hi + step / 2; g += step) {
+        g_snprintf(label, sizeof(label), which ? "%.0f°" : "%.0f дБ", g);
+        cairo_move_to(cr, 4, y0 + (hi - g) / (hi - lo) * (height - 1) - 3);
+        cairo_show_text(cr, label);
+    }
+    cairo_set_source_rgb(cr, trace_rgb[which][0], trace_rgb[which][1], trace_rgb[which][2]);
+    cairo_set_line_width(cr, 1.5);
+    bool pen = false;
+    for (unsigned i = 0; i < done; i++) {
+        // Точка без входного сигнала — разрыв кривой
+        if (!bode_value(st, i, &v[0], &v[1])) {
+            pen = false;
+            continue;
+        }
+        double x = bode_x(b, b->pt[i].f_hz, width), y = y0 + (hi - v[which]) / (hi - lo) * (height - 1);
+        if (pen) cairo_line_to(cr, x, y);
+        else cairo_move_to(cr, x, y);
+        pen = true;
+    }
+    cairo_stroke(cr);
+}
+
+// Усиление сверху, фаза снизу; частота — по сетке свипа (логарифм или линейно)
+static void draw_bode(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data)
+{
+    (void)area;
+    AppState *st = user_data;
+    const bode_t *b = &st->bode;
+    cairo_set_source_rgb(cr, 0.05, 0.05, 0.08);
+    cairo_paint(cr);
+    unsigned done = atomic_load(&b->done);
+    if (!done || atomic_load(&b->state) == BODE_IDLE) return;
+    // Декады (или десятые диапазона) по горизонтали
+    double lo = MIN(b->f0_hz, b->f1_hz), hi = MAX(b->f0_hz, b->f1_hz);
+    cairo_set_source_rgb(cr, 0.18, 0.18, 0.22);
+    cairo_set_line_width(cr, 1.0);
+    if (b->log) {
+        for (double f = pow(10, ceil(log10(lo))); f <= hi; f *= 10) {
+            double x = (int)bode_x(b, f, width) + 0.5;
+            cairo_move_to(cr, x, 0);
+            cairo_line_to(cr, x, height);
+        }
+    } else {
+        for (int i = 1; i < 10; i++) {
+            cairo_move_to(cr, (int)(width * i / 10) + 0.5, 0);
+            cairo_line_to(cr, (int)(width * i / 10) + 0.5, height);
+        }
+    }
+    cairo_move_to(cr, 0, height / 2 + 0.5);
+    cairo_line_to(cr, width, height / 2 + 0.5);
+    cairo_stroke(cr);
+    int h = height / 2 - 4;
+    draw_bode_plot(st, cr, done, 0, 10, 2, width, h);
+    draw_bode_plot(st, cr, done, 1, 45, height / 2 + 2, width, h);
+}
+
+static void update_bode_label(AppState *st)
+{
+    const bode_t *b = &st->bode;
+    char buf[256], t_total[32], t_cap[32];
+    unsigned done = atomic_load(&b->done);
+    int state = atomic_load(&b->state);
+    const char *what = st->bode_calibrating ? "Калибровка" : "Свип";
+    if (state == BODE_RUN) {
+        g_snprintf(buf, sizeof(buf), "%s: точка %u из %u", what, done, b->npoints);
+    } else if (state == BODE_FAILED) {
+        g_snprintf(buf, sizeof(buf), "%s прерван на точке %u: %s", what, done + 1, b->msg);
+    } else {
+        fmt_s(t_total, sizeof(t_total), b->total_s);
+        fmt_s(t_cap, sizeof(t_cap), b->capture_s);
+        g_snprintf(buf, sizeof(buf), "%s %s: %u точек за %s (из них захват %s)", what,
+                   state == BODE_DONE ? "закончен" : "остановлен", done, t_total, t_cap);
+    }
+    gtk_label_set_text(st->bode_label, buf);
+}
+
+static gboolean on_bode_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
+{
+    (void)clock;
+    AppState *st = user_data;
+    static unsigned shown_done = 0;
+    static int shown_state = BODE_IDLE;
+    unsigned done = atomic_load(&st->bode.done);
+    int state = atomic_load(&st->bode.state);
+    if (done == shown_done && state == shown_state) return G_SOURCE_CONTINUE;
+    if (state == BODE_DONE && shown_state == BODE_RUN && st->bode_calibrating) {
+        const bode_t *b = &st->bode;
+        memcpy(st->bode_cal, b->pt, b->npoints * sizeof(bode_point_t));
+        st->bode_cal_n = b->npoints;
+        st->bode_cal_f0 = b->f0_hz;
+        st->bode_cal_f1 = b->f1_hz;
+        st->bode_cal_log = b->log;
+        gtk_check_button_set_active(st->bode_cal_check, TRUE);
+    }
+    shown_done = done;
+    shown_state = state;
+    update_bode_label(st);
+    gtk_widget_queue_draw(widget);
+    return G_SOURCE_CONTINUE;
+}
+
+// Осциллограф на время свипа — 2 канала, 12 бит: то же в его вкладке,
+// без повторной отправки команд
+static void bode_sync_scope(AppState *st)
+{
+    st->osc_nch = 2;
+    st->osc_bits = 12;
+    g_signal_handlers_block_by_func(st->ch_combo, on_channels_changed, st);
+    gtk_combo_box_set_active(st->ch_combo, st->osc_nch - 1);
+    g_signal_handlers_unblock_by_func(st->ch_combo, on_channels_changed, st);
+    g_signal_handlers_block_by_func(st->ovs_combo, on_ovs_changed, st);
+    gtk_combo_box_set_active(st->ovs_combo, 0);
+    g_signal_handlers_unblock_by_func(st->ovs_combo, on_ovs_changed, st);
+}
+
+static void bode_begin(AppState *st, bool calibrate)
+{
+    bode_t *b = &st->bode;
+    if (!st->osc_thread || !st->gen_thread) {
+        gtk_label_set_text(st->status_label, "Для свипа нужны обе платы");
+        return;
+    }
+    if (atomic_load(&b->state) == BODE_RUN) return;
+    b->f0_hz = gtk_spin_button_get_value(st->bode_f0_spin);
+    b->f1_hz = gtk_spin_button_get_value(st->bode_f1_spin);
+    b->npoints = (unsigned)gtk_spin_button_get_value_as_int(st->bode_n_spin);
+    b->log = gtk_check_button_get_active(st->bode_log_check);
+    b->gen = &st->cmd_gen;
+    b->osc = &st->cmd_osc;
+    b->rd = &st->rd;
+    if (!bode_start(b)) {
+        gtk_label_set_text(st->status_label, "Свип не запущен: проверьте частоты и число точек");
+        return;
+    }
+    st->bode_calibrating = calibrate;
+    bode_sync_scope(st);
+    gtk_label_set_text(st->status_label, calibrate ? "Калибровка: вход цепи на оба канала" : "Свип запущен");
+}
+
+static void on_bode_start(GtkButton *btn, gpointer user_data)
+{
+    (void)btn;
+    bode_begin(user_data, false);
+}
+
+static void on_bode_calibrate(GtkButton *btn, gpointer user_data)
+{
+    (void)btn;
+    bode_begin(user_data, true);
+}
+
+// Поток свипа сам заметит флаг; ждать его здесь — подвесить GUI до таймаута команд
+static void on_bode_stop(GtkButton *btn, gpointer user_data)
+{
+    (void)btn;
+    AppState *st = user_data;
+    atomic_store(&st->bode.stop, true);
+}
+
+static void on_bode_cal_toggled(GtkCheckButton *check, gpointer user_data)
+{
+    (void)check;
+    AppState *st = user_data;
+    gtk_widget_queue_draw(GTK_WIDGET(st->bode_area));
+}
+
+static GtkWidget *build_bode_tab(AppState *st)
+{
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+
+    st->bode_f0_spin = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(1, BODE_F_MAX, 1));
+    gtk_spin_button_set_value(st->bode_f0_spin, 100);
+    st->bode_f1_spin = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(1, BODE_F_MAX, 1));
+    gtk_spin_button_set_value(st->bode_f1_spin, 100000);
+    st->bode_n_spin = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(2, BODE_MAX_POINTS, 1));
+    gtk_spin_button_set_value(st->bode_n_spin, 100);
+    st->bode_log_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label("Логарифм"));
+    gtk_check_button_set_active(st->bode_log_check, TRUE);
+
+    GtkWidget *start_btn = gtk_button_new_with_label("Свип");
+    g_signal_connect(start_btn, "clicked", G_CALLBACK(on_bode_start), st);
+    GtkWidget *stop_btn = gtk_button_new_with_label("Стоп");
+    g_signal_connect(stop_btn, "clicked", G_CALLBACK(on_bode_stop), st);
+    GtkWidget *cal_btn = gtk_button_new_with_label("Калибровка");
+    g_signal_connect(cal_btn, "clicked", G_CALLBACK(on_bode_calibrate), st);
+    st->bode_cal_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label("Вычитать калибровку"));
+    g_signal_connect(st->bode_cal_check, "toggled", G_CALLBACK(on_bode_cal_toggled), st);
+
+    gtk_box_append(GTK_BOX(row), gtk_label_new("От, Гц"));
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(st->bode_f0_spin));
+    gtk_box_append(GTK_BOX(row), gtk_label_new("До, Гц"));
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(st->bode_f1_spin));
+    gtk_box_append(GTK_BOX(row), gtk_label_new("Точек"));
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(st->bode_n_spin));
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(st->bode_log_check));
+    gtk_box_append(GTK_BOX(row), start_btn);
+    gtk_box_append(GTK_BOX(row), stop_btn);
+    gtk_box_append(GTK_BOX(row), cal_btn);
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(st->bode_cal_check));
+    gtk_box_append(GTK_BOX(box), row);
+
+    // Канал 0 — вход цепи (выход генератора), канал 1 — выход цепи
+    st->bode_label = GTK_LABEL(gtk_label_new("Канал 1 — вход цепи, канал 2 — выход; свип не запускался"));
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(st->bode_label));
+
+    st->bode_area = GTK_DRAWING_AREA(gtk_drawing_area_new());
+    gtk_drawing_area_set_content_width(st->bode_area, 640);
+    gtk_drawing_area_set_content_height(st->bode_area, 400);
+    gtk_widget_set_vexpand(GTK_WIDGET(st->bode_area), TRUE);
+    gtk_drawing_area_set_draw_func(st->bode_area, draw_bode, st, NULL);
+    gtk_widget_add_tick_callback(GTK_WIDGET(st->bode_area), on_bode_tick, st, NULL);
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(st->bode_area));
+    return box;
 }
 
 static GtkWidget *build_scope_tab(AppState *st)
@@ -278,6 +1745,16 @@ static GtkWidget *build_scope_tab(AppState *st)
     gtk_box_append(GTK_BOX(connect_row), GTK_WIDGET(st->osc_entry));
     gtk_box_append(GTK_BOX(connect_row), gtk_label_new("Генератор"));
     gtk_box_append(GTK_BOX(connect_row), GTK_WIDGET(st->gen_entry));
+    GtkWidget *baud_combo = gtk_combo_box_text_new();
+    for (int i = 0; port_bauds[i]; i++) {
+        char label[16];
+        g_snprintf(label, sizeof(label), "%u", port_bauds[i]);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(baud_combo), label);
+        if (port_bauds[i] == st->baud) gtk_combo_box_set_active(GTK_COMBO_BOX(baud_combo), i);
+    }
+    g_signal_connect(baud_combo, "changed", G_CALLBACK(on_baud_changed), st);
+    gtk_box_append(GTK_BOX(connect_row), gtk_label_new("Скорость"));
+    gtk_box_append(GTK_BOX(connect_row), baud_combo);
     gtk_box_append(GTK_BOX(connect_row), connect_btn);
     gtk_box_append(GTK_BOX(box), connect_row);
 
@@ -289,14 +1766,107 @@ static GtkWidget *build_scope_tab(AppState *st)
     g_signal_connect(stop_btn, "clicked", G_CALLBACK(on_stop_stream), st);
     gtk_box_append(GTK_BOX(btn_row), start_btn);
     gtk_box_append(GTK_BOX(btn_row), stop_btn);
+
+    GtkWidget *view_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(view_combo), "Линия");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(view_combo), "Послесвечение");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(view_combo), VIEW_LINE);
+    g_signal_connect(view_combo, "changed", G_CALLBACK(on_view_mode_changed), st);
+    gtk_box_append(GTK_BOX(btn_row), gtk_label_new("Режим"));
+    gtk_box_append(GTK_BOX(btn_row), view_combo);
+
+    GtkWidget *enc_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(enc_combo), "u16");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(enc_combo), "12 бит");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(enc_combo), "12 бит + дельта");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(enc_combo), st->osc_enc);
+    g_signal_connect(enc_combo, "changed", G_CALLBACK(on_encoding_changed), st);
+    gtk_box_append(GTK_BOX(btn_row), gtk_label_new("Кодирование"));
+    gtk_box_append(GTK_BOX(btn_row), enc_combo);
+
+    GtkWidget *ch_combo = gtk_combo_box_text_new();
+    for (int c = 1; c <= OSC_MAX_CH; c++) {
+        char label[4];
+        g_snprintf(label, sizeof(label), "%d", c);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(ch_combo), label);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(ch_combo), st->osc_nch - 1);
+    g_signal_connect(ch_combo, "changed", G_CALLBACK(on_channels_changed), st);
+    st->ch_combo = GTK_COMBO_BOX(ch_combo);
+    gtk_box_append(GTK_BOX(btn_row), gtk_label_new("Каналы"));
+    gtk_box_append(GTK_BOX(btn_row), ch_combo);
+
+    GtkWidget *gain_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(gain_combo), "×1");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(gain_combo), "×2");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(gain_combo), "×5");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(gain_combo), "×10");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(gain_combo), st->osc_gain);
+    g_signal_connect(gain_combo, "changed", G_CALLBACK(on_gain_changed), st);
+    gtk_box_append(GTK_BOX(btn_row), gtk_label_new("Усиление"));
+    gtk_box_append(GTK_BOX(btn_row), gain_combo);
+
+    GtkWidget *ovs_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(ovs_combo), "12 (без передискретизации)");
+    for (int b = 13; b <= PROTO_OVS_MAX_BITS; b++) {
+        char label[8];
+        g_snprintf(label, sizeof(label), "%d", b);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(ovs_combo), label);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(ovs_combo), st->osc_bits - 12);
+    g_signal_connect(ovs_combo, "changed", G_CALLBACK(on_ovs_changed), st);
+    st->ovs_combo = GTK_COMBO_BOX(ovs_combo);
+    gtk_box_append(GTK_BOX(btn_row), gtk_label_new("Разрядность"));
+    gtk_box_append(GTK_BOX(btn_row), ovs_combo);
     gtk_box_append(GTK_BOX(box), btn_row);
 
-    // Поле отрисовки осциллограммы
+    // Запись и воспроизведение
+    GtkWidget *rec_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    st->rec_entry = GTK_ENTRY(gtk_entry_new());
+    gtk_editable_set_text(GTK_EDITABLE(st->rec_entry), "capture.oscrec");
+    GtkWidget *rec_btn = gtk_toggle_button_new_with_label("Запись");
+    g_signal_connect(rec_btn, "toggled", G_CALLBACK(on_record_toggled), st);
+    st->play_btn = GTK_TOGGLE_BUTTON(gtk_toggle_button_new_with_label("Воспроизвести"));
+    g_signal_connect(st->play_btn, "toggled", G_CALLBACK(on_replay_toggled), st);
+    GtkWidget *pause_btn = gtk_toggle_button_new_with_label("Пауза");
+    g_signal_connect(pause_btn, "toggled", G_CALLBACK(on_replay_pause_toggled), st);
+    GtkWidget *speed_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(speed_combo), "1x");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(speed_combo), "2x");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(speed_combo), "10x");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(speed_combo), "макс");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(speed_combo), 0);
+    g_signal_connect(speed_combo, "changed", G_CALLBACK(on_replay_speed_changed), st);
+    st->play_scale = GTK_RANGE(gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 0, 1, 0.1));
+    gtk_scale_set_draw_value(GTK_SCALE(st->play_scale), TRUE);
+    gtk_widget_set_hexpand(GTK_WIDGET(st->play_scale), TRUE);
+    g_signal_connect(st->play_scale, "change-value", G_CALLBACK(on_replay_scrub), st);
+    gtk_box_append(GTK_BOX(rec_row), gtk_label_new("Файл"));
+    gtk_box_append(GTK_BOX(rec_row), GTK_WIDGET(st->rec_entry));
+    gtk_box_append(GTK_BOX(rec_row), rec_btn);
+    gtk_box_append(GTK_BOX(rec_row), GTK_WIDGET(st->play_btn));
+    gtk_box_append(GTK_BOX(rec_row), pause_btn);
+    gtk_box_append(GTK_BOX(rec_row), speed_combo);
+    gtk_box_append(GTK_BOX(rec_row), GTK_WIDGET(st->play_scale));
+    gtk_box_append(GTK_BOX(box), rec_row);
+
+    // Поле отрисовки осциллограммы, справа — измерения
+    GtkWidget *scope_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
     st->scope_area = GTK_DRAWING_AREA(gtk_drawing_area_new());
     gtk_drawing_area_set_content_width(st->scope_area, 640);
     gtk_drawing_area_set_content_height(st->scope_area, 240);
+    gtk_widget_set_hexpand(GTK_WIDGET(st->scope_area), TRUE);
     gtk_drawing_area_set_draw_func(st->scope_area, draw_scope, st, NULL);
-    gtk_box_append(GTK_BOX(box), GTK_WIDGET(st->scope_area));
+    gtk_widget_add_tick_callback(GTK_WIDGET(st->scope_area), on_scope_tick, st, NULL);
+    st->meas_label = GTK_LABEL(gtk_label_new(""));
+    gtk_widget_set_size_request(GTK_WIDGET(st->meas_label), 180, -1);
+    gtk_widget_set_valign(GTK_WIDGET(st->meas_label), GTK_ALIGN_START);
+    gtk_box_append(GTK_BOX(scope_row), GTK_WIDGET(st->scope_area));
+    gtk_box_append(GTK_BOX(scope_row), GTK_WIDGET(st->meas_label));
+    gtk_box_append(GTK_BOX(box), scope_row);
+
+    st->stats_label = GTK_LABEL(gtk_label_new(""));
+    gtk_box_append(GTK_BOX(box), GTK_WIDGET(st->stats_label));
 
     // Статус
     st->status_label = GTK_LABEL(gtk_label_new("Нет подключений"));
@@ -319,7 +1889,8 @@ static GtkWidget *build_generator_tab(AppState *st)
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(wave_combo), "Пользовательская");
     gtk_combo_box_set_active(GTK_COMBO_BOX(wave_combo), 0);
 
-    GtkWidget *freq_spin = gtk_spin_button_new_with_range(1, 200000, 1);
+    GtkWidget *freq_spin = gtk_spin_button_new_with_range(0.001, 500000, 1);
+    gtk_spin_button_set_digits(GTK_SPIN_BUTTON(freq_spin), 3);
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(freq_spin), 1000);
 
     GtkWidget *ampl_spin = gtk_spin_button_new_with_range(0, 3000, 10);
@@ -352,6 +1923,48 @@ static GtkWidget *build_generator_tab(AppState *st)
     g_object_set_data(G_OBJECT(box), "duty_spin", duty_spin);
     g_signal_connect(apply_btn, "clicked", G_CALLBACK(on_apply_generator), st);
 
+    // DDS и свип
+    GtkWidget *dds_check = gtk_check_button_new_with_label("DDS (частота до 0,001 Гц, без разрывов)");
+    gtk_box_append(GTK_BOX(box), dds_check);
+    g_signal_connect(dds_check, "toggled", G_CALLBACK(on_dds_toggled), st);
+
+    GtkWidget *sweep_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *sweep_to_spin = gtk_spin_button_new_with_range(0.001, 500000, 1);
+    gtk_spin_button_set_digits(GTK_SPIN_BUTTON(sweep_to_spin), 3);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(sweep_to_spin), 10000);
+    GtkWidget *sweep_time_spin = gtk_spin_button_new_with_range(0.01, 3600, 0.1);
+    gtk_spin_button_set_digits(GTK_SPIN_BUTTON(sweep_time_spin), 2);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(sweep_time_spin), 1);
+    GtkWidget *sweep_log_check = gtk_check_button_new_with_label("Лог.");
+    GtkWidget *sweep_repeat_check = gtk_check_button_new_with_label("По кругу");
+    GtkWidget *sweep_btn = gtk_button_new_with_label("Свип");
+    gtk_box_append(GTK_BOX(sweep_row), gtk_label_new("Свип до, Гц"));
+    gtk_box_append(GTK_BOX(sweep_row), sweep_to_spin);
+    gtk_box_append(GTK_BOX(sweep_row), gtk_label_new("за, с"));
+    gtk_box_append(GTK_BOX(sweep_row), sweep_time_spin);
+    gtk_box_append(GTK_BOX(sweep_row), sweep_log_check);
+    gtk_box_append(GTK_BOX(sweep_row), sweep_repeat_check);
+    gtk_box_append(GTK_BOX(sweep_row), sweep_btn);
+    gtk_box_append(GTK_BOX(box), sweep_row);
+    g_object_set_data(G_OBJECT(box), "sweep_to_spin", sweep_to_spin);
+    g_object_set_data(G_OBJECT(box), "sweep_time_spin", sweep_time_spin);
+    g_object_set_data(G_OBJECT(box), "sweep_log_check", sweep_log_check);
+    g_object_set_data(G_OBJECT(box), "sweep_repeat_check", sweep_repeat_check);
+    g_signal_connect(sweep_btn, "clicked", G_CALLBACK(on_sweep), st);
+
+    // Форма из файла (CSV — последний столбец, WAV — первый канал): размах
+    // на всю шкалу ЦАП, до 4096 точек
+    GtkWidget *wave_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    st->wave_entry = GTK_ENTRY(gtk_entry_new());
+    gtk_editable_set_text(GTK_EDITABLE(st->wave_entry), "wave.csv");
+    gtk_widget_set_hexpand(GTK_WIDGET(st->wave_entry), TRUE);
+    GtkWidget *wave_btn = gtk_button_new_with_label("Загрузить форму");
+    g_signal_connect(wave_btn, "clicked", G_CALLBACK(on_upload_wave), st);
+    gtk_box_append(GTK_BOX(wave_row), gtk_label_new("Файл формы (CSV/WAV)"));
+    gtk_box_append(GTK_BOX(wave_row), GTK_WIDGET(st->wave_entry));
+    gtk_box_append(GTK_BOX(wave_row), wave_btn);
+    gtk_box_append(GTK_BOX(box), wave_row);
+
     return box;
 }
 
@@ -365,6 +1978,10 @@ static void app_activate(GtkApplication *app, gpointer user_data)
     GtkWidget *notebook = gtk_notebook_new();
     gtk_notebook_append_page(GTK_NOTEBOOK(notebook), build_scope_tab(st), gtk_label_new("Осциллограф"));
     gtk_notebook_append_page(GTK_NOTEBOOK(notebook), build_generator_tab(st), gtk_label_new("Генератор"));
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), build_spectrum_tab(st), gtk_label_new("Спектр"));
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), build_segments_tab(st), gtk_label_new("Сегменты"));
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), build_bode_tab(st), gtk_label_new("АЧХ/ФЧХ"));
+    g_signal_connect(notebook, "switch-page", G_CALLBACK(on_page_switched), st);
 
     gtk_window_set_child(GTK_WINDOW(win), notebook);
     gtk_widget_set_visible(win, TRUE);
@@ -373,16 +1990,55 @@ static void app_activate(GtkApplication *app, gpointer user_data)
 int main(int argc, char **argv)
 {
     AppState st = {0};
-    g_mutex_init(&st.osc_lock);
+    st.osc_nch = 1;
+    st.osc_bits = 12;
+    st.baud = 115200;
+    st.play_speed = 1;
+    crc16_init();
+    frameq_init(&st.osc_q, OSC_QUEUE_FRAMES, OSC_MAX_POINTS);
+    frameq_init(&st.persist_q, PERSIST_QUEUE_FRAMES, OSC_MAX_POINTS);
+    frameq_init(&st.spec_q, SPEC_QUEUE_FRAMES, OSC_MAX_POINTS);
+    frameq_init(&st.seg_q, SEG_READ_BATCH, OSC_MAX_POINTS);
+    spectrum_init(&st.spec);
+    persist_init(&st.persist);
+    osc_reader_init(&st.rd, OSC_DEFAULT_MAX_POINTS);
+    st.rd.out = &st.osc_q;
+    st.rd.seg_out = &st.seg_q;
+    osc_reader_init(&st.rd_gen, 64);
+    cmdchan_init(&st.cmd_osc);
+    cmdchan_init(&st.cmd_gen);
+    upload_init(&st.upload);
+    bode_init(&st.bode);
+    st.rd.cmd = &st.cmd_osc;
+    st.rd_gen.cmd = &st.cmd_gen;
     GtkApplication *app = gtk_application_new("student.oscgen", G_APPLICATION_DEFAULT_FLAGS);
     g_signal_connect(app, "activate", G_CALLBACK(app_activate), &st);
     int status = g_application_run(G_APPLICATION(app), argc, argv);
     g_object_unref(app);
-    if (st.osc_thread) {
-        st.osc_thread_run = false;
-        g_thread_join(st.osc_thread);
+    replay_stop(&st);
+    osc_reader_stop(&st);
+    if (atomic_load(&st.rd.rec)) {
+        atomic_store(&st.rd.rec, NULL);
+        recorder_stop(&st.rec);
     }
     if (st.fd_osc > 0) close(st.fd_osc);
     if (st.fd_gen > 0) close(st.fd_gen);
+    osc_reader_free(&st.rd);
+    osc_reader_free(&st.rd_gen);
+    cmdchan_free(&st.cmd_osc);
+    cmdchan_free(&st.cmd_gen);
+    upload_free(&st.upload);
+    bode_free(&st.bode);
+    persist_stop(&st);
+    persist_free(&st.persist);
+    spectrum_stop(&st);
+    spectrum_free(&st.spec);
+    frameq_free(&st.spec_q);
+    seg_clear(&st);
+    frameq_free(&st.seg_q);
+    frameq_free(&st.persist_q);
+    frameq_free(&st.osc_q);
+    g_free(st.col_min);
+    g_free(st.col_max);
     return status;
 }
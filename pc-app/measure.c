@@ -0,0 +1,283 @@
+#include "measure.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MEAS_X86 1
+#endif
+
+// Свёртка кусками: суммы по дорожкам векторов — в u32, кусок их не переполнит
+#define MEAS_CHUNK 65536u
+
+static void reduce_scalar(const uint16_t *x, uint32_t n, meas_acc_t *a)
+{
+    uint16_t lo = 0xFFFF, hi = 0;
+    uint64_t sum = 0, sum2 = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t v = x[i];
+        if (v < lo) lo = (uint16_t)v;
+        if (v > hi) hi = (uint16_t)v;
+        sum += v;
+        sum2 += v * v;
+    }
+    a->min = lo;
+    a->max = hi;
+    a->sum = sum;
+    a->sum2 = sum2;
+}
+
+static uint32_t skip_scalar(const uint16_t *x, uint32_t i, uint32_t n, uint16_t lo, uint16_t hi)
+{
+    for (; i < n; i++) {
+        if (x[i] < lo || x[i] > hi) break;
+    }
+    return i;
+}
+
+#ifdef MEAS_X86
+// Квадраты u16 -> u32 из младших и старших половин произведений, сразу в
+// 64-битные суммы; min/max — как в decimate.c, со сдвигом в знаковый диапазон
+__attribute__((target("sse2")))
+static void reduce_sse2(const uint16_t *x, uint32_t n, meas_acc_t *a)
+{
+    const __m128i bias = _mm_set1_epi16((short)0x8000), zero = _mm_setzero_si128();
+    __m128i vlo = _mm_set1_epi16(0x7FFF);
+    __m128i vhi = _mm_set1_epi16((short)0x8000);
+    __m128i s32 = zero, q64 = zero;
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i vb = _mm_xor_si128(v, bias);
+        vlo = _mm_min_epi16(vlo, vb);
+        vhi = _mm_max_epi16(vhi, vb);
+        s32 = _mm_add_epi32(s32, _mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)));
+        __m128i pl = _mm_mullo_epi16(v, v), ph = _mm_mulhi_epu16(v, v);
+        __m128i q0 = _mm_unpacklo_epi16(pl, ph), q1 = _mm_unpackhi_epi16(pl, ph);
+        q64 = _mm_add_epi64(q64, _mm_add_epi64(_mm_unpacklo_epi32(q0, zero), _mm_unpackhi_epi32(q0, zero)));
+        q64 = _mm_add_epi64(q64, _mm_add_epi64(_mm_unpacklo_epi32(q1, zero), _mm_unpackhi_epi32(q1, zero)));
+    }
+    uint16_t lo16[8], hi16[8];
+    uint32_t s[4];
+    uint64_t q[2];
+    _mm_storeu_si128((__m128i *)lo16, _mm_xor_si128(vlo, bias));
+    _mm_storeu_si128((__m128i *)hi16, _mm_xor_si128(vhi, bias));
+    _mm_storeu_si128((__m128i *)s, s32);
+    _mm_storeu_si128((__m128i *)q, q64);
+    meas_acc_t t;
+    reduce_scalar(x + i, n - i, &t);
+    for (int k = 0; k < 8; k++) {
+        if (lo16[k] < t.min) t.min = lo16[k];
+        if (hi16[k] > t.max) t.max = hi16[k];
+    }
+    t.sum += (uint64_t)s[0] + s[1] + s[2] + s[3];
+    t.sum2 += q[0] + q[1];
+    *a = t;
+}
+
+// Первый отсчёт вне [lo, hi]: сравнение восьми сразу, позиция — по маске
+__attribute__((target("sse2")))
+static uint32_t skip_sse2(const uint16_t *x, uint32_t i, uint32_t n, uint16_t lo, uint16_t hi)
+{
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    const __m128i vlo = _mm_set1_epi16((short)(lo ^ 0x8000));
+    const __m128i vhi = _mm_set1_epi16((short)(hi ^ 0x8000));
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(x + i)), bias);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi16(v, vlo), _mm_cmpgt_epi16(v, vhi)));
+        if (mask) return i + (uint32_t)__builtin_ctz((unsigned)mask) / 2;
+    }
+    return skip_scalar(x, i, n, lo, hi);
+}
+
+__attribute__((target("avx2")))
+static void reduce_avx2(const uint16_t *x, uint32_t n, meas_acc_t *a)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i vlo = _mm256_set1_epi16((short)0xFFFF);
+    __m256i vhi = zero, s32 = zero, q64 = zero;
+    uint32_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        vlo = _mm256_min_epu16(vlo, v);
+        vhi = _mm256_max_epu16(vhi, v);
+        s32 = _mm256_add_epi32(s32, _mm256_add_epi32(_mm256_unpacklo_epi16(v, zero), _mm256_unpackhi_epi16(v, zero)));
+        __m256i pl = _mm256_mullo_epi16(v, v), ph = _mm256_mulhi_epu16(v, v);
+        __m256i q0 = _mm256_unpacklo_epi16(pl, ph), q1 = _mm256_unpackhi_epi16(pl, ph);
+        q64 = _mm256_add_epi64(q64, _mm256_add_epi64(_mm256_unpacklo_epi32(q0, zero), _mm256_unpackhi_epi32(q0, zero)));
+        q64 = _mm256_add_epi64(q64, _mm256_add_epi64(_mm256_unpacklo_epi32(q1, zero), _mm256_unpackhi_epi32(q1, zero)));
+    }
+    uint16_t lo16[16], hi16[16];
+    uint32_t s[8];
+    uint64_t q[4];
+    _mm256_storeu_si256((__m256i *)lo16, vlo);
+    _mm256_storeu_si256((__m256i *)hi16, vhi);
+    _mm256_storeu_si256((__m256i *)s, s32);
+    _mm256_storeu_si256((__m256i *)q, q64);
+    meas_acc_t t;
+    reduce_scalar(x + i, n - i, &t);
+    for (int k = 0; k < 16; k++) {
+        if (lo16[k] < t.min) t.min = lo16[k];
+        if (hi16[k] > t.max) t.max = hi16[k];
+    }
+    for (int k = 0; k < 8; k++) t.sum += s[k];
+    t.sum2 += q[0] + q[1] + q[2] + q[3];
+    *a = t;
+}
+
+// В AVX2 нет беззнакового сравнения u16 — тот же сдвиг, что в SSE2
+__attribute__((target("avx2")))
+static uint32_t skip_avx2(const uint16_t *x, uint32_t i, uint32_t n, uint16_t lo, uint16_t hi)
+{
+    const __m256i bias = _mm256_set1_epi16((short)0x8000);
+    const __m256i vlo = _mm256_set1_epi16((short)(lo ^ 0x8000));
+    const __m256i vhi = _mm256_set1_epi16((short)(hi ^ 0x8000));
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(x + i)), bias);
+        __m256i out = _mm256_or_si256(_mm256_cmpgt_epi16(vlo, v), _mm256_cmpgt_epi16(v, vhi));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(out);
+        if (mask) return i + (uint32_t)__builtin_ctz(mask) / 2;
+    }
+    return skip_sse2(x, i, n, lo, hi);
+}
+
+const meas_kernels_t meas_sse2 = {"sse2", reduce_sse2, skip_sse2};
+const meas_kernels_t meas_avx2 = {"avx2", reduce_avx2, skip_avx2};
+#else
+const meas_kernels_t meas_sse2 = {"sse2", NULL, NULL};
+const meas_kernels_t meas_avx2 = {"avx2", NULL, NULL};
+#endif
+
+const meas_kernels_t meas_scalar = {"scalar", reduce_scalar, skip_scalar};
+
+static const meas_kernels_t *pick_kernels(void)
+{
+#ifdef MEAS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &meas_avx2;
+    if (__builtin_cpu_supports("sse2")) return &meas_sse2;
+#endif
+    return &meas_scalar;
+}
+
+// Поиск фронтов. Зоны отсчёта: 0 — ниже 10 %, 1 — до 50 %, 2 — до 90 %,
+// 3 — выше. Нарастающий фронт — переход из низа (был ниже 10 %) в верх
+// (выше 90 %); его момент — последнее пересечение 50 % вверх перед этим,
+// время нарастания — от последнего пересечения 10 % до 90 %. Спадающий —
+// зеркально. Дребезг между уровнями фронтов не добавляет.
+typedef struct {
+    double lvl[3];              // 10/50/90 %, коды
+    int state;                  // -1 неизвестно, 0 низ, 1 верх
+    double t_lo_up, t_mid_up;   // < 0 — не было с прихода в низ
+    double t_hi_dn, t_mid_dn;   // < 0 — не было с прихода в верх
+    double first_r, last_r, first_f, last_f;
+    unsigned nr, nf, nh;
+    double rise, fall, high;
+} scan_t;
+
+static void on_cross(scan_t *s, int k, bool up, double t)
+{
+    if (up) {
+        if (k == 0) {
+            s->t_lo_up = t;
+        } else if (k == 1) {
+            s->t_mid_up = t;
+        } else if (s->state != 1) {
+            if (s->state == 0 && s->t_lo_up >= 0) {
+                if (!s->nr++) s->first_r = s->t_mid_up;
+                s->last_r = s->t_mid_up;
+                s->rise += t - s->t_lo_up;
+            }
+            s->state = 1;
+            s->t_hi_dn = s->t_mid_dn = -1;
+        }
+        return;
+    }
+    if (k == 2) {
+        s->t_hi_dn = t;
+    } else if (k == 1) {
+        s->t_mid_dn = t;
+    } else if (s->state != 0) {
+        if (s->state == 1 && s->t_hi_dn >= 0) {
+            if (!s->nf++) s->first_f = s->t_mid_dn;
+            s->last_f = s->t_mid_dn;
+            s->fall += t - s->t_hi_dn;
+            if (s->nr) {
+                s->high += s->t_mid_dn - s->last_r;
+                s->nh++;
+            }
+        }
+        s->state = 0;
+        s->t_lo_up = s->t_mid_up = -1;
+    }
+}
+
+static void scan_edges(const meas_kernels_t *k, const uint16_t *x, uint32_t n, uint16_t mn, uint16_t mx, meas_t *m)
+{
+    scan_t s = {.state = -1, .t_lo_up = -1, .t_mid_up = -1, .t_hi_dn = -1, .t_mid_dn = -1};
+    uint16_t thr[3];            // зона z: [thr[z-1], thr[z] - 1]
+    static const double frac[3] = {0.1, 0.5, 0.9};
+    for (int i = 0; i < 3; i++) {
+        s.lvl[i] = mn + (mx - mn) * frac[i];
+        thr[i] = (uint16_t)ceil(s.lvl[i]);
+    }
+    int z = (x[0] >= thr[0]) + (x[0] >= thr[1]) + (x[0] >= thr[2]);
+    if (z == 0) s.state = 0;
+    else if (z == 3) s.state = 1;
+    for (uint32_t i = 1; i < n; i++) {
+        i = k->skip(x, i, n, z ? thr[z - 1] : 0, z < 3 ? (uint16_t)(thr[z] - 1) : 0xFFFF);
+        if (i >= n) break;
+        double x0 = x[i - 1], x1 = x[i];
+        int zn = (x[i] >= thr[0]) + (x[i] >= thr[1]) + (x[i] >= thr[2]);
+        if (zn > z) {
+            for (int c = z; c < zn; c++) on_cross(&s, c, true, i - 1 + (s.lvl[c] - x0) / (x1 - x0));
+        } else {
+            for (int c = z - 1; c >= zn; c--) on_cross(&s, c, false, i - 1 + (s.lvl[c] - x0) / (x1 - x0));
+        }
+        z = zn;
+    }
+    m->edges = (uint16_t)(s.nr + s.nf > 0xFFFF ? 0xFFFF : s.nr + s.nf);
+    if (s.nr >= 2) m->period = (float)((s.last_r - s.first_r) / (s.nr - 1));
+    else if (s.nf >= 2) m->period = (float)((s.last_f - s.first_f) / (s.nf - 1));
+    if (s.nr) m->rise = (float)(s.rise / s.nr);
+    if (s.nf) m->fall = (float)(s.fall / s.nf);
+    if (s.nh && m->period > 0) m->duty = (float)(s.high / s.nh / m->period);
+}
+
+void measure_with(const meas_kernels_t *k, const uint16_t *x, uint32_t n, meas_t *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->duty = -1;
+    if (!n) return;
+    meas_acc_t a = {0xFFFF, 0, 0, 0};
+    for (uint32_t i = 0; i < n; i += MEAS_CHUNK) {
+        meas_acc_t c;
+        k->reduce(x + i, n - i < MEAS_CHUNK ? n - i : MEAS_CHUNK, &c);
+        if (c.min < a.min) a.min = c.min;
+        if (c.max > a.max) a.max = c.max;
+        a.sum += c.sum;
+        a.sum2 += c.sum2;
+    }
+    double mean = (double)a.sum / n, ms = (double)a.sum2 / n;
+    m->min = a.min;
+    m->max = a.max;
+    m->mean = (float)mean;
+    m->rms = (float)sqrt(ms);
+    m->ac_rms = ms > mean * mean ? (float)sqrt(ms - mean * mean) : 0.0f;
+    if (n >= 3 && a.max - a.min >= MEAS_MIN_PP) scan_edges(k, x, n, a.min, a.max, m);
+}
+
+void measure(const uint16_t *x, uint32_t n, meas_t *m)
+{
+    static const meas_kernels_t *k;
+    if (!k) k = pick_kernels();
+    measure_with(k, x, n, m);
+}
+
+double meas_mv_per_code(unsigned step)
+{
+    static const double gain[MEAS_GAIN_STEPS] = {1, 2, 5, 10};
+    return 3300.0 / 4095.0 / gain[step < MEAS_GAIN_STEPS ? step : 0];
+}
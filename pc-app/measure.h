@@ -0,0 +1,56 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+// Автоматические измерения канала на каждом кадре: размах, среднее, СКЗ,
+// период (по пересечениям уровня 50 % с интерполяцией между отсчётами),
+// скважность, время нарастания и спада (10–90 %). Считаются в кодах АЦП и
+// отсчётах; в мВ и секунды — при показе, по шагу усиления (set_gain) и
+// частоте дискретизации кадра.
+//
+// Два прохода по кадру (он ещё в кэше): свёртка min/max/Σx/Σx² и поиск
+// фронтов — уровни 10/50/90 % берутся от min/max этого же кадра. Во втором
+// проходе блоки, где ни один уровень не пересечён, пропускаются целиком
+// сравнением векторов; скалярно разбираются только переходы. Ядра: AVX2,
+// SSE2 и скалярное; выбор при первом вызове по CPUID.
+
+#include <stdint.h>
+
+#define MEAS_MIN_PP      20     // размах меньше (кодов) — фронтов не ищем: шум
+#define MEAS_GAIN_STEPS  4      // set_gain: ×1, ×2, ×5, ×10
+
+typedef struct {
+    uint16_t min, max;          // коды
+    float mean;                 // коды
+    float rms;                  // полное СКЗ, коды
+    float ac_rms;               // без постоянной составляющей
+    float period;               // в отсчётах; 0 — меньше двух фронтов одного знака
+    float duty;                 // доля периода выше 50 %; < 0 — не измерена
+    float rise, fall;           // 10–90 % в отсчётах; 0 — ни одного фронта
+    uint16_t edges;             // фронтов (нарастающих и спадающих) в кадре
+} meas_t;
+
+void measure(const uint16_t *x, uint32_t n, meas_t *m);
+
+// мВ на код АЦП при шаге усиления step (шкала 3300 мВ / 4095 кодов)
+double meas_mv_per_code(unsigned step);
+
+// Для бенчмарка: ядра свёртки и пропуска блоков (у sse2/avx2 reduce = NULL,
+// если не собраны) и измерение с заданными ядрами
+typedef struct {
+    uint16_t min, max;
+    uint64_t sum, sum2;
+} meas_acc_t;
+typedef void (*meas_reduce_fn)(const uint16_t *x, uint32_t n, meas_acc_t *a);
+// Первый индекс с i, где отсчёт вне [lo, hi] (n — нет такого)
+typedef uint32_t (*meas_skip_fn)(const uint16_t *x, uint32_t i, uint32_t n, uint16_t lo, uint16_t hi);
+typedef struct {
+    const char *name;
+    meas_reduce_fn reduce;
+    meas_skip_fn skip;
+} meas_kernels_t;
+extern const meas_kernels_t meas_scalar;
+extern const meas_kernels_t meas_sse2;
+extern const meas_kernels_t meas_avx2;
+void measure_with(const meas_kernels_t *k, const uint16_t *x, uint32_t n, meas_t *m);
+
+#endif
@@ -0,0 +1,74 @@
+// Симулятор двух плат для GUI без железа: два псевдотерминала (осциллограф
+// и генератор), пути печатаются при запуске — их вписать в поля портов.
+// Раз в секунду — сколько отправлено.
+//
+//   ./osc_sim [-n точек] [-r кадров_в_с] [-e enc] [-c каналов] [-s]
+//             [-C crc_ppm] [-D drop_ppm] [-G garbage_ppm] [-R reply_drop_ppm]
+//             [-U chunk_corrupt_ppm]
+//   -r 0 — так быстро, как читает приёмник; -s — поток сразу, без stream_on
+
+#include "devsim.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+int main(int argc, char **argv)
+{
+    devsim_cfg_t cfg = {.points = 8192, .rate = 50, .nch = 1};
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:e:c:sC:D:G:R:U:")) != -1) {
+        switch (opt) {
+        case 'n': cfg.points = (uint16_t)atoi(optarg); break;
+        case 'r': cfg.rate = (uint32_t)atoi(optarg); break;
+        case 'e': cfg.enc = (uint8_t)atoi(optarg); break;
+        case 'c': cfg.nch = (uint8_t)atoi(optarg); break;
+        case 's': cfg.stream = true; break;
+        case 'C': cfg.crc_ppm = (uint32_t)atoi(optarg); break;
+        case 'D': cfg.drop_ppm = (uint32_t)atoi(optarg); break;
+        case 'G': cfg.garbage_ppm = (uint32_t)atoi(optarg); break;
+        case 'R': cfg.reply_drop_ppm = (uint32_t)atoi(optarg); break;
+        case 'U': cfg.chunk_corrupt_ppm = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n points] [-r fps] [-e enc] [-c nch] [-s] [-C ppm] [-D ppm] [-G ppm] [-R ppm] [-U ppm]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    crc16_init();
+    static devsim_t osc, gen;
+    devsim_cfg_t gcfg = {.points = 2, .nch = 1, .reply_drop_ppm = cfg.reply_drop_ppm,
+                          .chunk_corrupt_ppm = cfg.chunk_corrupt_ppm};
+    if (!devsim_start(&osc, &cfg) || !devsim_start(&gen, &gcfg)) {
+        perror("openpty");
+        return 1;
+    }
+    printf("Осциллограф: %s\nГенератор:   %s\n", osc.path, gen.path);
+    fflush(stdout);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    unsigned long long prev = 0;
+    while (!stop) {
+        sleep(1);
+        unsigned long long bytes = atomic_load(&osc.bytes_sent);
+        printf("%llu кадров, %.2f МБ/с, не успели %llu, команд %llu + %llu\n",
+               (unsigned long long)atomic_load(&osc.frames_sent), (bytes - prev) / 1e6,
+               (unsigned long long)atomic_load(&osc.overruns), (unsigned long long)atomic_load(&osc.commands),
+               (unsigned long long)atomic_load(&gen.commands));
+        fflush(stdout);
+        prev = bytes;
+    }
+    devsim_stop(&osc);
+    devsim_stop(&gen);
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include "persist.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define PERSIST_SSE2 1
+#endif
+
+#define PERSIST_BG 0xFF0D0D14u   // как фон draw_scope (0.05, 0.05, 0.08)
+
+void persist_init(persist_t *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->back = 0;
+    atomic_init(&p->mid, 1);
+    p->front = 2;
+    p->decay_shift = 3;
+    // Зелёный люминофор: яркость ~ sqrt(счётчика), частые места белеют
+    p->lut[0] = PERSIST_BG;
+    for (int c = 1; c < 1024; c++) {
+        double t = sqrt(c / 1023.0);
+        uint32_t g = (uint32_t)(60 + 195 * t);
+        uint32_t rb = (uint32_t)(220 * t * t * t);
+        p->lut[c] = 0xFF000000u | (rb << 16) | (g << 8) | rb;
+    }
+}
+
+void persist_free(persist_t *p)
+{
+    free(p->hist);
+    free(p->rows);
+    for (int i = 0; i < 3; i++) free(p->img[i].px);
+    memset(p, 0, sizeof(*p));
+}
+
+void persist_clear(persist_t *p)
+{
+    if (p->hist) memset(p->hist, 0, (size_t)p->w * p->h * sizeof(uint16_t));
+}
+
+// Строка экрана для каждого отсчёта: (h-1) - v*(h-1)/maxv
+void persist_rows(const uint16_t *samples, uint32_t n, uint16_t maxv, int h, uint16_t *rows)
+{
+    uint32_t scale = ((uint32_t)(h - 1) << 16) / maxv;
+    uint32_t i = 0;
+#ifdef PERSIST_SSE2
+    if (scale <= 0xFFFF) {
+        const __m128i bias = _mm_set1_epi16((short)0x8000);
+        const __m128i vmax = _mm_set1_epi16((short)(maxv ^ 0x8000));
+        const __m128i vscale = _mm_set1_epi16((short)scale);
+        const __m128i vtop = _mm_set1_epi16((short)(h - 1));
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+            // беззнаковый min(v, maxv) через сдвиг в знаковый диапазон
+            v = _mm_xor_si128(_mm_min_epi16(_mm_xor_si128(v, bias), vmax), bias);
+            __m128i r = _mm_sub_epi16(vtop, _mm_mulhi_epu16(v, vscale));
+            _mm_storeu_si128((__m128i *)(rows + i), r);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t v = samples[i] > maxv ? maxv : samples[i];
+        rows[i] = (uint16_t)((h - 1) - ((v * scale) >> 16));
+    }
+}
+
+// Затухание: h -= (h >> shift) + (h != 0), с насыщением в 0
+void persist_decay(uint16_t *hist, uint32_t n, uint8_t shift)
+{
+    uint32_t i = 0;
+#ifdef PERSIST_SSE2
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(hist + i));
+        __m128i nz = _mm_andnot_si128(_mm_cmpeq_epi16(v, zero), one);
+        __m128i dec = _mm_add_epi16(_mm_srl_epi16(v, sh), nz);
+        _mm_storeu_si128((__m128i *)(hist + i), _mm_subs_epu16(v, dec));
+    }
+#endif
+    for (; i < n; i++) {
+        uint16_t dec = (uint16_t)((hist[i] >> shift) + (hist[i] != 0));
+        hist[i] = hist[i] > dec ? hist[i] - dec : 0;
+    }
+}
+
+static void resize(persist_t *p)
+{
+    int w = atomic_load_explicit(&p->want_w, memory_order_relaxed);
+    int h = atomic_load_explicit(&p->want_h, memory_order_relaxed);
+    if (w <= 0 || h <= 1 || (w == p->w && h == p->h && p->hist)) return;
+    free(p->hist);
+    p->hist = calloc((size_t)w * h, sizeof(uint16_t));
+    p->w = p->hist ? w : 0;
+    p->h = p->hist ? h : 0;
+}
+
+void persist_accumulate(persist_t *p, const uint16_t *samples, uint32_t n, uint16_t maxv)
+{
+    resize(p);
+    if (!p->hist || n < 2) return;
+    if (n > p->rows_cap) {
+        free(p->rows);
+        p->rows = malloc(n * sizeof(uint16_t));
+        p->rows_cap = p->rows ? n : 0;
+        if (!p->rows) return;
+    }
+    persist_rows(samples, n, maxv, p->h, p->rows);
+
+    // Попадания: точка на отсчёт плюс вертикаль до предыдущего, чтобы
+    // крутые фронты не рассыпались на отдельные точки
+    const uint16_t *rows = p->rows;
+    uint16_t *hist = p->hist;
+    int w = p->w;
+    uint32_t step = (uint32_t)(((uint64_t)w << 16) / n);
+    uint32_t xf = 0;
+    int prev = rows[0];
+    for (uint32_t i = 0; i < n; i++, xf += step) {
+        int x = (int)(xf >> 16);
+        int r = rows[i];
+        int a = r, b = r;
+        if (r > prev) a = prev + 1;       // точка prev уже учтена
+        else if (r < prev) b = prev - 1;
+        uint16_t *cell = hist + (size_t)a * w + x;
+        for (int y = a; y <= b; y++, cell += w) {
+            *cell += (*cell != 0xFFFF);
+        }
+        prev = r;
+    }
+}
+
+void persist_render(persist_t *p)
+{
+    if (!p->hist) return;
+    persist_img_t *img = &p->img[p->back];
+    if (img->w != p->w || img->h != p->h) {
+        free(img->px);
+        img->px = malloc((size_t)p->w * p->h * sizeof(uint32_t));
+        img->w = img->px ? p->w : 0;
+        img->h = img->px ? p->h : 0;
+        img->stride = img->w * 4;
+        if (!img->px) return;
+    }
+
+    uint32_t n = (uint32_t)p->w * p->h;
+    persist_decay(p->hist, n, p->decay_shift);
+    const uint16_t *hist = p->hist;
+    uint32_t *px = img->px;
+    for (uint32_t i = 0; i < n; i++) {
+        px[i] = p->lut[hist[i] < 1023 ? hist[i] : 1023];
+    }
+
+    p->back = atomic_exchange_explicit(&p->mid, p->back | PERSIST_FRESH, memory_order_acq_rel) & 3;
+}
+
+bool persist_has_new(persist_t *p)
+{
+    return atomic_load_explicit(&p->mid, memory_order_relaxed) & PERSIST_FRESH;
+}
+
+const persist_img_t *persist_front(persist_t *p)
+{
+    if (atomic_load_explicit(&p->mid, memory_order_relaxed) & PERSIST_FRESH) {
+        p->front = atomic_exchange_explicit(&p->mid, p->front, memory_order_acq_rel) & 3;
+    }
+    const persist_img_t *img = &p->img[p->front];
+    return img->px ? img : NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+// Режим послесвечения: кадры копятся в гистограмму попаданий w×h, она
+// затухает и раскрашивается в ARGB32-картинку, которую отрисовка выводит
+// одной cairo_image_surface. Накопление идёт в отдельном потоке; готовые
+// картинки передаются через тройной буфер без блокировок.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    int w, h, stride;       // stride в байтах
+    uint32_t *px;
+} persist_img_t;
+
+typedef struct {
+    int w, h;
+    uint16_t *hist;         // только поток накопления
+    uint16_t *rows;         // строки отсчётов текущего кадра (временный)
+    uint32_t rows_cap;
+    persist_img_t img[3];
+    int back;               // пишет поток накопления
+    int front;              // читает отрисовка
+    _Atomic int mid;        // обмен; PERSIST_FRESH — там свежая картинка
+    _Atomic int want_w;     // размер области отрисовки (задаёт GTK)
+    _Atomic int want_h;
+    uint8_t decay_shift;    // за картинку гасим hist >> decay_shift
+    uint32_t lut[1024];     // счётчик -> цвет
+} persist_t;
+
+#define PERSIST_FRESH 4
+
+void persist_init(persist_t *p);
+void persist_free(persist_t *p);
+void persist_clear(persist_t *p);
+
+// Поток накопления
+void persist_accumulate(persist_t *p, const uint16_t *samples, uint32_t n, uint16_t maxv);
+void persist_render(persist_t *p);  // затухание + раскраска + публикация
+
+// Отрисовка: свежая картинка (или прежняя; NULL — ещё ни одной)
+const persist_img_t *persist_front(persist_t *p);
+bool persist_has_new(persist_t *p);
+
+// Ядра, открыты для бенчмарка (bench_persist сверяет SSE2 со скалярным хвостом)
+void persist_decay(uint16_t *hist, uint32_t n, uint8_t shift);
+void persist_rows(const uint16_t *samples, uint32_t n, uint16_t maxv, int h, uint16_t *rows);
+
+#endif
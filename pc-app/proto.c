@@ -0,0 +1,175 @@
+#define _GNU_SOURCE
+#include "proto.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static size_t round_pow2(size_t v)
+{
+    size_t p = (size_t)sysconf(_SC_PAGESIZE);
+    while (p < v) p <<= 1;
+    return p;
+}
+
+// Кольцо: одна и та же memfd-область отображена в [0, cap) и [cap, 2*cap)
+bool proto_rx_init(proto_rx_t *rx, size_t cap)
+{
+    memset(rx, 0, sizeof(*rx));
+    cap = round_pow2(cap);
+
+    int fd = memfd_create("osc_rx", MFD_CLOEXEC);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)cap) != 0) {
+        close(fd);
+        return false;
+    }
+    uint8_t *base = mmap(NULL, cap * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (mmap(base, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + cap, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, cap * 2);
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    rx->buf = base;
+    rx->cap = cap;
+    rx->mask = cap - 1;
+    size_t max_len = cap - PROTO_HDR_LEN - PROTO_CRC_LEN;
+    rx->max_len = max_len > 0xFFFF ? 0xFFFF : (uint16_t)max_len;
+    return true;
+}
+
+void proto_rx_free(proto_rx_t *rx)
+{
+    if (rx->buf) munmap(rx->buf, rx->cap * 2);
+    memset(rx, 0, sizeof(*rx));
+}
+
+// Новый сеанс (переподключение): и данные, и счётчики — с нуля, иначе
+// linkstats_sync_rx вернёт сброшенной статистике ошибки прежнего сеанса
+void proto_rx_reset(proto_rx_t *rx)
+{
+    rx->rd = rx->wr = 0;
+    rx->frames = rx->crc_errors = rx->bad_headers = rx->skipped_bytes = 0;
+}
+
+bool proto_rx_resize(proto_rx_t *rx, size_t cap)
+{
+    if (round_pow2(cap) <= rx->cap) return true;
+    proto_rx_t n;
+    if (!proto_rx_init(&n, cap)) return false;
+    size_t have = rx->wr - rx->rd;
+    memcpy(n.buf, rx->buf + (rx->rd & rx->mask), have);
+    n.wr = have;
+    n.frames = rx->frames;
+    n.crc_errors = rx->crc_errors;
+    n.bad_headers = rx->bad_headers;
+    n.skipped_bytes = rx->skipped_bytes;
+    munmap(rx->buf, rx->cap * 2);
+    *rx = n;
+    return true;
+}
+
+uint8_t *proto_rx_write_ptr(proto_rx_t *rx, size_t *space)
+{
+    *space = rx->cap - (rx->wr - rx->rd);
+    return rx->buf + (rx->wr & rx->mask);
+}
+
+void proto_rx_commit(proto_rx_t *rx, size_t n)
+{
+    rx->wr += n;
+}
+
+size_t proto_rx_feed(proto_rx_t *rx, const uint8_t *data, size_t n)
+{
+    size_t space;
+    uint8_t *dst = proto_rx_write_ptr(rx, &space);
+    if (n > space) n = space;
+    memcpy(dst, data, n);
+    rx->wr += n;
+    return n;
+}
+
+static void skip(proto_rx_t *rx, size_t n)
+{
+    rx->rd += n;
+    rx->skipped_bytes += n;
+}
+
+bool proto_rx_next(proto_rx_t *rx, proto_frame_t *f)
+{
+    for (;;) {
+        size_t have = rx->wr - rx->rd;
+        if (have < 2) return false;
+        const uint8_t *p = rx->buf + (rx->rd & rx->mask);
+
+        // Поиск sync 0x55 0xAA: memchr по непрерывному окну кольца
+        if (p[0] != PROTO_SYNC0 || p[1] != PROTO_SYNC1) {
+            const uint8_t *s = memchr(p + 1, PROTO_SYNC0, have - 1);
+            if (!s) {
+                skip(rx, have);
+                return false;
+            }
+            skip(rx, (size_t)(s - p));
+            continue;
+        }
+        if (have < PROTO_HDR_LEN) return false; // ждём заголовок
+
+        uint16_t len = p[6] | (p[7] << 8);
+        if (p[2] != PROTO_VER || len > rx->max_len) {
+            rx->bad_headers++;
+            skip(rx, 1);
+            continue;
+        }
+        size_t frame_len = PROTO_HDR_LEN + len + PROTO_CRC_LEN;
+        if (have < frame_len) return false; // ждём весь кадр
+
+        uint16_t crc_calc = crc16_ibm(p + 2, PROTO_HDR_LEN - 2 + len);
+        uint16_t crc_rx = p[PROTO_HDR_LEN + len] | (p[PROTO_HDR_LEN + len + 1] << 8);
+        if (crc_calc != crc_rx) {
+            rx->crc_errors++;
+            skip(rx, 1);
+            continue;
+        }
+
+        f->ver = p[2];
+        f->seq = p[3] | (p[4] << 8);
+        f->cmd = p[5];
+        f->len = len;
+        f->payload = p + PROTO_HDR_LEN;
+        f->raw = p;
+        f->raw_len = frame_len;
+        rx->rd += frame_len;
+        rx->frames++;
+        return true;
+    }
+}
+
+// Кадр: sync, ver=1, seq, cmd, len, payload, crc16 (от ver)
+size_t proto_build(uint8_t *out, uint16_t seq, uint8_t cmd, const uint8_t *payload, uint16_t len)
+{
+    size_t idx = 0;
+    out[idx++] = PROTO_SYNC0;
+    out[idx++] = PROTO_SYNC1;
+    out[idx++] = PROTO_VER;
+    out[idx++] = seq & 0xFF;
+    out[idx++] = seq >> 8;
+    out[idx++] = cmd;
+    out[idx++] = len & 0xFF;
+    out[idx++] = len >> 8;
+    if (payload && len) {
+        memcpy(&out[idx], payload, len);
+    }
+    idx += len;
+    uint16_t crc = crc16_ibm(&out[2], idx - 2);
+    out[idx++] = crc & 0xFF;
+    out[idx++] = crc >> 8;
+    return idx;
+}
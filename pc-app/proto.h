@@ -0,0 +1,111 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+// Разбор входящего потока кадров протокола (см. docs/protocol.md).
+// Модуль не зависит от GTK и собирается отдельно (бенчмарки в bench/).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crc16.h"
+
+#define PROTO_SYNC0     0x55
+#define PROTO_SYNC1     0xAA
+#define PROTO_VER       0x01
+#define PROTO_HDR_LEN   8   // sync(2) + ver(1) + seq(2) + cmd(1) + len(2)
+#define PROTO_CRC_LEN   2
+#define PROTO_MAX_FRAME (PROTO_HDR_LEN + 0xFFFF + PROTO_CRC_LEN)
+
+#define PROTO_RESP          0x80   // ответ: cmd | 0x80, payload[0] — код ошибки
+#define PROTO_ERR_PARAM     1      // неверный параметр
+#define PROTO_ERR_UNKNOWN   2      // команду плата не знает (старая прошивка)
+#define PROTO_CMD_GEN_SET_WAVE 0x10 // {u8 type}: 0 — синус
+#define PROTO_CMD_GEN_SET_FREQ 0x11 // {u32 mHz}
+#define PROTO_CMD_GEN_SET_ALL 0x16 // {u8 wave; u32 freq_mHz; u16 ampl_mVpp; i16 offset_mV; u16 duty_permille}
+#define PROTO_CMD_GEN_SET_MODE 0x17 // {u8 mode}: 0 — таблица, 1 — DDS
+#define PROTO_CMD_GEN_SWEEP  0x18  // {u32 f0_mHz; u32 f1_mHz; u32 time_ms; u8 flags}, только в DDS
+#define PROTO_GEN_MODE_DDS   1
+#define PROTO_SWEEP_LOG      1
+#define PROTO_SWEEP_REPEAT   2
+#define PROTO_CMD_GEN_UPLOAD      0x15 // {u16 n; n×u16} одним кадром (старая прошивка)
+#define PROTO_CMD_GEN_UPLOAD_BEGIN 0x19 // {u32 n; u16 chunk_points; u16 crc}
+#define PROTO_CMD_GEN_UPLOAD_CHUNK 0x1A // {u32 offset; u16 n; u16 crc; n×u16}
+#define PROTO_CMD_GEN_UPLOAD_COMMIT 0x1B // -> {u8 err; u16 missing}
+#define PROTO_UPLOAD_MAX_POINTS    4096 // MAX_USER_POINTS прошивки
+#define PROTO_UPLOAD_CHUNK_MAX     512
+#define PROTO_CMD_SET_FS     0x20  // {u32 Hz}
+#define PROTO_CMD_SET_GAIN   0x21  // {u8 step}, 0..MEAS_GAIN_STEPS-1
+#define PROTO_CMD_SET_TRIG   0x22  // {u8 mode; i16 level_mV; u8 edge}, mode 0 — выкл.
+#define PROTO_CMD_CAPTURE_ONCE 0x23 // {u16 pre_pct; u16 samples; u16 segments} -> {u8 err; u16 nseg}
+#define PROTO_CMD_STREAM_ON  0x24  // {u8 on}; on — и выход из сегментного режима
+#define PROTO_CMD_SET_ENC    0x25
+#define PROTO_CMD_SET_CH     0x26
+#define PROTO_CMD_SEG_STATUS 0x27  // -> {u8 err; u8 state; u16 filled; u16 nseg; u16 samples; u16 pretrig; u32 pool}
+#define PROTO_CMD_SEG_READ   0x28  // {u16 first; u16 count} -> {u8 err}, затем count кадров
+#define PROTO_CMD_SEG_STOP   0x29  // -> {u8 err; u16 filled}
+#define PROTO_SEG_IDLE       0
+#define PROTO_SEG_ARMED      1
+#define PROTO_SEG_DONE       2
+#define PROTO_SEG_MAX        256   // сегментов у платы
+#define PROTO_CMD_SET_OVS    0x2A  // {u8 bits} -> {u8 err; u8 bits}: передискретизация, 12..16 бит
+#define PROTO_OVS_MAX_BITS   16
+#define PROTO_CMD_OSC_STATS  0x2E
+#define PROTO_CMD_OSC_STATUS 0x2F
+#define PROTO_CMD_OSC_DATA  0x40
+#define PROTO_CMD_OSC_DATA_EXT 0x41    // meta + u8 ext_len + ext + отсчёты в кодировке ext.enc
+
+// OSC_DATA: meta {u32 fs_hz; u8 ch; u16 nsamples; u16 pretrig} + u16 отсчёты
+#define OSC_META_LEN        9
+#define OSC_MAX_POINTS      ((0xFFFF - OSC_META_LEN) / 2)   // предел по полю len
+#define OSC_FRAME_BYTES(n)  (PROTO_HDR_LEN + OSC_META_LEN + (size_t)(n) * 2 + PROTO_CRC_LEN)
+#define OSC_MAX_CH          4       // каналов в кадре (OSC_DATA_EXT, ext.nch)
+
+// Разобранный кадр. payload указывает прямо в кольцо и действителен
+// до следующего вызова proto_rx_write_ptr()/proto_rx_feed().
+typedef struct {
+    uint8_t ver;
+    uint16_t seq;
+    uint8_t cmd;
+    uint16_t len;
+    const uint8_t *payload;
+    const uint8_t *raw;     // начало кадра (sync), длина raw_len
+    size_t raw_len;
+} proto_frame_t;
+
+// Приёмное кольцо. Ёмкость — степень двойки; память отображена дважды
+// подряд, поэтому любой кадр (и свободное место) виден непрерывным
+// куском и разбирается без memmove и без копирования.
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t mask;
+    size_t rd;          // монотонные счётчики байт
+    size_t wr;
+    uint16_t max_len;   // предел поля len, длиннее — считаем мусором
+    // Счётчики
+    uint64_t frames;
+    uint64_t crc_errors;
+    uint64_t bad_headers;
+    uint64_t skipped_bytes;
+} proto_rx_t;
+
+bool proto_rx_init(proto_rx_t *rx, size_t cap);
+void proto_rx_free(proto_rx_t *rx);
+void proto_rx_reset(proto_rx_t *rx);
+// Увеличить кольцо, сохранив непрочитанные данные (только из потока-читателя)
+bool proto_rx_resize(proto_rx_t *rx, size_t cap);
+
+// Непрерывное свободное место для read(): после чтения вызвать commit.
+uint8_t *proto_rx_write_ptr(proto_rx_t *rx, size_t *space);
+void proto_rx_commit(proto_rx_t *rx, size_t n);
+// Скопировать готовые данные в кольцо, возвращает сколько поместилось.
+size_t proto_rx_feed(proto_rx_t *rx, const uint8_t *data, size_t n);
+
+// Достаёт следующий корректный кадр: true — кадр в *f, false — нужны данные.
+bool proto_rx_next(proto_rx_t *rx, proto_frame_t *f);
+
+// Сборка кадра в out (нужно len + PROTO_HDR_LEN + PROTO_CRC_LEN байт).
+size_t proto_build(uint8_t *out, uint16_t seq, uint8_t cmd, const uint8_t *payload, uint16_t len);
+
+#endif
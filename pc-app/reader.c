@@ -0,0 +1,269 @@
+#include "reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "deinterleave.h"
+#include "unpack.h"
+
+// Те же часы, что g_get_monotonic_time() в GUI (CLOCK_MONOTONIC, мкс)
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool osc_reader_init(osc_reader_t *rd, uint32_t max_points)
+{
+    memset(rd, 0, sizeof(*rd));
+    rd->fd = -1;
+    rd->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    rd->scratch = malloc(OSC_MAX_POINTS * sizeof(uint16_t));
+    if (rd->wake_fd < 0 || !rd->scratch || !proto_rx_init(&rd->rx, OSC_FRAME_BYTES(max_points) * 2)) {
+        osc_reader_free(rd);
+        return false;
+    }
+    return osc_reader_set_max_points(rd, max_points);
+}
+
+void osc_reader_free(osc_reader_t *rd)
+{
+    proto_rx_free(&rd->rx);
+    free(rd->scratch);
+    rd->scratch = NULL;
+    if (rd->wake_fd >= 0) close(rd->wake_fd);
+    rd->wake_fd = -1;
+}
+
+bool osc_reader_set_max_points(osc_reader_t *rd, uint32_t nmax)
+{
+    if (nmax > OSC_MAX_POINTS) nmax = OSC_MAX_POINTS;
+    if (nmax == rd->max_points) return true;
+    if (!proto_rx_resize(&rd->rx, OSC_FRAME_BYTES(nmax) * 2)) return false;
+    rd->max_points = nmax;
+    return true;
+}
+
+// Ответ get_osc_status: {u8 err; u32 fs; u8 gain; u8 mode; i16 level_mV; u8 edge; u16 frame_points}
+// и у новых прошивок u8 enc_mask. Payload лежит в кольце приёма, а рост
+// кольца его освобождает — всё нужное читается до osc_reader_set_max_points
+static void handle_osc_status(osc_reader_t *rd, const proto_frame_t *f)
+{
+    const uint8_t *p = f->payload;
+    if (f->len < 12 || p[0] != 0) return;
+    uint16_t frame_points = p[10] | (p[11] << 8);
+    uint8_t enc_mask = f->len >= 13 ? p[12] : OSC_ENC_BIT(OSC_ENC_RAW16);
+    atomic_store(&rd->enc_mask, enc_mask);
+    if (frame_points > rd->max_points) {
+        osc_reader_set_max_points(rd, frame_points);
+    }
+}
+
+// Ответ seg_status: {u8 err; u8 state; u16 filled; u16 nseg; u16 samples; ...}
+static void handle_seg_status(osc_reader_t *rd, const proto_frame_t *f)
+{
+    const uint8_t *p = f->payload;
+    if (f->len < 8 || p[0] != 0) return;
+    atomic_store(&rd->seg_state, p[1]);
+    atomic_store(&rd->seg_filled, p[2] | (p[3] << 8));
+    atomic_store(&rd->seg_nseg, p[4] | (p[5] << 8));
+    atomic_store(&rd->seg_samples, p[6] | (p[7] << 8));
+    atomic_fetch_add(&rd->seg_status_rx, 1);
+}
+
+// Кадр OSC_DATA (u16) или OSC_DATA_EXT (упакованные отсчёты): meta + отсчёты
+void osc_reader_handle_data(osc_reader_t *rd, const proto_frame_t *f)
+{
+    osc_meta_t m;
+    if (!osc_parse_data(f->cmd, f->payload, f->len, &m)) return;
+    linkstats_on_data(&rd->link, f->seq);
+    if (m.nsamples == 0 || m.nsamples > rd->max_points ||
+        (m.enc == OSC_ENC_RAW16 && m.nsamples * 2u > m.data_len)) {
+        rd->rejected_size++;
+        return;
+    }
+    // Кадр уходит потребителю текущего режима и, если есть, в tap; кто
+    // отстал, тому кадр учитывается в dropped. Распаковка — один раз, во
+    // второй слот — копией. Сегменты — только в свою очередь
+    frameq_t *q = atomic_load_explicit(m.nseg ? &rd->seg_out : &rd->out, memory_order_acquire);
+    frameq_t *tap = m.nseg ? NULL : atomic_load_explicit(&rd->tap, memory_order_acquire);
+    osc_frame_t *main_fr = q ? frameq_begin(q) : NULL;
+    osc_frame_t *tap_fr = tap ? frameq_begin(tap) : NULL;
+    osc_frame_t *fr = main_fr ? main_fr : tap_fr;
+    if (!fr) return;
+    // Распаковка прямо в слот (несколько каналов — через черновик и разбор
+    // по каналам в слот); битый поток слот не занимает
+    if (m.enc == OSC_ENC_RAW16) m.data_len = m.nsamples * 2u;
+    if (!osc_unpack(&m, m.nch > 1 ? rd->scratch : fr->samples)) {
+        rd->rejected_size++;
+        return;
+    }
+    fr->nch = m.nch;
+    if (m.nch == 1) {
+        fr->ch_off[0] = 0;
+        fr->ch_len[0] = m.nsamples;
+    } else {
+        uint16_t *dst[OSC_MAX_CH];
+        uint32_t off = 0;
+        for (unsigned c = 0; c < m.nch; c++) {
+            fr->ch_off[c] = (uint16_t)off;
+            fr->ch_len[c] = (uint16_t)deinterleave_count(m.nsamples, m.nch, m.phase, c);
+            dst[c] = fr->samples + off;
+            off += fr->ch_len[c];
+        }
+        deinterleave(rd->scratch, m.nsamples, m.nch, m.phase, dst, NULL);
+    }
+    fr->fs_hz = m.fs_hz;
+    fr->ch = m.ch;
+    fr->seq = f->seq;
+    fr->nsamples = m.nsamples;
+    fr->pretrig = m.pretrig;
+    fr->seg = m.seg;
+    fr->nseg = m.nseg;
+    fr->seg_t = m.seg_t;
+    fr->bits = m.bits;
+    fr->phase = m.nch > 1 ? m.phase : 0;
+    fr->rx_us = mono_us();
+    // Измерения — на каждом кадре, пока отсчёты ещё в кэше
+    for (unsigned c = 0; c < fr->nch; c++) {
+        measure(fr->samples + fr->ch_off[c], fr->ch_len[c], &fr->meas[c]);
+    }
+    if (main_fr && tap_fr) frameq_copy(tap_fr, main_fr);
+    if (main_fr) frameq_publish(q);
+    if (tap_fr) frameq_publish(tap);
+}
+
+void osc_reader_dispatch(osc_reader_t *rd, const proto_frame_t *f)
+{
+    if ((f->cmd & PROTO_RESP) && rd->cmd) cmdchan_on_response(rd->cmd, f);
+    if (f->cmd == PROTO_CMD_OSC_DATA || f->cmd == PROTO_CMD_OSC_DATA_EXT) {
+        recorder_t *rec = atomic_load_explicit(&rd->rec, memory_order_acquire);
+        if (rec) recorder_push(rec, f->raw, f->raw_len, mono_us());
+        osc_reader_handle_data(rd, f);
+    } else if (f->cmd == (PROTO_CMD_OSC_STATUS | PROTO_RESP)) {
+        handle_osc_status(rd, f);
+    } else if (f->cmd == (PROTO_CMD_OSC_STATS | PROTO_RESP)) {
+        linkstats_on_board(&rd->link, f->payload, f->len);
+    } else if (f->cmd == (PROTO_CMD_SEG_STATUS | PROTO_RESP)) {
+        handle_seg_status(rd, f);
+    }
+}
+
+// Читает, пока порт отдаёт полный запрошенный кусок (за одно пробуждение —
+// всё накопившееся), и разбирает кадры после каждого read(). false — порт
+// закрыт или ошибка.
+static bool drain(osc_reader_t *rd)
+{
+    proto_rx_t *rx = &rd->rx;
+    proto_frame_t f;
+    for (;;) {
+        size_t space;
+        uint8_t *dst = proto_rx_write_ptr(rx, &space);
+        ssize_t r = read(rd->fd, dst, space);
+        if (r < 0) return errno == EAGAIN || errno == EINTR;
+        if (r == 0) return false;
+        proto_rx_commit(rx, (size_t)r);
+        linkstats_on_read(&rd->link, (size_t)r);
+        while (proto_rx_next(rx, &f)) osc_reader_dispatch(rd, &f);
+        linkstats_sync_rx(&rd->link, rx);
+        if ((size_t)r < space) return true;
+    }
+}
+
+void osc_reader_run(osc_reader_t *rd)
+{
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0) return;
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = rd->fd};
+    epoll_ctl(ep, EPOLL_CTL_ADD, rd->fd, &ev);
+    ev.data.fd = rd->wake_fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, rd->wake_fd, &ev);
+
+    proto_rx_reset(&rd->rx);
+    atomic_store(&rd->hangup, false);
+    while (atomic_load_explicit(&rd->run, memory_order_relaxed)) {
+        struct epoll_event got[2];
+        // Спим до данных, остановки или срока ближайшей команды без ответа
+        int timeout = rd->cmd ? cmdchan_poll(rd->cmd, mono_us()) : -1;
+        int n = epoll_wait(ep, got, 2, timeout);
+        if (n < 0 && errno != EINTR) break;
+        linkstats_on_wakeup(&rd->link);
+        for (int i = 0; i < n; i++) {
+            if (got[i].data.fd == rd->wake_fd) {
+                uint64_t v;
+                if (read(rd->wake_fd, &v, sizeof(v)) < 0) {}
+                continue;
+            }
+            if (!drain(rd) || (got[i].events & (EPOLLHUP | EPOLLERR))) {
+                // Порт пропал: ждём только остановки
+                atomic_store(&rd->hangup, true);
+                epoll_ctl(ep, EPOLL_CTL_DEL, rd->fd, NULL);
+            }
+        }
+    }
+    uint64_t v;
+    while (read(rd->wake_fd, &v, sizeof(v)) > 0) {}
+    close(ep);
+}
+
+void osc_reader_cancel(osc_reader_t *rd)
+{
+    uint64_t one = 1;
+    atomic_store(&rd->run, false);
+    if (write(rd->wake_fd, &one, sizeof(one)) < 0) {}
+}
+
+const unsigned port_bauds[] = {115200, 230400, 460800, 921600, 1000000, 1500000, 2000000, 3000000, 4000000, 0};
+
+static speed_t baud_speed(unsigned baud)
+{
+    switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    case 4000000: return B4000000;
+    default: return 0;
+    }
+}
+
+// Неблокирующий порт под epoll: VMIN = VTIME = 0 (read отдаёт, что есть);
+// у настоящих UART (ttyS, ttyUSB) ещё ASYNC_LOW_LATENCY — драйвер отдаёт
+// принятое сразу, а не по таймеру. USB CDC и pty флаг не знают, это не ошибка.
+int port_open(const char *path, unsigned baud)
+{
+    speed_t sp = baud_speed(baud);
+    if (!sp) return -1;
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct termios tio = {0};
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, sp);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    struct serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss) == 0) {
+        ss.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &ss);
+    }
+    return fd;
+}
@@ -0,0 +1,64 @@
+#ifndef READER_H
+#define READER_H
+
+// Приём потока осциллографа: поток спит в epoll_wait, пока в порту нет
+// данных, и читает всё, что есть, прямо в кольцо proto_rx; кадры
+// разбираются на месте (см. proto.c), OSC_DATA/OSC_DATA_EXT распаковываются
+// в очередь кадров текущего потребителя (сегменты capture_once — в свою),
+// ответы get_osc_status/get_osc_stats/seg_status разбираются здесь же. Ответы на команды (cmd|0x80) сверяются с таблицей
+// канала команд rd->cmd (cmdchan.c), его повторы и таймауты — по сроку
+// epoll_wait. Тот же цикл без очереди кадров читает ответы генератора.
+// Без GTK: GUI крутит osc_reader_run в своём потоке, bench/bench_e2e —
+// против симулятора платы (devsim.c).
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cmdchan.h"
+#include "frameq.h"
+#include "linkstats.h"
+#include "proto.h"
+#include "recorder.h"
+
+typedef struct {
+    int fd;
+    _Atomic bool run;
+    int wake_fd;                        // eventfd: остановка или новая команда
+    _Atomic bool hangup;                // порт закрылся с той стороны (USB отключён)
+    proto_rx_t rx;
+    _Atomic(frameq_t *) out;            // куда идут кадры (линия или послесвечение)
+    _Atomic(frameq_t *) tap;            // копия кадров второму потребителю (спектр), NULL — нет
+    _Atomic(recorder_t *) rec;          // запись на диск, NULL — не пишем
+    _Atomic(frameq_t *) seg_out;        // сегменты (seg_read), NULL — отбрасываем
+    cmdchan_t *cmd;                     // команды этой плате, NULL — нет; до osc_reader_run
+    linkstats_t link;                   // телеметрия линии и платы
+    uint32_t max_points;                // предел приёма, из get_osc_status
+    _Atomic int enc_mask;               // кодировки платы из get_osc_status, 0 — неизвестно
+    _Atomic uint64_t rejected_size;     // кадры, отброшенные из-за размера
+    // Последний ответ seg_status (PROTO_SEG_*); seg_status_rx растёт на каждый
+    _Atomic int seg_state, seg_filled, seg_nseg, seg_samples;
+    _Atomic uint64_t seg_status_rx;
+    uint16_t *scratch;                  // распаковка кадра из нескольких каналов до разбора
+} osc_reader_t;
+
+bool osc_reader_init(osc_reader_t *rd, uint32_t max_points);
+void osc_reader_free(osc_reader_t *rd);
+// Предел приёма и приёмное кольцо под кадр из nmax точек. Слоты очереди
+// кадров выделены сразу под OSC_MAX_POINTS и не перевыделяются.
+bool osc_reader_set_max_points(osc_reader_t *rd, uint32_t nmax);
+
+// Цикл чтения rd->fd, пока rd->run; osc_reader_cancel — из другого потока
+void osc_reader_run(osc_reader_t *rd);
+void osc_reader_cancel(osc_reader_t *rd);
+// Принятый кадр: данные, ответы на команды, get_osc_status/get_osc_stats
+void osc_reader_dispatch(osc_reader_t *rd, const proto_frame_t *f);
+// Кадр данных (с линии или из записи) -> очередь rd->out
+void osc_reader_handle_data(osc_reader_t *rd, const proto_frame_t *f);
+
+// Порт в сыром режиме, неблокирующий, baud — бит/с (для USB CDC не важна);
+// -1 — не открылся или скорость не поддерживается
+int port_open(const char *path, unsigned baud);
+extern const unsigned port_bauds[];     // стандартные скорости, 0 в конце
+
+#endif
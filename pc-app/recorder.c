@@ -0,0 +1,414 @@
+#include "recorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REC_VERSION 1
+#define REC_INDEX_HDR 16
+#define REC_INDEX_ENT 40
+#define REC_TRAILER 24
+
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// ПК little-endian, как и формат файла
+static void put32(uint8_t *p, uint32_t v) { memcpy(p, &v, 4); }
+static void put64(uint8_t *p, uint64_t v) { memcpy(p, &v, 8); }
+static uint32_t get32(const uint8_t *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static uint64_t get64(const uint8_t *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+
+static bool write_all(int fd, const uint8_t *p, size_t n)
+{
+    while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// Кольцо с переходом через край: копии в две части
+static void ring_put(recorder_t *r, uint64_t pos, const void *src, size_t n)
+{
+    size_t at = pos & (r->ring_cap - 1), first = r->ring_cap - at;
+    if (first > n) first = n;
+    memcpy(r->ring + at, src, first);
+    memcpy(r->ring, (const uint8_t *)src + first, n - first);
+}
+
+static void ring_get(const recorder_t *r, uint64_t pos, void *dst, size_t n)
+{
+    size_t at = pos & (r->ring_cap - 1), first = r->ring_cap - at;
+    if (first > n) first = n;
+    memcpy(dst, r->ring + at, first);
+    memcpy((uint8_t *)dst + first, r->ring, n - first);
+}
+
+// Кусок целиком — один write(): заголовок собирается в начале буфера
+static void flush_chunk(recorder_t *r)
+{
+    rec_chunk_t *c = &r->cur;
+    if (c->nframes == 0) return;
+    uint8_t *h = r->chunk;
+    memcpy(h, "OSCCHUNK", 8);
+    put32(h + 8, c->nframes);
+    put32(h + 12, c->body_len);
+    put64(h + 16, (uint64_t)c->t_first_us);
+    put64(h + 24, (uint64_t)c->t_last_us);
+    put64(h + 32, c->first_frame);
+    size_t n = REC_CHUNK_HDR + c->body_len;
+    if (!r->io_error && !write_all(r->fd, r->chunk, n)) r->io_error = true;
+    atomic_fetch_add_explicit(&r->written, n, memory_order_relaxed);
+
+    if (r->nindex == r->index_cap) {
+        size_t cap = r->index_cap ? r->index_cap * 2 : 256;
+        rec_chunk_t *ix = realloc(r->index, cap * sizeof(*ix));
+        if (ix) {
+            r->index = ix;
+            r->index_cap = cap;
+        }
+    }
+    c->off = r->file_off;
+    if (r->nindex < r->index_cap) r->index[r->nindex++] = *c;
+    r->file_off += n;
+
+    uint64_t next = c->first_frame + c->nframes;
+    memset(c, 0, sizeof(*c));
+    c->first_frame = next;
+    r->chunk_fill = REC_CHUNK_HDR;
+}
+
+static void *writer_thread(void *arg)
+{
+    recorder_t *r = arg;
+    int64_t last_flush = mono_us();
+    for (;;) {
+        uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (head == tail) {
+            if (atomic_load(&r->closing)) break;
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100 * 1000000L;
+            ts.tv_sec += ts.tv_nsec / 1000000000;
+            ts.tv_nsec %= 1000000000;
+            sem_timedwait(&r->ready, &ts);
+        }
+        // Всё, что накопилось, — в кусок; полный кусок — на диск
+        while (tail != head) {
+            uint8_t hdr[REC_FRAME_HDR];
+            ring_get(r, tail, hdr, sizeof(hdr));
+            uint32_t len = get32(hdr + 8);
+            int64_t t = (int64_t)get64(hdr);
+            size_t rec = REC_FRAME_HDR + len;
+            if (r->chunk_fill + rec > REC_CHUNK_BYTES) flush_chunk(r);
+            ring_get(r, tail, r->chunk + r->chunk_fill, rec);
+            r->chunk_fill += rec;
+            if (r->cur.nframes == 0) r->cur.t_first_us = t;
+            r->cur.t_last_us = t;
+            r->cur.nframes++;
+            r->cur.body_len += (uint32_t)rec;
+            tail += rec;
+            atomic_store_explicit(&r->tail, tail, memory_order_release);
+        }
+        int64_t now = mono_us();
+        if (now - last_flush >= REC_FLUSH_US) {
+            flush_chunk(r);
+            last_flush = now;
+        }
+    }
+    flush_chunk(r);
+    return NULL;
+}
+
+bool recorder_start(recorder_t *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+    r->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (r->fd < 0) return false;
+    r->ring_cap = REC_RING_BYTES;
+    r->ring = malloc(r->ring_cap);
+    r->chunk = malloc(REC_CHUNK_BYTES);
+    if (!r->ring || !r->chunk) goto fail;
+
+    uint8_t h[REC_FILE_HDR] = {0};
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    memcpy(h, "OSCREC01", 8);
+    put32(h + 8, REC_VERSION);
+    put32(h + 12, REC_CHUNK_BYTES);
+    put64(h + 16, (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000);
+    if (!write_all(r->fd, h, sizeof(h))) goto fail;
+    r->file_off = sizeof(h);
+    r->chunk_fill = REC_CHUNK_HDR;
+    r->t0_us = -1;
+
+    sem_init(&r->ready, 0, 0);
+    atomic_store(&r->run, true);
+    if (pthread_create(&r->thread, NULL, writer_thread, r) != 0) {
+        sem_destroy(&r->ready);
+        goto fail;
+    }
+    return true;
+
+fail:
+    close(r->fd);
+    free(r->ring);
+    free(r->chunk);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    return false;
+}
+
+void recorder_push(recorder_t *r, const uint8_t *raw, size_t len, int64_t t_us)
+{
+    atomic_fetch_add(&r->pushing, 1);
+    if (!atomic_load(&r->run)) {
+        atomic_fetch_sub(&r->pushing, 1);
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    size_t rec = REC_FRAME_HDR + len;
+    if (r->ring_cap - (head - tail) < rec) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+    } else {
+        if (r->t0_us < 0) r->t0_us = t_us;
+        uint8_t hdr[REC_FRAME_HDR];
+        put64(hdr, (uint64_t)(t_us - r->t0_us));
+        put32(hdr + 8, (uint32_t)len);
+        ring_put(r, head, hdr, sizeof(hdr));
+        ring_put(r, head + sizeof(hdr), raw, len);
+        atomic_store_explicit(&r->head, head + rec, memory_order_release);
+        atomic_fetch_add_explicit(&r->frames, 1, memory_order_relaxed);
+        sem_post(&r->ready);
+    }
+    atomic_fetch_sub(&r->pushing, 1);
+}
+
+bool recorder_stop(recorder_t *r)
+{
+    if (!atomic_load(&r->run)) return false;
+    // Новых кадров не будет; тот, что уже кладётся, дождёмся
+    atomic_store(&r->run, false);
+    while (atomic_load(&r->pushing)) sched_yield();
+    atomic_store(&r->closing, true);
+    sem_post(&r->ready);
+    pthread_join(r->thread, NULL);
+    sem_destroy(&r->ready);
+
+    // Индекс и хвост
+    size_t n = REC_INDEX_HDR + r->nindex * REC_INDEX_ENT + REC_TRAILER;
+    uint8_t *ix = calloc(1, n);
+    bool ok = !r->io_error && ix;
+    if (ix) {
+        memcpy(ix, "OSCINDEX", 8);
+        put32(ix + 8, (uint32_t)r->nindex);
+        uint64_t total = 0;
+        for (size_t i = 0; i < r->nindex; i++) {
+            uint8_t *e = ix + REC_INDEX_HDR + i * REC_INDEX_ENT;
+            const rec_chunk_t *c = &r->index[i];
+            put64(e, c->off);
+            put64(e + 8, (uint64_t)c->t_first_us);
+            put64(e + 16, (uint64_t)c->t_last_us);
+            put64(e + 24, c->first_frame);
+            put32(e + 32, c->nframes);
+            put32(e + 36, c->body_len);
+            total += c->nframes;
+        }
+        uint8_t *t = ix + n - REC_TRAILER;
+        memcpy(t, "OSCTRAIL", 8);
+        put64(t + 8, r->file_off);
+        put64(t + 16, total);
+        ok = ok && write_all(r->fd, ix, n);
+        free(ix);
+    }
+    if (close(r->fd) != 0) ok = false;
+    free(r->ring);
+    free(r->chunk);
+    free(r->index);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    return ok;
+}
+
+// Заголовок куска по смещению off; false — не кусок или выходит за файл
+static bool read_chunk(const rec_file_t *rf, uint64_t off, rec_chunk_t *c)
+{
+    if (off + REC_CHUNK_HDR > rf->size) return false;
+    const uint8_t *h = rf->map + off;
+    if (memcmp(h, "OSCCHUNK", 8) != 0) return false;
+    c->off = off;
+    c->nframes = get32(h + 8);
+    c->body_len = get32(h + 12);
+    c->t_first_us = (int64_t)get64(h + 16);
+    c->t_last_us = (int64_t)get64(h + 24);
+    c->first_frame = get64(h + 32);
+    return off + REC_CHUNK_HDR + c->body_len <= rf->size;
+}
+
+static bool load_index(rec_file_t *rf)
+{
+    if (rf->size < REC_FILE_HDR + REC_INDEX_HDR + REC_TRAILER) return false;
+    const uint8_t *t = rf->map + rf->size - REC_TRAILER;
+    if (memcmp(t, "OSCTRAIL", 8) != 0) return false;
+    uint64_t ix_off = get64(t + 8);
+    if (ix_off + REC_INDEX_HDR > rf->size - REC_TRAILER) return false;
+    const uint8_t *ix = rf->map + ix_off;
+    if (memcmp(ix, "OSCINDEX", 8) != 0) return false;
+    size_t n = get32(ix + 8);
+    if (ix_off + REC_INDEX_HDR + (uint64_t)n * REC_INDEX_ENT > rf->size - REC_TRAILER) return false;
+    rf->chunks = calloc(n ? n : 1, sizeof(rec_chunk_t));
+    if (!rf->chunks) return false;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *e = ix + REC_INDEX_HDR + i * REC_INDEX_ENT;
+        rec_chunk_t *c = &rf->chunks[i];
+        c->off = get64(e);
+        c->t_first_us = (int64_t)get64(e + 8);
+        c->t_last_us = (int64_t)get64(e + 16);
+        c->first_frame = get64(e + 24);
+        c->nframes = get32(e + 32);
+        c->body_len = get32(e + 36);
+        if (c->off + REC_CHUNK_HDR + c->body_len > ix_off) {
+            free(rf->chunks);
+            rf->chunks = NULL;
+            return false;
+        }
+    }
+    rf->nchunks = n;
+    return true;
+}
+
+// Запись оборвалась (нет хвоста): идём по заголовкам кусков подряд
+static bool rebuild_index(rec_file_t *rf)
+{
+    size_t cap = 256;
+    rf->chunks = malloc(cap * sizeof(rec_chunk_t));
+    if (!rf->chunks) return false;
+    uint64_t off = REC_FILE_HDR;
+    rec_chunk_t c;
+    while (read_chunk(rf, off, &c)) {
+        if (rf->nchunks == cap) {
+            rec_chunk_t *p = realloc(rf->chunks, cap * 2 * sizeof(rec_chunk_t));
+            if (!p) break;
+            rf->chunks = p;
+            cap *= 2;
+        }
+        rf->chunks[rf->nchunks++] = c;
+        off += REC_CHUNK_HDR + c.body_len;
+    }
+    return true;
+}
+
+bool recfile_open(rec_file_t *rf, const char *path)
+{
+    memset(rf, 0, sizeof(*rf));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size < REC_FILE_HDR) {
+        close(fd);
+        return false;
+    }
+    rf->size = (size_t)sb.st_size;
+    void *m = mmap(NULL, rf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return false;
+    rf->map = m;
+    if (memcmp(rf->map, "OSCREC01", 8) != 0 || get32(rf->map + 8) != REC_VERSION) {
+        recfile_close(rf);
+        return false;
+    }
+    madvise(m, rf->size, MADV_SEQUENTIAL);
+
+    rf->indexed = load_index(rf);
+    if (!rf->indexed && !rebuild_index(rf)) {
+        recfile_close(rf);
+        return false;
+    }
+    if (rf->nchunks) {
+        const rec_chunk_t *last = &rf->chunks[rf->nchunks - 1];
+        rf->total_frames = last->first_frame + last->nframes;
+        rf->duration_us = last->t_last_us;
+    }
+    return true;
+}
+
+void recfile_close(rec_file_t *rf)
+{
+    if (rf->map) munmap((void *)rf->map, rf->size);
+    free(rf->chunks);
+    memset(rf, 0, sizeof(*rf));
+}
+
+static void enter_chunk(const rec_file_t *rf, rec_cursor_t *cur, size_t chunk)
+{
+    cur->chunk = chunk;
+    cur->frame = 0;
+    if (chunk >= rf->nchunks) return;
+    const rec_chunk_t *c = &rf->chunks[chunk];
+    cur->off = c->off + REC_CHUNK_HDR;
+    // Подкачка куска заранее: при перемотке — сразу нужного
+    uintptr_t pg = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t a = (uintptr_t)(rf->map + c->off) & ~(pg - 1);
+    madvise((void *)a, (uintptr_t)(rf->map + cur->off + c->body_len) - a, MADV_WILLNEED);
+}
+
+void recfile_seek(const rec_file_t *rf, int64_t t_us, rec_cursor_t *cur)
+{
+    // Первый кусок, который кончается не раньше t
+    size_t lo = 0, hi = rf->nchunks;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (rf->chunks[mid].t_last_us < t_us) lo = mid + 1;
+        else hi = mid;
+    }
+    enter_chunk(rf, cur, lo);
+    if (lo >= rf->nchunks) return;
+    // Внутри куска — по записям, не дальше его конца (длина записи из файла:
+    // битую дальше не проходим, на ней остановится и recfile_next)
+    const rec_chunk_t *c = &rf->chunks[lo];
+    uint64_t end = c->off + REC_CHUNK_HDR + c->body_len;
+    while (cur->frame < c->nframes && cur->off + REC_FRAME_HDR <= end) {
+        const uint8_t *p = rf->map + cur->off;
+        uint32_t len = get32(p + 8);
+        if ((int64_t)get64(p) >= t_us || cur->off + REC_FRAME_HDR + len > end) break;
+        cur->off += REC_FRAME_HDR + len;
+        cur->frame++;
+    }
+}
+
+bool recfile_next(const rec_file_t *rf, rec_cursor_t *cur, rec_frame_t *out)
+{
+    while (cur->chunk < rf->nchunks && cur->frame >= rf->chunks[cur->chunk].nframes) {
+        enter_chunk(rf, cur, cur->chunk + 1);
+    }
+    if (cur->chunk >= rf->nchunks) return false;
+    const rec_chunk_t *c = &rf->chunks[cur->chunk];
+    uint64_t end = c->off + REC_CHUNK_HDR + c->body_len;
+    if (cur->off + REC_FRAME_HDR > end) return false;
+    const uint8_t *p = rf->map + cur->off;
+    uint32_t len = get32(p + 8);
+    if (cur->off + REC_FRAME_HDR + len > end) return false;
+    out->t_us = (int64_t)get64(p);
+    out->raw = p + REC_FRAME_HDR;
+    out->len = len;
+    cur->off += REC_FRAME_HDR + len;
+    cur->frame++;
+    return true;
+}
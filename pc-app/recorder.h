@@ -0,0 +1,113 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+// Запись потока осциллографа на диск и воспроизведение записи.
+//
+// Запись: поток чтения кладёт каждый проверенный кадр OSC_DATA/OSC_DATA_EXT
+// (как пришёл по линии, с заголовком и CRC) в байтовое кольцо и никогда не
+// ждёт — при полном кольце кадр считается в dropped. Свой поток записи
+// собирает кадры в куски по REC_CHUNK_BYTES и пишет каждый одним write().
+// При остановке в конец файла пишется индекс кусков.
+//
+// Файл (все числа little-endian):
+//   заголовок    "OSCREC01" u32 version; u32 chunk_bytes; i64 start_unix_us; u64 0
+//   кусок        "OSCCHUNK" u32 nframes; u32 body_len; i64 t_first_us; i64 t_last_us;
+//                u64 first_frame; затем nframes записей {i64 t_us; u32 len; len байт кадра}
+//   ...
+//   индекс       "OSCINDEX" u32 nchunks; u32 0; nchunks * rec_chunk_t
+//   хвост        "OSCTRAIL" u64 index_off; u64 total_frames
+// t_us — от начала записи. Без хвоста (запись оборвалась) индекс
+// восстанавливается проходом по заголовкам кусков.
+//
+// Воспроизведение: файл отображается в память (mmap) целиком, кадры
+// читаются прямо из отображения; в ОЗУ только индекс, поэтому и запись на
+// несколько ГБ перематывается сразу.
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REC_CHUNK_BYTES  (4u << 20)
+#define REC_RING_BYTES   (32u << 20)
+#define REC_FLUSH_US     1000000     // кусок уходит на диск не реже раза в секунду
+
+#define REC_FILE_HDR   32
+#define REC_CHUNK_HDR  40
+#define REC_FRAME_HDR  12
+
+typedef struct {
+    uint64_t off;           // смещение заголовка куска в файле
+    int64_t t_first_us;
+    int64_t t_last_us;
+    uint64_t first_frame;
+    uint32_t nframes;
+    uint32_t body_len;
+} rec_chunk_t;
+
+typedef struct {
+    int fd;
+    pthread_t thread;
+    _Atomic bool run;           // recorder_push принимает кадры
+    _Atomic bool closing;       // кадров больше не будет: дописать и выйти
+    _Atomic int pushing;        // поток чтения внутри recorder_push
+    sem_t ready;
+    // Кольцо поток чтения -> поток записи: записи {i64 t_us; u32 len; кадр}
+    uint8_t *ring;
+    size_t ring_cap;            // степень двойки
+    _Atomic uint64_t head;      // пишет поток чтения
+    _Atomic uint64_t tail;      // пишет поток записи
+    int64_t t0_us;
+    // Поток записи
+    uint8_t *chunk;
+    size_t chunk_fill;
+    rec_chunk_t cur;
+    rec_chunk_t *index;
+    size_t nindex, index_cap;
+    uint64_t file_off;
+    bool io_error;
+    // Счётчики
+    _Atomic uint64_t frames;    // принято в кольцо
+    _Atomic uint64_t dropped;   // кольцо было полно
+    _Atomic uint64_t written;   // байт записано в файл
+} recorder_t;
+
+// Открывает файл и запускает поток записи
+bool recorder_start(recorder_t *r, const char *path);
+// Поток чтения: кадр (raw, len) принят в момент t_us (g_get_monotonic_time)
+void recorder_push(recorder_t *r, const uint8_t *raw, size_t len, int64_t t_us);
+// Дописывает остаток и индекс, закрывает файл; false — была ошибка записи
+bool recorder_stop(recorder_t *r);
+
+typedef struct {
+    const uint8_t *map;
+    size_t size;
+    rec_chunk_t *chunks;
+    size_t nchunks;
+    uint64_t total_frames;
+    int64_t duration_us;        // t последнего кадра
+    bool indexed;               // индекс из файла (иначе восстановлен)
+} rec_file_t;
+
+typedef struct {
+    size_t chunk;
+    uint32_t frame;             // номер кадра в куске
+    size_t off;                 // смещение записи в файле
+} rec_cursor_t;
+
+typedef struct {
+    int64_t t_us;
+    const uint8_t *raw;         // кадр протокола целиком (sync .. CRC)
+    uint32_t len;
+} rec_frame_t;
+
+bool recfile_open(rec_file_t *rf, const char *path);
+void recfile_close(rec_file_t *rf);
+// Курсор на первый кадр с t_us >= t (двоичный поиск по индексу)
+void recfile_seek(const rec_file_t *rf, int64_t t_us, rec_cursor_t *cur);
+// Следующий кадр; false — конец записи
+bool recfile_next(const rec_file_t *rf, rec_cursor_t *cur, rec_frame_t *out);
+
+#endif
@@ -0,0 +1,409 @@
+#include "spectrum.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPEC_X86 1
+#endif
+
+#define SPEC_FS_POW (2048.0f * 2048.0f)     // 0 дБFS: амплитуда 2048 кодов
+
+// Половина главного лепестка окна, бинов: ближе к пику (и к нулю) маркеров нет
+static const uint32_t win_lobe[SPEC_WIN_COUNT] = {2, 3, 5};
+
+static float *falloc(size_t n)
+{
+    return aligned_alloc(32, (n * sizeof(float) + 31) & ~(size_t)31);
+}
+
+void spectrum_init(spectrum_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->back = 0;
+    atomic_init(&s->mid, 1);
+    s->front = 2;
+    atomic_init(&s->want_avg, 1);
+    atomic_init(&s->want_log, true);
+}
+
+static void free_plan(spectrum_t *s)
+{
+    free(s->rev);
+    free(s->tw_re);
+    free(s->tw_im);
+    free(s->sp_re);
+    free(s->sp_im);
+    free(s->w);
+    free(s->re);
+    free(s->im);
+    free(s->pow);
+    free(s->avg);
+    free(s->hold);
+    s->rev = NULL;
+    s->tw_re = s->tw_im = s->sp_re = s->sp_im = s->w = s->re = s->im = s->pow = s->avg = s->hold = NULL;
+    s->n = 0;
+}
+
+void spectrum_free(spectrum_t *s)
+{
+    free_plan(s);
+    for (int i = 0; i < 3; i++) {
+        free(s->out[i].mag);
+        free(s->out[i].peak);
+    }
+    memset(s, 0, sizeof(*s));
+}
+
+static double window_at(int win, uint32_t i, uint32_t n)
+{
+    double x = 2 * M_PI * i / n;   // периодическое окно: спектр без лишнего лепестка
+    switch (win) {
+    case SPEC_WIN_BLACKMAN:
+        return 0.42 - 0.5 * cos(x) + 0.08 * cos(2 * x);
+    case SPEC_WIN_FLATTOP:
+        return 0.21557895 - 0.41663158 * cos(x) + 0.277263158 * cos(2 * x) - 0.083578947 * cos(3 * x) +
+               0.006947368 * cos(4 * x);
+    default:
+        return 0.5 - 0.5 * cos(x);
+    }
+}
+
+static spec_fft_fn pick_fft(void);
+
+bool spectrum_plan(spectrum_t *s, uint32_t n, int win)
+{
+    if (n < SPEC_MIN_N || n > SPEC_MAX_N || (n & (n - 1)) || win < 0 || win >= SPEC_WIN_COUNT) return false;
+    if (n != s->n) {
+        free_plan(s);
+        uint32_t m = n / 2;
+        s->rev = malloc(m * sizeof(uint32_t));
+        s->tw_re = falloc(m);
+        s->tw_im = falloc(m);
+        s->sp_re = falloc(m + 1);
+        s->sp_im = falloc(m + 1);
+        s->w = falloc(n);
+        s->re = falloc(m);
+        s->im = falloc(m);
+        s->pow = falloc(m + 1);
+        s->avg = falloc(m + 1);
+        s->hold = falloc(m + 1);
+        if (!s->rev || !s->tw_re || !s->tw_im || !s->sp_re || !s->sp_im || !s->w || !s->re || !s->im || !s->pow ||
+            !s->avg || !s->hold) {
+            free_plan(s);
+            return false;
+        }
+        unsigned bits = 0;
+        while ((1u << bits) < m) bits++;
+        for (uint32_t k = 0; k < m; k++) {
+            uint32_t r = 0;
+            for (unsigned b = 0; b < bits; b++) r |= ((k >> b) & 1) << (bits - 1 - b);
+            s->rev[k] = r;
+        }
+        // Этап с половиной h: w^j = exp(-i·pi·j/h), j < h — подряд с индекса h
+        for (uint32_t h = 1; h < m; h *= 2) {
+            for (uint32_t j = 0; j < h; j++) {
+                s->tw_re[h + j] = (float)cos(M_PI * j / h);
+                s->tw_im[h + j] = (float)-sin(M_PI * j / h);
+            }
+        }
+        for (uint32_t k = 0; k <= m; k++) {
+            s->sp_re[k] = (float)cos(2 * M_PI * k / n);
+            s->sp_im[k] = (float)-sin(2 * M_PI * k / n);
+        }
+        s->n = n;
+        s->win = -1;
+    }
+    if (win != s->win) {
+        double sum = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            s->w[i] = (float)window_at(win, i, n);
+            sum += s->w[i];
+        }
+        s->amp_scale = (float)(4.0 / (sum * sum));
+        s->win = win;
+    }
+    if (!s->fft) s->fft = pick_fft();
+    return true;
+}
+
+// Первые два этапа (h = 1, 2) разом: повороты 1 и -i, без умножений
+static void fft_first(float *re, float *im, uint32_t m)
+{
+    for (uint32_t b = 0; b < m; b += 4) {
+        float r0 = re[b] + re[b + 1], i0 = im[b] + im[b + 1];
+        float r1 = re[b] - re[b + 1], i1 = im[b] - im[b + 1];
+        float r2 = re[b + 2] + re[b + 3], i2 = im[b + 2] + im[b + 3];
+        float r3 = re[b + 2] - re[b + 3], i3 = im[b + 2] - im[b + 3];
+        re[b] = r0 + r2;
+        im[b] = i0 + i2;
+        re[b + 2] = r0 - r2;
+        im[b + 2] = i0 - i2;
+        // (r3 + i·i3)·(-i) = i3 - i·r3
+        re[b + 1] = r1 + i3;
+        im[b + 1] = i1 - r3;
+        re[b + 3] = r1 - i3;
+        im[b + 3] = i1 + r3;
+    }
+}
+
+static void stage_scalar(float *re, float *im, uint32_t m, uint32_t h, const float *wr, const float *wi)
+{
+    for (uint32_t b = 0; b < m; b += 2 * h) {
+        float *ar = re + b, *ai = im + b, *br = re + b + h, *bi = im + b + h;
+        for (uint32_t j = 0; j < h; j++) {
+            float tr = br[j] * wr[j] - bi[j] * wi[j];
+            float ti = br[j] * wi[j] + bi[j] * wr[j];
+            br[j] = ar[j] - tr;
+            bi[j] = ai[j] - ti;
+            ar[j] += tr;
+            ai[j] += ti;
+        }
+    }
+}
+
+static void fft_scalar(const spectrum_t *s, float *re, float *im)
+{
+    uint32_t m = s->n / 2;
+    fft_first(re, im, m);
+    for (uint32_t h = 4; h < m; h *= 2) stage_scalar(re, im, m, h, s->tw_re + h, s->tw_im + h);
+}
+
+#ifdef SPEC_X86
+// Этапы с h >= 4: четыре бабочки за раз, повороты этапа лежат подряд
+__attribute__((target("sse2")))
+static void stage_sse2(float *re, float *im, uint32_t m, uint32_t h, const float *wr, const float *wi)
+{
+    for (uint32_t b = 0; b < m; b += 2 * h) {
+        float *ar = re + b, *ai = im + b, *br = re + b + h, *bi = im + b + h;
+        for (uint32_t j = 0; j < h; j += 4) {
+            __m128 vwr = _mm_load_ps(wr + j), vwi = _mm_load_ps(wi + j);
+            __m128 vbr = _mm_load_ps(br + j), vbi = _mm_load_ps(bi + j);
+            __m128 var = _mm_load_ps(ar + j), vai = _mm_load_ps(ai + j);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(vbr, vwr), _mm_mul_ps(vbi, vwi));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(vbr, vwi), _mm_mul_ps(vbi, vwr));
+            _mm_store_ps(br + j, _mm_sub_ps(var, tr));
+            _mm_store_ps(bi + j, _mm_sub_ps(vai, ti));
+            _mm_store_ps(ar + j, _mm_add_ps(var, tr));
+            _mm_store_ps(ai + j, _mm_add_ps(vai, ti));
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static void fft_sse2(const spectrum_t *s, float *re, float *im)
+{
+    uint32_t m = s->n / 2;
+    fft_first(re, im, m);
+    for (uint32_t h = 4; h < m; h *= 2) stage_sse2(re, im, m, h, s->tw_re + h, s->tw_im + h);
+}
+
+// h >= 8: восемь бабочек, умножение на поворот — через FMA
+__attribute__((target("avx2,fma")))
+static void stage_avx2(float *re, float *im, uint32_t m, uint32_t h, const float *wr, const float *wi)
+{
+    for (uint32_t b = 0; b < m; b += 2 * h) {
+        float *ar = re + b, *ai = im + b, *br = re + b + h, *bi = im + b + h;
+        for (uint32_t j = 0; j < h; j += 8) {
+            __m256 vwr = _mm256_load_ps(wr + j), vwi = _mm256_load_ps(wi + j);
+            __m256 vbr = _mm256_load_ps(br + j), vbi = _mm256_load_ps(bi + j);
+            __m256 var = _mm256_load_ps(ar + j), vai = _mm256_load_ps(ai + j);
+            __m256 tr = _mm256_fmsub_ps(vbr, vwr, _mm256_mul_ps(vbi, vwi));
+            __m256 ti = _mm256_fmadd_ps(vbr, vwi, _mm256_mul_ps(vbi, vwr));
+            _mm256_store_ps(br + j, _mm256_sub_ps(var, tr));
+            _mm256_store_ps(bi + j, _mm256_sub_ps(vai, ti));
+            _mm256_store_ps(ar + j, _mm256_add_ps(var, tr));
+            _mm256_store_ps(ai + j, _mm256_add_ps(vai, ti));
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void fft_avx2(const spectrum_t *s, float *re, float *im)
+{
+    uint32_t m = s->n / 2;
+    fft_first(re, im, m);
+    stage_sse2(re, im, m, 4, s->tw_re + 4, s->tw_im + 4);
+    for (uint32_t h = 8; h < m; h *= 2) stage_avx2(re, im, m, h, s->tw_re + h, s->tw_im + h);
+}
+
+const spec_fft_fn spec_fft_sse2 = fft_sse2;
+const spec_fft_fn spec_fft_avx2 = fft_avx2;
+#else
+const spec_fft_fn spec_fft_sse2 = NULL;
+const spec_fft_fn spec_fft_avx2 = NULL;
+#endif
+
+const spec_fft_fn spec_fft_scalar = fft_scalar;
+
+static spec_fft_fn pick_fft(void)
+{
+#ifdef SPEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return fft_avx2;
+    if (__builtin_cpu_supports("sse2")) return fft_sse2;
+#endif
+    return fft_scalar;
+}
+
+// Окно и перестановка при загрузке, БПФ n/2 точек, разделение:
+// X[k] = Xe + W^k·Xo, Xe = (Z[k] + Z*[m-k]) / 2, Xo = -i·(Z[k] - Z*[m-k]) / 2
+void spectrum_power_with(spectrum_t *s, spec_fft_fn fft, const uint16_t *samples)
+{
+    uint32_t m = s->n / 2;
+    float *re = s->re, *im = s->im, *pw = s->pow;
+    const float *w = s->w;
+    for (uint32_t k = 0; k < m; k++) {
+        uint32_t r = s->rev[k];
+        re[r] = samples[2 * k] * w[2 * k];
+        im[r] = samples[2 * k + 1] * w[2 * k + 1];
+    }
+    fft(s, re, im);
+    for (uint32_t k = 0; k <= m; k++) {
+        uint32_t a = k & (m - 1), b = (m - k) & (m - 1);
+        float er = 0.5f * (re[a] + re[b]), ei = 0.5f * (im[a] - im[b]);
+        float orr = 0.5f * (im[a] + im[b]), oi = -0.5f * (re[a] - re[b]);
+        float c = s->sp_re[k], sn = s->sp_im[k];
+        float xr = er + c * orr - sn * oi, xi = ei + c * oi + sn * orr;
+        pw[k] = (xr * xr + xi * xi) * s->amp_scale;
+    }
+    // Нуль и fs/2 — без удвоения
+    pw[0] *= 0.25f;
+    pw[m] *= 0.25f;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void spectrum_process(spectrum_t *s, const uint16_t *samples, uint32_t n, uint32_t fs_hz, uint8_t bits)
+{
+    uint64_t t0 = now_ns();
+    if (n > SPEC_MAX_N) n = SPEC_MAX_N;
+    uint32_t p2 = SPEC_MIN_N;
+    if (n < p2) return;
+    while (p2 * 2 <= n) p2 *= 2;
+    int win = atomic_load_explicit(&s->want_win, memory_order_relaxed);
+    bool reset = atomic_exchange_explicit(&s->want_reset, false, memory_order_relaxed);
+    // Другие N, окно, fs или разрядность — прежнее среднее не к чему прибавлять
+    if (p2 != s->n || win != s->win || fs_hz != s->fs_hz || bits != s->bits) reset = true;
+    if (!spectrum_plan(s, p2, win)) return;
+    s->fs_hz = fs_hz;
+    s->bits = bits;
+    if (reset) s->avg_frames = 0;
+
+    spectrum_power_with(s, s->fft, samples);
+
+    // Первые avg кадров — среднее, дальше — экспоненциальное с весом 1/avg
+    uint32_t bins = s->n / 2 + 1;
+    int want = atomic_load_explicit(&s->want_avg, memory_order_relaxed);
+    uint32_t navg = want > 1 ? (uint32_t)want : 1;
+    if (s->avg_frames < navg) s->avg_frames++;
+    if (s->avg_frames > navg) s->avg_frames = navg;
+    float a = 1.0f / s->avg_frames;
+    float *avg = s->avg, *hold = s->hold;
+    float *pw = s->pow;
+    // Передискретизация: коды в 2^(bits-12) раз крупнее, мощность — в 4^(bits-12)
+    if (bits > 12) {
+        float k = 1.0f / (float)(1u << 2 * (bits - 12));
+        for (uint32_t i = 0; i < bins; i++) pw[i] *= k;
+    }
+    if (s->avg_frames == 1) {
+        memcpy(avg, pw, bins * sizeof(float));
+    } else {
+        for (uint32_t k = 0; k < bins; k++) avg[k] += (pw[k] - avg[k]) * a;
+    }
+    // Удержание выключено — hold идёт за средним: при включении копит с него
+    if (reset || !atomic_load_explicit(&s->want_hold, memory_order_relaxed)) {
+        memcpy(hold, avg, bins * sizeof(float));
+    } else {
+        for (uint32_t k = 0; k < bins; k++) hold[k] = hold[k] > avg[k] ? hold[k] : avg[k];
+    }
+    atomic_fetch_add_explicit(&s->frames, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->busy_ns, now_ns() - t0, memory_order_relaxed);
+}
+
+static float to_db(float p)
+{
+    float db = p > 0 ? 10.0f * log10f(p / SPEC_FS_POW) : SPEC_FLOOR_DB;
+    return db > SPEC_FLOOR_DB ? db : SPEC_FLOOR_DB;
+}
+
+// Маркеры: самые сильные локальные максимумы среднего, не ближе главного
+// лепестка к нулю и друг к другу; частота и уровень — по параболе через
+// три бина в дБ. У flat-top вершина плоская — уровень прямо из бина
+static void find_markers(const spectrum_t *s, spec_out_t *o)
+{
+    uint32_t m = s->n / 2, lobe = win_lobe[s->win];
+    const float *p = s->avg;
+    float floor_pow = SPEC_FS_POW * 1e-12f;         // -120 дБFS
+    o->nmk = 0;
+    uint32_t at[SPEC_MARKERS];
+    for (unsigned i = 0; i < SPEC_MARKERS; i++) {
+        uint32_t best = 0;
+        float bp = floor_pow;
+        for (uint32_t k = lobe + 1; k < m; k++) {
+            if (p[k] <= bp || p[k] <= p[k - 1] || p[k] < p[k + 1]) continue;
+            bool near = false;
+            for (unsigned j = 0; j < i; j++) near |= k + 2 * lobe > at[j] && k < at[j] + 2 * lobe;
+            if (near) continue;
+            best = k;
+            bp = p[k];
+        }
+        if (!best) break;
+        at[i] = best;
+        float l = to_db(p[best - 1]), c = to_db(p[best]), r = to_db(p[best + 1]);
+        float den = l - 2 * c + r, d = den < 0 ? 0.5f * (l - r) / den : 0;
+        float db = s->win == SPEC_WIN_FLATTOP ? c : c - 0.25f * (l - r) * d;
+        o->mk[i].freq_hz = (best + d) * o->bin_hz;
+        o->mk[i].level = o->log ? db : 2048.0f * powf(10.0f, db / 20);
+        o->nmk = i + 1;
+    }
+}
+
+void spectrum_publish(spectrum_t *s)
+{
+    if (!s->n || !s->avg_frames) return;
+    spec_out_t *o = &s->out[s->back];
+    uint32_t bins = s->n / 2 + 1;
+    if (o->cap < bins) {
+        free(o->mag);
+        free(o->peak);
+        o->mag = falloc(bins);
+        o->peak = falloc(bins);
+        o->cap = o->mag && o->peak ? bins : 0;
+        if (!o->cap) return;
+    }
+    o->bins = bins;
+    o->fs_hz = s->fs_hz;
+    o->bin_hz = (float)s->fs_hz / s->n;
+    o->log = atomic_load_explicit(&s->want_log, memory_order_relaxed);
+    o->hold = atomic_load_explicit(&s->want_hold, memory_order_relaxed);
+    o->averaged = s->avg_frames;
+    for (uint32_t k = 0; k < bins; k++) o->mag[k] = o->log ? to_db(s->avg[k]) : sqrtf(s->avg[k]);
+    if (o->hold) {
+        for (uint32_t k = 0; k < bins; k++) o->peak[k] = o->log ? to_db(s->hold[k]) : sqrtf(s->hold[k]);
+    }
+    find_markers(s, o);
+    s->back = atomic_exchange_explicit(&s->mid, s->back | SPEC_FRESH, memory_order_acq_rel) & 3;
+}
+
+bool spectrum_has_new(spectrum_t *s)
+{
+    return atomic_load_explicit(&s->mid, memory_order_relaxed) & SPEC_FRESH;
+}
+
+const spec_out_t *spectrum_front(spectrum_t *s)
+{
+    if (atomic_load_explicit(&s->mid, memory_order_relaxed) & SPEC_FRESH) {
+        s->front = atomic_exchange_explicit(&s->mid, s->front, memory_order_acq_rel) & 3;
+    }
+    const spec_out_t *o = &s->out[s->front];
+    return o->bins ? o : NULL;
+}
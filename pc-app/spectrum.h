@@ -0,0 +1,103 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+// Спектр кадров осциллографа: окно (Ханна, Блэкмана, flat-top),
+// вещественное БПФ, усреднение мощности, удержание пиков и маркеры на
+// самых сильных пиках. Считает свой поток (кадры — через frameq), готовый
+// спектр передаётся отрисовке через тройной буфер без блокировок, как в
+// persist.c.
+//
+// БПФ: N вещественных отсчётов — комплексное БПФ N/2 точек (чётные —
+// действительная часть, нечётные — мнимая) и разделение на спектр N.
+// План (повороты по этапам, перестановка, окно) и все буферы считаются
+// заново только при смене N или окна, кадр памяти не выделяет. Ядра
+// бабочек: AVX2+FMA, SSE2 и скалярное; выбор при первом вызове по CPUID.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SPEC_MIN_N    64
+#define SPEC_MAX_N    16384     // больше — берутся первые 16384 отсчёта
+#define SPEC_MARKERS  5
+#define SPEC_FLOOR_DB (-140.0f) // ниже — нули и округление
+
+enum { SPEC_WIN_HANN = 0, SPEC_WIN_BLACKMAN, SPEC_WIN_FLATTOP, SPEC_WIN_COUNT };
+
+typedef struct {
+    float freq_hz;              // с параболической интерполяцией между бинами
+    float level;                // как mag: дБFS или амплитуда в кодах
+} spec_marker_t;
+
+// Готовый спектр: bins = N/2 + 1 значений от 0 до fs/2
+typedef struct {
+    uint32_t bins, cap;
+    uint32_t fs_hz;
+    float bin_hz;
+    bool log;                   // mag/peak в дБFS (0 дБ — синус на всю шкалу 12 бит), иначе амплитуда в кодах
+    bool hold;                  // peak заполнен
+    uint32_t averaged;          // кадров в среднем
+    float *mag;
+    float *peak;
+    spec_marker_t mk[SPEC_MARKERS];
+    unsigned nmk;
+} spec_out_t;
+
+typedef struct spectrum spectrum_t;
+typedef void (*spec_fft_fn)(const spectrum_t *s, float *re, float *im);
+
+struct spectrum {
+    // План под n отсчётов и окно win
+    uint32_t n;                 // 0 — ещё не строился
+    int win;
+    uint32_t *rev;              // n/2: перестановка входа БПФ
+    float *tw_re, *tw_im;       // n/2: повороты этапа с половиной h — с индекса h
+    float *sp_re, *sp_im;       // n/2 + 1: повороты разделения на спектр n
+    float *w;                   // окно, n
+    float amp_scale;            // |X|^2 -> амплитуда^2: (2 / сумма окна)^2
+    float *re, *im;             // рабочие, n/2
+    float *pow;                 // мощность кадра, n/2 + 1
+    float *avg, *hold;
+    uint32_t fs_hz;
+    uint8_t bits;               // разрядность кадров в среднем
+    uint32_t avg_frames;        // кадров в среднем (до avg)
+    spec_fft_fn fft;
+    // Из GUI
+    _Atomic int want_win;       // SPEC_WIN_*
+    _Atomic int want_avg;       // усреднение: 1 — без него
+    _Atomic bool want_log;
+    _Atomic bool want_hold;
+    _Atomic bool want_reset;    // сбросить среднее и удержание
+    // Обмен с отрисовкой
+    spec_out_t out[3];
+    int back, front;
+    _Atomic int mid;            // SPEC_FRESH — там свежий спектр
+    // Счётчики
+    _Atomic uint64_t frames;    // обработано кадров
+    _Atomic uint64_t busy_ns;   // время обработки всего
+};
+
+#define SPEC_FRESH 4
+
+void spectrum_init(spectrum_t *s);
+void spectrum_free(spectrum_t *s);
+
+// Поток спектра: кадр в среднее (n — сколько отсчётов канала; берётся
+// наибольшая степень двойки не больше n; bits — разрядность отсчётов,
+// мощность приводится к шкале 12 бит); publish — выложить результат
+void spectrum_process(spectrum_t *s, const uint16_t *samples, uint32_t n, uint32_t fs_hz, uint8_t bits);
+void spectrum_publish(spectrum_t *s);
+
+// Отрисовка: свежий спектр (или прежний; NULL — ещё ни одного)
+const spec_out_t *spectrum_front(spectrum_t *s);
+bool spectrum_has_new(spectrum_t *s);
+
+// Для бенчмарка: план, ядра БПФ (sse2/avx2 — NULL, если не собраны) и
+// БПФ кадра любым ядром — мощность в s->pow
+bool spectrum_plan(spectrum_t *s, uint32_t n, int win);
+extern const spec_fft_fn spec_fft_scalar;
+extern const spec_fft_fn spec_fft_sse2;
+extern const spec_fft_fn spec_fft_avx2;
+void spectrum_power_with(spectrum_t *s, spec_fft_fn fft, const uint16_t *samples);
+
+#endif
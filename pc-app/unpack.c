@@ -0,0 +1,201 @@
+#include "unpack.h"
+
+#include <string.h>
+
+#include "proto.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UNPACK_X86 1
+#endif
+
+bool osc_parse_data(uint8_t cmd, const uint8_t *p, uint16_t len, osc_meta_t *m)
+{
+    if (len < OSC_META_LEN) return false;
+    m->fs_hz = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    m->ch = p[4];
+    m->nsamples = p[5] | (p[6] << 8);
+    m->pretrig = p[7] | (p[8] << 8);
+    m->enc = OSC_ENC_RAW16;
+    m->nch = 1;
+    m->phase = 0;
+    m->seg = m->nseg = 0;
+    m->seg_t = 0;
+    m->bits = 12;
+    size_t off = OSC_META_LEN;
+    if (cmd == PROTO_CMD_OSC_DATA_EXT) {
+        // u8 ext_len, затем поля расширения {enc [, nch, phase [, seg, nseg,
+        // t [, bits]]]}; незнакомые хвосты пропускаем
+        if (len < off + 1) return false;
+        uint8_t ext_len = p[off++];
+        if (len < off + ext_len || ext_len < 1) return false;
+        m->enc = p[off];
+        if (ext_len >= 3) {
+            m->nch = p[off + 1];
+            m->phase = p[off + 2];
+            if (m->nch < 1 || m->nch > OSC_MAX_CH || m->phase >= m->nch) return false;
+        }
+        if (ext_len >= 15) {
+            const uint8_t *q = p + off + 3;
+            m->seg = q[0] | (q[1] << 8);
+            m->nseg = q[2] | (q[3] << 8);
+            m->seg_t = 0;
+            for (int i = 7; i >= 0; i--) m->seg_t = m->seg_t << 8 | q[4 + i];
+            if (m->nseg && m->seg >= m->nseg) return false;
+        }
+        if (ext_len >= 16) {
+            // Шире 12 бит — только u16
+            m->bits = p[off + 15];
+            if (m->bits < 12 || m->bits > 16 || (m->bits > 12 && m->enc != OSC_ENC_RAW16)) return false;
+        }
+        off += ext_len;
+    }
+    m->data = p + off;
+    m->data_len = len - off;
+    return true;
+}
+
+static bool unpack16(const uint8_t *src, size_t len, uint16_t *dst, size_t n)
+{
+    if (len != n * 2) return false;
+    memcpy(dst, src, n * 2); // ПК little-endian, как и протокол
+    return true;
+}
+
+#ifdef UNPACK_X86
+// Пара отсчётов в 3 байтах: в u16-дорожку k кладём байты 3j,3j+1 (чётный)
+// или 3j+1,3j+2 (нечётный), затем чётные << 4 (старшая тетрада уходит) и
+// все >> 4 — ровно 12 бит в каждой дорожке
+#define PACK12_SHUF 0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11
+
+__attribute__((target("ssse3")))
+static bool pack12_ssse3(const uint8_t *src, size_t len, uint16_t *dst, size_t n)
+{
+    if (len != OSC_PACK12_BYTES(n)) return false;
+    const __m128i shuf = _mm_setr_epi8(PACK12_SHUF);
+    const __m128i mul = _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1);
+    size_t i = 0;
+    // 12 байт -> 8 отсчётов; читаем 16, поэтому держимся 4 байт от конца
+    for (; i + 8 <= n && (i / 2) * 3 + 16 <= len; i += 8) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i / 2 * 3)), shuf);
+        v = _mm_srli_epi16(_mm_mullo_epi16(v, mul), 4);
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    return osc_pack12_decode_ref(src + i / 2 * 3, len - i / 2 * 3, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static bool pack12_avx2(const uint8_t *src, size_t len, uint16_t *dst, size_t n)
+{
+    if (len != OSC_PACK12_BYTES(n)) return false;
+    const __m256i shuf = _mm256_setr_epi8(PACK12_SHUF, PACK12_SHUF);
+    const __m256i mul = _mm256_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1);
+    size_t i = 0;
+    // 24 байта -> 16 отсчётов: по 12 байт в каждую 128-битную половину
+    for (; i + 16 <= n && (i / 2) * 3 + 28 <= len; i += 16) {
+        const uint8_t *s = src + i / 2 * 3;
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)s)),
+                                            _mm_loadu_si128((const __m128i *)(s + 12)), 1);
+        v = _mm256_shuffle_epi8(v, shuf);
+        v = _mm256_srli_epi16(_mm256_mullo_epi16(v, mul), 4);
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    return osc_pack12_decode_ref(src + i / 2 * 3, len - i / 2 * 3, dst + i, n - i);
+}
+
+// 8 разностей (7 бит со знаком в u16) -> отсчёты от base, префиксной суммой
+__attribute__((target("sse2")))
+static inline __m128i delta8(__m128i d, __m128i base)
+{
+    d = _mm_srai_epi16(_mm_slli_epi16(d, 9), 9);
+    d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+    d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+    d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+    return _mm_add_epi16(d, base);
+}
+
+// Быстрый путь: 16 байт подряд без старшего бита — 16 коротких разностей.
+// Остальные токены (серии, длинные разности) — по одному, как в эталоне.
+__attribute__((target("sse2")))
+static bool delta_sse2(const uint8_t *src, size_t len, uint16_t *dst, size_t n)
+{
+    const uint8_t *end = src + len;
+    const __m128i zero = _mm_setzero_si128();
+    const uint8_t *slow_until = src;
+    uint16_t x = 0;
+    size_t i = 0;
+    while (src < end && i < n) {
+        if (src >= slow_until && end - src >= 16 && n - i >= 16) {
+            __m128i t = _mm_loadu_si128((const __m128i *)src);
+            // Не вышло — следующие 16 байт по токену, чтобы на шуме не
+            // проверять каждый байт заново
+            slow_until = src + 16;
+            if (_mm_movemask_epi8(t) == 0) {
+                __m128i lo = delta8(_mm_unpacklo_epi8(t, zero), _mm_set1_epi16((short)x));
+                __m128i hi = delta8(_mm_unpackhi_epi8(t, zero), _mm_unpackhi_epi64(_mm_shufflehi_epi16(lo, 0xFF), _mm_shufflehi_epi16(lo, 0xFF)));
+                _mm_storeu_si128((__m128i *)(dst + i), lo);
+                _mm_storeu_si128((__m128i *)(dst + i + 8), hi);
+                x = (uint16_t)_mm_extract_epi16(hi, 7);
+                src += 16;
+                i += 16;
+                continue;
+            }
+        }
+        uint8_t t = *src++;
+        if (t < 0x80) {
+            x += (int8_t)(t << 1) >> 1;
+            dst[i++] = x;
+        } else if (t < 0xC0) {
+            size_t run = (t & 0x3F) + 1u;
+            if (run > n - i) return false;
+            while (run--) dst[i++] = x;
+        } else if (t < 0xE0) {
+            if (src == end) return false;
+            int32_t d = ((t & 0x1F) << 8) | *src++;
+            x += (int16_t)(d << 3) >> 3;
+            dst[i++] = x;
+        } else if (t == 0xE0) {
+            if (end - src < 2) return false;
+            x = src[0] | (src[1] << 8);
+            src += 2;
+            dst[i++] = x;
+        } else {
+            return false;
+        }
+    }
+    return i == n && src == end;
+}
+
+const unpack_fn unpack12_ssse3 = pack12_ssse3;
+const unpack_fn unpack12_avx2 = pack12_avx2;
+const unpack_fn undelta_sse2 = delta_sse2;
+#else
+const unpack_fn unpack12_ssse3 = NULL;
+const unpack_fn unpack12_avx2 = NULL;
+const unpack_fn undelta_sse2 = NULL;
+#endif
+
+const unpack_fn unpack12_scalar = osc_pack12_decode_ref;
+const unpack_fn undelta_scalar = osc_delta_decode_ref;
+
+static unpack_fn pick(int enc)
+{
+    if (enc == OSC_ENC_RAW16) return unpack16;
+#ifdef UNPACK_X86
+    __builtin_cpu_init();
+    if (enc == OSC_ENC_PACK12) {
+        if (__builtin_cpu_supports("avx2")) return pack12_avx2;
+        if (__builtin_cpu_supports("ssse3")) return pack12_ssse3;
+    }
+    if (enc == OSC_ENC_DELTA && __builtin_cpu_supports("sse2")) return delta_sse2;
+#endif
+    return enc == OSC_ENC_PACK12 ? osc_pack12_decode_ref : osc_delta_decode_ref;
+}
+
+bool osc_unpack(const osc_meta_t *m, uint16_t *dst)
+{
+    static unpack_fn fns[OSC_ENC_COUNT];
+    if (m->enc >= OSC_ENC_COUNT) return false;
+    if (!fns[m->enc]) fns[m->enc] = pick(m->enc);
+    return fns[m->enc](m->data, m->data_len, dst, m->nsamples);
+}
@@ -0,0 +1,44 @@
+#ifndef UNPACK_H
+#define UNPACK_H
+
+// Разбор payload OSC_DATA (0x40) и OSC_DATA_EXT (0x41) и распаковка
+// отсчётов (common/osc_codec.h). Ядра PACK12: AVX2, SSSE3 и скалярное;
+// DELTA: SSE2 (блоки из 16 коротких разностей — префиксной суммой) и
+// скалярное. Выбор при первом вызове по CPUID.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "osc_codec.h"
+
+typedef struct {
+    uint32_t fs_hz;
+    uint8_t ch;
+    uint16_t nsamples;
+    uint16_t pretrig;
+    uint8_t enc;                // OSC_ENC_*
+    uint8_t nch;                // каналов, отсчёты чередуются (ext.nch, иначе 1)
+    uint8_t phase;              // канал первого отсчёта
+    uint16_t seg, nseg;         // сегмент seg из nseg (capture_once); nseg = 0 — кадр потока
+    uint64_t seg_t;             // отсчёт срабатывания сегмента с начала захвата
+    uint8_t bits;               // разрядность отсчётов: 12, с передискретизацией до 16 (шкала 4095·2^(bits-12))
+    const uint8_t *data;        // закодированные отсчёты
+    size_t data_len;
+} osc_meta_t;
+
+// false — payload короче meta или поля не сходятся
+bool osc_parse_data(uint8_t cmd, const uint8_t *payload, uint16_t len, osc_meta_t *m);
+
+// Распаковать m->nsamples отсчётов в dst; false — поток битый
+bool osc_unpack(const osc_meta_t *m, uint16_t *dst);
+
+// Для бенчмарка: конкретные ядра (NULL, если не собраны)
+typedef bool (*unpack_fn)(const uint8_t *src, size_t len, uint16_t *dst, size_t n);
+extern const unpack_fn unpack12_scalar;
+extern const unpack_fn unpack12_ssse3;
+extern const unpack_fn unpack12_avx2;
+extern const unpack_fn undelta_scalar;
+extern const unpack_fn undelta_sse2;
+
+#endif
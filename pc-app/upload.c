@@ -0,0 +1,450 @@
+#include "upload.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool upload_init(upload_t *u)
+{
+    memset(u, 0, sizeof(*u));
+    return pthread_mutex_init(&u->lock, NULL) == 0;
+}
+
+void upload_free(upload_t *u)
+{
+    pthread_mutex_destroy(&u->lock);
+}
+
+uint16_t upload_chunk_points(unsigned baud)
+{
+    if (!baud) return PROTO_UPLOAD_CHUNK_MAX;
+    // Окно кусков — за четверть таймаута; 10 бит на байт, кадр +10 байт
+    double bytes = baud / 10.0 * (CMDCHAN_TIMEOUT_US / 4 * 1e-6) / UPLOAD_WINDOW - PROTO_HDR_LEN - PROTO_CRC_LEN - 8;
+    if (bytes >= PROTO_UPLOAD_CHUNK_MAX * 2) return PROTO_UPLOAD_CHUNK_MAX;
+    if (bytes < 32) return 16;
+    return (uint16_t)(bytes / 2);
+}
+
+// Итог — один раз; done вне блокировки
+static void finish_locked(upload_t *u, const char *msg, upload_done_fn *done, void **ctx)
+{
+    if (u->finished) return;
+    u->finished = true;
+    u->active = false;
+    snprintf(u->msg, sizeof(u->msg), "%s", msg);
+    *done = u->done;
+    *ctx = u->ctx;
+}
+
+static void chunk_done(void *ctx, int status, const proto_frame_t *resp);
+
+static bool send_chunk(upload_t *u, unsigned k)
+{
+    uint8_t p[8 + PROTO_UPLOAD_CHUNK_MAX * 2];
+    uint32_t off = k * u->chunk;
+    uint16_t n = (uint16_t)(u->n - off < u->chunk ? u->n - off : u->chunk);
+    memcpy(p, &off, 4);
+    memcpy(p + 4, &n, 2);
+    memcpy(p + 8, u->pts + off, n * 2);
+    uint16_t crc = crc16_ibm(p + 8, n * 2);
+    memcpy(p + 6, &crc, 2);
+    u->ck[k].u = u;
+    u->ck[k].k = k;
+    return cmdchan_send(u->cc, PROTO_CMD_GEN_UPLOAD_CHUNK, p, 8 + n * 2, chunk_done, &u->ck[k]);
+}
+
+static void commit_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    upload_t *u = ctx;
+    upload_done_fn done = NULL;
+    void *dctx = NULL;
+    char msg[96];
+    if (status == CMD_OK) {
+        double dt = now_s() - u->t0;
+        snprintf(msg, sizeof(msg), "Форма загружена: %u точек за %.0f мс (%.1f КБ/с)", u->n, dt * 1e3,
+                 u->n * 2 / dt / 1024);
+    } else if (status == CMD_ERR && resp->len >= 3) {
+        uint16_t missing;
+        memcpy(&missing, resp->payload + 1, 2);
+        snprintf(msg, sizeof(msg), missing ? "Форма не принята: нет %u кусков" : "Форма не принята: CRC таблицы",
+                 missing);
+    } else {
+        snprintf(msg, sizeof(msg), "Форма не принята: нет ответа на commit");
+    }
+    pthread_mutex_lock(&u->lock);
+    finish_locked(u, msg, &done, &dctx);
+    pthread_mutex_unlock(&u->lock);
+    if (done) done(dctx, status, msg);
+}
+
+// Окно: досылаем куски, пока в полёте меньше window; после последнего
+// подтверждения — commit
+static void pump(upload_t *u)
+{
+    for (;;) {
+        unsigned k = 0;
+        bool commit = false, send = false;
+        upload_done_fn done = NULL;
+        void *dctx = NULL;
+        pthread_mutex_lock(&u->lock);
+        if (u->finished) {
+            pthread_mutex_unlock(&u->lock);
+            return;
+        }
+        if (u->acked == u->chunks && !u->inflight && u->next == u->chunks) {
+            u->next++;                  // commit — один раз
+            commit = true;
+        } else if (u->next < u->chunks && u->inflight < u->window) {
+            k = u->next++;
+            u->inflight++;
+            send = true;
+        }
+        pthread_mutex_unlock(&u->lock);
+        if (commit) {
+            if (!cmdchan_send(u->cc, PROTO_CMD_GEN_UPLOAD_COMMIT, NULL, 0, commit_done, u)) {
+                commit_done(u, CMD_CANCELLED, NULL);
+            }
+            return;
+        }
+        if (!send) return;
+        if (!send_chunk(u, k)) {
+            pthread_mutex_lock(&u->lock);
+            u->inflight--;
+            finish_locked(u, "Загрузка прервана: команда не ушла", &done, &dctx);
+            pthread_mutex_unlock(&u->lock);
+            if (done) done(dctx, CMD_CANCELLED, u->msg);
+            return;
+        }
+    }
+}
+
+static void chunk_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    upload_ck_t *c = ctx;
+    upload_t *u = c->u;
+    upload_done_fn done = NULL;
+    void *dctx = NULL;
+    upload_progress_fn progress = NULL;
+    bool resend = false;
+    unsigned acked = 0;
+    (void)resp;
+
+    pthread_mutex_lock(&u->lock);
+    u->inflight--;
+    if (status == CMD_OK) {
+        u->acked++;
+        acked = u->acked;
+        progress = u->progress;
+    } else if (status == CMD_ERR && ++u->tries[c->k] < UPLOAD_CHUNK_TRIES) {
+        // Кусок не сошёлся по CRC (или смещению) — ещё раз, место в окне его
+        u->inflight++;
+        resend = true;
+    } else {
+        char msg[96];
+        snprintf(msg, sizeof(msg), status == CMD_ERR ? "Загрузка прервана: кусок %u не принят"
+                                                    : "Загрузка прервана: нет ответа на кусок %u", c->k);
+        finish_locked(u, msg, &done, &dctx);
+    }
+    bool finished = u->finished;
+    pthread_mutex_unlock(&u->lock);
+
+    if (done) done(dctx, status, u->msg);
+    if (finished) return;
+    if (progress) progress(u->ctx, acked, u->chunks);
+    if (resend) {
+        atomic_fetch_add(&u->resent, 1);
+        if (!send_chunk(u, c->k)) {
+            pthread_mutex_lock(&u->lock);
+            u->inflight--;
+            finish_locked(u, "Загрузка прервана: команда не ушла", &done, &dctx);
+            pthread_mutex_unlock(&u->lock);
+            if (done) done(dctx, CMD_CANCELLED, u->msg);
+        }
+        return;
+    }
+    pump(u);
+}
+
+static void legacy_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    upload_t *u = ctx;
+    upload_done_fn done = NULL;
+    void *dctx = NULL;
+    char msg[96];
+    (void)resp;
+    snprintf(msg, sizeof(msg), status == CMD_OK ? "Форма загружена одним кадром: %u точек"
+                                                : "Форма не принята (upload_wave): %u точек", u->n);
+    pthread_mutex_lock(&u->lock);
+    finish_locked(u, msg, &done, &dctx);
+    pthread_mutex_unlock(&u->lock);
+    if (done) done(dctx, status, msg);
+}
+
+// Ответ на upload_begin: окно кусков; старая прошивка — одним кадром
+static void begin_done(void *ctx, int status, const proto_frame_t *resp)
+{
+    upload_t *u = ctx;
+    upload_done_fn done = NULL;
+    void *dctx = NULL;
+    char msg[96];
+    if (status == CMD_OK) {
+        pump(u);
+        return;
+    }
+    if (status == CMD_ERR && resp->len >= 1 && resp->payload[0] == PROTO_ERR_UNKNOWN &&
+        2 + u->n * 2 <= CMDCHAN_MAX_PAYLOAD) {
+        uint8_t p[CMDCHAN_MAX_PAYLOAD];
+        uint16_t n = (uint16_t)u->n;
+        memcpy(p, &n, 2);
+        memcpy(p + 2, u->pts, n * 2);
+        atomic_fetch_add(&u->legacy, 1);
+        if (cmdchan_send(u->cc, PROTO_CMD_GEN_UPLOAD, p, 2 + n * 2, legacy_done, u)) return;
+        status = CMD_CANCELLED;
+    }
+    if (status == CMD_ERR && resp->len >= 1 && resp->payload[0] == PROTO_ERR_UNKNOWN) {
+        snprintf(msg, sizeof(msg), "Прошивка без загрузки кусками: не больше %u точек",
+                 (unsigned)(CMDCHAN_MAX_PAYLOAD - 2) / 2);
+    } else {
+        snprintf(msg, sizeof(msg), status == CMD_ERR ? "Генератор отклонил форму (%u точек)"
+                                                     : "Загрузка прервана: нет ответа (%u точек)", u->n);
+    }
+    pthread_mutex_lock(&u->lock);
+    finish_locked(u, msg, &done, &dctx);
+    pthread_mutex_unlock(&u->lock);
+    if (done) done(dctx, status, msg);
+}
+
+bool upload_start(upload_t *u, cmdchan_t *cc, const uint16_t *pts, uint32_t n, uint16_t chunk,
+                  upload_progress_fn progress, upload_done_fn done, void *ctx)
+{
+    if (n < 1 || n > UPLOAD_MAX_POINTS) return false;
+    if (chunk < 16) chunk = 16;
+    if (chunk > PROTO_UPLOAD_CHUNK_MAX) chunk = PROTO_UPLOAD_CHUNK_MAX;
+    pthread_mutex_lock(&u->lock);
+    if (u->active) {
+        pthread_mutex_unlock(&u->lock);
+        return false;
+    }
+    u->cc = cc;
+    memcpy(u->pts, pts, n * sizeof(uint16_t));
+    u->n = n;
+    u->chunk = chunk;
+    u->chunks = (n + chunk - 1) / chunk;
+    if (!u->window) u->window = UPLOAD_WINDOW;
+    u->next = u->inflight = u->acked = 0;
+    memset(u->tries, 0, sizeof(u->tries));
+    u->active = true;
+    u->finished = false;
+    u->progress = progress;
+    u->done = done;
+    u->ctx = ctx;
+    u->msg[0] = 0;
+    pthread_mutex_unlock(&u->lock);
+
+    uint8_t p[8];
+    uint16_t crc = crc16_ibm((const uint8_t *)pts, n * 2);
+    memcpy(p, &n, 4);
+    memcpy(p + 4, &chunk, 2);
+    memcpy(p + 6, &crc, 2);
+    u->t0 = now_s();
+    if (cmdchan_send(cc, PROTO_CMD_GEN_UPLOAD_BEGIN, p, sizeof(p), begin_done, u)) return true;
+    pthread_mutex_lock(&u->lock);
+    u->active = false;
+    pthread_mutex_unlock(&u->lock);
+    return false;
+}
+
+bool upload_busy(upload_t *u)
+{
+    pthread_mutex_lock(&u->lock);
+    bool b = u->active;
+    pthread_mutex_unlock(&u->lock);
+    return b;
+}
+
+// Чтение файла форм
+
+static uint8_t *read_all(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    uint8_t *buf = NULL;
+    size_t cap = 0;
+    *len = 0;
+    for (;;) {
+        if (*len == cap) {
+            cap = cap ? cap * 2 : 65536;
+            uint8_t *nb = realloc(buf, cap);
+            if (!nb) {
+                free(buf);
+                fclose(f);
+                return NULL;
+            }
+            buf = nb;
+        }
+        size_t r = fread(buf + *len, 1, cap - *len, f);
+        if (!r) break;
+        *len += r;
+    }
+    fclose(f);
+    return buf;
+}
+
+static uint32_t get_le(const uint8_t *p, unsigned bytes)
+{
+    uint32_t v = 0;
+    for (unsigned i = 0; i < bytes; i++) v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+
+// WAV: PCM 8/16/24/32 бит или float 32/64, первый канал
+static size_t parse_wav(const uint8_t *buf, size_t len, double **out, char *err, size_t errlen)
+{
+    unsigned fmt = 0, nch = 0, bits = 0;
+    const uint8_t *data = NULL;
+    size_t data_len = 0;
+    for (size_t pos = 12; pos + 8 <= len;) {
+        uint32_t sz = get_le(buf + pos + 4, 4);
+        const uint8_t *body = buf + pos + 8;
+        if (sz > len - pos - 8) sz = (uint32_t)(len - pos - 8);   // обрезанный файл
+        if (!memcmp(buf + pos, "fmt ", 4) && sz >= 16) {
+            fmt = get_le(body, 2);
+            nch = get_le(body + 2, 2);
+            bits = get_le(body + 14, 2);
+            if (fmt == 0xFFFE && sz >= 26) fmt = get_le(body + 24, 2);    // WAVE_FORMAT_EXTENSIBLE
+        } else if (!memcmp(buf + pos, "data", 4)) {
+            data = body;
+            data_len = sz;
+        }
+        pos += 8 + sz + (sz & 1);
+    }
+    bool pcm = fmt == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+    bool flt = fmt == 3 && (bits == 32 || bits == 64);
+    if (!data || !nch || (!pcm && !flt)) {
+        snprintf(err, errlen, "WAV: нужен PCM 8/16/24/32 бит или float");
+        return 0;
+    }
+    size_t frame = (size_t)nch * (bits / 8), n = data_len / frame;
+    double *x = malloc((n ? n : 1) * sizeof(double));
+    if (!x) {
+        snprintf(err, errlen, "WAV: нет памяти");
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *s = data + i * frame;
+        if (flt && bits == 32) {
+            float v;
+            memcpy(&v, s, 4);
+            x[i] = v;
+        } else if (flt) {
+            memcpy(&x[i], s, 8);
+        } else if (bits == 8) {
+            x[i] = s[0] - 128;                                  // 8 бит — без знака
+        } else {
+            uint32_t v = get_le(s, bits / 8) << (32 - bits);    // знак — в старший бит
+            x[i] = (int32_t)v;
+        }
+    }
+    *out = x;
+    return n;
+}
+
+// CSV: число из последнего столбца каждой строки (время, значение — берём
+// значение); строки без числа (заголовок) пропускаются. С разделителем ';'
+// запятая — десятичная.
+static size_t parse_csv(char *buf, size_t len, double **out, char *err, size_t errlen)
+{
+    size_t n = 0, cap = 4096;
+    double *x = malloc(cap * sizeof(double));
+    if (!x) {
+        snprintf(err, errlen, "CSV: нет памяти");
+        return 0;
+    }
+    buf[len] = 0;
+    for (char *line = buf; line && *line;) {
+        char *end = strchr(line, '\n');
+        if (end) *end = 0;
+        bool semi = strchr(line, ';') != NULL;
+        if (semi) {
+            for (char *c = line; *c; c++) {
+                if (*c == ',') *c = '.';
+            }
+        }
+        bool found = false;
+        double v = 0;
+        for (char *c = line; *c;) {
+            char *e;
+            double d = strtod(c, &e);
+            if (e != c && (!*e || *e == ',' || *e == ';' || *e == '\r' || isspace((unsigned char)*e))) {
+                v = d;
+                found = true;
+                c = e;
+            } else {
+                c = e != c ? e : c + 1;
+            }
+        }
+        if (found && isfinite(v)) {
+            if (n == cap) {
+                double *nx = realloc(x, (cap *= 2) * sizeof(double));
+                if (!nx) break;
+                x = nx;
+            }
+            x[n++] = v;
+        }
+        line = end ? end + 1 : NULL;
+    }
+    if (!n) {
+        snprintf(err, errlen, "CSV: ни одного числа");
+        free(x);
+        return 0;
+    }
+    *out = x;
+    return n;
+}
+
+uint32_t upload_load_file(const char *path, uint16_t *pts, uint32_t max, char *err, size_t errlen)
+{
+    size_t len = 0, n;
+    uint8_t *buf = read_all(path, &len);
+    double *x = NULL;
+    if (!buf) {
+        snprintf(err, errlen, "Не открыть %s", path);
+        return 0;
+    }
+    if (len >= 12 && !memcmp(buf, "RIFF", 4) && !memcmp(buf + 8, "WAVE", 4)) {
+        n = parse_wav(buf, len, &x, err, errlen);
+    } else {
+        uint8_t *nb = realloc(buf, len + 1);    // место под завершающий 0
+        if (nb) buf = nb;
+        n = nb ? parse_csv((char *)buf, len, &x, err, errlen) : 0;
+    }
+    free(buf);
+    if (!n) return 0;
+
+    double lo = x[0], hi = x[0];
+    for (size_t i = 1; i < n; i++) {
+        if (x[i] < lo) lo = x[i];
+        if (x[i] > hi) hi = x[i];
+    }
+    // Больше max — линейная передискретизация периода в max точек
+    uint32_t m = n > max ? max : (uint32_t)n;
+    for (uint32_t i = 0; i < m; i++) {
+        double pos = (double)i * n / m, v;
+        size_t k = (size_t)pos;
+        double fr = pos - k;
+        v = x[k] + (k + 1 < n ? (x[k + 1] - x[k]) * fr : 0);
+        pts[i] = hi > lo ? (uint16_t)lround((v - lo) / (hi - lo) * 4095) : 2048;
+    }
+    free(x);
+    return m;
+}
@@ -0,0 +1,78 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+// Загрузка пользовательской формы в генератор кусками (docs/protocol.md,
+// 0x19..0x1B): upload_begin с длиной и CRC всей таблицы, куски по
+// смещениям со своим CRC — до UPLOAD_WINDOW в полёте, следующий уходит по
+// подтверждению предыдущего, кусок с ошибкой — повторно; после всех —
+// upload_commit. Прошивка без 0x19 (err = 2): таблица, если помещается,
+// одним кадром upload_wave.
+//
+// Команды — через cmdchan, завершения — в потоке чтения порта: GTK не
+// трогать, progress и done только передают состояние (g_idle_add).
+// Без GTK — для bench/bench_upload.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cmdchan.h"
+
+#define UPLOAD_MAX_POINTS   PROTO_UPLOAD_MAX_POINTS
+#define UPLOAD_WINDOW       4       // кусков в полёте
+#define UPLOAD_CHUNK_TRIES  3       // отправок куска с ошибкой CRC
+#define UPLOAD_MAX_CHUNKS   (UPLOAD_MAX_POINTS / 16)
+
+// status — CMD_*; msg — итог для строки состояния
+typedef void (*upload_done_fn)(void *ctx, int status, const char *msg);
+typedef void (*upload_progress_fn)(void *ctx, unsigned acked, unsigned total);
+
+typedef struct upload upload_t;
+
+typedef struct {
+    upload_t *u;                        // ctx завершения куска для cmdchan
+    unsigned k;
+} upload_ck_t;
+
+struct upload {
+    cmdchan_t *cc;
+    pthread_mutex_t lock;
+    uint16_t pts[UPLOAD_MAX_POINTS];
+    uint32_t n;
+    uint16_t chunk;                     // точек в куске
+    unsigned chunks, window;
+    unsigned next;                      // первый неотправленный кусок
+    unsigned inflight, acked;
+    uint8_t tries[UPLOAD_MAX_CHUNKS];
+    upload_ck_t ck[UPLOAD_MAX_CHUNKS];
+    bool active, finished;
+    double t0;
+    upload_done_fn done;
+    upload_progress_fn progress;
+    void *ctx;
+    char msg[96];
+    // Счётчики
+    _Atomic unsigned resent;            // кусков отправлено повторно (CRC)
+    _Atomic unsigned legacy;            // загрузок одним кадром (старая прошивка)
+};
+
+bool upload_init(upload_t *u);
+void upload_free(upload_t *u);
+
+// Кусок под скорость линии: окно кусков должно уходить в порт заметно
+// быстрее таймаута cmdchan (иначе лишние повторы); 0 — без ограничения
+uint16_t upload_chunk_points(unsigned baud);
+
+// Начать загрузку n точек (коды ЦАП 0..4095); false — идёт прежняя,
+// n вне 1..UPLOAD_MAX_POINTS или команда не ушла (done не вызывается)
+bool upload_start(upload_t *u, cmdchan_t *cc, const uint16_t *pts, uint32_t n, uint16_t chunk,
+                  upload_progress_fn progress, upload_done_fn done, void *ctx);
+bool upload_busy(upload_t *u);
+
+// Файл формы (CSV или WAV) в коды ЦАП: размах файла — на всю шкалу
+// 0..4095, больше max точек — передискретизация до max (файл — один
+// период). Возвращает число точек, 0 — ошибка (текст в err).
+uint32_t upload_load_file(const char *path, uint16_t *pts, uint32_t max, char *err, size_t errlen);
+
+#endif